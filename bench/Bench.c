@@ -0,0 +1,740 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <math.h>
+#include "../src/network/Network.h"
+#include "../src/train/NetworkTrain.h"
+
+#define Bench_SAMPLE_COUNT 1024
+#define Bench_MAX_LATENCIES 100000
+#define Bench_MIN_BATCH_NS 20000
+#define Bench_MAX_REPEAT 31
+#define Bench_MAD_SCALE 1.4826 //MAD to standard deviation, for normally distributed noise
+#define Bench_MEDIAN_SCALE 1.2533 //standard error of the median of n runs, in standard deviations of one run, times sqrt(n)
+#define Bench_SEED 42
+#define Bench_MIN_SPEED_KERNELS 8 //below that many compared kernels, the speed of the machine is not estimated
+#define Bench_LAYOUTS 3 //copies of each topology at different addresses: the speed of some kernels depends on where the network lies in memory
+
+#define Bench_SCOPE_NETWORK 0	//the kernel touches every synapse of the network
+#define Bench_SCOPE_NEURON 1	//the first neuron of the first hidden layer
+#define Bench_SCOPE_LAYER 2		//the first hidden layer
+
+
+
+//TYPE DEFINITIONS
+	typedef struct {
+		const char *name;
+		NeuralNetwork net;
+		TrainDataSet data;
+		TrainDataProvider provider;
+		BPTrainer trainer;
+		NetworkPlan plan;
+		NeuronUnit *rows;
+		NeuronUnit *weights;
+		NeuronUnit *gradient;
+		NeuronUnit *errorDerivatives;
+		NeuronUnit *expected;
+		unsigned int nextSample;
+	} BenchTopology;
+
+	typedef struct {
+		const char *kernel;
+		const char *topology;
+		unsigned long int synapses;
+		unsigned long int calls;
+		double p50;
+		double p90;
+		double p99;
+		double samplesPerSecond;	//of a run: from its median latency per call. Aggregated: median over the repeated runs
+		double madSamplesPerSecond;	//median absolute deviation over the repeated runs
+		unsigned int runs;
+		double gflops;
+		double bytesPerSynapse;
+	} BenchResult;
+
+	typedef struct {
+		const char *name;
+		void (*run)(BenchTopology* top, unsigned int count);
+		double flopsPerSynapse; //floating point operations per synapse and call
+		unsigned char scope;	//which synapses a call touches
+	} BenchKernel;
+
+	typedef struct {
+		double minSeconds;
+		unsigned int repeat;
+		unsigned int maxRepeat;	//kernels still too noisy after repeat runs get more, up to maxRepeat
+		const char *filter;
+		const char *outputPath;
+		const char *baselinePath;
+		double threshold;	//relative throughput drop that always fails the comparison
+		double noiseFactor;	//drops within noiseFactor standard errors (from the MADs) are tolerated
+		double maxNoise;	//relative noise allowance above which a kernel is too noisy to judge
+	} BenchOptions;
+
+	typedef struct {
+		char kernel[64];
+		char topology[64];
+		double samplesPerSecond;
+		double madSamplesPerSecond;
+		unsigned int runs;
+	} BaselineEntry;
+
+
+
+//UTILS
+	static double nowNs() {
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec * 1e9 + ts.tv_nsec;
+	}
+
+	static double randomUnit() {
+		return (double)rand() / RAND_MAX * 2 - 1;
+	}
+
+	static int compareDoubles(const void *a, const void *b) {
+		double x = *(const double*)a, y = *(const double*)b;
+		return x < y? -1 : x > y? 1 : 0;
+	}
+
+	static void squaredError(NeuralNetwork* net, NeuronUnit* expected, NeuronUnit* errorValue, NeuronUnit* errorGradients) {
+		NetworkLayer *out = net->layers + net->layerCount - 1;
+		NeuronUnit sum = 0;
+		for (unsigned short int i = out->neuronCount; i--;) {
+			NeuronUnit diff = out->neurons[i].out - expected[i];
+			errorGradients[i] = 2 * diff;
+			sum += diff * diff;
+		}
+		*errorValue = sum;
+	}
+
+
+
+//TOPOLOGIES
+	static void BenchTopology_setup(BenchTopology* this, const char *name, NeuralNetworkStructure *str) {
+		this->name = name;
+		NeuralNetwork_init(&this->net, str);
+
+		//the same weights and data on every run (NeuralNetwork_randomSynapses seeds with the time)
+		srand(Bench_SEED);
+		for (unsigned short int i = this->net.layerCount - 1; i--;) NetworkLayer_randomSynapses(this->net.layers + i);
+
+		NeuralNetwork *net = &this->net;
+		unsigned short int inputCount = net->layers[0].neuronCount;
+		unsigned short int outputCount = net->layers[net->layerCount - 1].neuronCount;
+		unsigned long int rowSize = inputCount + outputCount;
+
+		this->rows = malloc(Bench_SAMPLE_COUNT * rowSize * sizeof(NeuronUnit));
+		for (unsigned long int i = 0; i < Bench_SAMPLE_COUNT * rowSize; ++i) this->rows[i] = randomUnit();
+		TrainDataSet_init(&this->data, this->rows, Bench_SAMPLE_COUNT, inputCount, outputCount);
+		TrainDataProvider_initIndexed(&this->provider, *TrainDataSet_provideSample, &this->data, outputCount, Bench_SAMPLE_COUNT, 0, 0);
+		BPTrainer_init(&this->trainer, net, &this->provider, *squaredError);
+
+		this->weights = malloc(net->synapseCount * sizeof(NeuronUnit));
+		this->gradient = calloc(net->synapseCount, sizeof(NeuronUnit));
+		this->errorDerivatives = malloc(outputCount * sizeof(NeuronUnit));
+		this->expected = malloc(outputCount * sizeof(NeuronUnit));
+		this->nextSample = 0;
+		NeuralNetwork_saveSynapseWeights(net, this->weights);
+		NetworkPlan_init(&this->plan, net);
+	}
+
+	static void BenchTopology_deinit(BenchTopology* this) {
+		BPTrainer_deinit(&this->trainer);
+		TrainDataProvider_deinit(&this->provider);
+		TrainDataSet_deinit(&this->data);
+		NetworkPlan_deinit(&this->plan);
+		NeuralNetwork_deinit(&this->net);
+		free(this->rows);
+		free(this->weights);
+		free(this->gradient);
+		free(this->errorDerivatives);
+		free(this->expected);
+	}
+
+	static void createDense(BenchTopology* top, const char *name, int *sizes, unsigned short int layerCount, unsigned char activator) {
+		NetworkLayerStructure layers[layerCount];
+		for (unsigned short int i = 0; i < layerCount; ++i) {
+			layers[i] = (NetworkLayerStructure) {
+				.connectionType = (i == layerCount - 1)? NetworkLayer_OUTPUT : NetworkLayer_FULLY_CONNECTED,
+				.neuronCount = sizes[i],
+				.activatorType = (i == layerCount - 1)? NeuronActivator_LINEAR : activator
+			};
+		}
+
+		NeuralNetworkStructure str = { layers };
+		BenchTopology_setup(top, name, &str);
+	}
+
+	/** Each neuron (and bias) connects to fanOut distinct random neurons of the next layer. */
+	static void createSparse(BenchTopology* top, const char *name, int *sizes, unsigned short int layerCount, unsigned short int fanOut) {
+		NetworkLayerStructure layers[layerCount];
+		srand(7);
+
+		for (unsigned short int i = 0; i < layerCount; ++i) {
+			layers[i] = (NetworkLayerStructure) {
+				.connectionType = NetworkLayer_OUTPUT,
+				.neuronCount = sizes[i],
+				.activatorType = (i == layerCount - 1)? NeuronActivator_LINEAR : NeuronActivator_RELU
+			};
+			if (i == layerCount - 1) break;
+
+			layers[i].connectionType = NetworkLayer_INDIVIDUAL;
+			layers[i].neurons = malloc((sizes[i] + 1) * sizeof(int*));
+			layers[i].neurons[sizes[i]] = NULL;
+
+			for (int j = 0; j <= sizes[i]; ++j) {
+				int *targets = malloc((fanOut + 1) * sizeof(int));
+				char used[sizes[i+1]];
+				memset(used, 0, sizes[i+1]);
+				int count = 0;
+				while (count < fanOut && count < sizes[i+1]) {
+					int target = rand() % sizes[i+1];
+					if (used[target]) continue;
+					used[target] = 1;
+					count++;
+				}
+				count = 0;
+				for (int k = 0; k < sizes[i+1]; ++k) if (used[k]) targets[count++] = k;
+				targets[count] = -1;
+
+				if (j == sizes[i]) layers[i].bias = targets;
+				else layers[i].neurons[j] = targets;
+			}
+		}
+
+		NeuralNetworkStructure str = { layers };
+		BenchTopology_setup(top, name, &str);
+
+		for (unsigned short int i = 0; i < layerCount - 1; ++i) {
+			for (int j = 0; j < sizes[i]; ++j) free(layers[i].neurons[j]);
+			free(layers[i].neurons);
+			free(layers[i].bias);
+		}
+	}
+
+	static void createXor(BenchTopology* top) {
+		NeuralNetworkStructure str = {
+			(NetworkLayerStructure[]) {
+				(NetworkLayerStructure) {
+					.connectionType = NetworkLayer_FULLY_CONNECTED,
+					.neuronCount = 2,
+				},
+				(NetworkLayerStructure) {
+					.connectionType = NetworkLayer_INDIVIDUAL,
+					.neurons = (int*[]) {
+						(int[]) {1, 2, -1},
+						(int[]) {0, 1, -1},
+						(int[]) {0, 2, -1},
+						(int[]) {0, 2, -1},
+						(int[]) {0, 1, 2, -1},
+						NULL
+					},
+					.bias = (int[]) {-1},
+					.activatorType = NeuronActivator_LEAKY_RELU
+				},
+				(NetworkLayerStructure) {
+					.connectionType = NetworkLayer_FULLY_CONNECTED,
+					.neuronCount = 3,
+					.activatorType = NeuronActivator_LEAKY_RELU
+				},
+				(NetworkLayerStructure) {
+					.connectionType = NetworkLayer_OUTPUT,
+					.neuronCount = 1,
+					.activatorType = NeuronActivator_LINEAR,
+				},
+			}
+		};
+		BenchTopology_setup(top, "tiny_xor", &str);
+	}
+
+
+
+//KERNELS
+	static void Bench_predict(BenchTopology* top, unsigned int count) {
+		for (unsigned int i = 0; i < count; ++i) {
+			TrainDataSet_loadSample(&top->data, &top->net, top->nextSample, top->expected);
+			top->nextSample = (top->nextSample + 1) % Bench_SAMPLE_COUNT;
+			NeuralNetwork_predict(&top->net);
+		}
+	}
+
+	static void Bench_planRun(BenchTopology* top, unsigned int count) {
+		NetworkLayer *outputLayer = top->net.layers + top->net.layerCount - 1;
+		unsigned long int rowSize = top->net.layers[0].neuronCount + outputLayer->neuronCount;
+		for (unsigned int i = 0; i < count; ++i) {
+			NetworkPlan_run(&top->plan, top->rows + top->nextSample * rowSize, top->expected);
+			top->nextSample = (top->nextSample + 1) % Bench_SAMPLE_COUNT;
+		}
+	}
+
+	static void Bench_addToGradient(BenchTopology* top, unsigned int count) {
+		for (unsigned int i = 0; i < count; ++i) NeuralNetwork_addToGradient(&top->net, top->errorDerivatives, top->gradient);
+	}
+
+	/** Layer kernels run on the first hidden layer. */
+	static void Bench_neuronFire(BenchTopology* top, unsigned int count) {
+		Neuron *neuron = top->net.layers[1].neurons;
+		for (unsigned int i = 0; i < count; ++i) Neuron_fire(neuron);
+	}
+
+	static void Bench_layerFire(BenchTopology* top, unsigned int count) {
+		NetworkLayer *layer = top->net.layers + 1;
+		for (unsigned int i = 0; i < count; ++i) {
+			NetworkLayer_reset(layer + 1);
+			NetworkLayer_fire(layer);
+		}
+	}
+
+	static void Bench_layerSaveGradient(BenchTopology* top, unsigned int count) {
+		NetworkLayer *layer = top->net.layers + 1;
+		unsigned long int offset = top->net.layers[0].synapseCount;
+		for (unsigned int i = 0; i < count; ++i) NetworkLayer_saveGradient(layer, top->gradient + offset);
+	}
+
+	static void Bench_adjustWeights(BenchTopology* top, unsigned int count) {
+		for (unsigned int i = 0; i < count; ++i) NeuralNetwork_adjustWeights(&top->net, top->gradient);
+	}
+
+	static void Bench_trainOnline(BenchTopology* top, unsigned int count) {
+		TrainDataProvider_reset(&top->provider, count);
+		BPTrainer_trainOnline(&top->trainer, 1e-4, 0, 0);
+	}
+
+	static void Bench_trainStochastic(BenchTopology* top, unsigned int count) {
+		TrainDataProvider_reset(&top->provider, count);
+		BPTrainer_trainStochastic(&top->trainer, 32, 1e-4, 0, 0);
+	}
+
+	static BenchKernel kernels[] = {
+		{ "predict", Bench_predict, 2, Bench_SCOPE_NETWORK },
+		{ "planRun", Bench_planRun, 2, Bench_SCOPE_NETWORK },
+		{ "addToGradient", Bench_addToGradient, 4, Bench_SCOPE_NETWORK },
+		{ "trainOnline", Bench_trainOnline, 8, Bench_SCOPE_NETWORK },
+		{ "trainStochastic", Bench_trainStochastic, 8, Bench_SCOPE_NETWORK },
+		{ "neuronFire", Bench_neuronFire, 2, Bench_SCOPE_NEURON },
+		{ "layerFire", Bench_layerFire, 2, Bench_SCOPE_LAYER },
+		{ "layerSaveGradient", Bench_layerSaveGradient, 3, Bench_SCOPE_LAYER },
+		{ "adjustWeights", Bench_adjustWeights, 1, Bench_SCOPE_NETWORK },
+	};
+
+	static unsigned long int Bench_kernelSynapses(BenchKernel* kernel, BenchTopology* top) {
+		switch (kernel->scope) {
+			case Bench_SCOPE_NEURON: return top->net.layers[1].neurons[0].synapseCount;
+			case Bench_SCOPE_LAYER: return top->net.layers[1].synapseCount;
+			default: return top->net.synapseCount;
+		}
+	}
+
+
+
+//MEASUREMENT
+	/** Times kernel in batches big enough to hide the timer overhead, until minSeconds have passed.
+	 * Latency percentiles are per call, derived from the batch times. */
+	static void Bench_measureOnce(BenchOptions* options, BenchKernel* kernel, BenchTopology* top, BenchResult* result) {
+		NeuralNetwork *net = &top->net;
+		NeuralNetwork_loadSynapseWeights(net, top->weights);
+		Bench_predict(top, 1);
+		for (unsigned short int i = net->layers[net->layerCount - 1].neuronCount; i--;) top->errorDerivatives[i] = 0.1;
+		for (unsigned long int i = net->synapseCount; i--;) top->gradient[i] = 0;
+
+		//pick the batch size
+		unsigned int batch = 1;
+		while (batch < (1 << 16)) {
+			double start = nowNs();
+			kernel->run(top, batch);
+			if (nowNs() - start >= Bench_MIN_BATCH_NS) break;
+			batch *= 2;
+		}
+
+		double *latencies = malloc(Bench_MAX_LATENCIES * sizeof(double));
+		unsigned long int latencyCount = 0, calls = 0;
+		double total = 0;
+		while ((total < options->minSeconds * 1e9 || latencyCount < 10) && latencyCount < Bench_MAX_LATENCIES) {
+			double start = nowNs();
+			kernel->run(top, batch);
+			double elapsed = nowNs() - start;
+
+			latencies[latencyCount++] = elapsed / batch;
+			calls += batch;
+			total += elapsed;
+		}
+
+		qsort(latencies, latencyCount, sizeof(double), compareDoubles);
+		result->kernel = kernel->name;
+		result->topology = top->name;
+		result->synapses = net->synapseCount;
+		result->calls = calls;
+		result->p50 = latencies[latencyCount / 2];
+		result->p90 = latencies[latencyCount * 9 / 10];
+		result->p99 = latencies[latencyCount * 99 / 100];
+		result->samplesPerSecond = 1e9 / result->p50; //unlike calls / total, not skewed by the batches the machine was busy elsewhere
+		result->madSamplesPerSecond = 0;
+		result->runs = 1;
+		result->gflops = kernel->flopsPerSynapse * Bench_kernelSynapses(kernel, top) * result->samplesPerSecond / 1e9;
+		result->bytesPerSynapse = (double) NeuralNetwork_modelBytes(&top->net) / net->synapseCount;
+
+		free(latencies);
+		NeuralNetwork_loadSynapseWeights(net, top->weights);
+	}
+
+	static int compareThroughput(const void *a, const void *b) {
+		return compareDoubles(&((const BenchResult*)a)->samplesPerSecond, &((const BenchResult*)b)->samplesPerSecond);
+	}
+
+	/** Combines repeated runs of one kernel: reports the run with the median throughput, plus the MAD of the throughputs. */
+	static void Bench_aggregate(BenchResult* runs, unsigned int repeat, BenchResult* result) {
+		qsort(runs, repeat, sizeof(BenchResult), compareThroughput);
+
+		*result = runs[repeat / 2];
+		double deviations[repeat];
+		for (unsigned int i = 0; i < repeat; ++i) deviations[i] = fabs(runs[i].samplesPerSecond - result->samplesPerSecond);
+		qsort(deviations, repeat, sizeof(double), compareDoubles);
+		result->madSamplesPerSecond = deviations[repeat / 2];
+		result->runs = repeat;
+	}
+
+
+
+//BASELINE COMPARISON
+	/** Reads a result line of a file written by Bench_writeJson. Returns 0 if the line is not a result. */
+	static char Bench_parseEntry(const char *line, BaselineEntry* e) {
+		char *kernel = strstr(line, "\"kernel\": \"");
+		char *topology = strstr(line, "\"topology\": \"");
+		char *throughput = strstr(line, "\"samples_per_sec\": ");
+		char *mad = strstr(line, "\"mad_samples_per_sec\": ");
+		char *runs = strstr(line, "\"runs\": ");
+		if (kernel == NULL || topology == NULL || throughput == NULL) return 0;
+
+		if (sscanf(kernel, "\"kernel\": \"%63[^\"]", e->kernel) != 1) return 0;
+		if (sscanf(topology, "\"topology\": \"%63[^\"]", e->topology) != 1) return 0;
+		e->samplesPerSecond = atof(throughput + strlen("\"samples_per_sec\": "));
+		e->madSamplesPerSecond = mad == NULL? 0 : atof(mad + strlen("\"mad_samples_per_sec\": "));
+		e->runs = runs == NULL? 1 : atoi(runs + strlen("\"runs\": "));
+		if (e->runs < 1) e->runs = 1;
+		return 1;
+	}
+
+	/** Reads the results of a file written by Bench_writeJson. Returns the number of entries read, or -1 if the file cannot be opened. */
+	static int Bench_readBaseline(const char *path, BaselineEntry *entries, int maxEntries) {
+		FILE *in = fopen(path, "r");
+		if (in == NULL) return -1;
+
+		char line[1024];
+		int count = 0;
+		while (count < maxEntries && fgets(line, sizeof(line), in) != NULL) {
+			if (Bench_parseEntry(line, entries + count)) count++;
+		}
+
+		fclose(in);
+		return count;
+	}
+
+	/** Relative standard error of the median throughput of runs repeated runs, estimated from their MAD. */
+	static double Bench_relativeError(double samplesPerSecond, double madSamplesPerSecond, unsigned int runs) {
+		return Bench_MAD_SCALE * madSamplesPerSecond / samplesPerSecond * Bench_MEDIAN_SCALE / sqrt(runs);
+	}
+
+	static BaselineEntry* Bench_findBaseline(BaselineEntry *baseline, int baselineCount, BenchResult* result) {
+		for (int j = 0; j < baselineCount; ++j) {
+			if (strcmp(baseline[j].kernel, result->kernel) == 0 && strcmp(baseline[j].topology, result->topology) == 0) return baseline + j;
+		}
+		return NULL;
+	}
+
+	/** Prints a per kernel diff against the baseline. Returns the number of failed kernels.
+	 * The speed of the whole machine drifts between runs (clock, neighbours), so on a slower machine each change is taken relative to the median
+	 * change of all kernels: a kernel regresses when it falls behind the others by more than the larger of the relative threshold and the noise allowance,
+	 * noiseFactor standard errors of the ratio of both medians, estimated from their relative MADs. A kernel whose allowance is above
+	 * maxNoise only gets a warning: it is too noisy to tell a regression apart, so rerun on a quieter machine, or with more repeats.
+	 * So does a drop of all kernels together, as that cannot be told apart from a slower machine.
+	 * A baseline kernel without a current result (within the filter) fails too: it must not drop out of the gate unnoticed.
+	 * regressed, if not NULL, flags the results that regressed. */
+	static int Bench_compare(BenchOptions* options, BenchResult *results, unsigned int count, char *regressed) {
+		BaselineEntry baseline[256];
+		int baselineCount = Bench_readBaseline(options->baselinePath, baseline, 256);
+		if (baselineCount < 0) {
+			fprintf(stderr, "Cannot read baseline %s\n", options->baselinePath);
+			return 1;
+		}
+
+		double ratios[count];
+		unsigned int ratioCount = 0;
+		for (unsigned int i = 0; i < count; ++i) {
+			BaselineEntry *base = Bench_findBaseline(baseline, baselineCount, results + i);
+			if (base != NULL) ratios[ratioCount++] = results[i].samplesPerSecond / base->samplesPerSecond;
+		}
+		qsort(ratios, ratioCount, sizeof(double), compareDoubles);
+		//only a slower machine is made up for: on a faster one, kernels that did not speed up with the rest would look slower
+		double machineSpeed = ratioCount < Bench_MIN_SPEED_KERNELS? 1 : fmin(1, ratios[ratioCount / 2]);
+
+		int regressions = 0, noisy = 0, missing = 0;
+		fprintf(stderr, "\n%-36s %14s %14s %9s %9s  %s\n", "kernel", "baseline/s", "current/s", "change", "allowed", "status");
+		for (unsigned int i = 0; i < count; ++i) {
+			BenchResult *r = results + i;
+			char label[128];
+			snprintf(label, sizeof(label), "%s/%s", r->topology, r->kernel);
+			if (regressed != NULL) regressed[i] = 0;
+
+			BaselineEntry *base = Bench_findBaseline(baseline, baselineCount, r);
+			if (base == NULL) {
+				fprintf(stderr, "%-36s %14s %14.1f %9s %9s  new\n", label, "-", r->samplesPerSecond, "-", "-");
+				continue;
+			}
+
+			double baseError = Bench_relativeError(base->samplesPerSecond, base->madSamplesPerSecond, base->runs);
+			double currentError = Bench_relativeError(r->samplesPerSecond, r->madSamplesPerSecond, r->runs);
+			double noise = options->noiseFactor * sqrt(baseError * baseError + currentError * currentError);
+			double allowed = fmax(options->threshold, noise);
+			double change = r->samplesPerSecond / base->samplesPerSecond / machineSpeed - 1;
+
+			const char *status = "ok";
+			if (noise > options->maxNoise) {
+				status = "too noisy";
+				noisy++;
+			}
+			else if (change < -allowed) {
+				status = "REGRESSION";
+				regressions++;
+				if (regressed != NULL) regressed[i] = 1;
+			}
+			fprintf(stderr, "%-36s %14.1f %14.1f %+8.1f%% %8.1f%%  %s\n",
+				label, base->samplesPerSecond, r->samplesPerSecond, change * 100, -allowed * 100, status);
+		}
+
+		for (int j = 0; j < baselineCount; ++j) {
+			char label[128];
+			snprintf(label, sizeof(label), "%s/%s", baseline[j].topology, baseline[j].kernel);
+			if (options->filter != NULL && strstr(label, options->filter) == NULL) continue;
+
+			char found = 0;
+			for (unsigned int i = 0; i < count && !found; ++i) {
+				found = strcmp(baseline[j].kernel, results[i].kernel) == 0 && strcmp(baseline[j].topology, results[i].topology) == 0;
+			}
+			if (found) continue;
+			fprintf(stderr, "%-36s %14.1f %14s %9s %9s  MISSING\n", label, baseline[j].samplesPerSecond, "-", "-", "-");
+			missing++;
+		}
+
+		fprintf(stderr, "\n");
+		if (machineSpeed < 1) fprintf(stderr, "The machine is %.1f%% slower than for the baseline (median of all kernels): changes are relative to that\n", (1 - machineSpeed) * 100);
+		if (regressions > 0) fprintf(stderr, "%d kernel(s) slower than the baseline %s\n", regressions, options->baselinePath);
+		if (missing > 0) fprintf(stderr, "%d kernel(s) of the baseline %s were not measured\n", missing, options->baselinePath);
+		if (noisy > 0) fprintf(stderr, "Warning: %d kernel(s) too noisy to judge (allowance above %.0f%%)\n", noisy, options->maxNoise * 100);
+		if (machineSpeed < 1 - options->maxNoise) fprintf(stderr, "Warning: all kernels are %.0f%% slower: a slower machine, or a regression of everything\n", (1 - machineSpeed) * 100);
+		if (regressions + missing == 0) fprintf(stderr, "No regressions against %s\n", options->baselinePath);
+		return regressions + missing;
+	}
+
+
+
+	static void Bench_writeJsonHeader(FILE *out) {
+		char host[256] = "unknown";
+		gethostname(host, sizeof(host) - 1);
+		fprintf(out, "{\n\t\"version\": 1,\n\t\"host\": \"%s\",\n\t\"compiler\": \"%s\",\n\t\"timestamp\": %ld,\n\t\"results\": [\n", host, __VERSION__, (long int) time(NULL));
+	}
+
+	static void Bench_writeJson(FILE *out, BenchResult *results, unsigned int count) {
+		Bench_writeJsonHeader(out);
+		for (unsigned int i = 0; i < count; ++i) {
+			BenchResult *r = results + i;
+			fprintf(out, "\t\t{\"kernel\": \"%s\", \"topology\": \"%s\", \"synapses\": %lu, \"calls\": %lu, "
+				"\"p50_ns\": %.1f, \"p90_ns\": %.1f, \"p99_ns\": %.1f, \"samples_per_sec\": %.1f, \"mad_samples_per_sec\": %.1f, \"runs\": %u, "
+				"\"gflops\": %.4f, \"bytes_per_synapse\": %.2f}%s\n",
+				r->kernel, r->topology, r->synapses, r->calls, r->p50, r->p90, r->p99, r->samplesPerSecond, r->madSamplesPerSecond, r->runs,
+				r->gflops, r->bytesPerSynapse,
+				i + 1 < count? "," : "");
+		}
+		fprintf(out, "\t]\n}\n");
+	}
+
+	/** Writes a baseline from several result files: per kernel, the result of the file where it was slowest.
+	 * The speed of a host can change for minutes (clock, neighbours), longer than one run of the bench sees,
+	 * so the baseline is recorded by several runs, and a regression must be slower than all of them. Returns 0 if a file cannot be read. */
+	static char Bench_mergeBaselines(char **paths, int pathCount, FILE *out) {
+		BaselineEntry slowest[256];
+		char (*lines)[1024] = malloc(256 * sizeof(*lines));
+		int count = 0;
+		for (int p = 0; p < pathCount; ++p) {
+			FILE *in = fopen(paths[p], "r");
+			if (in == NULL) {
+				free(lines);
+				return 0;
+			}
+
+			char line[1024];
+			while (fgets(line, sizeof(line), in) != NULL) {
+				BaselineEntry e;
+				if (!Bench_parseEntry(line, &e)) continue;
+
+				int j = 0;
+				while (j < count && (strcmp(slowest[j].kernel, e.kernel) != 0 || strcmp(slowest[j].topology, e.topology) != 0)) j++;
+				if (j == count) {
+					if (count == 256) continue;
+					count++;
+				}
+				else if (slowest[j].samplesPerSecond <= e.samplesPerSecond) continue;
+				slowest[j] = e;
+				*(strrchr(line, '}') + 1) = 0;	//the separator is written again, as the last entry changes
+				strcpy(lines[j], line);
+			}
+			fclose(in);
+		}
+
+		Bench_writeJsonHeader(out);
+		for (int j = 0; j < count; ++j) fprintf(out, "%s%s\n", lines[j], j + 1 < count? "," : "");
+		fprintf(out, "\t]\n}\n");
+		free(lines);
+		return 1;
+	}
+
+
+
+//MAIN
+	static void Bench_printUsage() {
+		fprintf(stderr, "usage: bench [--quick] [--time seconds] [--repeat n] [--max-repeat n] [--filter text] [-o file|-] [--compare baseline.json] [--threshold ratio] [--max-noise ratio]\n");
+		fprintf(stderr, "       bench [-o file|-] --merge results.json...\n");
+	}
+
+	/** Whether runs of a kernel pin its median down well enough: compared against a baseline as precise, the noise allowance stays within maxNoise. */
+	static char Bench_isSettled(BenchOptions* options, BenchResult* runs, unsigned int runCount) {
+		if (runCount < 3) return 0;
+		BenchResult aggregated;
+		Bench_aggregate(runs, runCount, &aggregated);
+		double error = Bench_relativeError(aggregated.samplesPerSecond, aggregated.madSamplesPerSecond, runCount);
+		return options->noiseFactor * sqrt(2) * error <= options->maxNoise;
+	}
+
+	int main(int argc, char **argv) {
+		BenchOptions options = {
+			.minSeconds = 0.3,
+			.repeat = 1,
+			.maxRepeat = 0,
+			.filter = NULL,
+			.outputPath = "out/bench.json",
+			.baselinePath = NULL,
+			.threshold = 0.1,
+			.noiseFactor = 3,
+			.maxNoise = 0.2
+		};
+		for (int i = 1; i < argc; ++i) {
+			if (strcmp(argv[i], "--quick") == 0) options.minSeconds = 0.05;
+			else if (strcmp(argv[i], "--time") == 0 && i + 1 < argc) options.minSeconds = atof(argv[++i]);
+			else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) options.filter = argv[++i];
+			else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) options.outputPath = argv[++i];
+			else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) options.repeat = atoi(argv[++i]);
+			else if (strcmp(argv[i], "--max-repeat") == 0 && i + 1 < argc) options.maxRepeat = atoi(argv[++i]);
+			else if (strcmp(argv[i], "--compare") == 0 && i + 1 < argc) options.baselinePath = argv[++i];
+			else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) options.threshold = atof(argv[++i]);
+			else if (strcmp(argv[i], "--max-noise") == 0 && i + 1 < argc) options.maxNoise = atof(argv[++i]);
+			else if (strcmp(argv[i], "--merge") == 0 && i + 1 < argc) {
+				FILE *out = strcmp(options.outputPath, "-") == 0? stdout : fopen(options.outputPath, "w");
+				if (out == NULL) {
+					fprintf(stderr, "Cannot write %s\n", options.outputPath);
+					return 1;
+				}
+				char merged = Bench_mergeBaselines(argv + i + 1, argc - i - 1, out);
+				if (out != stdout) fclose(out);
+				if (!merged) fprintf(stderr, "Cannot read the results to merge\n");
+				return merged? 0 : 1;
+			}
+			else {
+				Bench_printUsage();
+				return 2;
+			}
+		}
+		if (options.repeat < 1) options.repeat = 1;
+		if (options.repeat > Bench_MAX_REPEAT) options.repeat = Bench_MAX_REPEAT;
+		if (options.maxRepeat < options.repeat) options.maxRepeat = options.repeat;
+		if (options.maxRepeat > Bench_MAX_REPEAT) options.maxRepeat = Bench_MAX_REPEAT;
+
+		BenchTopology layouts[Bench_LAYOUTS][4];
+		for (unsigned int l = 0; l < Bench_LAYOUTS; ++l) {
+			BenchTopology *topologies = layouts[l];
+			createXor(topologies + 0);
+			createDense(topologies + 1, "wide_dense", (int[]) {256, 512, 512, 10}, 4, NeuronActivator_RELU);
+			createDense(topologies + 2, "deep_narrow", (int[]) {16, 32, 32, 32, 32, 32, 32, 32, 32, 4}, 10, NeuronActivator_TANH);
+			createSparse(topologies + 3, "sparse_individual", (int[]) {256, 512, 512, 10}, 4, 16);
+		}
+
+		unsigned int kernelCount = sizeof(kernels) / sizeof(BenchKernel);
+		unsigned int maxRepeat = options.maxRepeat;
+		BenchResult *runs = malloc(4 * kernelCount * maxRepeat * sizeof(BenchResult));
+		unsigned int runCounts[4 * kernelCount];
+		BenchKernel *resultKernels[4 * kernelCount];
+		unsigned int resultTopologies[4 * kernelCount];
+		BenchResult results[4 * kernelCount];
+		unsigned int resultCount = 0;
+		memset(runCounts, 0, sizeof(runCounts));
+
+		//every sweep runs all kernels, so that slow drifts of the machine show up in the MAD, and on the next layout, so that the memory layout does too.
+		//After repeat sweeps, only the kernels that are still too noisy run again
+		for (unsigned int sweep = 0; sweep < maxRepeat; ++sweep) {
+			BenchTopology *topologies = layouts[sweep % Bench_LAYOUTS];
+			resultCount = 0;
+			unsigned int measured = 0;
+			for (unsigned int t = 0; t < 4; ++t) {
+				for (unsigned int k = 0; k < kernelCount; ++k) {
+					char label[128];
+					snprintf(label, sizeof(label), "%s/%s", topologies[t].name, kernels[k].name);
+					if (options.filter != NULL && strstr(label, options.filter) == NULL) continue;
+
+					resultKernels[resultCount] = kernels + k;
+					resultTopologies[resultCount] = t;
+					BenchResult *kernelRuns = runs + resultCount * maxRepeat;
+					unsigned int *runCount = runCounts + resultCount++;
+					if (sweep >= options.repeat && Bench_isSettled(&options, kernelRuns, *runCount)) continue;
+					Bench_measureOnce(&options, kernels + k, topologies + t, kernelRuns + (*runCount)++);
+					measured++;
+				}
+			}
+			if (measured == 0) break;
+		}
+
+		fprintf(stderr, "%-18s %-18s %12s %12s %12s %14s %10s %5s\n", "topology", "kernel", "p50 ns", "p90 ns", "p99 ns", "samples/s", "GFLOP/s", "runs");
+		for (unsigned int i = 0; i < resultCount; ++i) {
+			BenchResult *r = results + i;
+			Bench_aggregate(runs + i * maxRepeat, runCounts[i], r);
+			fprintf(stderr, "%-18s %-18s %12.1f %12.1f %12.1f %14.1f %10.3f %5u\n", r->topology, r->kernel, r->p50, r->p90, r->p99, r->samplesPerSecond, r->gflops, r->runs);
+		}
+
+		int regressions = 0;
+		if (options.baselinePath != NULL) {
+			char regressed[resultCount];
+			memset(regressed, 0, sizeof(regressed));
+			regressions = Bench_compare(&options, results, resultCount, regressed);
+
+			//a slow spell of the machine can outlast the runs of a kernel, but hardly a second set of them:
+			//the kernels that regressed are measured again from scratch, and only a regression that shows up twice counts
+			char confirm = 0;
+			for (unsigned int i = 0; i < resultCount; ++i) confirm |= regressed[i];
+			if (confirm) {
+				fprintf(stderr, "\nMeasuring the slower kernels again\n");
+				for (unsigned int i = 0; i < resultCount; ++i) if (regressed[i]) runCounts[i] = 0;
+				for (unsigned int sweep = 0; sweep < maxRepeat; ++sweep) {
+					BenchTopology *topologies = layouts[sweep % Bench_LAYOUTS];
+					for (unsigned int i = 0; i < resultCount; ++i) {
+						if (regressed[i]) Bench_measureOnce(&options, resultKernels[i], topologies + resultTopologies[i], runs + i * maxRepeat + runCounts[i]++);
+					}
+				}
+				for (unsigned int i = 0; i < resultCount; ++i) if (regressed[i]) Bench_aggregate(runs + i * maxRepeat, runCounts[i], results + i);
+				regressions = Bench_compare(&options, results, resultCount, NULL);
+			}
+		}
+		free(runs);
+
+		FILE *out = strcmp(options.outputPath, "-") == 0? stdout : fopen(options.outputPath, "w");
+		if (out == NULL) {
+			fprintf(stderr, "Cannot write %s\n", options.outputPath);
+			return 1;
+		}
+		Bench_writeJson(out, results, resultCount);
+		if (out != stdout) fclose(out);
+
+		for (unsigned int l = 0; l < Bench_LAYOUTS; ++l) {
+			for (unsigned int t = 0; t < 4; ++t) BenchTopology_deinit(layouts[l] + t);
+		}
+		return regressions == 0? 0 : 1;
+	}
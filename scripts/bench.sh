@@ -0,0 +1,6 @@
+ALL_C_FILES="$(find src -type f -name "*.c") $(find bench/ -type f -name "*.c")"
+gcc -O3 -march=native -o out/bench $ALL_C_FILES -lm -lpthread -DBENCHMARKS
+
+if [ $? -eq 0 ]; then
+    out/bench $@ > /dev/null
+fi
@@ -1,5 +1,5 @@
 ALL_C_FILES="$(find src -type f -name "*.c")"
-gcc -o out/main $ALL_C_FILES -lm
+gcc -o out/main $ALL_C_FILES -lm -lpthread
 
 if [ $? -eq 0 ]; then
     out/main $@
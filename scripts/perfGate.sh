@@ -0,0 +1,34 @@
+# Compares the benchmarks against bench/baseline.json, and fails on throughput regressions.
+# A kernel that looks slower is measured again, and fails only if it is still slower.
+# Kernels too noisy to judge only get a warning. The full report is in out/perfGate.log.
+# Run with --update to record a new baseline (on the machine that runs the gate): the speed of a host changes
+# over minutes, so the bench runs several times, and the baseline keeps the slowest run of each kernel.
+ALL_C_FILES="$(find src -type f -name "*.c") $(find bench/ -type f -name "*.c")"
+gcc -O3 -march=native -o out/bench $ALL_C_FILES -lm -lpthread -DBENCHMARKS
+if [ $? -ne 0 ]; then
+    exit 1
+fi
+
+BENCH_OPTIONS="--repeat 6 --max-repeat 24 --time 0.1"
+
+if [ "$1" = "--update" ]; then
+    for i in 1 2 3 4 5; do
+        out/bench $BENCH_OPTIONS -o out/baseline.$i.json 2> /dev/null || exit 1
+        sleep 10
+    done
+    out/bench -o bench/baseline.json --merge out/baseline.*.json
+    status=$?
+    rm -f out/baseline.*.json
+    exit $status
+fi
+
+out/bench $BENCH_OPTIONS -o out/bench.json --compare bench/baseline.json > /dev/null 2> out/perfGate.log
+status=$?
+if [ $status -ne 0 ]; then
+    cat out/perfGate.log
+else
+    # the last comparison is the verdict: earlier ones were measured again
+    awk '/^Measuring the slower kernels again/ { n = NR } { lines[NR] = $0 } END { for (i = n + 1; i <= NR; i++) print lines[i] }' out/perfGate.log \
+        | grep -E "too noisy|^Warning" | sed 's/^/perfGate: /'
+fi
+exit $status
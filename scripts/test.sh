@@ -1,6 +1,7 @@
 ALL_C_FILES="$(find src -type f -name "*.c") $(find test/ -type f -name "*.c")"
-gcc -o out/test $ALL_C_FILES -lm -DUNIT_TESTS
+gcc -o out/test $ALL_C_FILES -lm -lpthread -DUNIT_TESTS || exit 1
 
-if [ $? -eq 0 ]; then
-    out/test
+out/test || exit 1
+if [ "$1" != "--no-perf" ]; then
+    ./scripts/perfGate.sh || exit 1
 fi
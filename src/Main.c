@@ -1,8 +1,12 @@
 #include<stdio.h>
 #include "network/Network.h"
 #include "cli/NetworkCLI.h"
+#include "server/InferenceServer.h"
+#include <fcntl.h>
+#include <signal.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include<math.h>
 
 
@@ -109,9 +113,299 @@
 
 
 
+	/** main serve modelFile unix path|tcp port [maxBatch] [maxDelayUs] [watchIntervalMs]
+	 * Serves a saved model until SIGINT or SIGTERM, and reloads it whenever the file is replaced. */
+	int serveModel(int argc, char** argv) {
+		if (argc < 5 || (strcmp(argv[3], "unix") != 0 && strcmp(argv[3], "tcp") != 0)) {
+			printf("Usage: %s serve modelFile unix path|tcp port [maxBatch] [maxDelayUs] [watchIntervalMs]\n", argv[0]);
+			return 1;
+		}
+
+		NeuralNetwork net;
+		if (!NeuralNetwork_load(&net, argv[2])) {
+			printf("Could not load %s\n", argv[2]);
+			return 1;
+		}
+
+		//maxBatch, maxDelayUs and watchIntervalMs, within these bounds
+		long int values[] = {32, 1000, 1000};
+		const long int minimums[] = {1, 0, 1};
+		const long int maximums[] = {InferenceServer_MAX_BATCH, InferenceServer_MAX_DELAY_US, 3600000};
+		for (int i = 5; i < argc && i < 8; ++i) {
+			char* check;
+			values[i-5] = strtol(argv[i], &check, 10);
+			if (*check != '\0' || values[i-5] < minimums[i-5] || values[i-5] > maximums[i-5]) {
+				printf("Not an integer from %ld to %ld: %s\n", minimums[i-5], maximums[i-5], argv[i]);
+				NeuralNetwork_deinit(&net);
+				return 1;
+			}
+		}
+		unsigned int maxBatch = values[0];
+		unsigned int maxDelayUs = values[1];
+		unsigned int watchIntervalMs = values[2];
+
+		//every thread inherits this mask, so that only sigwait below sees the signals
+		sigset_t signals;
+		sigemptyset(&signals);
+		sigaddset(&signals, SIGINT);
+		sigaddset(&signals, SIGTERM);
+		pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+		SharedModel model;
+		SharedModel_init(&model, &net);
+		NeuralNetwork_deinit(&net);
+
+		InferenceServer server;
+		if (!InferenceServer_init(&server, &model, maxBatch, maxDelayUs, 16 * maxBatch)) {
+			printf("No free reader slot in the model\n");
+			SharedModel_deinit(&model);
+			return 1;
+		}
+		char started = strcmp(argv[3], "unix") == 0? InferenceServer_listenUnix(&server, argv[4]) : InferenceServer_listenTcp(&server, atoi(argv[4]));
+		if (!started) {
+			printf("Could not listen on %s\n", argv[4]);
+			InferenceServer_deinit(&server);
+			SharedModel_deinit(&model);
+			return 1;
+		}
+		printf("Serving %s on %s\n", argv[2], argv[4]);
+		fflush(stdout);
+
+		ModelWatcher watcher;
+		ModelWatcher_init(&watcher, &model, argv[2], watchIntervalMs);
+
+		int signal;
+		sigwait(&signals, &signal);
+
+		ModelWatcher_deinit(&watcher);
+		InferenceServer_printStats(&server, stdout);
+		printf("Model version %lu, %lu reloads, %lu failed\n", atomic_load(&model.version), atomic_load(&watcher.loads), atomic_load(&watcher.failures));
+		InferenceServer_deinit(&server);
+		SharedModel_deinit(&model);
+		return 0;
+	}
+
+
+
+	/** main predict modelFile input|- output|- [csv|bin] [csv|bin] [batchSize]
+	 * Predicts every row of the input (a file, or stdin for -), and streams the outputs, in the same order, to the output (stdout for -).
+	 * The formats are those of the input and of the output. */
+	int predictFile(int argc, char** argv) {
+		if (argc < 5) {
+			printf("Usage: %s predict modelFile input|- output|- [csv|bin] [csv|bin] [batchSize]\n", argv[0]);
+			return 1;
+		}
+
+		NeuralNetwork net;
+		if (!NeuralNetwork_load(&net, argv[2])) {
+			fprintf(stderr, "Could not load %s\n", argv[2]);
+			return 1;
+		}
+
+		unsigned char inputFormat = argc > 5 && strcmp(argv[5], "bin") == 0? BulkPredictor_BINARY : BulkPredictor_CSV;
+		unsigned char outputFormat = argc > 6 && strcmp(argv[6], "bin") == 0? BulkPredictor_BINARY : BulkPredictor_CSV;
+		unsigned int batchSize = 256;
+		if (argc > 7) {
+			char* check;
+			long int value = strtol(argv[7], &check, 10);
+			if (*check != '\0' || value <= 0) {
+				fprintf(stderr, "Not a positive batch size: %s\n", argv[7]);
+				NeuralNetwork_deinit(&net);
+				return 1;
+			}
+			batchSize = value > BulkPredictor_MAX_BATCH? BulkPredictor_MAX_BATCH : value;
+		}
+
+		int input = strcmp(argv[3], "-") == 0? STDIN_FILENO : open(argv[3], O_RDONLY);
+		FILE *output = strcmp(argv[4], "-") == 0? stdout : fopen(argv[4], "wb");
+		if (input < 0 || output == NULL) {
+			fprintf(stderr, "Could not open %s\n", input < 0? argv[3] : argv[4]);
+			if (input > 0) close(input);
+			NeuralNetwork_deinit(&net);
+			return 1;
+		}
+		setvbuf(output, NULL, _IOFBF, 1 << 20);
+
+		struct timespec start, end;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		BulkPredictor predictor;
+		BulkPredictor_init(&predictor, &net, inputFormat, outputFormat, batchSize);
+		char ok = BulkPredictor_run(&predictor, input, output);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		//the summary goes to stderr, stdout may carry the predictions
+		NeuronUnit seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+		fprintf(stderr, "%lu rows in %lu batches, %.3f s, %.0f rows/s%s\n", predictor.rows, predictor.batches, seconds,
+			seconds > 0? predictor.rows / seconds : 0, predictor.mapped? " (mapped input)" : "");
+		if (predictor.errorRow) fprintf(stderr, "Could not read row %lu\n", predictor.errorRow);
+		else if (!ok) fprintf(stderr, "Could not write the predictions\n");
+
+		if (input != STDIN_FILENO) close(input);
+		if (output != stdout) fclose(output);
+		NeuralNetwork_deinit(&net);
+		return ok? 0 : 1;
+	}
+
+
+
+	/** main generate modelFile output.c [name]
+	 * Writes a saved model as a standalone C function, see NeuralNetwork_generateC. */
+	int generateC(int argc, char** argv) {
+		if (argc < 4) {
+			printf("Usage: %s generate modelFile output.c [name]\n", argv[0]);
+			return 1;
+		}
+
+		NeuralNetwork net;
+		if (!NeuralNetwork_load(&net, argv[2])) {
+			printf("Could not load %s\n", argv[2]);
+			return 1;
+		}
+
+		FILE *out = fopen(argv[3], "w");
+		char ok = out != NULL && NeuralNetwork_generateC(&net, out, argc > 4? argv[4] : "network_predict");
+		if (out != NULL) ok = fclose(out) == 0 && ok;
+		if (!ok) printf("Could not generate %s\n", argv[3]);
+		NeuralNetwork_deinit(&net);
+		return ok? 0 : 1;
+	}
+
+
+
+	/** main optimize modelFile output [normalization.csv]
+	 * Saves an equivalent network that predicts faster, see NeuralNetwork_optimize. With a normalization file (the means of the inputs
+	 * in the first line, their standard deviations in the second one), the saved network takes the inputs before standardization. */
+	int optimizeModel(int argc, char** argv) {
+		if (argc < 4) {
+			printf("Usage: %s optimize modelFile output [normalization.csv]\n", argv[0]);
+			return 1;
+		}
+
+		NeuralNetwork net;
+		if (!NeuralNetwork_load(&net, argv[2])) {
+			printf("Could not load %s\n", argv[2]);
+			return 1;
+		}
+
+		unsigned short int inputCount = net.layers[0].neuronCount;
+		NeuronUnit *means = NULL, *deviations = NULL;
+		char ok = 1;
+		if (argc > 4) {
+			means = malloc(inputCount * sizeof(NeuronUnit));
+			deviations = malloc(inputCount * sizeof(NeuronUnit));
+			ok = NetworkOptimizer_readNormalization(argv[4], inputCount, means, deviations);
+			if (!ok) printf("Could not read %s: expected %u means and %u standard deviations\n", argv[4], inputCount, inputCount);
+		}
+
+		NeuralNetwork optimized;
+		NetworkOptimizerReport report;
+		if (ok) {
+			ok = NeuralNetwork_optimize(&net, &optimized, means, deviations, &report);
+			if (!ok) printf("Could not optimize %s\n", argv[2]);
+		}
+		if (ok) {
+			printf("Layers: %u -> %u\nSynapses: %lu -> %lu\nLargest difference: %g\n",
+				report.layersBefore, report.layersAfter, report.synapsesBefore, report.synapsesAfter, report.maxDifference);
+			ok = NeuralNetwork_save(&optimized, argv[3]);
+			if (!ok) printf("Could not save %s\n", argv[3]);
+			NeuralNetwork_deinit(&optimized);
+		}
+
+		free(means);
+		free(deviations);
+		NeuralNetwork_deinit(&net);
+		return ok? 0 : 1;
+	}
+
+
+
+	/** main prune modelFile output threshold [keepPerLayer]
+	 * Saves the model without the synapses smaller than threshold, keeping at most keepPerLayer per layer. See NeuralNetwork_prune. */
+	int pruneModel(int argc, char** argv) {
+		if (argc < 5) {
+			printf("Usage: %s prune modelFile output threshold [keepPerLayer]\n", argv[0]);
+			return 1;
+		}
+
+		char *check;
+		NeuronUnit threshold = strtod(argv[4], &check);
+		unsigned long int keepPerLayer = 0;
+		if (*check == '\0' && argc > 5) keepPerLayer = strtol(argv[5], &check, 10);
+		if (*check != '\0') {
+			printf("Not a number: %s\n", check);
+			return 1;
+		}
+
+		NeuralNetwork net;
+		if (!NeuralNetwork_load(&net, argv[2])) {
+			printf("Could not load %s\n", argv[2]);
+			return 1;
+		}
+
+		NeuralNetwork pruned;
+		NetworkPruneReport report;
+		NeuralNetwork_prune(&net, &pruned, threshold, keepPerLayer, &report);
+		NetworkPruneReport_print(&report, stdout);
+		char ok = NeuralNetwork_save(&pruned, argv[3]);
+		if (!ok) printf("Could not save %s\n", argv[3]);
+
+		NeuralNetwork_deinit(&pruned);
+		NeuralNetwork_deinit(&net);
+		return ok? 0 : 1;
+	}
+
+
+
+	/** main pruneNeurons modelFile output calibrationFile [tolerance]
+	 * Saves the model without the hidden neurons that are dead, constant or duplicates on the calibration inputs
+	 * (binary NeuronUnit rows, like the binary input of main predict). See NeuralNetwork_pruneNeurons. */
+	int pruneModelNeurons(int argc, char** argv) {
+		if (argc < 5) {
+			printf("Usage: %s pruneNeurons modelFile output calibrationFile [tolerance]\n", argv[0]);
+			return 1;
+		}
+
+		char *check = "";
+		NeuronUnit tolerance = argc > 5? strtod(argv[5], &check) : 0;
+		if (*check != '\0') {
+			printf("Not a number: %s\n", argv[5]);
+			return 1;
+		}
+
+		NeuralNetwork net;
+		if (!NeuralNetwork_load(&net, argv[2])) {
+			printf("Could not load %s\n", argv[2]);
+			return 1;
+		}
+
+		TrainDataSet calibration;
+		char ok = TrainDataSet_initMapped(&calibration, argv[4], net.layers[0].neuronCount, 0) && calibration.sampleCount > 0;
+		if (!ok) printf("Could not read %s\n", argv[4]);
+		else {
+			NeuralNetwork pruned;
+			NetworkNeuronPruneReport report;
+			NeuralNetwork_pruneNeurons(&net, &pruned, calibration.rows, calibration.sampleCount, calibration.inputCount, tolerance, &report);
+			NetworkNeuronPruneReport_print(&report, stdout);
+			ok = NeuralNetwork_save(&pruned, argv[3]);
+			if (!ok) printf("Could not save %s\n", argv[3]);
+			NeuralNetwork_deinit(&pruned);
+		}
+
+		TrainDataSet_deinit(&calibration);
+		NeuralNetwork_deinit(&net);
+		return ok? 0 : 1;
+	}
+
+
 
-	#ifndef UNIT_TESTS
+	#if !defined(UNIT_TESTS) && !defined(BENCHMARKS)
 		int main(int argc, char** argv) {
+			if (argc > 1 && strcmp(argv[1], "serve") == 0) return serveModel(argc, argv);
+			if (argc > 1 && strcmp(argv[1], "predict") == 0) return predictFile(argc, argv);
+			if (argc > 1 && strcmp(argv[1], "generate") == 0) return generateC(argc, argv);
+			if (argc > 1 && strcmp(argv[1], "optimize") == 0) return optimizeModel(argc, argv);
+			if (argc > 1 && strcmp(argv[1], "prune") == 0) return pruneModel(argc, argv);
+			if (argc > 1 && strcmp(argv[1], "pruneNeurons") == 0) return pruneModelNeurons(argc, argv);
 			startCLI();
 			return 0;
 		}
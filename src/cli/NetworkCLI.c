@@ -2,6 +2,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "NetworkCLI.h"
+#include "../server/InferenceServer.h"
+#include <fcntl.h>
+#include <unistd.h>
 
 	typedef struct {
 		char** tokens;
@@ -63,6 +66,7 @@
 
 		unsigned long int count = target->network->synapseCount;
 		NeuronUnit *minWeights = target->minimum.weights;
+		printf("Smoothed error: %f (weights copied %lu times)\n", target->minimum.error, target->snapshotCount);
 		for (int i=0; i<count; i++) printf("%1.2f, ", minWeights[i]);
 		printf("\n");
 	}
@@ -86,28 +90,32 @@
 		NeuralNetwork_loadSynapseWeights(net, target->minimum.weights);
 	}
 
-	void NetworkCLI_predict(NeuralNetwork *net, Command *com) {
+	char NetworkCLI_readInputs(NeuralNetwork *net, Command *com, NeuronUnit *buf) {
 		int inputLen = net->layers[0].neuronCount;
 		if (com->length - 1 != inputLen) {
 			printf("Input size must be %d, but %d was found\n", inputLen, com->length - 1);
-			return;
+			return 0;
 		}
 
-		//initialize input buffer
-		NeuronUnit buf[inputLen];
 		char* ch;
-
 		for (int i=1; i<com->length; ++i) {
 			buf[i-1] = (NeuronUnit) strtod(com->tokens[i], &ch);
 			if (*ch != '\0') {
 				printf("Not a number: %s\n", com->tokens[i]);
-				return;
+				return 0;
 			}
 		}
+		return 1;
+	}
+
+	void NetworkCLI_predict(NeuralNetwork *net, Command *com) {
+		//initialize input buffer
+		NeuronUnit buf[net->layers[0].neuronCount];
+		if (!NetworkCLI_readInputs(net, com, buf)) return;
 
 		//feed it to network
 		NetworkLayer *inpLayer = net->layers;
-		for (int i=0; i<inputLen; i++) {
+		for (int i=0, inputLen = inpLayer->neuronCount; i<inputLen; i++) {
 			inpLayer->neurons[i].out = buf[i];
 		}
 
@@ -118,10 +126,75 @@
 		printf("\n");
 	}
 
+	/** predictFile input output [csv|bin] [csv|bin] [batchSize]: every row of the input file, in batches, into the output file. */
+	void NetworkCLI_predictFile(NeuralNetwork *net, Command *com) {
+		if (com->length <= 2) {
+			printf("Please specify: input output [csv|bin] [csv|bin] [batchSize]\n");
+			return;
+		}
+
+		unsigned int batchSize = 256;
+		if (com->length > 5) {
+			char* check;
+			long int value = strtol(com->tokens[5], &check, 10);
+			if (*check != '\0' || value <= 0) {
+				printf("Not a positive integer: %s\n", com->tokens[5]);
+				return;
+			}
+			batchSize = value > BulkPredictor_MAX_BATCH? BulkPredictor_MAX_BATCH : value;
+		}
+
+		int input = open(com->tokens[1], O_RDONLY);
+		if (input < 0) {
+			printf("Could not open %s\n", com->tokens[1]);
+			return;
+		}
+		FILE *output = fopen(com->tokens[2], "wb");
+		if (output == NULL) {
+			printf("Could not open %s\n", com->tokens[2]);
+			close(input);
+			return;
+		}
+
+		BulkPredictor predictor;
+		BulkPredictor_init(&predictor, net,
+			com->length > 3 && strcmp(com->tokens[3], "bin") == 0? BulkPredictor_BINARY : BulkPredictor_CSV,
+			com->length > 4 && strcmp(com->tokens[4], "bin") == 0? BulkPredictor_BINARY : BulkPredictor_CSV,
+			batchSize);
+		char ok = BulkPredictor_run(&predictor, input, output);
+		printf("%lu rows predicted\n", predictor.rows);
+		if (predictor.errorRow) printf("Could not read row %lu\n", predictor.errorRow);
+		else if (!ok) printf("Could not write %s\n", com->tokens[2]);
+
+		close(input);
+		fclose(output);
+	}
+
+	/** Predicts with the weights published last, while the network itself is being trained on another thread. */
+	void NetworkCLI_predictSnapshot(NeuralNetwork *net, SharedModel *model, Command *com) {
+		NeuronUnit buf[net->layers[0].neuronCount];
+		if (!NetworkCLI_readInputs(net, com, buf)) return;
+
+		int slot = SharedModel_register(model);
+		if (slot < 0) {
+			printf("No free reader slot in the model, try again\n");
+			return;
+		}
+		NeuralNetwork *snapshot = SharedModel_acquire(model, slot);
+		NeuronUnit out[model->outputCount];
+		NeuronUnit scratch[NeuralNetwork_batchScratchSize(snapshot, 1)];
+		NeuralNetwork_predictBatch(snapshot, buf, 1, out, scratch);
+		SharedModel_release(model, slot);
+		SharedModel_unregister(model, slot);
+
+		for (int i=0; i<model->outputCount; i++) printf("%1.2f ", out[i]);
+		printf("(version %lu)\n", atomic_load(&model->version));
+	}
+
 	void NetworkCLI_trainOnline(BPTrainer *trainer, Command *com) {
 		char* check;
-		NeuronUnit learningRate = 0.1;
-		NeuronUnit momentum = 0;
+		NeuronUnit learningRate = Optimizer_KEEP;	//the default of the optimizer
+		NeuronUnit momentum = Optimizer_KEEP;
 		unsigned int times = 10000;
 		char debug = 0;
 
@@ -184,8 +257,8 @@
 
 	void NetworkCLI_trainStochastic(BPTrainer *trainer, Command *com) {
 		char* check;
-		NeuronUnit learningRate = 0.1;
-		NeuronUnit momentum = 0;
+		NeuronUnit learningRate = Optimizer_KEEP;	//the default of the optimizer
+		NeuronUnit momentum = Optimizer_KEEP;
 		unsigned int times = 10000;
 		unsigned int updateEvery = 25;
 		char debug = 0;
@@ -255,6 +328,73 @@
 		free(endPoint);
 	}
 
+	void NetworkCLI_trainLBFGS(NeuralNetwork *net, TrainDataProvider *provider, Command *com,
+			void (*errorFunction)(NeuralNetwork* net, NeuronUnit* expected, NeuronUnit* errorValue, NeuronUnit* errorGradients)) {
+		char* check;
+		unsigned int samples = 1000;
+		unsigned int iterations = 100;
+		unsigned int history = 10;
+
+		//read samples, iterations and history size
+		unsigned int *targets[3] = {&samples, &iterations, &history};
+		for (int i=1; i<com->length && i<4; ++i) {
+			*targets[i-1] = strtol(com->tokens[i], &check, 10);
+			if (*check != '\0') {
+				printf("Not an integer: %s\n", com->tokens[i]);
+				return;
+			}
+		}
+		if (history == 0) history = 1;
+
+		//the data set is drawn from the provider once, and then revisited on every pass
+		TrainDataSet set;
+		TrainDataSet_initFromProvider(&set, provider, net, samples);
+
+		LBFGSTrainer trainer;
+		LBFGSTrainer_init(&trainer, net, &set, errorFunction, history, 0);
+
+		NeuronUnit *startPoint = malloc(net->synapseCount * sizeof(NeuronUnit));
+		NeuralNetwork_saveSynapseWeights(net, startPoint);
+		NeuronUnit startError = LBFGSTrainer_evaluate(&trainer, startPoint, trainer.gradient);
+		NeuronUnit endError = LBFGSTrainer_train(&trainer, iterations, 1e-9);
+
+		printf("Error: %f -> %f after %u iterations, %lu passes over %u samples (%u threads)\n\n",
+			startError, endError, trainer.iterations, trainer.dataPasses, set.sampleCount, trainer.replicas.threadCount);
+
+		free(startPoint);
+		LBFGSTrainer_deinit(&trainer);
+		TrainDataSet_deinit(&set);
+	}
+
+	void NetworkCLI_trainLM(NeuralNetwork *net, TrainDataProvider *provider, Command *com) {
+		char* check;
+		unsigned int samples = 100;
+		unsigned int iterations = 50;
+
+		//read samples and iterations
+		unsigned int *targets[2] = {&samples, &iterations};
+		for (int i=1; i<com->length && i<3; ++i) {
+			*targets[i-1] = strtol(com->tokens[i], &check, 10);
+			if (*check != '\0') {
+				printf("Not an integer: %s\n", com->tokens[i]);
+				return;
+			}
+		}
+
+		TrainDataSet set;
+		TrainDataSet_initFromProvider(&set, provider, net, samples);
+
+		LMTrainer trainer;
+		LMTrainer_init(&trainer, net, &set, 0);
+		NeuronUnit endError = LMTrainer_train(&trainer, iterations, 1e-12);
+
+		printf("Error: %f after %u iterations, %lu passes over %u samples (%u threads, damping %g)\n\n",
+			endError, trainer.iterations, trainer.dataPasses, set.sampleCount, trainer.replicas.threadCount, trainer.damping);
+
+		LMTrainer_deinit(&trainer);
+		TrainDataSet_deinit(&set);
+	}
+
 	void NetworkCLI_setWeights(NeuralNetwork *net, Command *com) {
 		if (com->length - 1 != net->synapseCount) {
 			printf("Weight length must be %ld, but %d was found\n", net->synapseCount, com->length - 1);
@@ -275,11 +415,668 @@
 	}
 
 
+	void NetworkCLI_setOptimizer(Command *com, BPTrainer *online, BPTrainer *stochastic) {
+		if (com->length <= 1) {
+			printf("Please specify optimizer: sgd, nesterov, adam, rmsprop or adagrad\n");
+			return;
+		}
+
+		unsigned char type;
+		if (strcmp(com->tokens[1], "sgd") == 0) type = Optimizer_SGD;
+		else if (strcmp(com->tokens[1], "nesterov") == 0) type = Optimizer_NESTEROV;
+		else if (strcmp(com->tokens[1], "adam") == 0) type = Optimizer_ADAM;
+		else if (strcmp(com->tokens[1], "rmsprop") == 0) type = Optimizer_RMSPROP;
+		else if (strcmp(com->tokens[1], "adagrad") == 0) type = Optimizer_ADAGRAD;
+		else {
+			printf("Unknown optimizer: %s\n", com->tokens[1]);
+			return;
+		}
+
+		//read beta1, beta2 and epsilon
+		NeuronUnit params[3];
+		char* check;
+		for (int i=2; i<com->length && i<5; ++i) {
+			params[i-2] = strtod(com->tokens[i], &check);
+			if (*check != '\0') {
+				printf("Not a number: %s\n", com->tokens[i]);
+				return;
+			}
+		}
+
+		BPTrainer *trainers[2] = {online, stochastic};
+		for (int t=0; t<2; ++t) {
+			BPTrainer_setOptimizer(trainers[t], type);
+			Optimizer *opt = &trainers[t]->optimizer;
+			if (com->length > 2) opt->beta1 = params[0];
+			if (com->length > 3) opt->beta2 = params[1];
+			if (com->length > 4) opt->epsilon = params[2];
+		}
+	}
+
+
 	void NetworkCLI_randomWeights(NeuralNetwork *net) {
 		NeuralNetwork_randomSynapses(net);
 	}
 
 
+	void NetworkCLI_trace(Command *com, char *tracePath) {
+		if (com->length <= 1) {
+			printf("Please specify the trace file, or off\n");
+			return;
+		}
+
+		if (strcmp(com->tokens[1], "off") == 0) tracePath[0] = '\0';
+		else {
+			snprintf(tracePath, 256, "%s", com->tokens[1]);
+			printf("The next training run will be traced to %s\n", tracePath);
+		}
+	}
+
+	char NetworkCLI_isTrainingCommand(char *name) {
+		return strcmp(name, "online") == 0 || strcmp(name, "stoch") == 0 || strcmp(name, "lm") == 0 || strcmp(name, "lbfgs") == 0 || strcmp(name, "fit") == 0;
+	}
+
+	void NetworkCLI_writeTrace(char *tracePath) {
+		Tracer_stop();
+		if (Tracer_write(tracePath)) {
+			printf("Trace of %lu events written to %s\n", Tracer_eventCount(), tracePath);
+			unsigned long int dropped = Tracer_droppedCount();
+			if (dropped > 0) printf("%lu events were dropped: a thread recorded more than %d\n", dropped, Tracer_CHUNK_CAPACITY * Tracer_MAX_CHUNKS);
+		}
+		else printf("Could not write trace file: %s\n", tracePath);
+		tracePath[0] = '\0';
+	}
+
+
+	/** Replaces the progress reporting of both trainers. The previous sink is flushed and its file closed. */
+	void NetworkCLI_metrics(Command *com, MetricsSink *sink, FILE **file, BPTrainer *online, BPTrainer *stochastic) {
+		if (com->length <= 1) {
+			printf("Please specify: console [intervalMs] [every], csv file [intervalMs] [every], jsonl file [intervalMs] [every] or off\n");
+			return;
+		}
+
+		unsigned char format;
+		int next = 2;
+		if (strcmp(com->tokens[1], "console") == 0) format = MetricsSink_CONSOLE;
+		else if (strcmp(com->tokens[1], "csv") == 0) format = MetricsSink_CSV;
+		else if (strcmp(com->tokens[1], "jsonl") == 0) format = MetricsSink_JSONL;
+		else if (strcmp(com->tokens[1], "off") == 0) format = 0;
+		else {
+			printf("Unknown metrics output: %s\n", com->tokens[1]);
+			return;
+		}
+
+		FILE *out = stdout;
+		if (format == MetricsSink_CSV || format == MetricsSink_JSONL) {
+			if (com->length <= 2) {
+				printf("Please specify the output file\n");
+				return;
+			}
+			next = 3;
+		}
+
+		//read interval and samples per record
+		unsigned int params[2] = {500, 100};
+		char* check;
+		for (int i=next; i<com->length && i<next+2; ++i) {
+			params[i-next] = strtol(com->tokens[i], &check, 10);
+			if (*check != '\0') {
+				printf("Not an integer: %s\n", com->tokens[i]);
+				return;
+			}
+		}
+
+		if (next == 3) {
+			out = fopen(com->tokens[2], "w");
+			if (out == NULL) {
+				printf("Could not open %s\n", com->tokens[2]);
+				return;
+			}
+		}
+
+		//close the previous sink
+		if (online->metrics != NULL) {
+			MetricsSink_deinit(sink);
+			if (*file != stdout) fclose(*file);
+		}
+
+		if (format == 0) {
+			BPTrainer_setMetrics(online, NULL, 0);
+			BPTrainer_setMetrics(stochastic, NULL, 0);
+			return;
+		}
+
+		*file = out;
+		MetricsSink_init(sink, format, out, 4096, params[0]);
+		BPTrainer_setMetrics(online, sink, params[1]);
+		BPTrainer_setMetrics(stochastic, sink, params[1]);
+	}
+
+
+	void NetworkCLI_setBestTracking(Command *com, BPTrainer *online, BPTrainer *stochastic) {
+		if (com->length <= 2) {
+			printf("Please specify the loss smoothing (1 for none) and the minimum samples between weight copies\n");
+			return;
+		}
+
+		char* check;
+		NeuronUnit smoothing = strtod(com->tokens[1], &check);
+		if (*check != '\0') {
+			printf("Not a number: %s\n", com->tokens[1]);
+			return;
+		}
+
+		unsigned int every = strtol(com->tokens[2], &check, 10);
+		if (*check != '\0') {
+			printf("Not an integer: %s\n", com->tokens[2]);
+			return;
+		}
+
+		BPTrainer_setBestTracking(online, smoothing, every);
+		BPTrainer_setBestTracking(stochastic, smoothing, every);
+	}
+
+
+	void NetworkCLI_evaluate(NeuralNetwork *net, TrainDataProvider *provider, Command *com,
+			void (*errorFunction)(NeuralNetwork* net, NeuronUnit* expected, NeuronUnit* errorValue, NeuronUnit* errorGradients)) {
+		char* check;
+		unsigned int samples = 10000;
+		if (com->length > 1) {
+			samples = strtol(com->tokens[1], &check, 10);
+			if (*check != '\0') {
+				printf("Not an integer: %s\n", com->tokens[1]);
+				return;
+			}
+		}
+
+		EvaluationMetrics metrics;
+		EvaluationMetrics_init(&metrics, net->layers[net->layerCount - 1].neuronCount);
+		TrainDataProvider_reset(provider, samples);
+		NeuralNetwork_evaluate(net, provider, errorFunction, &metrics);
+		EvaluationMetrics_print(&metrics, stdout);
+		EvaluationMetrics_deinit(&metrics);
+	}
+
+
+	void NetworkCLI_fit(Command *com, BPTrainer *online, BPTrainer *stochastic) {
+		if (com->length <= 1) {
+			printf("Please specify: epochSamples [maxEpochs] [targetLoss|none] [patience] [constant|step|cosine|plateau] [learningRate] [updateEvery] [seconds]\n");
+			return;
+		}
+
+		//read the numeric arguments. Position 3 can be none, position 5 is the schedule
+		NeuronUnit values[9] = {0, 0, 100, TrainingController_NO_TARGET, 5, 0, 0.1, 0, 0};
+		char* check;
+		for (int i=1; i<com->length && i<9; ++i) {
+			if (i == 5 || (i == 3 && strcmp(com->tokens[i], "none") == 0)) continue;
+			values[i] = strtod(com->tokens[i], &check);
+			if (*check != '\0') {
+				printf("Not a number: %s\n", com->tokens[i]);
+				return;
+			}
+		}
+
+		unsigned char schedule = LearningRateSchedule_CONSTANT;
+		if (com->length > 5) {
+			if (strcmp(com->tokens[5], "constant") == 0) schedule = LearningRateSchedule_CONSTANT;
+			else if (strcmp(com->tokens[5], "step") == 0) schedule = LearningRateSchedule_STEP;
+			else if (strcmp(com->tokens[5], "cosine") == 0) schedule = LearningRateSchedule_COSINE;
+			else if (strcmp(com->tokens[5], "plateau") == 0) schedule = LearningRateSchedule_PLATEAU;
+			else {
+				printf("Unknown schedule: %s\n", com->tokens[5]);
+				return;
+			}
+		}
+
+		unsigned int updateEvery = (unsigned int) values[7];
+		TrainingController controller;
+		if (values[1] < 0 || !TrainingController_init(&controller, updateEvery == 0? online : stochastic, (unsigned int) values[1])) {
+			printf("epochSamples must be positive: the provider has no fixed sample count\n");
+			return;
+		}
+		controller.maxEpochs = (unsigned int) values[2];
+		controller.targetLoss = values[3];
+		controller.patience = (unsigned int) values[4];
+		controller.learningRate = values[6];
+		controller.updateEvery = updateEvery;
+		controller.timeBudget = values[8];
+		TrainingController_setSchedule(&controller, schedule, 0.5, schedule == LearningRateSchedule_STEP? 10 : 2);
+
+		unsigned char reason = TrainingController_run(&controller);
+		printf("Stopped after %u epochs (%lu samples, %.2fs): %s\n", controller.epoch, controller.samples, controller.elapsed, TrainingController_stopReasonName(reason));
+		printf("Last loss: %f, best loss: %f, learning rate: %g\n", controller.lastLoss, controller.bestLoss, controller.currentLearningRate);
+	}
+
+
+	void NetworkCLI_setBatchSchedule(Command *com, BatchSizeSchedule *schedule, BPTrainer *stochastic) {
+		if (com->length <= 1) {
+			printf("Please specify: fixed, or step|noise minBatch maxBatch [none|linear|sqrt]\n");
+			return;
+		}
+
+		unsigned char mode;
+		if (strcmp(com->tokens[1], "fixed") == 0) {
+			stochastic->batchSchedule = NULL;
+			return;
+		}
+		else if (strcmp(com->tokens[1], "step") == 0) mode = BatchSizeSchedule_STEP;
+		else if (strcmp(com->tokens[1], "noise") == 0) mode = BatchSizeSchedule_NOISE;
+		else {
+			printf("Unknown batch schedule: %s\n", com->tokens[1]);
+			return;
+		}
+
+		if (com->length <= 3) {
+			printf("Please specify the minimum and the maximum batch size\n");
+			return;
+		}
+
+		unsigned int sizes[2];
+		char* check;
+		for (int i=2; i<4; ++i) {
+			sizes[i-2] = strtol(com->tokens[i], &check, 10);
+			if (*check != '\0') {
+				printf("Not an integer: %s\n", com->tokens[i]);
+				return;
+			}
+		}
+
+		if (mode == BatchSizeSchedule_NOISE && sizes[0] < 2) {
+			printf("The noise schedule needs a minimum batch of at least 2\n");
+			return;
+		}
+
+		unsigned char scaling = BatchSizeSchedule_SCALE_LINEAR;
+		if (com->length > 4) {
+			if (strcmp(com->tokens[4], "none") == 0) scaling = BatchSizeSchedule_SCALE_NONE;
+			else if (strcmp(com->tokens[4], "linear") == 0) scaling = BatchSizeSchedule_SCALE_LINEAR;
+			else if (strcmp(com->tokens[4], "sqrt") == 0) scaling = BatchSizeSchedule_SCALE_SQRT;
+			else {
+				printf("Unknown learning rate scaling: %s\n", com->tokens[4]);
+				return;
+			}
+		}
+
+		BatchSizeSchedule_init(schedule, mode, sizes[0], sizes[1], scaling);
+		stochastic->batchSchedule = schedule;
+	}
+
+
+	void NetworkCLI_stats(NeuralNetwork *net, Command *com) {
+		if (com->length > 1 && strcmp(com->tokens[1], "reset") == 0) NeuralNetwork_resetStats(net);
+		else NeuralNetwork_printStats(net, stdout);
+	}
+
+
+
+	void NetworkCLI_save(NeuralNetwork *net, Command *com) {
+		if (com->length <= 1) {
+			printf("Please specify a file\n");
+			return;
+		}
+		if (!NeuralNetwork_save(net, com->tokens[1])) printf("Could not save to %s\n", com->tokens[1]);
+	}
+
+	/** generate file.c [name]: the network as a standalone C function, see NeuralNetwork_generateC. */
+	void NetworkCLI_generate(NeuralNetwork *net, Command *com) {
+		if (com->length <= 1) {
+			printf("Please specify a file\n");
+			return;
+		}
+
+		FILE *out = fopen(com->tokens[1], "w");
+		if (out == NULL) {
+			printf("Could not open %s\n", com->tokens[1]);
+			return;
+		}
+		const char *name = com->length > 2? com->tokens[2] : "network_predict";
+		if (!NeuralNetwork_generateC(net, out, name)) printf("Could not generate %s: check the name and the activators\n", com->tokens[1]);
+		fclose(out);
+	}
+
+	/** optimize file [normalization.csv]: saves an equivalent network that predicts faster, see NeuralNetwork_optimize. */
+	void NetworkCLI_optimize(NeuralNetwork *net, Command *com) {
+		if (com->length <= 1) {
+			printf("Please specify a file\n");
+			return;
+		}
+
+		unsigned short int inputCount = net->layers[0].neuronCount;
+		NeuronUnit means[inputCount], deviations[inputCount];
+		if (com->length > 2 && !NetworkOptimizer_readNormalization(com->tokens[2], inputCount, means, deviations)) {
+			printf("Could not read %s: expected %u means and %u standard deviations\n", com->tokens[2], inputCount, inputCount);
+			return;
+		}
+
+		NeuralNetwork optimized;
+		NetworkOptimizerReport report;
+		if (!NeuralNetwork_optimize(net, &optimized, com->length > 2? means : NULL, deviations, &report)) {
+			printf("Could not optimize the network\n");
+			return;
+		}
+		printf("Layers: %u -> %u   Synapses: %lu -> %lu   Largest difference: %g\n",
+			report.layersBefore, report.layersAfter, report.synapsesBefore, report.synapsesAfter, report.maxDifference);
+		if (!NeuralNetwork_save(&optimized, com->tokens[1])) printf("Could not save %s\n", com->tokens[1]);
+		NeuralNetwork_deinit(&optimized);
+	}
+
+	/** prune file threshold [keepPerLayer=0] [fineTuneSamples=0] [learningRate=0.1]: saves the network without its small synapses,
+	 * see NeuralNetwork_prune. The pruned network is fine tuned online on the training data first, if fineTuneSamples is given. */
+	void NetworkCLI_prune(NeuralNetwork *net, Command *com, BPTrainer *trainer) {
+		if (com->length <= 2) {
+			printf("Please specify a file and a threshold\n");
+			return;
+		}
+
+		char* check;
+		NeuronUnit threshold = strtod(com->tokens[2], &check);
+		if (*check != '\0') {
+			printf("Not a number: %s\n", com->tokens[2]);
+			return;
+		}
+		unsigned long int values[] = {0, 0}; //keepPerLayer and fineTuneSamples
+		for (int i = 3; i < com->length && i < 5; ++i) {
+			values[i - 3] = strtol(com->tokens[i], &check, 10);
+			if (*check != '\0') {
+				printf("Not an integer: %s\n", com->tokens[i]);
+				return;
+			}
+		}
+		NeuronUnit learningRate = 0.1;
+		if (com->length > 5) {
+			learningRate = strtod(com->tokens[5], &check);
+			if (*check != '\0') {
+				printf("Not a number: %s\n", com->tokens[5]);
+				return;
+			}
+		}
+
+		NeuralNetwork pruned;
+		NetworkPruneReport report;
+		NeuralNetwork_prune(net, &pruned, threshold, values[0], &report);
+		NetworkPruneReport_print(&report, stdout);
+
+		if (values[1] > 0) {
+			BPTrainer tuner;
+			BPTrainer_init(&tuner, &pruned, trainer->provider, trainer->errorUpdater);
+			TrainDataProvider_reset(trainer->provider, values[1]);
+			BPTrainer_trainOnline(&tuner, learningRate, 0, 0);
+			printf("Fine tuned on %lu samples\n", values[1]);
+			BPTrainer_deinit(&tuner);
+		}
+
+		if (!NeuralNetwork_save(&pruned, com->tokens[1])) printf("Could not save %s\n", com->tokens[1]);
+		NeuralNetwork_deinit(&pruned);
+	}
+
+	/** pruneNeurons file [tolerance=0] [samples=1000]: saves the network without its dead, constant and duplicate hidden neurons,
+	 * found on samples of the training data. See NeuralNetwork_pruneNeurons. */
+	void NetworkCLI_pruneNeurons(NeuralNetwork *net, Command *com, TrainDataProvider *provider) {
+		if (com->length <= 1) {
+			printf("Please specify a file\n");
+			return;
+		}
+
+		char* check;
+		NeuronUnit tolerance = 0;
+		if (com->length > 2) {
+			tolerance = strtod(com->tokens[2], &check);
+			if (*check != '\0') {
+				printf("Not a number: %s\n", com->tokens[2]);
+				return;
+			}
+		}
+		unsigned int samples = 1000;
+		if (com->length > 3) {
+			samples = strtol(com->tokens[3], &check, 10);
+			if (*check != '\0') {
+				printf("Not an integer: %s\n", com->tokens[3]);
+				return;
+			}
+		}
+
+		TrainDataSet calibration;
+		TrainDataSet_initFromProvider(&calibration, provider, net, samples);
+		NeuralNetwork pruned;
+		NetworkNeuronPruneReport report;
+		NeuralNetwork_pruneNeurons(net, &pruned, calibration.rows, calibration.sampleCount, calibration.inputCount + calibration.outputCount, tolerance, &report);
+		NetworkNeuronPruneReport_print(&report, stdout);
+		if (!NeuralNetwork_save(&pruned, com->tokens[1])) printf("Could not save %s\n", com->tokens[1]);
+
+		NeuralNetwork_deinit(&pruned);
+		TrainDataSet_deinit(&calibration);
+	}
+
+	/** Loads the weights of a saved network into the one being trained, which keeps its topology. */
+	void NetworkCLI_load(NeuralNetwork *net, Command *com) {
+		if (com->length <= 1) {
+			printf("Please specify a file\n");
+			return;
+		}
+
+		NeuralNetwork loaded;
+		if (!NeuralNetwork_load(&loaded, com->tokens[1])) {
+			printf("Could not load %s\n", com->tokens[1]);
+			return;
+		}
+
+		if (NeuralNetwork_sameTopology(net, &loaded)) {
+			for (unsigned long int i = net->synapseCount; i--;) net->synapses[i].weight = loaded.synapses[i].weight;
+		}
+		else printf("%s has a different topology\n", com->tokens[1]);
+		NeuralNetwork_deinit(&loaded);
+	}
+
+	/** The model that the server answers with. It starts as a copy of the trained network, and only changes on publish or watch. */
+	SharedModel* NetworkCLI_sharedModel(NeuralNetwork *net, SharedModel *model, char *hasModel) {
+		if (!*hasModel) {
+			SharedModel_init(model, net);
+			*hasModel = 1;
+		}
+		return model;
+	}
+
+	void NetworkCLI_publish(NeuralNetwork *net, SharedModel *model, char hasModel) {
+		if (!hasModel) printf("Nothing is served yet\n");
+		else if (SharedModel_publishCopy(model, net)) printf("Published version %lu\n", atomic_load(&model->version));
+	}
+
+	/** Returns whether the watcher runs after the command. */
+	char NetworkCLI_watch(NeuralNetwork *net, Command *com, SharedModel *model, char *hasModel, ModelWatcher *watcher, char watching) {
+		if (com->length <= 1) {
+			if (watching) printf("Watching %s: model version %lu, %lu loads, %lu failures\n", watcher->path,
+				atomic_load(&model->version), atomic_load(&watcher->loads), atomic_load(&watcher->failures));
+			else printf("Please specify: file [intervalMs], or off\n");
+			return watching;
+		}
+
+		if (watching) ModelWatcher_deinit(watcher);
+		if (strcmp(com->tokens[1], "off") == 0) return 0;
+
+		unsigned int intervalMs = 1000;
+		if (com->length > 2) {
+			char* check;
+			intervalMs = strtol(com->tokens[2], &check, 10);
+			if (*check != '\0') {
+				printf("Not an integer: %s\n", com->tokens[2]);
+				return 0;
+			}
+		}
+
+		//serve the file as it is now, then follow its changes
+		NetworkCLI_sharedModel(net, model, hasModel);
+		NeuralNetwork *loaded = malloc(sizeof(NeuralNetwork));
+		if (!NeuralNetwork_load(loaded, com->tokens[1])) {
+			printf("Could not load %s yet\n", com->tokens[1]);
+			free(loaded);
+		}
+		else if (!SharedModel_publish(model, loaded)) printf("%s does not have the inputs and outputs of this network\n", com->tokens[1]);
+
+		ModelWatcher_init(watcher, model, com->tokens[1], intervalMs);
+		return 1;
+	}
+
+	/** checkpoint file [everySamples] [everySeconds], checkpoint off, or checkpoint alone for the status.
+	 * Returns whether checkpoints are written after the command. */
+	char NetworkCLI_checkpoint(NeuralNetwork *net, Command *com, Checkpointer *checkpointer, char checkpointing, BPTrainer *online, BPTrainer *stochastic) {
+		if (com->length <= 1) {
+			if (checkpointing) printf("Checkpoints to %s: %lu written, %lu replaced before writing, %lu failures, last write %.2f ms\n", checkpointer->path,
+				atomic_load(&checkpointer->written), atomic_load(&checkpointer->replaced), atomic_load(&checkpointer->failures), atomic_load(&checkpointer->lastWriteNs) / 1e6);
+			else printf("Please specify: file [everySamples] [everySeconds], or off\n");
+			return checkpointing;
+		}
+
+		//everySamples and everySeconds
+		NeuronUnit values[] = {10000, 0};
+		char* check;
+		for (int i=2; i<com->length && i<4; ++i) {
+			values[i-2] = strtod(com->tokens[i], &check);
+			if (*check != '\0') {
+				printf("Not a number: %s\n", com->tokens[i]);
+				return checkpointing;
+			}
+		}
+
+		if (checkpointing) {
+			BPTrainer_setCheckpointer(online, NULL);
+			BPTrainer_setCheckpointer(stochastic, NULL);
+			Checkpointer_deinit(checkpointer);
+		}
+		if (strcmp(com->tokens[1], "off") == 0) return 0;
+
+		Checkpointer_init(checkpointer, net, com->tokens[1], (unsigned long int) values[0], values[1]);
+		BPTrainer_setCheckpointer(online, checkpointer);
+		BPTrainer_setCheckpointer(stochastic, checkpointer);
+		return 1;
+	}
+
+	/** restore file online|stoch: the weights, and the optimizer state of that trainer, whose next run continues from the checkpoint. */
+	void NetworkCLI_restore(Command *com, BPTrainer *online, BPTrainer *stochastic) {
+		char stoch = com->length > 2 && strcmp(com->tokens[2], "stoch") == 0;
+		if (com->length <= 2 || (!stoch && strcmp(com->tokens[2], "online") != 0)) {
+			printf("Please specify: file online|stoch\n");
+			return;
+		}
+
+		BPTrainer *trainer = stoch? stochastic : online;
+		if (BPTrainer_restoreCheckpoint(trainer, com->tokens[1])) printf("Restored %lu samples\n", trainer->samplesSeen);
+		else printf("%s is not a checkpoint of this network\n", com->tokens[1]);
+	}
+
+	void NetworkCLI_publishSnapshot(void *target, NeuralNetwork *net) {
+		SharedModel_publishWeights((SharedModel*) target, net);
+	}
+
+	/** Commands that may run while a background run owns the network. */
+	char NetworkCLI_allowedWhileTraining(char *name) {
+		return strcmp(name, "predict") == 0 || strcmp(name, "pause") == 0 || strcmp(name, "resume") == 0 || strcmp(name, "stop") == 0
+			|| strcmp(name, "status") == 0 || strcmp(name, "serve") == 0 || strcmp(name, "exit") == 0;
+	}
+
+	/** start online [times] [learningRate] [momentum] [publishEvery]
+	 * start stoch [times] [updateEvery] [learningRate] [momentum] [publishEvery] */
+	void NetworkCLI_startBackground(Command *com, BackgroundTrainer *background, BPTrainer *online, BPTrainer *stochastic) {
+		char stoch = com->length > 1 && strcmp(com->tokens[1], "stoch") == 0;
+		if (com->length <= 1 || (!stoch && strcmp(com->tokens[1], "online") != 0)) {
+			printf("Please specify online or stoch\n");
+			return;
+		}
+
+		//times, updateEvery, learningRate, momentum and publishEvery
+		NeuronUnit values[] = {10000, 0, Optimizer_KEEP, Optimizer_KEEP, 1000};
+		if (stoch) values[1] = 25;
+		char* check;
+		for (int i=2; i<com->length; ++i) {
+			int index = stoch? i-2 : (i == 2? 0 : i-1);
+			if (index > 4) break;
+			values[index] = strtod(com->tokens[i], &check);
+			if (*check != '\0') {
+				printf("Not a number: %s\n", com->tokens[i]);
+				return;
+			}
+		}
+
+		BackgroundTrainer_wait(background);
+		background->trainer = stoch? stochastic : online;
+		background->publishEvery = values[4] < 1? 1 : (unsigned int) values[4];
+		TrainDataProvider_reset(background->trainer->provider, (unsigned int) values[0]);
+		BackgroundTrainer_start(background, (unsigned int) values[1], values[2], values[3]);
+		printf("Training in the background. predict uses the weights published every %u samples\n", background->publishEvery);
+	}
+
+	void NetworkCLI_backgroundStatus(BackgroundTrainer *background, SharedModel *model, char hasModel) {
+		unsigned char state = atomic_load(&background->state);
+		printf("%s, %lu samples, %lu publications", state == BackgroundTrainer_RUNNING? "Running" : state == BackgroundTrainer_PAUSED? "Paused" : "Idle",
+			atomic_load(&background->samples), atomic_load(&background->publications));
+		if (hasModel) printf(", model version %lu", atomic_load(&model->version));
+		if (state == BackgroundTrainer_IDLE) printf(", last run loss %f", background->loss);
+		printf("\n");
+	}
+
+	/** Returns whether the server runs after the command. */
+	char NetworkCLI_serve(SharedModel *model, Command *com, InferenceServer *server, char serving) {
+		if (com->length <= 1) {
+			printf("Please specify: unix path|tcp port [maxBatch] [maxDelayUs], stats or stop\n");
+			return serving;
+		}
+
+		if (strcmp(com->tokens[1], "stats") == 0) {
+			if (serving) InferenceServer_printStats(server, stdout);
+			else printf("The server is not running\n");
+			return serving;
+		}
+		else if (strcmp(com->tokens[1], "stop") == 0) {
+			if (serving) {
+				InferenceServer_printStats(server, stdout);
+				InferenceServer_deinit(server);
+			}
+			return 0;
+		}
+
+		char local = strcmp(com->tokens[1], "unix") == 0;
+		if (!local && strcmp(com->tokens[1], "tcp") != 0) {
+			printf("Unknown server command: %s\n", com->tokens[1]);
+			return serving;
+		}
+		if (serving) {
+			printf("The server is already running. Stop it first\n");
+			return serving;
+		}
+		if (com->length <= 2) {
+			printf("Please specify the %s\n", local? "socket path" : "port");
+			return serving;
+		}
+
+		//port, maxBatch and maxDelayUs, within these bounds
+		long int values[] = {0, 32, 1000};
+		const long int minimums[] = {0, 1, 0};
+		const long int maximums[] = {65535, InferenceServer_MAX_BATCH, InferenceServer_MAX_DELAY_US};
+		char* check;
+		for (int i=local? 3 : 2; i<com->length && i<5; ++i) {
+			values[i-2] = strtol(com->tokens[i], &check, 10);
+			if (*check != '\0' || values[i-2] < minimums[i-2] || values[i-2] > maximums[i-2]) {
+				printf("Not an integer from %ld to %ld: %s\n", minimums[i-2], maximums[i-2], com->tokens[i]);
+				return serving;
+			}
+		}
+
+		if (!InferenceServer_init(server, model, values[1], values[2], 16 * values[1])) {
+			printf("No free reader slot in the model\n");
+			return 0;
+		}
+		char started = local? InferenceServer_listenUnix(server, com->tokens[2]) : InferenceServer_listenTcp(server, values[0]);
+		if (!started) {
+			printf("Could not listen on %s\n", com->tokens[2]);
+			InferenceServer_deinit(server);
+			return 0;
+		}
+
+		if (local) printf("Serving on %s\n", com->tokens[2]);
+		else printf("Serving on 127.0.0.1:%u\n", server->port);
+		return 1;
+	}
+
+
 
 	void NetworkCLI_start(
 		NeuralNetwork *net,
@@ -287,6 +1084,7 @@
 		void (*onlineBPErrorFunction)(NeuralNetwork* net, NeuronUnit* expected, NeuronUnit* errorValue, NeuronUnit* errorGradients),
 		void (*stochasticBPErrorFunction)(NeuralNetwork* net, NeuronUnit* expected, NeuronUnit* errorValue, NeuronUnit* errorGradients)) {
 		char buf[2048];
+		char tracePath[256] = "";
 		Command com;
 		com.tokens = malloc(100 * sizeof(char*));
 
@@ -295,6 +1093,25 @@
 		BPTrainer_init(&onlineBP, net, provider, *onlineBPErrorFunction);
 		BPTrainer_init(&stochasticBP, net, provider, *stochasticBPErrorFunction);
 
+		BatchSizeSchedule batchSchedule;
+		SharedModel model;
+		char hasModel = 0;
+		InferenceServer server;
+		char serving = 0;
+		ModelWatcher watcher;
+		char watching = 0;
+		Checkpointer checkpointer;
+		char checkpointing = 0;
+		BackgroundTrainer background;
+		BackgroundTrainer_init(&background, &onlineBP, NetworkCLI_publishSnapshot, &model, 1000);
+
+		//progress goes to the console by default, written by the reporter thread
+		MetricsSink metrics;
+		FILE *metricsFile = stdout;
+		MetricsSink_init(&metrics, MetricsSink_CONSOLE, stdout, 4096, 500);
+		BPTrainer_setMetrics(&onlineBP, &metrics, 100);
+		BPTrainer_setMetrics(&stochasticBP, &metrics, 100);
+
 
 		//loop
 		while(1) {
@@ -303,20 +1120,71 @@
 
 			if (com.length == 0) continue;
 
+			char training = atomic_load(&background.state) != BackgroundTrainer_IDLE;
+			if (training && !NetworkCLI_allowedWhileTraining(com.tokens[0])) {
+				printf("Training runs in the background. Stop it first (stop)\n");
+				continue;
+			}
+
+			char traced = tracePath[0] != '\0' && NetworkCLI_isTrainingCommand(com.tokens[0]);
+			if (traced) Tracer_start();
+
 			if (strcmp(com.tokens[0], "exit") == 0) break;
 			else if (strcmp(com.tokens[0], "weights") == 0) NetworkCLI_reportWeights(net);
+			else if (strcmp(com.tokens[0], "predict") == 0 && training) NetworkCLI_predictSnapshot(net, &model, &com);
 			else if (strcmp(com.tokens[0], "predict") == 0) NetworkCLI_predict(net, &com);
+			else if (strcmp(com.tokens[0], "predictFile") == 0) NetworkCLI_predictFile(net, &com);
+			else if (strcmp(com.tokens[0], "start") == 0) {
+				NetworkCLI_sharedModel(net, &model, &hasModel);
+				NetworkCLI_startBackground(&com, &background, &onlineBP, &stochasticBP);
+			}
+			else if (strcmp(com.tokens[0], "pause") == 0) BackgroundTrainer_pause(&background);
+			else if (strcmp(com.tokens[0], "resume") == 0) BackgroundTrainer_resume(&background);
+			else if (strcmp(com.tokens[0], "stop") == 0) BackgroundTrainer_stop(&background);
+			else if (strcmp(com.tokens[0], "status") == 0) NetworkCLI_backgroundStatus(&background, &model, hasModel);
 			else if (strcmp(com.tokens[0], "online") == 0) NetworkCLI_trainOnline(&onlineBP, &com);
 			else if (strcmp(com.tokens[0], "stoch") == 0) NetworkCLI_trainStochastic(&stochasticBP, &com);
+			else if (strcmp(com.tokens[0], "lm") == 0) NetworkCLI_trainLM(net, provider, &com);
+			else if (strcmp(com.tokens[0], "lbfgs") == 0) NetworkCLI_trainLBFGS(net, provider, &com, *stochasticBPErrorFunction);
 			else if (strcmp(com.tokens[0], "minWeights") == 0) NetworkCLI_reportMinWeights(&com, &onlineBP, &stochasticBP);
 			else if (strcmp(com.tokens[0], "loadWeights") == 0) NetworkCLI_loadMinWeights(&com, net, &onlineBP, &stochasticBP);
 			else if (strcmp(com.tokens[0], "setWeights") == 0) NetworkCLI_setWeights(net, &com);
 			else if (strcmp(com.tokens[0], "randomWeights") == 0) NetworkCLI_randomWeights(net);
+			else if (strcmp(com.tokens[0], "optimizer") == 0) NetworkCLI_setOptimizer(&com, &onlineBP, &stochasticBP);
+			else if (strcmp(com.tokens[0], "batch") == 0) NetworkCLI_setBatchSchedule(&com, &batchSchedule, &stochasticBP);
+			else if (strcmp(com.tokens[0], "fit") == 0) NetworkCLI_fit(&com, &onlineBP, &stochasticBP);
+			else if (strcmp(com.tokens[0], "eval") == 0) NetworkCLI_evaluate(net, provider, &com, *stochasticBPErrorFunction);
+			else if (strcmp(com.tokens[0], "best") == 0) NetworkCLI_setBestTracking(&com, &onlineBP, &stochasticBP);
+			else if (strcmp(com.tokens[0], "stats") == 0) NetworkCLI_stats(net, &com);
+			else if (strcmp(com.tokens[0], "trace") == 0) NetworkCLI_trace(&com, tracePath);
+			else if (strcmp(com.tokens[0], "metrics") == 0) NetworkCLI_metrics(&com, &metrics, &metricsFile, &onlineBP, &stochasticBP);
+			else if (strcmp(com.tokens[0], "save") == 0) NetworkCLI_save(net, &com);
+			else if (strcmp(com.tokens[0], "load") == 0) NetworkCLI_load(net, &com);
+			else if (strcmp(com.tokens[0], "generate") == 0) NetworkCLI_generate(net, &com);
+			else if (strcmp(com.tokens[0], "optimize") == 0) NetworkCLI_optimize(net, &com);
+			else if (strcmp(com.tokens[0], "prune") == 0) NetworkCLI_prune(net, &com, &onlineBP);
+			else if (strcmp(com.tokens[0], "pruneNeurons") == 0) NetworkCLI_pruneNeurons(net, &com, provider);
+			else if (strcmp(com.tokens[0], "checkpoint") == 0) checkpointing = NetworkCLI_checkpoint(net, &com, &checkpointer, checkpointing, &onlineBP, &stochasticBP);
+			else if (strcmp(com.tokens[0], "restore") == 0) NetworkCLI_restore(&com, &onlineBP, &stochasticBP);
+			else if (strcmp(com.tokens[0], "publish") == 0) NetworkCLI_publish(net, &model, hasModel);
+			else if (strcmp(com.tokens[0], "watch") == 0) watching = NetworkCLI_watch(net, &com, &model, &hasModel, &watcher, watching);
+			else if (strcmp(com.tokens[0], "serve") == 0) serving = NetworkCLI_serve(NetworkCLI_sharedModel(net, &model, &hasModel), &com, &server, serving);
 			else if (strcmp(com.tokens[0], "") == 0) continue;
 			else printf("Unknown command: %s\n", com.tokens[0]);
+
+			if (traced) NetworkCLI_writeTrace(tracePath);
 		}
 
 		//cleanup
+		BackgroundTrainer_deinit(&background);
+		if (checkpointing) Checkpointer_deinit(&checkpointer);
+		if (watching) ModelWatcher_deinit(&watcher);
+		if (serving) InferenceServer_deinit(&server);
+		if (hasModel) SharedModel_deinit(&model);
+		if (onlineBP.metrics != NULL) {
+			MetricsSink_deinit(&metrics);
+			if (metricsFile != stdout) fclose(metricsFile);
+		}
 		BPTrainer_deinit(&onlineBP);
 		BPTrainer_deinit(&stochasticBP);
 		free(com.tokens);
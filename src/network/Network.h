@@ -31,9 +31,43 @@
 	typedef struct {
 		NeuronUnit (*inToOut)(NeuronUnit x);
 		NeuronUnit (*inToDerivative)(NeuronUnit x);
+		unsigned char type;		//one of NeuronActivator_*, so that the network can be saved
 	} NeuronActivator;
 
 
+	//Per layer instrumentation. Compiled in only with -DNETWORK_STATS
+	//-DNETWORK_PERF_COUNTERS (linux only) adds hardware counters through perf_event_open, and implies NETWORK_STATS.
+	#if defined(NETWORK_PERF_COUNTERS) && !defined(NETWORK_STATS)
+		#define NETWORK_STATS
+	#endif
+
+	#define NetworkStats_PREDICT 0
+	#define NetworkStats_SAVE_GRADIENT 1
+	#define NetworkStats_ADD_TO_GRADIENT 2
+	#define NetworkStats_ADJUST_WEIGHTS 3
+	#define NetworkStats_PHASE_COUNT 4
+
+	#define NetworkStats_CYCLES 0
+	#define NetworkStats_INSTRUCTIONS 1
+	#define NetworkStats_L1D_MISSES 2
+	#define NetworkStats_LLC_MISSES 3
+	#define NetworkStats_BRANCH_MISSES 4
+	#define NetworkStats_COUNTER_COUNT 5
+	typedef struct {
+		unsigned long int calls;
+		unsigned long int nanoseconds;
+		unsigned long int synapses; //synapses touched
+		unsigned long int counters[NetworkStats_COUNTER_COUNT]; //hardware counters. Zero if unavailable.
+	} NetworkLayerStats;
+
+	typedef struct {
+		unsigned long int nanoseconds;
+		#ifdef NETWORK_PERF_COUNTERS
+			unsigned long int counters[NetworkStats_COUNTER_COUNT];
+		#endif
+	} NetworkStatsSample;
+
+
 	#define NetworkLayer_FULLY_CONNECTED 1
 	#define NetworkLayer_INDIVIDUAL 2
 	#define NetworkLayer_OUTPUT 3
@@ -44,6 +78,10 @@
 		NeuronActivator activator;
 
 		unsigned int synapseCount;
+
+		#ifdef NETWORK_STATS
+			NetworkLayerStats stats[NetworkStats_PHASE_COUNT];
+		#endif
 	} NetworkLayer;
 
 
@@ -53,10 +91,106 @@
 
 		unsigned short int neuronCount;
 		unsigned long int synapseCount;
+		NeuronSynapse* synapses; //all synapses of the network, in the same order as the weight buffers
 	} NeuralNetwork;
 
 
 
+	/** A synapse seen from its target, see NeuralNetwork_incoming. */
+	typedef struct {
+		unsigned short int source;	//index of the source neuron in its layer, neuronCount for the bias
+		unsigned long int synapse;	//index in NeuralNetwork.synapses
+	} NetworkLayerTerm;
+
+
+
+	/** A network lowered into flat ops for fast single sample inference, see NetworkPlan_init.
+	 * Every layer's values live in one buffer, followed by a constant 1 that stands for the bias. */
+	#define NetworkPlan_DENSE 1		//every input to every output: the weights are a column major matrix, inputs (and the bias) by outputs
+	#define NetworkPlan_SPARSE 2	//the synapses of every output, in rows (compressed sparse rows)
+	typedef struct {
+		unsigned char kind;		//one of NetworkPlan_*
+		unsigned char activatorType;
+		NeuronUnit (*activate)(NeuronUnit x);	//called only for NeuronActivator_CUSTOM
+
+		unsigned short int inputCount;
+		unsigned short int outputCount;
+		NeuronUnit *input;		//inputCount values and the bias
+		NeuronUnit *output;
+
+		NeuronUnit *weights;
+		unsigned long int *synapses;	//the synapse of every weight, NetworkPlan_NO_SYNAPSE for the zeros of dense ops
+		unsigned int *rowStarts;		//SPARSE only: outputCount+1 offsets into weights and columns
+		unsigned short int *columns;	//SPARSE only: the input of every weight, inputCount for the bias
+	} NetworkPlanOp;
+
+	#define NetworkPlan_NO_SYNAPSE ((unsigned long int) -1)
+	typedef struct {
+		unsigned short int inputCount;
+		unsigned short int outputCount;
+		unsigned short int opCount;
+		NetworkPlanOp *ops;
+		unsigned long int weightCount;
+		NeuronUnit *weights;			//the weights of all ops, in the order they run
+		unsigned long int *synapses;
+		unsigned int *rowStarts;
+		unsigned short int *columns;
+		NeuronUnit *values;				//the values of all layers
+		NeuronUnit *output;				//the values of the last one
+	} NetworkPlan;
+
+
+
+	/** A network as one dense matrix per layer, which is easy to rewrite (fold, prune) before building a network from it again.
+	 * A synapse exists where connected is set, even if its weight is 0. */
+	typedef struct {
+		unsigned short int neuronCount;
+		NeuronActivator activator;
+		NeuronUnit *weights;		//neuronCount+1 rows (the bias last) of the next layer's neuronCount. NULL for the last layer
+		unsigned char *connected;	//same layout as weights
+	} NetworkDraftLayer;
+
+	typedef struct {
+		unsigned short int layerCount;
+		NetworkDraftLayer *layers;
+	} NetworkDraft;
+
+	typedef struct {
+		unsigned short int layersBefore;
+		unsigned short int layersAfter;
+		unsigned long int synapsesBefore;
+		unsigned long int synapsesAfter;
+		NeuronUnit maxDifference;	//largest difference between the outputs of both networks on the probe inputs, relative to 1+|output|
+	} NetworkOptimizerReport;
+
+
+
+	typedef struct {
+		unsigned long int synapsesBefore;
+		unsigned long int synapsesAfter;
+		unsigned long int bytesBefore;		//see NeuralNetwork_modelBytes
+		unsigned long int bytesAfter;
+		NeuronUnit predictNsBefore;			//per NeuralNetwork_predict
+		NeuronUnit predictNsAfter;
+		NeuronUnit planNsBefore;			//per NetworkPlan_run, which runs the pruned layers with sparse kernels
+		NeuronUnit planNsAfter;
+	} NetworkPruneReport;
+
+
+
+	typedef struct {
+		unsigned short int hiddenBefore;	//neurons of the hidden layers
+		unsigned short int hiddenAfter;
+		unsigned short int dead;			//removed ReLU and leaky ReLU neurons that never activated, or neurons without outgoing synapses
+		unsigned short int constant;		//removed neurons with the same output for every sample
+		unsigned short int duplicates;		//removed neurons with the same outputs as another one of their layer
+		unsigned long int synapsesBefore;
+		unsigned long int synapsesAfter;
+		NeuronUnit maxDifference;			//largest difference between the outputs of both networks on the calibration samples
+	} NetworkNeuronPruneReport;
+
+
+
 //STRUCTURES. Those structs store information on how to initialize a Network.
 	typedef struct {
 		unsigned char connectionType;
@@ -134,6 +268,8 @@
 //NeuralNetwork functions
 	void NeuralNetwork_init(NeuralNetwork* this, NeuralNetworkStructure* s);
 	void NeuralNetwork_deinit(NeuralNetwork* this);
+	void NeuralNetwork_initCopy(NeuralNetwork* this, NeuralNetwork* source);
+	char NeuralNetwork_sameTopology(NeuralNetwork* this, NeuralNetwork* other);
 	void NeuralNetwork_randomSynapses(NeuralNetwork* this);
 	void NeuralNetwork_loadSynapseWeights(NeuralNetwork* this, NeuronUnit* weights);
 	void NeuralNetwork_saveSynapseWeights(NeuralNetwork* this, NeuronUnit* buffer);
@@ -145,10 +281,83 @@
 	void NeuralNetwork_predict(NeuralNetwork * this);
 	void NeuralNetwork_saveGradient(NeuralNetwork *this, NeuronUnit *errorDerivatives, NeuronUnit* grad);
 	void NeuralNetwork_addToGradient(NeuralNetwork *this, NeuronUnit *errorDerivatives, NeuronUnit* grad);
+	unsigned long int NeuralNetwork_batchScratchSize(NeuralNetwork * this, unsigned int batchSize);
+	void NeuralNetwork_predictBatch(NeuralNetwork * this, const NeuronUnit* inputs, unsigned int batchSize, NeuronUnit* outputs, NeuronUnit* scratch);
+	void NeuralNetwork_saveJacobianRow(NeuralNetwork *this, unsigned short int outputIndex, NeuronUnit* row);
+	NetworkLayerTerm* NeuralNetwork_incoming(NeuralNetwork* this, unsigned short int layerIndex, unsigned int* first);
+	unsigned long int NeuralNetwork_modelBytes(NeuralNetwork* this);
+
+
+
+
+
+//NetworkStats functions
+	#ifdef NETWORK_STATS
+		#define NetworkStats_BEGIN(start) NetworkStatsSample start; NetworkStats_sample(&start)
+		#define NetworkStats_END(layer, phase, start, synapseCount) NetworkStats_record(layer, phase, &start, synapseCount)
+	#else
+		#define NetworkStats_BEGIN(start)
+		#define NetworkStats_END(layer, phase, start, synapseCount)
+	#endif
+
+	void NetworkStats_sample(NetworkStatsSample* sample);
+	void NetworkStats_record(NetworkLayer* layer, unsigned char phase, NetworkStatsSample* start, unsigned long int synapseCount);
+	char NetworkStats_countersAvailable();
+	void NeuralNetwork_resetStats(NeuralNetwork* this);
+	char NeuralNetwork_getLayerStats(NeuralNetwork* this, unsigned short int layerIndex, unsigned char phase, NetworkLayerStats* stats);
+	void NeuralNetwork_printStats(NeuralNetwork* this, FILE* out);
+
+
+
+//NetworkFile functions
+	char NeuralNetwork_save(NeuralNetwork* this, const char* path);
+	char NeuralNetwork_load(NeuralNetwork* this, const char* path);
+	char NetworkFile_write(const char* path, NeuralNetwork* net, const NeuronUnit* weights, const void* extra, unsigned long int extraSize);
+	char NetworkFile_read(const char* path, NeuralNetwork* net, void** extra, unsigned long int* extraSize);
+
+
+
+//NetworkCodegen functions
+	char NeuralNetwork_generateC(NeuralNetwork* this, FILE* out, const char* name);
+
+
+
+//NetworkPlan functions
+	void NetworkPlan_init(NetworkPlan* this, NeuralNetwork* net);
+	void NetworkPlan_deinit(NetworkPlan* this);
+	void NetworkPlan_refresh(NetworkPlan* this, NeuralNetwork* net);
+	void NetworkPlan_run(NetworkPlan* this, const NeuronUnit* input, NeuronUnit* output);
+
+
+
+//NetworkDraft functions
+	void NetworkDraft_init(NetworkDraft* this, NeuralNetwork* net);
+	void NetworkDraft_deinit(NetworkDraft* this);
+	void NetworkDraft_build(NetworkDraft* this, NeuralNetwork* net);
+	unsigned long int NetworkDraft_synapseCount(NetworkDraft* this);
+	void NetworkDraft_removeNeurons(NetworkDraft* this, unsigned short int layerIndex, const unsigned char* removed);
+
+
+
+//NetworkOptimizer functions
+	char NetworkDraft_foldNormalization(NetworkDraft* this, const NeuronUnit* means, const NeuronUnit* deviations);
+	unsigned short int NetworkDraft_foldLinearLayers(NetworkDraft* this);
+	char NeuralNetwork_optimize(NeuralNetwork* this, NeuralNetwork* result, const NeuronUnit* means, const NeuronUnit* deviations, NetworkOptimizerReport* report);
+	char NetworkOptimizer_readNormalization(const char* path, unsigned short int inputCount, NeuronUnit* means, NeuronUnit* deviations);
+
 
 
+//NetworkPruner functions
+	unsigned long int NetworkDraft_pruneBelow(NetworkDraft* this, NeuronUnit threshold);
+	unsigned long int NetworkDraft_pruneTopK(NetworkDraft* this, unsigned long int keepPerLayer);
+	void NeuralNetwork_prune(NeuralNetwork* this, NeuralNetwork* result, NeuronUnit threshold, unsigned long int keepPerLayer, NetworkPruneReport* report);
+	void NetworkPruneReport_print(NetworkPruneReport* this, FILE* out);
+	void NeuralNetwork_pruneNeurons(NeuralNetwork* this, NeuralNetwork* result, const NeuronUnit* inputs, unsigned int sampleCount, unsigned long int stride,
+		NeuronUnit tolerance, NetworkNeuronPruneReport* report);
+	void NetworkNeuronPruneReport_print(NetworkNeuronPruneReport* this, FILE* out);
 
 
 
 //NeuralNetworkStructure functions
-	void NeuralNetworkStructure_deinit();
+	void NeuralNetworkStructure_init(NeuralNetworkStructure* this, NeuralNetwork* net);
+	void NeuralNetworkStructure_deinit(NeuralNetworkStructure* this);
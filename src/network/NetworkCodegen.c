@@ -0,0 +1,99 @@
+#include "Network.h"
+#include <ctype.h>
+#include <stdlib.h>
+
+/* The generated function adds the inputs of every neuron in the order of NeuralNetwork_predict
+ * (source neurons from the last to the first, then the bias), so that both give the same results. */
+
+//UTILS
+	static char NetworkCodegen_isIdentifier(const char* name) {
+		if (!isalpha((unsigned char) name[0]) && name[0] != '_') return 0;
+		for (const char *c = name; *c; ++c) {
+			if (!isalnum((unsigned char) *c) && *c != '_') return 0;
+		}
+		return 1;
+	}
+
+	static const char* NetworkCodegen_activatorName(unsigned char type) {
+		switch (type) {
+			case NeuronActivator_SIGMOID: return "sigmoid";
+			case NeuronActivator_TANH: return "tanh";
+			case NeuronActivator_RELU: return "relu";
+			case NeuronActivator_LEAKY_RELU: return "leakyRelu";
+			default: return "linear";
+		}
+	}
+
+
+
+//GENERATION
+	/** Writes a standalone C file with `void name(const double* input, double* output)`, which predicts like this network:
+	 * every layer unrolled, the weights in static const arrays, the activators inlined, no function pointers and no heap.
+	 * It includes <math.h> (link with -lm) only for sigmoid and tanh. Meant for small networks: the code grows with the synapse count.
+	 * Returns 0 if name is not a C identifier, or a layer (but the input one) has a NeuronActivator_CUSTOM activator. */
+	char NeuralNetwork_generateC(NeuralNetwork* this, FILE* out, const char* name) {
+		if (!NetworkCodegen_isIdentifier(name)) return 0;
+		char used[NeuronActivator_LEAKY_RELU + 1] = {0};
+		for (unsigned short int i = 1; i < this->layerCount; ++i) {
+			if (this->layers[i].activator.type == NeuronActivator_CUSTOM) return 0;
+			used[this->layers[i].activator.type] = 1;
+		}
+
+		unsigned short int inputCount = this->layers[0].neuronCount;
+		unsigned short int outputCount = this->layers[this->layerCount - 1].neuronCount;
+		fprintf(out, "/* Generated by NeuralNetwork_generateC: %u layers, %u inputs, %u outputs, %lu synapses. */\n",
+			this->layerCount, inputCount, outputCount, this->synapseCount);
+		if (used[NeuronActivator_SIGMOID] || used[NeuronActivator_TANH]) fprintf(out, "#include <math.h>\n");
+		fprintf(out, "\n#define %s_INPUT_COUNT %u\n#define %s_OUTPUT_COUNT %u\n\n", name, inputCount, name, outputCount);
+
+		//activators
+		if (used[NeuronActivator_SIGMOID]) fprintf(out, "static inline double %s_sigmoid(double x) { return 1 / (1 + exp(-x)); }\n", name);
+		if (used[NeuronActivator_TANH]) fprintf(out, "static inline double %s_tanh(double x) { return tanh(x); }\n", name);
+		if (used[NeuronActivator_LINEAR]) fprintf(out, "static inline double %s_linear(double x) { return x; }\n", name);
+		if (used[NeuronActivator_RELU]) fprintf(out, "static inline double %s_relu(double x) { return x > 0 ? x : 0; }\n", name);
+		if (used[NeuronActivator_LEAKY_RELU]) fprintf(out, "static inline double %s_leakyRelu(double x) { return x > 0 ? x : 0.001 * x; }\n", name);
+
+		//weights of every layer, in the order they are used below
+		unsigned int **firsts = malloc(this->layerCount * sizeof(unsigned int*));
+		NetworkLayerTerm **terms = malloc(this->layerCount * sizeof(NetworkLayerTerm*));
+		for (unsigned short int i = 0; i + 1 < this->layerCount; ++i) {
+			unsigned short int targetCount = this->layers[i + 1].neuronCount;
+			firsts[i] = malloc((targetCount + 1) * sizeof(unsigned int));
+			terms[i] = NeuralNetwork_incoming(this, i, firsts[i]);
+
+			unsigned int count = firsts[i][targetCount];
+			fprintf(out, "\nstatic const double %s_w%u[%u] = {", name, i, count == 0? 1 : count);
+			for (unsigned int k = 0; k < count; ++k) fprintf(out, "%s%s%.17g", k == 0? "" : ",", k % 4 == 0? "\n\t" : " ", this->synapses[terms[i][k].synapse].weight);
+			fprintf(out, count == 0? "0};\n" : "\n};\n");
+		}
+
+		//the function
+		fprintf(out, "\nvoid %s(const double* restrict input, double* restrict output) {\n", name);
+		for (unsigned short int i = 0; i + 1 < this->layerCount; ++i) {
+			char last = i + 2 == this->layerCount;
+			unsigned short int targetCount = this->layers[i + 1].neuronCount;
+			const char *activator = NetworkCodegen_activatorName(this->layers[i + 1].activator.type);
+			for (unsigned short int t = 0; t < targetCount; ++t) {
+				if (last) fprintf(out, "\toutput[%u] = %s_%s(", t, name, activator);
+				else fprintf(out, "\tconst double l%u_%u = %s_%s(", i + 1, t, name, activator);
+
+				if (firsts[i][t] == firsts[i][t + 1]) fprintf(out, "0.0");
+				for (unsigned int k = firsts[i][t]; k < firsts[i][t + 1]; ++k) {
+					fprintf(out, "%s%s_w%u[%u]", k == firsts[i][t]? "" : " + ", name, i, k);
+					if (terms[i][k].source == this->layers[i].neuronCount) continue; //the bias
+					if (i == 0) fprintf(out, " * input[%u]", terms[i][k].source);
+					else fprintf(out, " * l%u_%u", i, terms[i][k].source);
+				}
+				fprintf(out, ");\n");
+			}
+		}
+		fprintf(out, "}\n");
+
+		for (unsigned short int i = 0; i + 1 < this->layerCount; ++i) {
+			free(firsts[i]);
+			free(terms[i]);
+		}
+		free(firsts);
+		free(terms);
+		return !ferror(out);
+	}
@@ -0,0 +1,137 @@
+#include "Network.h"
+#include <stdlib.h>
+#include <string.h>
+
+//LIFE CIRCLE
+	/** Copies the topology, the activators and the weights of net. Synapses with the same source and target are merged into one. */
+	void NetworkDraft_init(NetworkDraft* this, NeuralNetwork* net) {
+		this->layerCount = net->layerCount;
+		this->layers = malloc(net->layerCount * sizeof(NetworkDraftLayer));
+
+		for (unsigned short int i = 0; i < net->layerCount; ++i) {
+			NetworkLayer *layer = net->layers + i;
+			NetworkDraftLayer *draft = this->layers + i;
+			draft->neuronCount = layer->neuronCount;
+			draft->activator = layer->activator;
+			draft->weights = NULL;
+			draft->connected = NULL;
+			if (i == net->layerCount - 1) continue;
+
+			unsigned short int targetCount = net->layers[i + 1].neuronCount;
+			unsigned long int size = (unsigned long int) (layer->neuronCount + 1) * targetCount;
+			draft->weights = calloc(size, sizeof(NeuronUnit));
+			draft->connected = calloc(size, sizeof(unsigned char));
+			for (unsigned short int j = 0; j <= layer->neuronCount; ++j) {
+				Neuron *neuron = (j == layer->neuronCount)? &layer->bias : layer->neurons + j;
+				for (unsigned int k = 0; k < neuron->synapseCount; ++k) {
+					unsigned long int position = (unsigned long int) j * targetCount + neuron->synapses[k].targetIndex;
+					draft->weights[position] += neuron->synapses[k].weight;
+					draft->connected[position] = 1;
+				}
+			}
+		}
+	}
+
+	void NetworkDraft_deinit(NetworkDraft* this) {
+		for (unsigned short int i = 0; i < this->layerCount; ++i) {
+			free(this->layers[i].weights);
+			free(this->layers[i].connected);
+		}
+		free(this->layers);
+	}
+
+	/** Initializes net with the topology, the activators and the weights of the draft. Every layer is built as NetworkLayer_INDIVIDUAL. */
+	void NetworkDraft_build(NetworkDraft* this, NeuralNetwork* net) {
+		NeuralNetworkStructure str;
+		str.layers = malloc(this->layerCount * sizeof(NetworkLayerStructure));
+
+		for (unsigned short int i = 0; i < this->layerCount; ++i) {
+			NetworkDraftLayer *draft = this->layers + i;
+			NetworkLayerStructure *layer = str.layers + i;
+			layer->activatorType = draft->activator.type;
+			layer->activationFunc = draft->activator.inToOut;
+			layer->activationDerivative = draft->activator.inToDerivative;
+			layer->neuronCount = draft->neuronCount;
+
+			if (i == this->layerCount - 1) {
+				layer->connectionType = NetworkLayer_OUTPUT;
+				layer->neurons = NULL;
+				layer->bias = NULL;
+				continue;
+			}
+
+			unsigned short int targetCount = this->layers[i + 1].neuronCount;
+			layer->connectionType = NetworkLayer_INDIVIDUAL;
+			layer->neurons = malloc((draft->neuronCount + 1) * sizeof(int*));
+			layer->neurons[draft->neuronCount] = NULL;
+			for (unsigned short int j = 0; j <= draft->neuronCount; ++j) {
+				const unsigned char *connected = draft->connected + (unsigned long int) j * targetCount;
+				int *targets = malloc((targetCount + 1) * sizeof(int));
+				unsigned short int count = 0;
+				for (unsigned short int t = 0; t < targetCount; ++t) {
+					if (connected[t]) targets[count++] = t;
+				}
+				targets[count] = -1;
+
+				if (j == draft->neuronCount) layer->bias = targets;
+				else layer->neurons[j] = targets;
+			}
+		}
+
+		NeuralNetwork_init(net, &str);
+		NeuralNetworkStructure_deinit(&str);
+
+		for (unsigned short int i = 0; i + 1 < this->layerCount; ++i) {
+			NetworkLayer *layer = net->layers + i;
+			unsigned short int targetCount = this->layers[i + 1].neuronCount;
+			for (unsigned short int j = 0; j <= layer->neuronCount; ++j) {
+				Neuron *neuron = (j == layer->neuronCount)? &layer->bias : layer->neurons + j;
+				const NeuronUnit *weights = this->layers[i].weights + (unsigned long int) j * targetCount;
+				for (unsigned int k = 0; k < neuron->synapseCount; ++k) neuron->synapses[k].weight = weights[neuron->synapses[k].targetIndex];
+			}
+		}
+	}
+
+
+
+//EDITING
+	/** Removes the neurons of the hidden layer layerIndex whose flag in removed is set, with the synapses that reach and leave them.
+	 * The matrices are compacted in place. Keep at least one neuron. */
+	void NetworkDraft_removeNeurons(NetworkDraft* this, unsigned short int layerIndex, const unsigned char* removed) {
+		NetworkDraftLayer *previous = this->layers + layerIndex - 1;
+		NetworkDraftLayer *layer = this->layers + layerIndex;
+		unsigned short int oldCount = layer->neuronCount, newCount = 0, targetCount = this->layers[layerIndex + 1].neuronCount;
+		for (unsigned short int j = 0; j < oldCount; ++j) newCount += !removed[j];
+
+		//the columns of the synapses that reach them
+		unsigned long int next = 0;
+		for (unsigned short int s = 0; s <= previous->neuronCount; ++s) {
+			for (unsigned short int j = 0; j < oldCount; ++j) {
+				if (removed[j]) continue;
+				previous->weights[next] = previous->weights[(unsigned long int) s * oldCount + j];
+				previous->connected[next++] = previous->connected[(unsigned long int) s * oldCount + j];
+			}
+		}
+
+		//the rows of the synapses that leave them. The bias row stays last
+		unsigned short int row = 0;
+		for (unsigned short int j = 0; j <= oldCount; ++j) {
+			if (j < oldCount && removed[j]) continue;
+			memmove(layer->weights + (unsigned long int) row * targetCount, layer->weights + (unsigned long int) j * targetCount, targetCount * sizeof(NeuronUnit));
+			memmove(layer->connected + (unsigned long int) row * targetCount, layer->connected + (unsigned long int) j * targetCount, targetCount);
+			row++;
+		}
+		layer->neuronCount = newCount;
+	}
+
+
+
+//QUERIES
+	unsigned long int NetworkDraft_synapseCount(NetworkDraft* this) {
+		unsigned long int count = 0;
+		for (unsigned short int i = 0; i + 1 < this->layerCount; ++i) {
+			unsigned long int size = (unsigned long int) (this->layers[i].neuronCount + 1) * this->layers[i + 1].neuronCount;
+			for (unsigned long int k = 0; k < size; ++k) count += this->layers[i].connected[k];
+		}
+		return count;
+	}
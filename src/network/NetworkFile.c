@@ -0,0 +1,257 @@
+#include "Network.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <unistd.h>
+
+/* File layout, in host byte order:
+ * "NNW1"
+ * u16 layerCount, then per layer: u8 activatorType, u16 neuronCount
+ * per layer but the last, per neuron and then the bias: u32 synapseCount, u16 targetIndex[synapseCount]
+ * u64 synapseCount, NeuronUnit weights[synapseCount] (the order of NeuralNetwork.synapses)
+ * u64 extraSize, extra bytes (training state of checkpoints. Files without this section are read as extraSize 0)
+ * u64 FNV-1a hash of everything above, so that a half written file is never loaded */
+#define NetworkFile_MAGIC "NNW1"
+
+
+//WRITING
+	typedef struct {
+		FILE *file;
+		uint64_t hash;
+		char ok;
+	} NetworkFileWriter;
+
+	static void NetworkFileWriter_write(NetworkFileWriter* this, const void* data, unsigned long int size) {
+		const unsigned char *bytes = data;
+		for (unsigned long int i = 0; i < size; ++i) this->hash = (this->hash ^ bytes[i]) * 1099511628211UL;
+		if (fwrite(data, 1, size, this->file) != size) this->ok = 0;
+	}
+
+	/** Makes a rename inside the directory of path durable. */
+	static void NetworkFile_syncDirectory(const char* path) {
+		char *copy = strdup(path);
+		int fd = open(dirname(copy), O_RDONLY);
+		if (fd >= 0) {
+			fsync(fd);
+			close(fd);
+		}
+		free(copy);
+	}
+
+	/** Saves the topology, the activators and the weights. The file is written next to path and then renamed,
+	 * so a process that watches path sees either the old model or the new one, never a mix.
+	 * Fails for layers (but the input one) with NeuronActivator_CUSTOM, whose functions cannot be saved. */
+	char NeuralNetwork_save(NeuralNetwork* this, const char* path) {
+		return NetworkFile_write(path, this, NULL, NULL, 0);
+	}
+
+	/** Like NeuralNetwork_save, with the weights taken from weights (NULL for the network's own, see NeuralNetwork_saveSynapseWeights)
+	 * and extraSize bytes of extra data. Only the topology of net is read, so it may be trained meanwhile if weights are given. */
+	char NetworkFile_write(const char* path, NeuralNetwork* net, const NeuronUnit* weights, const void* extra, unsigned long int extraSize) {
+		for (unsigned short int i = 1; i < net->layerCount; ++i) {
+			if (net->layers[i].activator.type == NeuronActivator_CUSTOM) return 0;
+		}
+
+		char *temporary = malloc(strlen(path) + 5);
+		strcpy(temporary, path);
+		strcat(temporary, ".tmp");
+		NetworkFileWriter writer = { fopen(temporary, "wb"), 14695981039346656037UL, 1 };
+		if (writer.file == NULL) {
+			free(temporary);
+			return 0;
+		}
+
+		NetworkFileWriter_write(&writer, NetworkFile_MAGIC, 4);
+		uint16_t layerCount = net->layerCount;
+		NetworkFileWriter_write(&writer, &layerCount, sizeof(uint16_t));
+		for (unsigned short int i = 0; i < net->layerCount; ++i) {
+			uint8_t type = net->layers[i].activator.type;
+			uint16_t neuronCount = net->layers[i].neuronCount;
+			NetworkFileWriter_write(&writer, &type, sizeof(uint8_t));
+			NetworkFileWriter_write(&writer, &neuronCount, sizeof(uint16_t));
+		}
+
+		for (unsigned short int i = 0; i + 1 < net->layerCount; ++i) {
+			NetworkLayer *layer = net->layers + i;
+			for (unsigned short int j = 0; j <= layer->neuronCount; ++j) {
+				Neuron *neuron = (j == layer->neuronCount)? &layer->bias : layer->neurons + j;
+				uint32_t synapseCount = neuron->synapseCount;
+				NetworkFileWriter_write(&writer, &synapseCount, sizeof(uint32_t));
+				for (unsigned int k = 0; k < neuron->synapseCount; ++k) {
+					uint16_t target = neuron->synapses[k].targetIndex;
+					NetworkFileWriter_write(&writer, &target, sizeof(uint16_t));
+				}
+			}
+		}
+
+		uint64_t synapseCount = net->synapseCount;
+		NetworkFileWriter_write(&writer, &synapseCount, sizeof(uint64_t));
+		if (weights != NULL) NetworkFileWriter_write(&writer, weights, net->synapseCount * sizeof(NeuronUnit));
+		else for (unsigned long int i = 0; i < net->synapseCount; ++i) NetworkFileWriter_write(&writer, &net->synapses[i].weight, sizeof(NeuronUnit));
+
+		uint64_t size = extraSize;
+		NetworkFileWriter_write(&writer, &size, sizeof(uint64_t));
+		if (extraSize) NetworkFileWriter_write(&writer, extra, extraSize);
+
+		uint64_t hash = writer.hash;
+		NetworkFileWriter_write(&writer, &hash, sizeof(uint64_t));
+
+		char ok = writer.ok && fflush(writer.file) == 0 && fsync(fileno(writer.file)) == 0;
+		ok = fclose(writer.file) == 0 && ok;
+		ok = ok && rename(temporary, path) == 0;
+		if (ok) NetworkFile_syncDirectory(path);
+		else remove(temporary);
+		free(temporary);
+		return ok;
+	}
+
+
+
+//READING
+	typedef struct {
+		const unsigned char *position;
+		const unsigned char *end;
+	} NetworkFileReader;
+
+	static char NetworkFileReader_read(NetworkFileReader* this, void* target, unsigned long int size) {
+		if ((unsigned long int) (this->end - this->position) < size) return 0;
+		memcpy(target, this->position, size);
+		this->position += size;
+		return 1;
+	}
+
+	/** Reads the whole file, and checks its hash. Returns NULL if the file is missing, incomplete or corrupt. */
+	static unsigned char* NetworkFile_readVerified(const char* path, unsigned long int* size) {
+		FILE *file = fopen(path, "rb");
+		if (file == NULL) return NULL;
+
+		fseek(file, 0, SEEK_END);
+		long int length = ftell(file);
+		fseek(file, 0, SEEK_SET);
+		if (length < 4 + (long int) sizeof(uint64_t)) {
+			fclose(file);
+			return NULL;
+		}
+
+		unsigned char *data = malloc(length);
+		char ok = fread(data, 1, length, file) == (unsigned long int) length;
+		fclose(file);
+
+		*size = length - sizeof(uint64_t);
+		uint64_t hash = 14695981039346656037UL;
+		for (unsigned long int i = 0; i < *size; ++i) hash = (hash ^ data[i]) * 1099511628211UL;
+		uint64_t expected;
+		memcpy(&expected, data + *size, sizeof(uint64_t));
+
+		if (!ok || hash != expected || memcmp(data, NetworkFile_MAGIC, 4) != 0) {
+			free(data);
+			return NULL;
+		}
+		return data;
+	}
+
+	static char NetworkFile_readStructure(NetworkFileReader* reader, NeuralNetworkStructure* str, unsigned short int* layerCount) {
+		uint16_t count;
+		if (!NetworkFileReader_read(reader, &count, sizeof(uint16_t)) || count == 0) return 0;
+		*layerCount = count;
+
+		str->layers = calloc(count, sizeof(NetworkLayerStructure));
+		for (unsigned short int i = 0; i < count; ++i) {
+			uint8_t type;
+			uint16_t neuronCount;
+			if (!NetworkFileReader_read(reader, &type, sizeof(uint8_t)) || !NetworkFileReader_read(reader, &neuronCount, sizeof(uint16_t))) return 0;
+			if (neuronCount == 0 || type > NeuronActivator_LEAKY_RELU || (i > 0 && type == NeuronActivator_CUSTOM)) return 0;
+
+			NetworkLayerStructure *layer = str->layers + i;
+			layer->activatorType = type;
+			layer->neuronCount = neuronCount;
+			layer->connectionType = (i == count - 1)? NetworkLayer_OUTPUT : NetworkLayer_INDIVIDUAL;
+		}
+
+		for (unsigned short int i = 0; i + 1 < count; ++i) {
+			NetworkLayerStructure *layer = str->layers + i;
+			unsigned short int targetCount = str->layers[i + 1].neuronCount;
+			layer->neurons = calloc(layer->neuronCount + 1, sizeof(int*));
+
+			for (unsigned short int j = 0; j <= layer->neuronCount; ++j) {
+				uint32_t synapseCount;
+				if (!NetworkFileReader_read(reader, &synapseCount, sizeof(uint32_t)) || synapseCount > targetCount) return 0;
+
+				int *targets = malloc((synapseCount + 1) * sizeof(int));
+				if (j == layer->neuronCount) layer->bias = targets;
+				else layer->neurons[j] = targets;
+				targets[synapseCount] = -1;
+
+				for (unsigned int k = 0; k < synapseCount; ++k) {
+					uint16_t target;
+					if (!NetworkFileReader_read(reader, &target, sizeof(uint16_t)) || target >= targetCount) return 0;
+					targets[k] = target;
+				}
+			}
+		}
+		return 1;
+	}
+
+	/** Frees what NetworkFile_readStructure allocated, even if it stopped half way. */
+	static void NetworkFile_freeStructure(NeuralNetworkStructure* str, unsigned short int layerCount) {
+		for (unsigned short int i = 0; i < layerCount; ++i) {
+			NetworkLayerStructure *layer = str->layers + i;
+			if (layer->neurons != NULL) {
+				for (unsigned short int j = 0; j < layer->neuronCount; ++j) free(layer->neurons[j]);
+				free(layer->neurons);
+			}
+			free(layer->bias);
+		}
+		free(str->layers);
+	}
+
+	/** Initializes this from a file written by NeuralNetwork_save.
+	 * Returns 0, leaving this uninitialized, if the file is missing, incomplete or corrupt. */
+	char NeuralNetwork_load(NeuralNetwork* this, const char* path) {
+		return NetworkFile_read(path, this, NULL, NULL);
+	}
+
+	/** Like NeuralNetwork_load. If extra is not NULL, it receives the extra data (malloc'ed, NULL if there is none) and its size. */
+	char NetworkFile_read(const char* path, NeuralNetwork* net, void** extra, unsigned long int* extraSize) {
+		unsigned long int size;
+		unsigned char *data = NetworkFile_readVerified(path, &size);
+		if (data == NULL) return 0;
+
+		NetworkFileReader reader = { data + 4, data + size };
+		NeuralNetworkStructure str = { NULL };
+		unsigned short int layerCount = 0;
+		char ok = NetworkFile_readStructure(&reader, &str, &layerCount);
+
+		uint64_t synapseCount;
+		ok = ok && NetworkFileReader_read(&reader, &synapseCount, sizeof(uint64_t));
+		ok = ok && (unsigned long int) (reader.end - reader.position) >= synapseCount * sizeof(NeuronUnit);
+		const unsigned char *weights = reader.position;
+		if (ok) reader.position += synapseCount * sizeof(NeuronUnit);
+
+		uint64_t storedExtraSize = 0;
+		if (ok && reader.position != reader.end) {
+			ok = NetworkFileReader_read(&reader, &storedExtraSize, sizeof(uint64_t));
+			ok = ok && (unsigned long int) (reader.end - reader.position) == storedExtraSize;
+		}
+
+		if (ok) {
+			NeuralNetwork_init(net, &str);
+			ok = net->synapseCount == synapseCount;
+			if (!ok) NeuralNetwork_deinit(net);
+		}
+
+		if (ok) {
+			for (unsigned long int i = 0; i < synapseCount; ++i) memcpy(&net->synapses[i].weight, weights + i * sizeof(NeuronUnit), sizeof(NeuronUnit));
+			if (extra != NULL) {
+				*extra = storedExtraSize? malloc(storedExtraSize) : NULL;
+				if (storedExtraSize) memcpy(*extra, reader.position, storedExtraSize);
+				*extraSize = storedExtraSize;
+			}
+		}
+
+		if (str.layers != NULL) NetworkFile_freeStructure(&str, layerCount);
+		free(data);
+		return ok;
+	}
@@ -31,7 +31,7 @@
 
 
 		//initialize synapse array
-		int arrOfNeurons[this->neuronCount+1];
+		int arrOfNeurons[nextLayerNeuronCount+1];
 		for(unsigned short int i = 0; i < nextLayerNeuronCount; i++) {
 			arrOfNeurons[i] = i;
 		}
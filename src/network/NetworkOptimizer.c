@@ -0,0 +1,221 @@
+#include "Network.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NetworkOptimizer_PROBES 64
+#define NetworkOptimizer_TOLERANCE 1e-9 //largest relative difference between the outputs of the original and the optimized network
+
+//FOLDING
+	/** Makes the first layer take raw inputs: input i used to be standardized as (x - means[i]) / deviations[i] before every prediction.
+	 * Each weight w of input i becomes w / deviations[i], and the bias of its target absorbs -w * means[i] / deviations[i].
+	 * Returns 0, changing nothing, if a deviation is 0 or not finite, or the draft has a single layer. */
+	char NetworkDraft_foldNormalization(NetworkDraft* this, const NeuronUnit* means, const NeuronUnit* deviations) {
+		if (this->layerCount < 2) return 0;
+		NetworkDraftLayer *first = this->layers;
+		for (unsigned short int i = 0; i < first->neuronCount; ++i) {
+			if (deviations[i] == 0 || !isfinite(deviations[i]) || !isfinite(means[i])) return 0;
+		}
+
+		unsigned short int targetCount = this->layers[1].neuronCount;
+		NeuronUnit *bias = first->weights + (unsigned long int) first->neuronCount * targetCount;
+		unsigned char *biasConnected = first->connected + (unsigned long int) first->neuronCount * targetCount;
+		for (unsigned short int i = 0; i < first->neuronCount; ++i) {
+			NeuronUnit *weights = first->weights + (unsigned long int) i * targetCount;
+			const unsigned char *connected = first->connected + (unsigned long int) i * targetCount;
+			for (unsigned short int t = 0; t < targetCount; ++t) {
+				if (!connected[t]) continue;
+				weights[t] /= deviations[i];
+				if (means[i] == 0) continue;
+				bias[t] -= weights[t] * means[i];
+				biasConnected[t] = 1;
+			}
+		}
+		return 1;
+	}
+
+	/** Replaces the synapses of layer i-1 with the product of those of layer i-1 and of layer i, and removes layer i,
+	 * whose neurons (linear) only passed their sum on. */
+	static void NetworkDraft_foldLayer(NetworkDraft* this, unsigned short int i) {
+		NetworkDraftLayer *previous = this->layers + i - 1;
+		NetworkDraftLayer *folded = this->layers + i;
+		unsigned short int sourceCount = previous->neuronCount, middleCount = folded->neuronCount, targetCount = this->layers[i + 1].neuronCount;
+
+		unsigned long int size = (unsigned long int) (sourceCount + 1) * targetCount;
+		NeuronUnit *weights = calloc(size, sizeof(NeuronUnit));
+		unsigned char *connected = calloc(size, sizeof(unsigned char));
+		for (unsigned short int s = 0; s <= sourceCount; ++s) {
+			NeuronUnit *row = weights + (unsigned long int) s * targetCount;
+			unsigned char *rowConnected = connected + (unsigned long int) s * targetCount;
+			for (unsigned short int m = 0; m < middleCount; ++m) {
+				unsigned long int position = (unsigned long int) s * middleCount + m;
+				if (!previous->connected[position]) continue;
+				NeuronUnit weight = previous->weights[position];
+				for (unsigned short int t = 0; t < targetCount; ++t) {
+					if (!folded->connected[(unsigned long int) m * targetCount + t]) continue;
+					row[t] += weight * folded->weights[(unsigned long int) m * targetCount + t];
+					rowConnected[t] = 1;
+				}
+			}
+		}
+
+		//the bias of the removed layer goes into the bias of the previous one
+		NeuronUnit *bias = weights + (unsigned long int) sourceCount * targetCount;
+		unsigned char *biasConnected = connected + (unsigned long int) sourceCount * targetCount;
+		for (unsigned short int t = 0; t < targetCount; ++t) {
+			unsigned long int position = (unsigned long int) middleCount * targetCount + t;
+			if (!folded->connected[position]) continue;
+			bias[t] += folded->weights[position];
+			biasConnected[t] = 1;
+		}
+
+		free(previous->weights);
+		free(previous->connected);
+		free(folded->weights);
+		free(folded->connected);
+		previous->weights = weights;
+		previous->connected = connected;
+		memmove(folded, folded + 1, (this->layerCount - i - 1) * sizeof(NetworkDraftLayer));
+		this->layerCount--;
+	}
+
+	/** Synapses that folding layer i would leave in place of those of layers i-1 and i. */
+	static unsigned long int NetworkDraft_foldedSynapseCount(NetworkDraft* this, unsigned short int i) {
+		NetworkDraftLayer *previous = this->layers + i - 1;
+		NetworkDraftLayer *folded = this->layers + i;
+		unsigned short int middleCount = folded->neuronCount, targetCount = this->layers[i + 1].neuronCount;
+
+		unsigned char *reached = malloc(targetCount + 1);
+		unsigned long int count = 0;
+		for (unsigned short int s = 0; s <= previous->neuronCount; ++s) {
+			memset(reached, 0, targetCount + 1);
+			if (s == previous->neuronCount) memcpy(reached, folded->connected + (unsigned long int) middleCount * targetCount, targetCount);
+			for (unsigned short int m = 0; m < middleCount; ++m) {
+				if (!previous->connected[(unsigned long int) s * middleCount + m]) continue;
+				const unsigned char *connected = folded->connected + (unsigned long int) m * targetCount;
+				for (unsigned short int t = 0; t < targetCount; ++t) reached[t] |= connected[t];
+			}
+			for (unsigned short int t = 0; t < targetCount; ++t) count += reached[t];
+		}
+		free(reached);
+		return count;
+	}
+
+	/** Folds every hidden NeuronActivator_LINEAR layer into the synapses of the previous one, as long as that does not add synapses.
+	 * Returns the number of removed layers. */
+	unsigned short int NetworkDraft_foldLinearLayers(NetworkDraft* this) {
+		unsigned short int removed = 0;
+		for (unsigned short int i = 1; i + 1 < this->layerCount;) {
+			if (this->layers[i].activator.type != NeuronActivator_LINEAR) {
+				++i;
+				continue;
+			}
+
+			unsigned long int before = 0;
+			for (unsigned short int k = i - 1; k <= i; ++k) {
+				unsigned long int size = (unsigned long int) (this->layers[k].neuronCount + 1) * this->layers[k + 1].neuronCount;
+				for (unsigned long int p = 0; p < size; ++p) before += this->layers[k].connected[p];
+			}
+			if (NetworkDraft_foldedSynapseCount(this, i) > before) {
+				++i;
+				continue;
+			}
+
+			NetworkDraft_foldLayer(this, i);
+			removed++;
+		}
+		return removed;
+	}
+
+
+
+//OPTIMIZATION
+	/** Runs both networks on the same probe inputs. original gets them standardized, optimized gets them raw.
+	 * Returns the largest difference of their outputs, relative to 1+|output|. */
+	static NeuronUnit NetworkOptimizer_verify(NeuralNetwork* original, NeuralNetwork* optimized, const NeuronUnit* means, const NeuronUnit* deviations) {
+		NetworkLayer *originalInput = original->layers, *optimizedInput = optimized->layers;
+		NetworkLayer *originalOutput = original->layers + original->layerCount - 1;
+		NetworkLayer *optimizedOutput = optimized->layers + optimized->layerCount - 1;
+
+		unsigned long int state = 88172645463325252UL; //xorshift, so that the callers' rand() sequence stays the same
+		NeuronUnit worst = 0;
+		for (unsigned int p = 0; p < NetworkOptimizer_PROBES; ++p) {
+			for (unsigned short int i = 0; i < originalInput->neuronCount; ++i) {
+				state ^= state << 13;
+				state ^= state >> 7;
+				state ^= state << 17;
+				NeuronUnit standardized = (NeuronUnit) (state >> 11) / (1UL << 53) * 6 - 3;
+				originalInput->neurons[i].out = standardized;
+				optimizedInput->neurons[i].out = means == NULL? standardized : means[i] + standardized * deviations[i];
+			}
+			NeuralNetwork_predict(original);
+			NeuralNetwork_predict(optimized);
+
+			for (unsigned short int i = 0; i < originalOutput->neuronCount; ++i) {
+				NeuronUnit expected = originalOutput->neurons[i].out;
+				NeuronUnit difference = fabs(optimizedOutput->neurons[i].out - expected) / (1 + fabs(expected));
+				if (!isnan(worst) && !(difference <= worst)) worst = difference; //a NaN stays
+			}
+		}
+		return worst;
+	}
+
+	/** Initializes result with an equivalent network that predicts faster: input standardization (if means is not NULL) folded into the
+	 * first layer, and hidden linear layers folded into the previous one. Then checks, on probe inputs, that both networks predict the same.
+	 * this is only read, but its neuron values change. Returns 0, leaving result uninitialized, if the normalization cannot be folded
+	 * or the check fails. report may be NULL. */
+	char NeuralNetwork_optimize(NeuralNetwork* this, NeuralNetwork* result, const NeuronUnit* means, const NeuronUnit* deviations, NetworkOptimizerReport* report) {
+		NetworkDraft draft;
+		NetworkDraft_init(&draft, this);
+		char ok = means == NULL || NetworkDraft_foldNormalization(&draft, means, deviations);
+		if (ok) {
+			NetworkDraft_foldLinearLayers(&draft);
+			NetworkDraft_build(&draft, result);
+		}
+		NetworkDraft_deinit(&draft);
+		if (!ok) return 0;
+
+		NeuronUnit difference = NetworkOptimizer_verify(this, result, means, deviations);
+		if (report != NULL) {
+			report->layersBefore = this->layerCount;
+			report->layersAfter = result->layerCount;
+			report->synapsesBefore = this->synapseCount;
+			report->synapsesAfter = result->synapseCount;
+			report->maxDifference = difference;
+		}
+
+		ok = difference <= NetworkOptimizer_TOLERANCE;
+		if (!ok) NeuralNetwork_deinit(result);
+		return ok;
+	}
+
+
+
+//FILES
+	/** Reads a normalization file: the means of the inputs in the first line, their standard deviations in the second one, comma separated.
+	 * Returns 0 if the file is missing, or a line does not have exactly inputCount numbers. */
+	char NetworkOptimizer_readNormalization(const char* path, unsigned short int inputCount, NeuronUnit* means, NeuronUnit* deviations) {
+		FILE *file = fopen(path, "r");
+		if (file == NULL) return 0;
+
+		char *line = NULL;
+		size_t capacity = 0;
+		char ok = 1;
+		NeuronUnit *targets[] = {means, deviations};
+		for (int row = 0; ok && row < 2; ++row) {
+			ok = getline(&line, &capacity, file) > 0;
+			char *position = line;
+			for (unsigned short int i = 0; ok && i < inputCount; ++i) {
+				char *check;
+				targets[row][i] = strtod(position, &check);
+				ok = check != position && (i + 1 == inputCount || *check == ',');
+				position = check + (i + 1 < inputCount);
+			}
+			while (ok && (*position == ' ' || *position == '\t' || *position == '\r')) position++;
+			ok = ok && (*position == '\n' || *position == '\0');
+		}
+
+		free(line);
+		fclose(file);
+		return ok;
+	}
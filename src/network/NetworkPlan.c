@@ -0,0 +1,211 @@
+#include "Network.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Both kernels add the inputs of every output in the order of NeuralNetwork_predict
+ * (source neurons from the last to the first, then the bias), so that a plan predicts the same values, to the last bit.
+ * Dense ops do it column by column, which the compiler vectorizes over the outputs. */
+
+#define NetworkPlan_DENSE_DENSITY 0.5 //layers with at least this share of all possible synapses run dense
+
+//UTILS
+	/** Whether the terms of a layer fit a dense op: dense enough, and no two synapses from one source to one target. */
+	static char NetworkPlan_fitsDense(NetworkLayerTerm* terms, unsigned int* first, unsigned short int inputCount, unsigned short int outputCount) {
+		if (first[outputCount] < NetworkPlan_DENSE_DENSITY * (inputCount + 1) * outputCount) return 0;
+
+		unsigned int *seenBy = calloc(inputCount + 1, sizeof(unsigned int));
+		char fits = 1;
+		for (unsigned short int t = 0; fits && t < outputCount; ++t) {
+			for (unsigned int k = first[t]; k < first[t + 1]; ++k) {
+				if (seenBy[terms[k].source] == t + 1u) fits = 0;
+				seenBy[terms[k].source] = t + 1;
+			}
+		}
+		free(seenBy);
+		return fits;
+	}
+
+
+
+//LIFECYCLE
+	/** Lowers net into one op per layer, choosing a dense or a sparse kernel for each, with every buffer resolved in advance.
+	 * The plan copies the weights: call NetworkPlan_refresh after training net. It may outlive net.
+	 * A plan has a single value buffer, so only one thread at a time may run it. */
+	void NetworkPlan_init(NetworkPlan* this, NeuralNetwork* net) {
+		this->inputCount = net->layers[0].neuronCount;
+		this->outputCount = net->layers[net->layerCount - 1].neuronCount;
+		this->opCount = net->layerCount - 1;
+		this->ops = calloc(this->opCount + 1, sizeof(NetworkPlanOp));
+
+		//the values of every layer, each followed by the 1 of its bias
+		unsigned long int valueCount = 0;
+		for (unsigned short int i = 0; i < net->layerCount; ++i) valueCount += net->layers[i].neuronCount + 1;
+		this->values = malloc(valueCount * sizeof(NeuronUnit));
+		NeuronUnit *values = this->values;
+		for (unsigned short int i = 0; i < net->layerCount; ++i) {
+			if (i > 0) this->ops[i - 1].output = values;
+			if (i < this->opCount) this->ops[i].input = values;
+			values += net->layers[i].neuronCount;
+			*values++ = 1;
+		}
+		this->output = this->opCount? this->ops[this->opCount - 1].output : this->values;
+
+		//choose the kernels, and size the shared arrays
+		NetworkLayerTerm **terms = malloc((this->opCount + 1) * sizeof(NetworkLayerTerm*));
+		unsigned int **firsts = malloc((this->opCount + 1) * sizeof(unsigned int*));
+		unsigned long int rowCount = 0, columnCount = 0;
+		this->weightCount = 0;
+		for (unsigned short int i = 0; i < this->opCount; ++i) {
+			NetworkPlanOp *op = this->ops + i;
+			NetworkLayer *target = net->layers + i + 1;
+			op->inputCount = net->layers[i].neuronCount;
+			op->outputCount = target->neuronCount;
+			op->activatorType = target->activator.type;
+			op->activate = target->activator.inToOut;
+
+			firsts[i] = malloc((op->outputCount + 1) * sizeof(unsigned int));
+			terms[i] = NeuralNetwork_incoming(net, i, firsts[i]);
+			op->kind = NetworkPlan_fitsDense(terms[i], firsts[i], op->inputCount, op->outputCount)? NetworkPlan_DENSE : NetworkPlan_SPARSE;
+
+			unsigned int termCount = firsts[i][op->outputCount];
+			if (op->kind == NetworkPlan_DENSE) this->weightCount += (unsigned long int) (op->inputCount + 1) * op->outputCount;
+			else {
+				this->weightCount += termCount;
+				rowCount += op->outputCount + 1;
+				columnCount += termCount;
+			}
+		}
+
+		this->weights = malloc((this->weightCount + 1) * sizeof(NeuronUnit));
+		this->synapses = malloc((this->weightCount + 1) * sizeof(unsigned long int));
+		this->rowStarts = malloc((rowCount + 1) * sizeof(unsigned int));
+		this->columns = malloc((columnCount + 1) * sizeof(unsigned short int));
+
+		//lay out the weights of every op
+		unsigned long int nextWeight = 0, nextRow = 0, nextColumn = 0;
+		for (unsigned short int i = 0; i < this->opCount; ++i) {
+			NetworkPlanOp *op = this->ops + i;
+			unsigned int *first = firsts[i];
+			op->weights = this->weights + nextWeight;
+			op->synapses = this->synapses + nextWeight;
+
+			if (op->kind == NetworkPlan_DENSE) {
+				unsigned long int size = (unsigned long int) (op->inputCount + 1) * op->outputCount;
+				for (unsigned long int k = 0; k < size; ++k) op->synapses[k] = NetworkPlan_NO_SYNAPSE;
+				for (unsigned short int t = 0; t < op->outputCount; ++t) {
+					for (unsigned int k = first[t]; k < first[t + 1]; ++k) op->synapses[(unsigned long int) terms[i][k].source * op->outputCount + t] = terms[i][k].synapse;
+				}
+				nextWeight += size;
+			}
+			else {
+				op->rowStarts = this->rowStarts + nextRow;
+				op->columns = this->columns + nextColumn;
+				for (unsigned short int t = 0; t <= op->outputCount; ++t) op->rowStarts[t] = first[t];
+				for (unsigned int k = 0; k < first[op->outputCount]; ++k) {
+					op->columns[k] = terms[i][k].source;
+					op->synapses[k] = terms[i][k].synapse;
+				}
+				nextWeight += first[op->outputCount];
+				nextRow += op->outputCount + 1;
+				nextColumn += first[op->outputCount];
+			}
+
+			free(terms[i]);
+			free(firsts[i]);
+		}
+		free(terms);
+		free(firsts);
+
+		NetworkPlan_refresh(this, net);
+	}
+
+	void NetworkPlan_deinit(NetworkPlan* this) {
+		free(this->ops);
+		free(this->values);
+		free(this->weights);
+		free(this->synapses);
+		free(this->rowStarts);
+		free(this->columns);
+	}
+
+	/** Copies the weights of net into the plan again. net must have the topology that the plan was made from. */
+	void NetworkPlan_refresh(NetworkPlan* this, NeuralNetwork* net) {
+		for (unsigned long int k = 0; k < this->weightCount; ++k) {
+			unsigned long int synapse = this->synapses[k];
+			this->weights[k] = synapse == NetworkPlan_NO_SYNAPSE? 0 : net->synapses[synapse].weight;
+		}
+	}
+
+
+
+//KERNELS
+	static void NetworkPlan_dense(NetworkPlanOp* op) {
+		unsigned short int inputCount = op->inputCount, outputCount = op->outputCount;
+		const NeuronUnit *restrict input = op->input;
+		NeuronUnit *restrict output = op->output;
+		for (unsigned short int t = 0; t < outputCount; ++t) output[t] = 0;
+
+		//the inputs from the last to the first, then the bias
+		for (unsigned int s = inputCount + 1; s--;) {
+			unsigned short int source = s == 0? inputCount : s - 1;
+			const NeuronUnit *restrict column = op->weights + (unsigned long int) source * outputCount;
+			NeuronUnit value = input[source];
+			for (unsigned short int t = 0; t < outputCount; ++t) output[t] += column[t] * value;
+		}
+	}
+
+	static void NetworkPlan_sparse(NetworkPlanOp* op) {
+		const NeuronUnit *restrict input = op->input;
+		const NeuronUnit *restrict weights = op->weights;
+		const unsigned short int *restrict columns = op->columns;
+		const unsigned int *rowStarts = op->rowStarts;
+		for (unsigned short int t = 0; t < op->outputCount; ++t) {
+			NeuronUnit sum = 0;
+			for (unsigned int k = rowStarts[t], end = rowStarts[t + 1]; k < end; ++k) sum += weights[k] * input[columns[k]];
+			op->output[t] = sum;
+		}
+	}
+
+	/** Same formulas as NeuronActivator, without a call per value. */
+	static void NetworkPlan_activate(NetworkPlanOp* op) {
+		NeuronUnit *values = op->output;
+		unsigned short int count = op->outputCount;
+		switch (op->activatorType) {
+			case NeuronActivator_LINEAR:
+				break;
+
+			case NeuronActivator_RELU:
+				for (unsigned short int t = 0; t < count; ++t) values[t] = values[t] > 0? values[t] : 0;
+				break;
+
+			case NeuronActivator_LEAKY_RELU:
+				for (unsigned short int t = 0; t < count; ++t) values[t] = values[t] > 0? values[t] : 0.001 * values[t];
+				break;
+
+			case NeuronActivator_SIGMOID:
+				for (unsigned short int t = 0; t < count; ++t) values[t] = 1 / (1 + exp(-values[t]));
+				break;
+
+			case NeuronActivator_TANH:
+				for (unsigned short int t = 0; t < count; ++t) values[t] = tanh(values[t]);
+				break;
+
+			default:
+				for (unsigned short int t = 0; t < count; ++t) values[t] = op->activate(values[t]);
+		}
+	}
+
+
+
+//RUNNING
+	/** Predicts the outputs of one sample: inputCount values in, outputCount values out. */
+	void NetworkPlan_run(NetworkPlan* this, const NeuronUnit* input, NeuronUnit* output) {
+		memcpy(this->values, input, this->inputCount * sizeof(NeuronUnit));
+		for (NetworkPlanOp *op = this->ops, *end = op + this->opCount; op < end; ++op) {
+			if (op->kind == NetworkPlan_DENSE) NetworkPlan_dense(op);
+			else NetworkPlan_sparse(op);
+			NetworkPlan_activate(op);
+		}
+		memcpy(output, this->output, this->outputCount * sizeof(NeuronUnit));
+	}
@@ -0,0 +1,283 @@
+#include "Network.h"
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define NetworkPruner_TIMING_NS 20000000 //time spent measuring each latency
+
+/* Pruning removes synapses between neurons. The biases are always kept: they are few, and cheap to run. */
+
+//UTILS
+	typedef struct {
+		NeuronUnit magnitude;
+		unsigned long int position;
+	} NetworkPrunerCandidate;
+
+	static int NetworkPruner_compareCandidates(const void* a, const void* b) {
+		NeuronUnit x = ((const NetworkPrunerCandidate*) a)->magnitude, y = ((const NetworkPrunerCandidate*) b)->magnitude;
+		return x > y? -1 : x < y? 1 : 0;
+	}
+
+	static unsigned long int NetworkPruner_now() {
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+	}
+
+	/** Average nanoseconds per prediction of net, with NeuralNetwork_predict or with a plan of it. */
+	static NeuronUnit NetworkPruner_latency(NeuralNetwork* net, char planned) {
+		NetworkPlan plan;
+		if (planned) NetworkPlan_init(&plan, net);
+		unsigned short int inputCount = net->layers[0].neuronCount;
+		NeuronUnit *input = malloc(inputCount * sizeof(NeuronUnit));
+		NeuronUnit *output = malloc(net->layers[net->layerCount - 1].neuronCount * sizeof(NeuronUnit));
+		for (unsigned short int i = 0; i < inputCount; ++i) input[i] = net->layers[0].neurons[i].out = (i % 7) * 0.25 - 0.75;
+
+		unsigned long int calls = 0, start = NetworkPruner_now(), elapsed;
+		do {
+			for (unsigned int k = 0; k < 64; ++k) {
+				if (planned) NetworkPlan_run(&plan, input, output);
+				else NeuralNetwork_predict(net);
+			}
+			calls += 64;
+			elapsed = NetworkPruner_now() - start;
+		} while (elapsed < NetworkPruner_TIMING_NS);
+
+		free(input);
+		free(output);
+		if (planned) NetworkPlan_deinit(&plan);
+		return (NeuronUnit) elapsed / calls;
+	}
+
+
+
+//PRUNING
+	/** Removes the synapses (but the biases) whose weight is smaller than threshold in magnitude. Returns how many were removed. */
+	unsigned long int NetworkDraft_pruneBelow(NetworkDraft* this, NeuronUnit threshold) {
+		unsigned long int removed = 0;
+		for (unsigned short int i = 0; i + 1 < this->layerCount; ++i) {
+			NetworkDraftLayer *layer = this->layers + i;
+			unsigned long int size = (unsigned long int) layer->neuronCount * this->layers[i + 1].neuronCount; //the bias row is last
+			for (unsigned long int k = 0; k < size; ++k) {
+				if (!layer->connected[k] || fabs(layer->weights[k]) >= threshold) continue;
+				layer->connected[k] = 0;
+				layer->weights[k] = 0;
+				removed++;
+			}
+		}
+		return removed;
+	}
+
+	/** Keeps, in every layer, the keepPerLayer synapses (but the biases) with the largest weights in magnitude. Returns how many were removed. */
+	unsigned long int NetworkDraft_pruneTopK(NetworkDraft* this, unsigned long int keepPerLayer) {
+		unsigned long int removed = 0;
+		for (unsigned short int i = 0; i + 1 < this->layerCount; ++i) {
+			NetworkDraftLayer *layer = this->layers + i;
+			unsigned long int size = (unsigned long int) layer->neuronCount * this->layers[i + 1].neuronCount;
+			NetworkPrunerCandidate *candidates = malloc((size + 1) * sizeof(NetworkPrunerCandidate));
+			unsigned long int count = 0;
+			for (unsigned long int k = 0; k < size; ++k) {
+				if (!layer->connected[k]) continue;
+				candidates[count].magnitude = fabs(layer->weights[k]);
+				candidates[count++].position = k;
+			}
+
+			if (count > keepPerLayer) {
+				qsort(candidates, count, sizeof(NetworkPrunerCandidate), NetworkPruner_compareCandidates);
+				for (unsigned long int k = keepPerLayer; k < count; ++k) {
+					layer->connected[candidates[k].position] = 0;
+					layer->weights[candidates[k].position] = 0;
+				}
+				removed += count - keepPerLayer;
+			}
+			free(candidates);
+		}
+		return removed;
+	}
+
+	/** Initializes result with the synapses of this whose weight is at least threshold in magnitude, at most keepPerLayer per layer
+	 * (0 for no limit), and all the biases. Every layer of result is NetworkLayer_INDIVIDUAL, so its training keeps the sparsity.
+	 * If report is not NULL, it receives the savings. Measuring the latencies takes a fraction of a second, and changes the neuron values of this. */
+	void NeuralNetwork_prune(NeuralNetwork* this, NeuralNetwork* result, NeuronUnit threshold, unsigned long int keepPerLayer, NetworkPruneReport* report) {
+		NetworkDraft draft;
+		NetworkDraft_init(&draft, this);
+		if (threshold > 0) NetworkDraft_pruneBelow(&draft, threshold);
+		if (keepPerLayer > 0) NetworkDraft_pruneTopK(&draft, keepPerLayer);
+		NetworkDraft_build(&draft, result);
+		NetworkDraft_deinit(&draft);
+		if (report == NULL) return;
+
+		report->synapsesBefore = this->synapseCount;
+		report->synapsesAfter = result->synapseCount;
+		report->bytesBefore = NeuralNetwork_modelBytes(this);
+		report->bytesAfter = NeuralNetwork_modelBytes(result);
+		report->predictNsBefore = NetworkPruner_latency(this, 0);
+		report->predictNsAfter = NetworkPruner_latency(result, 0);
+		report->planNsBefore = NetworkPruner_latency(this, 1);
+		report->planNsAfter = NetworkPruner_latency(result, 1);
+	}
+
+	void NetworkPruneReport_print(NetworkPruneReport* this, FILE* out) {
+		fprintf(out, "%-12s %14s %14s %8s\n", "", "before", "after", "saved");
+		fprintf(out, "%-12s %14lu %14lu %7.1f%%\n", "synapses", this->synapsesBefore, this->synapsesAfter,
+			100 - 100.0 * this->synapsesAfter / this->synapsesBefore);
+		fprintf(out, "%-12s %14lu %14lu %7.1f%%\n", "bytes", this->bytesBefore, this->bytesAfter, 100 - 100.0 * this->bytesAfter / this->bytesBefore);
+		fprintf(out, "%-12s %14.1f %14.1f %7.1f%%\n", "predict ns", this->predictNsBefore, this->predictNsAfter,
+			100 - 100 * this->predictNsAfter / this->predictNsBefore);
+		fprintf(out, "%-12s %14.1f %14.1f %7.1f%%\n", "plan ns", this->planNsBefore, this->planNsAfter, 100 - 100 * this->planNsAfter / this->planNsBefore);
+	}
+
+
+
+//NEURONS
+	#define NetworkPruner_KEPT 0
+	#define NetworkPruner_DEAD 1
+	#define NetworkPruner_CONSTANT 2
+	#define NetworkPruner_DUPLICATE 3
+
+	/** Whether two neurons gave the same outputs, within tolerance, on every sample. */
+	static char NetworkPruner_sameOutputs(const NeuronUnit* a, const NeuronUnit* b, unsigned int sampleCount, NeuronUnit tolerance) {
+		for (unsigned int s = 0; s < sampleCount; ++s) {
+			if (!(fabs(a[s] - b[s]) <= tolerance)) return 0;
+		}
+		return 1;
+	}
+
+	/** Initializes result with this, without the hidden neurons that do not change its outputs on the calibration samples:
+	 * - dead: ReLU neurons that never activated, leaky ReLU ones that never activated and whose output (leak times input) varies
+	 *   by at most tolerance, and neurons without outgoing synapses
+	 * - constant: neurons whose output varies by at most tolerance
+	 * - duplicates: neurons whose outputs are within tolerance of those of a kept neuron of their layer.
+	 * The average output of dead and constant neurons goes into the biases of their targets (exact for ReLU: 0), and the outgoing
+	 * synapses of duplicates are added to those of the neuron they repeat. The layers get narrower, not sparser: dense layers stay dense.
+	 * inputs holds sampleCount samples, stride NeuronUnits apart (the rows of a TrainDataSet work). Every layer keeps at least one neuron.
+	 * this is only read, but its neuron values change. report may be NULL. */
+	void NeuralNetwork_pruneNeurons(NeuralNetwork* this, NeuralNetwork* result, const NeuronUnit* inputs, unsigned int sampleCount, unsigned long int stride,
+		NeuronUnit tolerance, NetworkNeuronPruneReport* report) {
+		unsigned short int layerCount = this->layerCount, inputCount = this->layers[0].neuronCount;
+
+		//the outputs of every hidden neuron on every sample (neuron by neuron), and whether it ever activated
+		NeuronUnit **outputs = calloc(layerCount, sizeof(NeuronUnit*));
+		unsigned char **activated = calloc(layerCount, sizeof(unsigned char*));
+		for (unsigned short int i = 1; i + 1 < layerCount; ++i) {
+			outputs[i] = malloc(((unsigned long int) this->layers[i].neuronCount * sampleCount + 1) * sizeof(NeuronUnit));
+			activated[i] = calloc(this->layers[i].neuronCount, sizeof(unsigned char));
+		}
+		for (unsigned int s = 0; s < sampleCount; ++s) {
+			for (unsigned short int j = 0; j < inputCount; ++j) this->layers[0].neurons[j].out = inputs[s * stride + j];
+			NeuralNetwork_predict(this);
+			for (unsigned short int i = 1; i + 1 < layerCount; ++i) {
+				NetworkLayer *layer = this->layers + i;
+				for (unsigned short int j = 0; j < layer->neuronCount; ++j) {
+					outputs[i][(unsigned long int) j * sampleCount + s] = layer->neurons[j].out;
+					if (layer->neurons[j].in > 0) activated[i][j] = 1;
+				}
+			}
+		}
+
+		NetworkDraft draft;
+		NetworkDraft_init(&draft, this);
+		unsigned short int counts[NetworkPruner_DUPLICATE + 1] = {0}, hiddenBefore = 0;
+		for (unsigned short int i = 1; i + 1 < layerCount; ++i) {
+			NetworkDraftLayer *layer = draft.layers + i;
+			unsigned short int neuronCount = layer->neuronCount, targetCount = draft.layers[i + 1].neuronCount;
+			unsigned char *kinds = calloc(neuronCount, sizeof(unsigned char));
+			unsigned short int *repeated = malloc(neuronCount * sizeof(unsigned short int));
+			unsigned char activatorType = layer->activator.type;
+			char rectified = activatorType == NeuronActivator_RELU || activatorType == NeuronActivator_LEAKY_RELU;
+			unsigned short int kept = 0;
+			hiddenBefore += neuronCount;
+
+			for (unsigned short int j = 0; j < neuronCount; ++j) {
+				const NeuronUnit *values = outputs[i] + (unsigned long int) j * sampleCount;
+				NeuronUnit low = INFINITY, high = -INFINITY;
+				for (unsigned int s = 0; s < sampleCount; ++s) {
+					if (values[s] < low) low = values[s];
+					if (values[s] > high) high = values[s];
+				}
+				char connected = 0;
+				for (unsigned short int t = 0; t < targetCount; ++t) connected |= layer->connected[(unsigned long int) j * targetCount + t];
+
+				char flat = sampleCount > 0 && high - low <= tolerance;
+				char silent = rectified && sampleCount > 0 && !activated[i][j] && (activatorType == NeuronActivator_RELU || flat); //a leak still varies
+				if (!connected || silent) kinds[j] = NetworkPruner_DEAD;
+				else if (flat) kinds[j] = NetworkPruner_CONSTANT;
+				else for (unsigned short int k = 0; sampleCount > 0 && k < j; ++k) {
+					if (kinds[k] != NetworkPruner_KEPT || !NetworkPruner_sameOutputs(values, outputs[i] + (unsigned long int) k * sampleCount, sampleCount, tolerance)) continue;
+					kinds[j] = NetworkPruner_DUPLICATE;
+					repeated[j] = k;
+					break;
+				}
+				kept += kinds[j] == NetworkPruner_KEPT;
+			}
+			if (kept == 0) kinds[0] = NetworkPruner_KEPT; //nothing can be a duplicate then
+
+			//hand the work of the removed neurons over to the biases, or to the neurons they repeat
+			NeuronUnit *bias = layer->weights + (unsigned long int) neuronCount * targetCount;
+			unsigned char *biasConnected = layer->connected + (unsigned long int) neuronCount * targetCount;
+			for (unsigned short int j = 0; j < neuronCount; ++j) {
+				if (kinds[j] == NetworkPruner_KEPT) continue;
+				counts[kinds[j]]++;
+				const NeuronUnit *weights = layer->weights + (unsigned long int) j * targetCount;
+				const unsigned char *connected = layer->connected + (unsigned long int) j * targetCount;
+
+				NeuronUnit average = 0;
+				if (kinds[j] != NetworkPruner_DUPLICATE) {
+					for (unsigned int s = 0; s < sampleCount; ++s) average += outputs[i][(unsigned long int) j * sampleCount + s];
+					if (sampleCount > 0) average /= sampleCount;
+				}
+				NeuronUnit *into = kinds[j] == NetworkPruner_DUPLICATE? layer->weights + (unsigned long int) repeated[j] * targetCount : bias;
+				unsigned char *intoConnected = kinds[j] == NetworkPruner_DUPLICATE? layer->connected + (unsigned long int) repeated[j] * targetCount : biasConnected;
+				NeuronUnit scale = kinds[j] == NetworkPruner_DUPLICATE? 1 : average;
+				for (unsigned short int t = 0; t < targetCount; ++t) {
+					if (!connected[t] || scale == 0) continue;
+					into[t] += scale * weights[t];
+					intoConnected[t] = 1;
+				}
+			}
+
+			NetworkDraft_removeNeurons(&draft, i, kinds);
+			free(kinds);
+			free(repeated);
+		}
+		NetworkDraft_build(&draft, result);
+		NetworkDraft_deinit(&draft);
+
+		if (report != NULL) {
+			NetworkLayer *output = this->layers + layerCount - 1, *resultOutput = result->layers + layerCount - 1;
+			NeuronUnit worst = 0;
+			for (unsigned int s = 0; s < sampleCount; ++s) {
+				for (unsigned short int j = 0; j < inputCount; ++j) this->layers[0].neurons[j].out = result->layers[0].neurons[j].out = inputs[s * stride + j];
+				NeuralNetwork_predict(this);
+				NeuralNetwork_predict(result);
+				for (unsigned short int j = 0; j < output->neuronCount; ++j) {
+					NeuronUnit difference = fabs(output->neurons[j].out - resultOutput->neurons[j].out);
+					if (!isnan(worst) && !(difference <= worst)) worst = difference;
+				}
+			}
+
+			report->hiddenBefore = hiddenBefore;
+			report->hiddenAfter = 0;
+			for (unsigned short int i = 1; i + 1 < layerCount; ++i) report->hiddenAfter += result->layers[i].neuronCount;
+			report->dead = counts[NetworkPruner_DEAD];
+			report->constant = counts[NetworkPruner_CONSTANT];
+			report->duplicates = counts[NetworkPruner_DUPLICATE];
+			report->synapsesBefore = this->synapseCount;
+			report->synapsesAfter = result->synapseCount;
+			report->maxDifference = worst;
+		}
+
+		for (unsigned short int i = 0; i < layerCount; ++i) {
+			free(outputs[i]);
+			free(activated[i]);
+		}
+		free(outputs);
+		free(activated);
+	}
+
+	void NetworkNeuronPruneReport_print(NetworkNeuronPruneReport* this, FILE* out) {
+		fprintf(out, "Hidden neurons: %u -> %u (%u dead, %u constant, %u duplicates)\n",
+			this->hiddenBefore, this->hiddenAfter, this->dead, this->constant, this->duplicates);
+		fprintf(out, "Synapses: %lu -> %lu\n", this->synapsesBefore, this->synapsesAfter);
+		fprintf(out, "Largest output difference on the calibration samples: %g\n", this->maxDifference);
+	}
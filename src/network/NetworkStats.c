@@ -0,0 +1,184 @@
+#include "Network.h"
+#include <string.h>
+#include <time.h>
+
+#ifdef NETWORK_PERF_COUNTERS
+	#include <errno.h>
+	#include <unistd.h>
+	#include <sys/ioctl.h>
+	#include <sys/syscall.h>
+	#include <linux/perf_event.h>
+#endif
+
+static const char* phaseNames[NetworkStats_PHASE_COUNT] = { "predict", "saveGradient", "addToGradient", "adjustWeights" };
+static const double flopsPerSynapse[NetworkStats_PHASE_COUNT] = { 2, 4, 4, 2 };
+
+
+//HARDWARE COUNTERS
+#ifdef NETWORK_PERF_COUNTERS
+	/** One counter group per thread. groupFd is -2 before the first attempt and -1 if the counters could not be opened. */
+	static __thread int groupFd = -2;
+	static __thread int groupSlot[NetworkStats_COUNTER_COUNT]; //position of each counter in the group read, or -1
+	static __thread int groupSize = 0;
+	static int openError = 0;
+
+	static const unsigned int counterTypes[NetworkStats_COUNTER_COUNT] = {
+		PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE
+	};
+	static const unsigned long int counterConfigs[NetworkStats_COUNTER_COUNT] = {
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+		PERF_COUNT_HW_CACHE_MISSES,
+		PERF_COUNT_HW_BRANCH_MISSES
+	};
+
+	static int openCounter(unsigned char counter, int leader) {
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = counterTypes[counter];
+		attr.config = counterConfigs[counter];
+		attr.disabled = leader == -1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP;
+		return syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+	}
+
+	/** Opens the counter group of the calling thread. Cycles lead the group, any other counter that the cpu (or the container) refuses is just skipped. */
+	static void openGroup() {
+		groupSize = 0;
+		for (unsigned char i = 0; i < NetworkStats_COUNTER_COUNT; ++i) groupSlot[i] = -1;
+
+		groupFd = openCounter(NetworkStats_CYCLES, -1);
+		if (groupFd < 0) {
+			openError = errno;
+			groupFd = -1;
+			return;
+		}
+		groupSlot[NetworkStats_CYCLES] = groupSize++;
+
+		for (unsigned char i = 1; i < NetworkStats_COUNTER_COUNT; ++i) {
+			if (openCounter(i, groupFd) >= 0) groupSlot[i] = groupSize++;
+		}
+
+		ioctl(groupFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(groupFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	}
+
+	static void readCounters(unsigned long int* counters) {
+		if (groupFd == -2) openGroup();
+
+		unsigned long int values[NetworkStats_COUNTER_COUNT + 1]; //nr, then one value per opened counter
+		if (groupFd < 0 || read(groupFd, values, sizeof(values)) <= 0) {
+			memset(counters, 0, NetworkStats_COUNTER_COUNT * sizeof(unsigned long int));
+			return;
+		}
+
+		for (unsigned char i = 0; i < NetworkStats_COUNTER_COUNT; ++i) {
+			counters[i] = groupSlot[i] < 0? 0 : values[1 + groupSlot[i]];
+		}
+	}
+#endif
+
+	/** Returns 1 if the hardware counters could be opened for the calling thread. */
+	char NetworkStats_countersAvailable() {
+		#ifdef NETWORK_PERF_COUNTERS
+			if (groupFd == -2) openGroup();
+			return groupFd >= 0;
+		#else
+			return 0;
+		#endif
+	}
+
+
+
+//RECORDING
+	void NetworkStats_sample(NetworkStatsSample* sample) {
+		#ifdef NETWORK_PERF_COUNTERS
+			readCounters(sample->counters);
+		#endif
+
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		sample->nanoseconds = ts.tv_sec * 1000000000UL + ts.tv_nsec;
+	}
+
+	void NetworkStats_record(NetworkLayer* layer, unsigned char phase, NetworkStatsSample* start, unsigned long int synapseCount) {
+		#ifdef NETWORK_STATS
+			NetworkStatsSample end;
+			NetworkStats_sample(&end);
+
+			NetworkLayerStats *stats = layer->stats + phase;
+			stats->nanoseconds += end.nanoseconds - start->nanoseconds;
+			stats->calls++;
+			stats->synapses += synapseCount;
+
+			#ifdef NETWORK_PERF_COUNTERS
+				for (unsigned char i = 0; i < NetworkStats_COUNTER_COUNT; ++i) stats->counters[i] += end.counters[i] - start->counters[i];
+			#endif
+		#endif
+	}
+
+
+
+//API
+	void NeuralNetwork_resetStats(NeuralNetwork* this) {
+		#ifdef NETWORK_STATS
+			for (unsigned short int i = this->layerCount; i--;) memset(this->layers[i].stats, 0, sizeof(this->layers[i].stats));
+		#endif
+	}
+
+	/** Copies the counters of one layer and phase into stats. Returns 0 if the library was built without NETWORK_STATS. */
+	char NeuralNetwork_getLayerStats(NeuralNetwork* this, unsigned short int layerIndex, unsigned char phase, NetworkLayerStats* stats) {
+		#ifdef NETWORK_STATS
+			*stats = this->layers[layerIndex].stats[phase];
+			return 1;
+		#else
+			memset(stats, 0, sizeof(NetworkLayerStats));
+			return 0;
+		#endif
+	}
+
+	static void printPerSynapse(FILE* out, NetworkLayerStats* stats, unsigned char counter) {
+		if (stats->counters[counter] == 0 || stats->synapses == 0) fprintf(out, " %10s", "-");
+		else fprintf(out, " %10.4f", (double) stats->counters[counter] / stats->synapses);
+	}
+
+	void NeuralNetwork_printStats(NeuralNetwork* this, FILE* out) {
+		NetworkLayerStats stats;
+		if (!NeuralNetwork_getLayerStats(this, 0, 0, &stats)) {
+			fprintf(out, "Stats are not available. Build with -DNETWORK_STATS to enable them.\n");
+			return;
+		}
+
+		char counters = NetworkStats_countersAvailable();
+		#ifdef NETWORK_PERF_COUNTERS
+			if (!counters) fprintf(out, "Hardware counters are not available (perf_event_open: %s). Check /proc/sys/kernel/perf_event_paranoid, or the seccomp profile of the container.\n", strerror(openError));
+		#endif
+
+		fprintf(out, "%-6s %-14s %12s %14s %12s %16s %10s", "layer", "phase", "calls", "total ms", "ns/call", "synapses", "GFLOP/s");
+		if (counters) fprintf(out, " %10s %10s %10s %10s", "IPC", "L1D/syn", "LLC/syn", "branch/syn");
+		fprintf(out, "\n");
+
+		for (unsigned short int i = 0; i < this->layerCount; ++i) {
+			for (unsigned char phase = 0; phase < NetworkStats_PHASE_COUNT; ++phase) {
+				NeuralNetwork_getLayerStats(this, i, phase, &stats);
+				if (stats.calls == 0) continue;
+
+				double gflops = stats.nanoseconds == 0? 0 : flopsPerSynapse[phase] * stats.synapses / stats.nanoseconds;
+				fprintf(out, "%-6u %-14s %12lu %14.3f %12.1f %16lu %10.3f",
+					i, phaseNames[phase], stats.calls, stats.nanoseconds / 1e6, (double) stats.nanoseconds / stats.calls, stats.synapses, gflops);
+
+				if (counters) {
+					if (stats.counters[NetworkStats_CYCLES] == 0) fprintf(out, " %10s", "-");
+					else fprintf(out, " %10.3f", (double) stats.counters[NetworkStats_INSTRUCTIONS] / stats.counters[NetworkStats_CYCLES]);
+					printPerSynapse(out, &stats, NetworkStats_L1D_MISSES);
+					printPerSynapse(out, &stats, NetworkStats_LLC_MISSES);
+					printPerSynapse(out, &stats, NetworkStats_BRANCH_MISSES);
+				}
+				fprintf(out, "\n");
+			}
+		}
+	}
@@ -2,10 +2,31 @@
 #include <stdlib.h>
 #include <time.h>
 #include<math.h>
+#include <string.h>
 
 
 
 //LIFE CIRCLE
+	/** Moves the synapses of every neuron into one contiguous block, ordered like the weight buffers.
+	 * This lets flat buffers be applied to the weights in a single sequential pass. */
+	static void packSynapses(NeuralNetwork* this) {
+		NeuronSynapse *block = (NeuronSynapse*) malloc(this->synapseCount * sizeof(NeuronSynapse));
+		NeuronSynapse *next = block;
+
+		for (unsigned short int i = 0; i < this->layerCount; ++i) {
+			NetworkLayer *layer = this->layers + i;
+			for (unsigned short int j = 0; j <= layer->neuronCount; ++j) {
+				Neuron *neuron = (j == layer->neuronCount)? &layer->bias : layer->neurons + j;
+				memcpy(next, neuron->synapses, neuron->synapseCount * sizeof(NeuronSynapse));
+				free(neuron->synapses);
+				neuron->synapses = next;
+				next += neuron->synapseCount;
+			}
+		}
+
+		this->synapses = block;
+	}
+
 	void NeuralNetwork_init(NeuralNetwork* this, NeuralNetworkStructure* s) {
 		unsigned short int layerCount = 0;
 		while(s->layers[layerCount].connectionType != NetworkLayer_OUTPUT) layerCount++;
@@ -42,6 +63,7 @@
 		}
 		this->neuronCount = neuronCount;
 		this->synapseCount = synapseCount;
+		packSynapses(this);
 
 
 		//connect layers
@@ -51,15 +73,46 @@
 				if (i<=1) break;
 			}
 		}
+		NeuralNetwork_resetStats(this);
 	}
 
 	void NeuralNetwork_deinit(NeuralNetwork* this) {
-		for (unsigned short int i = this->layerCount; i--;) NetworkLayer_deinit(this->layers + i);
+		for (unsigned short int i = this->layerCount; i--;) {
+			NetworkLayer *layer = this->layers + i;
+			for (unsigned short int j = layer->neuronCount; j--;) layer->neurons[j].synapses = NULL; //owned by this->synapses
+			layer->bias.synapses = NULL;
+			NetworkLayer_deinit(layer);
+		}
+
+		free(this->synapses);
 		free(this->layers);
 	}
 
 
 
+	/** Initializes this as an independent copy of source: same topology, activators and weights. */
+	void NeuralNetwork_initCopy(NeuralNetwork* this, NeuralNetwork* source) {
+		NeuralNetworkStructure str;
+		NeuralNetworkStructure_init(&str, source);
+		NeuralNetwork_init(this, &str);
+		NeuralNetworkStructure_deinit(&str);
+
+		for (unsigned long int i = source->synapseCount; i--;) this->synapses[i].weight = source->synapses[i].weight;
+	}
+
+	/** Whether the weights of one network can be loaded into the other: same layers, same synapses. */
+	char NeuralNetwork_sameTopology(NeuralNetwork* this, NeuralNetwork* other) {
+		if (this->layerCount != other->layerCount || this->synapseCount != other->synapseCount) return 0;
+		for (unsigned short int i = 0; i < this->layerCount; ++i) {
+			if (this->layers[i].neuronCount != other->layers[i].neuronCount) return 0;
+		}
+		for (unsigned long int i = 0; i < this->synapseCount; ++i) {
+			if (this->synapses[i].targetIndex != other->synapses[i].targetIndex) return 0;
+		}
+		return 1;
+	}
+
+
 
 //STATE SETUP
 	void NeuralNetwork_randomSynapses(NeuralNetwork* this) {
@@ -97,7 +150,9 @@
 		for (unsigned short int i = this->layerCount-1; i--;) {
 			NetworkLayer *current = this->layers + i;
 			layerWeights -= current->synapseCount;
+			NetworkStats_BEGIN(start);
 			NetworkLayer_adjustWeights(current, layerWeights);
+			NetworkStats_END(current, NetworkStats_ADJUST_WEIGHTS, start, current->synapseCount);
 		}
 	}
 
@@ -110,10 +165,108 @@
 		for (unsigned short int i = 0, len = this->layerCount-1; i<len; ++i) {
 			NetworkLayer* current = this->layers + i;
 			NetworkLayer* next = current + 1;
+			NetworkStats_BEGIN(start);
 			NetworkLayer_reset(next);
 			NetworkLayer_fire(current);
 			NetworkLayer_activate(next);
+			NetworkStats_END(current, NetworkStats_PREDICT, start, current->synapseCount);
+		}
+	}
+
+	/** Size, in NeuronUnits, of the scratch buffer that NeuralNetwork_predictBatch needs for batchSize samples. */
+	unsigned long int NeuralNetwork_batchScratchSize(NeuralNetwork * this, unsigned int batchSize) {
+		unsigned short int widest = 0;
+		for (unsigned short int i = this->layerCount; i--;) {
+			if (this->layers[i].neuronCount > widest) widest = this->layers[i].neuronCount;
 		}
+		return 2UL * widest * batchSize;
+	}
+
+	/** Forward pass of batchSize samples at once. inputs and outputs hold one sample after the other.
+	 * The activations live in scratch (see NeuralNetwork_batchScratchSize), neuron by neuron, so that the inner loop runs over the batch.
+	 * The network itself is only read: several threads may predict with the same network at the same time. */
+	void NeuralNetwork_predictBatch(NeuralNetwork * this, const NeuronUnit* inputs, unsigned int batchSize, NeuronUnit* outputs, NeuronUnit* scratch) {
+		unsigned short int inputCount = this->layers[0].neuronCount;
+		NeuronUnit *current = scratch;
+		NeuronUnit *next = scratch + NeuralNetwork_batchScratchSize(this, batchSize) / 2;
+
+		for (unsigned int b = 0; b < batchSize; ++b) {
+			for (unsigned short int n = 0; n < inputCount; ++n) current[n * batchSize + b] = inputs[b * inputCount + n];
+		}
+
+		for (unsigned short int i = 0, len = this->layerCount-1; i<len; ++i) {
+			NetworkLayer* layer = this->layers + i;
+			NetworkLayer* nextLayer = layer + 1;
+			unsigned long int nextSize = (unsigned long int) nextLayer->neuronCount * batchSize;
+			for (unsigned long int k = 0; k < nextSize; ++k) next[k] = 0;
+
+			//fire every neuron
+			for (unsigned short int n = 0; n < layer->neuronCount; ++n) {
+				Neuron *neuron = layer->neurons + n;
+				const NeuronUnit *values = current + (unsigned long int) n * batchSize;
+				for (unsigned int s = 0; s < neuron->synapseCount; ++s) {
+					NeuronSynapse *synapse = neuron->synapses + s;
+					NeuronUnit *target = next + (unsigned long int) synapse->targetIndex * batchSize;
+					NeuronUnit weight = synapse->weight;
+					for (unsigned int b = 0; b < batchSize; ++b) target[b] += weight * values[b];
+				}
+			}
+
+			//and the bias, whose output is the same for every sample
+			for (unsigned int s = 0; s < layer->bias.synapseCount; ++s) {
+				NeuronSynapse *synapse = layer->bias.synapses + s;
+				NeuronUnit *target = next + (unsigned long int) synapse->targetIndex * batchSize;
+				NeuronUnit value = synapse->weight * layer->bias.out;
+				for (unsigned int b = 0; b < batchSize; ++b) target[b] += value;
+			}
+
+			NeuronUnit (*activationFunction)(NeuronUnit) = nextLayer->activator.inToOut;
+			for (unsigned long int k = 0; k < nextSize; ++k) next[k] = activationFunction(next[k]);
+
+			NeuronUnit *swap = current;
+			current = next;
+			next = swap;
+		}
+
+		unsigned short int outputCount = this->layers[this->layerCount - 1].neuronCount;
+		for (unsigned int b = 0; b < batchSize; ++b) {
+			for (unsigned short int n = 0; n < outputCount; ++n) outputs[b * outputCount + n] = current[n * batchSize + b];
+		}
+	}
+
+	/** Groups the synapses that leave layer layerIndex by their target in the next layer, each group in the order
+	 * NeuralNetwork_predict adds them: the neurons from the last to the first, each one's synapses from the last to the first, then the bias.
+	 * Returns the terms (malloc'ed), and fills first with the targetCount+1 offsets of the groups. */
+	NetworkLayerTerm* NeuralNetwork_incoming(NeuralNetwork* this, unsigned short int layerIndex, unsigned int* first) {
+		NetworkLayer *layer = this->layers + layerIndex;
+		unsigned short int targetCount = this->layers[layerIndex + 1].neuronCount;
+		memset(first, 0, (targetCount + 1) * sizeof(unsigned int));
+		for (unsigned short int j = 0; j <= layer->neuronCount; ++j) {
+			Neuron *neuron = j == layer->neuronCount? &layer->bias : layer->neurons + j;
+			for (unsigned int k = 0; k < neuron->synapseCount; ++k) first[neuron->synapses[k].targetIndex + 1]++;
+		}
+		for (unsigned short int t = 0; t < targetCount; ++t) first[t + 1] += first[t];
+
+		NetworkLayerTerm *terms = malloc((first[targetCount] + 1) * sizeof(NetworkLayerTerm));
+		unsigned int *next = malloc((targetCount + 1) * sizeof(unsigned int));
+		memcpy(next, first, (targetCount + 1) * sizeof(unsigned int));
+		for (int source = layer->neuronCount - 1; source >= -1; --source) {
+			Neuron *neuron = source < 0? &layer->bias : layer->neurons + source;
+			for (unsigned int k = neuron->synapseCount; k--;) {
+				NetworkLayerTerm *term = terms + next[neuron->synapses[k].targetIndex]++;
+				term->source = source < 0? layer->neuronCount : source;
+				term->synapse = neuron->synapses + k - this->synapses;
+			}
+		}
+		free(next);
+		return terms;
+	}
+
+	/** Memory of the synapses, the neurons and the layers. */
+	unsigned long int NeuralNetwork_modelBytes(NeuralNetwork* this) {
+		unsigned long int bytes = this->synapseCount * sizeof(NeuronSynapse) + this->layerCount * sizeof(NetworkLayer);
+		for (unsigned short int i = 0; i < this->layerCount; ++i) bytes += (this->layers[i].neuronCount + 1) * sizeof(Neuron);
+		return bytes;
 	}
 
 	void NeuralNetwork_saveGradient(NeuralNetwork *this, NeuronUnit *errorDerivatives, NeuronUnit* grad) {
@@ -121,20 +274,26 @@
 
 		//calculate deltas for last layer (no gradients)
 		unsigned short int currentLayerIndex = this->layerCount - 1;
+		NetworkStats_BEGIN(outputStart);
 		NetworkLayer_calculateDeltaFromErrorDerivatives(this->layers + currentLayerIndex, errorDerivatives);
+		NetworkStats_END(this->layers + currentLayerIndex, NetworkStats_SAVE_GRADIENT, outputStart, 0);
 
 		//calculate gradients and deltas for each other layer, exept the first.
 		NeuronUnit* layerGrad = grad + this->synapseCount;
 		while(currentLayerIndex-- > 1) {
 			NetworkLayer* currentLayer = this->layers + currentLayerIndex;
 			layerGrad -= currentLayer->synapseCount;
+			NetworkStats_BEGIN(start);
 			NetworkLayer_saveGradient(currentLayer, layerGrad); //NULL indicates that we dont care about delta calculation.
+			NetworkStats_END(currentLayer, NetworkStats_SAVE_GRADIENT, start, currentLayer->synapseCount);
 		}
 
 		//calculate gradients for the first layer, (NO deltas)
 		NetworkLayer* inputLayer = this->layers;
 		layerGrad -= inputLayer->synapseCount;
+		NetworkStats_BEGIN(inputStart);
 		NetworkLayer_saveGradient(inputLayer, layerGrad); //NULL indicates that we dont care about delta calculation.
+		NetworkStats_END(inputLayer, NetworkStats_SAVE_GRADIENT, inputStart, inputLayer->synapseCount);
 	}
 
 	void NeuralNetwork_addToGradient(NeuralNetwork *this, NeuronUnit *errorDerivatives, NeuronUnit* grad) {
@@ -142,18 +301,37 @@
 
 		//calculate deltas for last layer (no gradients)
 		unsigned short int currentLayerIndex = this->layerCount - 1;
+		NetworkStats_BEGIN(outputStart);
 		NetworkLayer_calculateDeltaFromErrorDerivatives(this->layers + currentLayerIndex, errorDerivatives);
+		NetworkStats_END(this->layers + currentLayerIndex, NetworkStats_ADD_TO_GRADIENT, outputStart, 0);
 
 		//calculate gradients and deltas for each other layer, exept the first.
 		NeuronUnit* layerGrad = grad + this->synapseCount;
 		while(currentLayerIndex-- > 1) {
 			NetworkLayer* currentLayer = this->layers + currentLayerIndex;
 			layerGrad -= currentLayer->synapseCount;
+			NetworkStats_BEGIN(start);
 			NetworkLayer_addToGradient(currentLayer, layerGrad); //NULL indicates that we dont care about delta calculation.
+			NetworkStats_END(currentLayer, NetworkStats_ADD_TO_GRADIENT, start, currentLayer->synapseCount);
 		}
 
 		//calculate gradients for the first layer, (NO deltas)
 		NetworkLayer* inputLayer = this->layers;
 		layerGrad -= inputLayer->synapseCount;
+		NetworkStats_BEGIN(inputStart);
 		NetworkLayer_addToGradient(inputLayer, layerGrad); //NULL indicates that we dont care about delta calculation.
+		NetworkStats_END(inputLayer, NetworkStats_ADD_TO_GRADIENT, inputStart, inputLayer->synapseCount);
+	}
+
+	/** Saves the derivatives of output neuron outputIndex with respect to every weight, for the last prediction.
+	 * This is the backward pass of NeuralNetwork_saveGradient, seeded with a unit error derivative on that output. */
+	void NeuralNetwork_saveJacobianRow(NeuralNetwork *this, unsigned short int outputIndex, NeuronUnit* row) {
+		if (this->layerCount <= 1) return;
+
+		unsigned short int outputCount = this->layers[this->layerCount - 1].neuronCount;
+		NeuronUnit seed[outputCount];
+		for (unsigned short int i = outputCount; i--;) seed[i] = 0;
+		seed[outputIndex] = 1;
+
+		NeuralNetwork_saveGradient(this, seed, row);
 	}
@@ -0,0 +1,58 @@
+#include "Network.h"
+#include <stdlib.h>
+
+
+//LIFE CIRCLE
+	/** Describes an existing network, so that NeuralNetwork_init can rebuild the same topology.
+	 * Every layer is described as NetworkLayer_INDIVIDUAL, which results in the same synapse order as the original. */
+	void NeuralNetworkStructure_init(NeuralNetworkStructure* this, NeuralNetwork* net) {
+		unsigned short int layerCount = net->layerCount;
+		this->layers = (NetworkLayerStructure*) malloc(layerCount * sizeof(NetworkLayerStructure));
+
+		for (unsigned short int i = 0; i < layerCount; ++i) {
+			NetworkLayer *layer = net->layers + i;
+			NetworkLayerStructure *str = this->layers + i;
+
+			str->activatorType = layer->activator.type; //the functions below are only used for NeuronActivator_CUSTOM
+			str->activationFunc = layer->activator.inToOut;
+			str->activationDerivative = layer->activator.inToDerivative;
+			str->neuronCount = layer->neuronCount;
+
+			if (i == layerCount - 1) {
+				str->connectionType = NetworkLayer_OUTPUT;
+				str->neurons = NULL;
+				str->bias = NULL;
+				continue;
+			}
+
+			str->connectionType = NetworkLayer_INDIVIDUAL;
+			str->neurons = (int**) malloc((layer->neuronCount + 1) * sizeof(int*));
+			str->neurons[layer->neuronCount] = NULL;
+
+			for (unsigned short int j = 0; j <= layer->neuronCount; ++j) {
+				Neuron *neuron = (j == layer->neuronCount)? &layer->bias : layer->neurons + j;
+				int *targets = (int*) malloc((neuron->synapseCount + 1) * sizeof(int));
+				for (unsigned int k = 0; k < neuron->synapseCount; ++k) targets[k] = neuron->synapses[k].targetIndex;
+				targets[neuron->synapseCount] = -1;
+
+				if (j == layer->neuronCount) str->bias = targets;
+				else str->neurons[j] = targets;
+			}
+		}
+	}
+
+	/** Frees a structure created by NeuralNetworkStructure_init. */
+	void NeuralNetworkStructure_deinit(NeuralNetworkStructure* this) {
+		unsigned short int i = 0;
+		while (1) {
+			NetworkLayerStructure *str = this->layers + i;
+			if (str->connectionType == NetworkLayer_OUTPUT) break;
+
+			for (unsigned short int j = 0; str->neurons[j] != NULL; ++j) free(str->neurons[j]);
+			free(str->neurons);
+			free(str->bias);
+			i++;
+		}
+
+		free(this->layers);
+	}
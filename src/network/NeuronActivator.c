@@ -56,6 +56,7 @@
 
 //SETUP
 	void NeuronActivator_init(NeuronActivator *this, NetworkLayerStructure *str) {
+		this->type = str->activatorType;
 		switch (str->activatorType) {
 			case NeuronActivator_RELU:
 				this->inToOut = *NeuronActivator_relu;
@@ -88,6 +89,7 @@
 				break;
 
 			default:
+				this->type = NeuronActivator_CUSTOM;
 				this->inToOut = NULL;
 				this->inToDerivative = NULL;
 				break;
@@ -0,0 +1,345 @@
+#include "InferenceServer.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BulkPredictor_CHUNK 65536
+
+//TYPES
+	typedef struct {
+		NeuronUnit *inputs;
+		unsigned int count;
+	} BulkBatch;
+
+	/** The input, either memory mapped or read in chunks. Chunks end with a '\0' sentinel, so that strtod stops there. */
+	typedef struct {
+		int fd;
+		char *mapping;
+		unsigned long int mappingSize;
+		const char *position;
+		const char *end;
+		char *buffer;
+		unsigned long int bufferSize;
+		char eof;
+	} BulkInput;
+
+	/** Batches travel from the reader thread to the caller through a ring of BulkPredictor_SLOTS slots. */
+	typedef struct {
+		BulkPredictor *owner;
+		BulkInput input;
+		unsigned short int inputCount;
+		unsigned long int row;			//rows read so far, including skipped blank lines (CSV)
+
+		BulkBatch slots[BulkPredictor_SLOTS];
+		unsigned int head;
+		unsigned int count;
+		char finished;					//the reader is done, successfully or not
+		char stopped;					//the caller gave up (write error)
+		pthread_mutex_t lock;
+		pthread_cond_t changed;
+	} BulkPipeline;
+
+
+
+//INPUT
+	static char BulkInput_init(BulkInput* this, int fd) {
+		this->fd = fd;
+		this->mapping = NULL;
+		this->buffer = NULL;
+		this->bufferSize = 0;
+		this->eof = 0;
+
+		struct stat st;
+		if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+			void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (mapping != MAP_FAILED) {
+				madvise(mapping, st.st_size, MADV_SEQUENTIAL);
+				this->mapping = mapping;
+				this->mappingSize = st.st_size;
+				this->position = mapping;
+				this->end = this->position + st.st_size;
+				this->eof = 1;
+				return 1;
+			}
+		}
+
+		this->bufferSize = BulkPredictor_CHUNK;
+		this->buffer = malloc(this->bufferSize + 1);
+		this->position = this->end = this->buffer;
+		this->buffer[0] = '\0';
+		return 0;
+	}
+
+	static void BulkInput_deinit(BulkInput* this) {
+		if (this->mapping) munmap(this->mapping, this->mappingSize);
+		free(this->buffer);
+	}
+
+	/** Reads more bytes after the unread ones, moving them to the start of the buffer (which grows for very long lines). */
+	static void BulkInput_fill(BulkInput* this) {
+		unsigned long int kept = this->end - this->position;
+		memmove(this->buffer, this->position, kept);
+		if (kept == this->bufferSize) {
+			this->bufferSize *= 2;
+			this->buffer = realloc(this->buffer, this->bufferSize + 1);
+		}
+
+		long int got;
+		do got = read(this->fd, this->buffer + kept, this->bufferSize - kept);
+		while (got < 0 && errno == EINTR);
+		if (got <= 0) this->eof = 1;
+		else kept += got;
+
+		this->position = this->buffer;
+		this->end = this->buffer + kept;
+		this->buffer[kept] = '\0';
+	}
+
+	/** The next line, without its '\n', in [*line, *lineEnd). The character at *lineEnd stops strtod. Returns 0 at the end of the input. */
+	static char BulkInput_nextLine(BulkInput* this, const char** line, const char** lineEnd) {
+		while (1) {
+			const char *newLine = memchr(this->position, '\n', this->end - this->position);
+			if (newLine != NULL) {
+				*line = this->position;
+				*lineEnd = newLine;
+				this->position = newLine + 1;
+				return 1;
+			}
+			if (this->eof) break;
+			BulkInput_fill(this);
+		}
+		if (this->position == this->end) return 0;
+
+		//a last line without '\n'. The end of a mapping has no sentinel, so copy it
+		if (this->mapping) {
+			unsigned long int length = this->end - this->position;
+			this->buffer = malloc(length + 1);
+			memcpy(this->buffer, this->position, length);
+			this->buffer[length] = '\0';
+			this->position = this->end = this->buffer + length;
+			*line = this->buffer;
+			*lineEnd = this->end;
+			return 1;
+		}
+		*line = this->position;
+		*lineEnd = this->end;
+		this->position = this->end;
+		return 1;
+	}
+
+	/** Reads exactly size bytes. Returns how many it got before the end of the input. */
+	static unsigned long int BulkInput_read(BulkInput* this, void* target, unsigned long int size) {
+		unsigned long int done = 0;
+		while (done < size) {
+			long int got = read(this->fd, (char*) target + done, size - done);
+			if (got < 0 && errno == EINTR) continue;
+			if (got <= 0) break;
+			done += got;
+		}
+		return done;
+	}
+
+
+
+//PARSING
+	static char BulkPredictor_isBlank(char c) {
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	/** Parses count comma separated numbers. Returns -1 for a blank line, 0 for a bad one. */
+	static int BulkPredictor_parseCsv(const char* line, const char* lineEnd, NeuronUnit* target, unsigned short int count) {
+		const char *position = line;
+		while (position < lineEnd && BulkPredictor_isBlank(*position)) ++position;
+		if (position == lineEnd) return -1;
+
+		for (unsigned short int i = 0; i < count; ++i) {
+			while (position < lineEnd && BulkPredictor_isBlank(*position)) ++position;
+			if (position == lineEnd) return 0; //strtod would skip the '\n' and read the next line
+
+			char *numberEnd;
+			target[i] = strtod(position, &numberEnd);
+			if (numberEnd == position || numberEnd > lineEnd) return 0;
+			position = numberEnd;
+
+			while (position < lineEnd && BulkPredictor_isBlank(*position)) ++position;
+			if (i + 1 < count) {
+				if (position == lineEnd || *position != ',') return 0;
+				++position;
+			}
+		}
+		return position == lineEnd;
+	}
+
+	/** Fills a batch from the input. Returns 0 for bad input. batch->count is 0 at the end of the input. */
+	static char BulkPipeline_fill(BulkPipeline* this, BulkBatch* batch) {
+		unsigned int batchSize = this->owner->batchSize;
+		unsigned short int inputCount = this->inputCount;
+		batch->count = 0;
+
+		if (this->owner->inputFormat == BulkPredictor_BINARY) {
+			unsigned long int rowSize = inputCount * sizeof(NeuronUnit);
+			unsigned long int got = BulkInput_read(&this->input, batch->inputs, batchSize * rowSize);
+			batch->count = got / rowSize;
+			this->row += batch->count;
+			if (got % rowSize == 0) return 1;
+			this->owner->errorRow = this->row + 1; //a partial row at the end
+			return 0;
+		}
+
+		const char *line, *lineEnd;
+		while (batch->count < batchSize && BulkInput_nextLine(&this->input, &line, &lineEnd)) {
+			this->row++;
+			int parsed = BulkPredictor_parseCsv(line, lineEnd, batch->inputs + (unsigned long int) batch->count * inputCount, inputCount);
+			if (parsed == 0) {
+				this->owner->errorRow = this->row;
+				return 0;
+			}
+			if (parsed > 0) batch->count++;
+		}
+		return 1;
+	}
+
+	static void* BulkPipeline_read(void* arg) {
+		BulkPipeline *this = arg;
+
+		pthread_mutex_lock(&this->lock);
+		while (1) {
+			while (this->count == BulkPredictor_SLOTS && !this->stopped) pthread_cond_wait(&this->changed, &this->lock);
+			if (this->stopped) break;
+			BulkBatch *batch = this->slots + (this->head + this->count) % BulkPredictor_SLOTS;
+			pthread_mutex_unlock(&this->lock);
+
+			char ok = BulkPipeline_fill(this, batch);
+
+			pthread_mutex_lock(&this->lock);
+			if (batch->count > 0) this->count++;
+			if (!ok || batch->count < this->owner->batchSize) break;
+			pthread_cond_broadcast(&this->changed);
+		}
+		this->finished = 1;
+		pthread_cond_broadcast(&this->changed);
+		pthread_mutex_unlock(&this->lock);
+		return NULL;
+	}
+
+
+
+//OUTPUT
+	static char BulkPredictor_write(BulkPredictor* this, const NeuronUnit* outputs, unsigned int count, FILE* out) {
+		unsigned short int outputCount = this->network->layers[this->network->layerCount - 1].neuronCount;
+		if (this->outputFormat == BulkPredictor_BINARY) return fwrite(outputs, sizeof(NeuronUnit), (unsigned long int) count * outputCount, out) == (unsigned long int) count * outputCount;
+
+		for (unsigned int i = 0; i < count; ++i) {
+			for (unsigned short int j = 0; j < outputCount; ++j) fprintf(out, j == 0? "%.9g" : ",%.9g", outputs[(unsigned long int) i * outputCount + j]);
+			fputc('\n', out);
+		}
+		return !ferror(out);
+	}
+
+
+
+//RUN
+	void BulkPredictor_init(BulkPredictor* this, NeuralNetwork* network, unsigned char inputFormat, unsigned char outputFormat, unsigned int batchSize) {
+		this->network = network;
+		this->inputFormat = inputFormat;
+		this->outputFormat = outputFormat;
+		this->batchSize = batchSize == 0? 1 : batchSize > BulkPredictor_MAX_BATCH? BulkPredictor_MAX_BATCH : batchSize;
+		this->rows = 0;
+		this->batches = 0;
+		this->errorRow = 0;
+		this->mapped = 0;
+	}
+
+	/** Binary rows straight from the mapping: nothing is copied or parsed. */
+	static char BulkPredictor_runMapped(BulkPredictor* this, BulkInput* input, FILE* out, NeuronUnit* outputs, NeuronUnit* scratch) {
+		unsigned long int rowSize = this->network->layers[0].neuronCount * sizeof(NeuronUnit);
+		unsigned long int rowCount = input->mappingSize / rowSize;
+		const NeuronUnit *rows = (const NeuronUnit*) input->mapping;
+		unsigned short int inputCount = this->network->layers[0].neuronCount;
+
+		for (unsigned long int first = 0; first < rowCount; first += this->batchSize) {
+			unsigned int count = rowCount - first < this->batchSize? rowCount - first : this->batchSize;
+			NeuralNetwork_predictBatch(this->network, rows + first * inputCount, count, outputs, scratch);
+			if (!BulkPredictor_write(this, outputs, count, out)) return 0;
+			this->rows += count;
+			this->batches++;
+		}
+
+		if (input->mappingSize % rowSize == 0) return 1;
+		this->errorRow = rowCount + 1;
+		return 0;
+	}
+
+	/** Predicts every row of inputFd, and writes the outputs to out in the same order.
+	 * Returns 0 if a row could not be read (see errorRow) or out could not be written. The rows before it are written anyway. */
+	char BulkPredictor_run(BulkPredictor* this, int inputFd, FILE* out) {
+		NeuralNetwork *net = this->network;
+		unsigned short int inputCount = net->layers[0].neuronCount;
+		unsigned short int outputCount = net->layers[net->layerCount - 1].neuronCount;
+		this->rows = 0;
+		this->batches = 0;
+		this->errorRow = 0;
+
+		NeuronUnit *outputs = malloc((unsigned long int) this->batchSize * outputCount * sizeof(NeuronUnit));
+		NeuronUnit *scratch = malloc(NeuralNetwork_batchScratchSize(net, this->batchSize) * sizeof(NeuronUnit));
+		BulkPipeline pipeline;
+		pipeline.owner = this;
+		pipeline.inputCount = inputCount;
+		this->mapped = BulkInput_init(&pipeline.input, inputFd);
+
+		char ok = 1;
+		if (this->mapped && this->inputFormat == BulkPredictor_BINARY) ok = BulkPredictor_runMapped(this, &pipeline.input, out, outputs, scratch);
+		else {
+			pipeline.row = 0;
+			pipeline.head = 0;
+			pipeline.count = 0;
+			pipeline.finished = 0;
+			pipeline.stopped = 0;
+			for (unsigned int i = 0; i < BulkPredictor_SLOTS; ++i) pipeline.slots[i].inputs = malloc((unsigned long int) this->batchSize * inputCount * sizeof(NeuronUnit));
+			pthread_mutex_init(&pipeline.lock, NULL);
+			pthread_cond_init(&pipeline.changed, NULL);
+
+			pthread_t reader;
+			pthread_create(&reader, NULL, BulkPipeline_read, &pipeline);
+
+			//predict and write a batch while the reader parses the next ones
+			pthread_mutex_lock(&pipeline.lock);
+			while (1) {
+				while (pipeline.count == 0 && !pipeline.finished) pthread_cond_wait(&pipeline.changed, &pipeline.lock);
+				if (pipeline.count == 0) break;
+				BulkBatch *batch = pipeline.slots + pipeline.head;
+				pthread_mutex_unlock(&pipeline.lock);
+
+				NeuralNetwork_predictBatch(net, batch->inputs, batch->count, outputs, scratch);
+				char written = BulkPredictor_write(this, outputs, batch->count, out);
+				this->rows += batch->count;
+				this->batches++;
+
+				pthread_mutex_lock(&pipeline.lock);
+				pipeline.head = (pipeline.head + 1) % BulkPredictor_SLOTS;
+				pipeline.count--;
+				if (!written) {
+					ok = 0;
+					pipeline.stopped = 1;
+				}
+				pthread_cond_broadcast(&pipeline.changed);
+				if (!written) break;
+			}
+			pthread_mutex_unlock(&pipeline.lock);
+			pthread_join(reader, NULL);
+			if (this->errorRow) ok = 0;
+
+			pthread_mutex_destroy(&pipeline.lock);
+			pthread_cond_destroy(&pipeline.changed);
+			for (unsigned int i = 0; i < BulkPredictor_SLOTS; ++i) free(pipeline.slots[i].inputs);
+		}
+
+		ok = fflush(out) == 0 && ok;
+		BulkInput_deinit(&pipeline.input);
+		free(scratch);
+		free(outputs);
+		return ok;
+	}
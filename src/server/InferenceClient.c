@@ -0,0 +1,83 @@
+#include "InferenceServer.h"
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+//LIFECYCLE
+	char InferenceClient_connectUnix(InferenceClient* this, const char* path) {
+		struct sockaddr_un address = {0};
+		if (strlen(path) >= sizeof(address.sun_path)) return 0;
+		address.sun_family = AF_UNIX;
+		strcpy(address.sun_path, path);
+
+		this->nextId = 0;
+		this->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (this->fd < 0) return 0;
+		if (connect(this->fd, (struct sockaddr*) &address, sizeof(address)) != 0) {
+			close(this->fd);
+			this->fd = -1;
+			return 0;
+		}
+		return 1;
+	}
+
+	char InferenceClient_connectTcp(InferenceClient* this, unsigned short int port) {
+		struct sockaddr_in address = {0};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		address.sin_port = htons(port);
+
+		this->nextId = 0;
+		this->fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (this->fd < 0) return 0;
+		if (connect(this->fd, (struct sockaddr*) &address, sizeof(address)) != 0) {
+			close(this->fd);
+			this->fd = -1;
+			return 0;
+		}
+
+		int on = 1;
+		setsockopt(this->fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+		return 1;
+	}
+
+	void InferenceClient_close(InferenceClient* this) {
+		if (this->fd >= 0) close(this->fd);
+		this->fd = -1;
+	}
+
+
+
+//REQUESTS
+	/** Sends a request without waiting for the answer. Returns its id, or -1 if the connection is gone. */
+	long int InferenceClient_send(InferenceClient* this, const NeuronUnit* inputs, unsigned short int inputCount) {
+		InferenceMessageHeader header = { this->nextId++, inputCount, 0 };
+		return InferenceSocket_sendMessage(this->fd, &header, inputs)? (long int) header.id : -1;
+	}
+
+	/** Waits for the next answer, and returns its status, or -1 if the connection is gone.
+	 * Outputs beyond maxOutputs are skipped. */
+	int InferenceClient_receive(InferenceClient* this, uint32_t* id, NeuronUnit* outputs, unsigned short int maxOutputs) {
+		InferenceMessageHeader header;
+		if (!InferenceSocket_readAll(this->fd, &header, sizeof(header))) return -1;
+
+		unsigned short int kept = header.count < maxOutputs? header.count : maxOutputs;
+		if (!InferenceSocket_readAll(this->fd, outputs, kept * sizeof(NeuronUnit))) return -1;
+		for (unsigned short int i = kept; i < header.count; ++i) {
+			NeuronUnit discard;
+			if (!InferenceSocket_readAll(this->fd, &discard, sizeof(NeuronUnit))) return -1;
+		}
+
+		*id = header.id;
+		return header.reserved;
+	}
+
+	/** One request and its answer. Only use it when no other requests are pending on this client. */
+	int InferenceClient_predict(InferenceClient* this, const NeuronUnit* inputs, unsigned short int inputCount, NeuronUnit* outputs, unsigned short int outputCount) {
+		if (InferenceClient_send(this, inputs, inputCount) < 0) return -1;
+		uint32_t id;
+		return InferenceClient_receive(this, &id, outputs, outputCount);
+	}
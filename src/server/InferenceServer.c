@@ -0,0 +1,488 @@
+#include "InferenceServer.h"
+#include <errno.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define InferenceServer_SEND_TIMEOUT_MS 200 //a connection whose answers cannot be written for that long is dropped
+
+struct _InferenceConnection {
+	int fd;
+	atomic_uint refs;				//the reader thread, plus one per queued request
+	pthread_mutex_t writeLock;		//the reader answers rejected requests, the batcher the others
+	atomic_char broken;				//a write failed: nothing more is read or written. Set under writeLock
+	NeuronUnit *inputs;
+	InferenceServer *server;
+	InferenceConnection *next;
+};
+
+
+//UTILS
+	static unsigned long int InferenceServer_now() {
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+	}
+
+	/** Reads exactly size bytes. Returns 0 on end of stream or error. */
+	char InferenceSocket_readAll(int fd, void* target, unsigned long int size) {
+		char *position = target;
+		while (size) {
+			ssize_t count = read(fd, position, size);
+			if (count < 0 && errno == EINTR) continue;
+			if (count <= 0) return 0;
+			position += count;
+			size -= count;
+		}
+		return 1;
+	}
+
+	/** Writes the header and the units in one go, without raising SIGPIPE if the peer is gone. */
+	char InferenceSocket_sendMessage(int fd, InferenceMessageHeader* header, const NeuronUnit* units) {
+		struct iovec parts[2] = {
+			{ header, sizeof(InferenceMessageHeader) },
+			{ (void*) units, header->count * sizeof(NeuronUnit) }
+		};
+		struct msghdr message = {0};
+		message.msg_iov = parts;
+		message.msg_iovlen = header->count? 2 : 1;
+
+		while (message.msg_iovlen) {
+			ssize_t count = sendmsg(fd, &message, MSG_NOSIGNAL);
+			if (count < 0 && errno == EINTR) continue;
+			if (count <= 0) return 0;
+
+			while (message.msg_iovlen && (size_t) count >= message.msg_iov->iov_len) {
+				count -= message.msg_iov->iov_len;
+				++message.msg_iov;
+				--message.msg_iovlen;
+			}
+			if (message.msg_iovlen) {
+				message.msg_iov->iov_base = (char*) message.msg_iov->iov_base + count;
+				message.msg_iov->iov_len -= count;
+			}
+		}
+		return 1;
+	}
+
+	/** Skips count units of a message that will not be used. */
+	static char InferenceSocket_skip(int fd, unsigned long int count) {
+		NeuronUnit discard[64];
+		while (count) {
+			unsigned long int chunk = count < 64? count : 64;
+			if (!InferenceSocket_readAll(fd, discard, chunk * sizeof(NeuronUnit))) return 0;
+			count -= chunk;
+		}
+		return 1;
+	}
+
+	static unsigned int InferenceServer_latencyBucket(unsigned long int nanoseconds) {
+		double microseconds = nanoseconds / 1000.0;
+		if (microseconds <= 1) return 0;
+		double bucket = ceil(4 * log2(microseconds));
+		return bucket >= InferenceServer_LATENCY_BUCKETS? InferenceServer_LATENCY_BUCKETS - 1 : (unsigned int) bucket;
+	}
+
+
+
+//CONNECTIONS
+	static void InferenceConnection_release(InferenceConnection* this) {
+		if (atomic_fetch_sub(&this->refs, 1) != 1) return;
+		close(this->fd);
+		pthread_mutex_destroy(&this->writeLock);
+		free(this->inputs);
+		free(this);
+	}
+
+	/** Writes one answer. A client that does not read its answers would block the single batcher, and every other client with it:
+	 * when a write fails or times out, the connection is shut down, which also ends its reader. */
+	static void InferenceConnection_respond(InferenceConnection* this, uint32_t id, uint16_t status, const NeuronUnit* outputs, uint16_t outputCount) {
+		InferenceMessageHeader header = { id, outputCount, status };
+		pthread_mutex_lock(&this->writeLock);
+		if (!atomic_load(&this->broken) && !InferenceSocket_sendMessage(this->fd, &header, outputs)) {
+			atomic_store(&this->broken, 1);
+			pthread_mutex_lock(&this->server->statsLock);
+			++this->server->stats.dropped;
+			pthread_mutex_unlock(&this->server->statsLock);
+			shutdown(this->fd, SHUT_RDWR);
+		}
+		pthread_mutex_unlock(&this->writeLock);
+	}
+
+	/** Queues the request in connection->inputs. Returns 0 if the queue is full or the server is stopping. */
+	static char InferenceServer_enqueue(InferenceServer* this, InferenceConnection* connection, uint32_t id) {
+		pthread_mutex_lock(&this->queueLock);
+		if (!atomic_load(&this->running) || this->queueCount == this->queueCapacity) {
+			pthread_mutex_unlock(&this->queueLock);
+			return 0;
+		}
+
+		unsigned int slot = (this->queueHead + this->queueCount) % this->queueCapacity;
+		InferenceRequest *request = this->queue + slot;
+		request->connection = connection;
+		request->id = id;
+		request->arrival = InferenceServer_now();
+		memcpy(this->queueInputs + (unsigned long int) slot * this->inputCount, connection->inputs, this->inputCount * sizeof(NeuronUnit));
+		atomic_fetch_add(&connection->refs, 1);
+
+		++this->queueCount;
+		if (this->queueCount == 1 || this->queueCount >= this->maxBatch) pthread_cond_signal(&this->queueChanged);
+		pthread_mutex_unlock(&this->queueLock);
+		return 1;
+	}
+
+	static void InferenceServer_reject(InferenceServer* this, InferenceConnection* connection, uint32_t id, uint16_t status) {
+		pthread_mutex_lock(&this->statsLock);
+		++this->stats.rejected;
+		pthread_mutex_unlock(&this->statsLock);
+		InferenceConnection_respond(connection, id, status, NULL, 0);
+	}
+
+	static void* InferenceConnection_read(void* arg) {
+		InferenceConnection *this = arg;
+		InferenceServer *server = this->server;
+		InferenceMessageHeader header;
+
+		while (!atomic_load(&this->broken) && InferenceSocket_readAll(this->fd, &header, sizeof(header))) {
+			if (header.reserved != 0) break; //not our protocol
+
+			if (header.count != server->inputCount) {
+				if (!InferenceSocket_skip(this->fd, header.count)) break;
+				InferenceServer_reject(server, this, header.id, InferenceServer_BAD_REQUEST);
+				continue;
+			}
+
+			if (!InferenceSocket_readAll(this->fd, this->inputs, header.count * sizeof(NeuronUnit))) break;
+			if (!InferenceServer_enqueue(server, this, header.id)) InferenceServer_reject(server, this, header.id, InferenceServer_OVERLOADED);
+		}
+
+		//unlink, so that stopping does not touch us anymore
+		pthread_mutex_lock(&server->connectionsLock);
+		InferenceConnection **link = &server->connections;
+		while (*link != this) link = &(*link)->next;
+		*link = this->next;
+		if (!server->connections) pthread_cond_broadcast(&server->connectionsClosed);
+		pthread_mutex_unlock(&server->connectionsLock);
+
+		InferenceConnection_release(this);
+		return NULL;
+	}
+
+	static void* InferenceServer_accept(void* arg) {
+		InferenceServer *this = arg;
+
+		while (atomic_load(&this->running)) {
+			int fd = accept(this->listenFd, NULL, NULL);
+			if (fd < 0) {
+				if (errno == EINTR || errno == ECONNABORTED) continue;
+				break; //the listening socket was shut down
+			}
+
+			int on = 1;
+			setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)); //fails harmlessly on unix sockets
+			struct timeval timeout = { 0, InferenceServer_SEND_TIMEOUT_MS * 1000 };
+			setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+			InferenceConnection *connection = malloc(sizeof(InferenceConnection));
+			connection->fd = fd;
+			atomic_init(&connection->broken, 0);
+			atomic_init(&connection->refs, 1);
+			pthread_mutex_init(&connection->writeLock, NULL);
+			connection->inputs = malloc(this->inputCount * sizeof(NeuronUnit));
+			connection->server = this;
+
+			pthread_mutex_lock(&this->connectionsLock);
+			connection->next = this->connections;
+			this->connections = connection;
+			pthread_mutex_unlock(&this->connectionsLock);
+
+			pthread_t reader;
+			pthread_attr_t attributes;
+			pthread_attr_init(&attributes);
+			pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+			pthread_create(&reader, &attributes, InferenceConnection_read, connection);
+			pthread_attr_destroy(&attributes);
+		}
+		return NULL;
+	}
+
+
+
+//BATCHING
+	static void InferenceServer_runBatch(InferenceServer* this, unsigned int size) {
+		NeuralNetwork *net = SharedModel_acquire(this->model, this->readerSlot);
+		unsigned long int scratchSize = NeuralNetwork_batchScratchSize(net, this->maxBatch);
+		if (scratchSize > this->scratchSize) { //a published network may have wider hidden layers
+			free(this->scratch);
+			this->scratch = malloc(scratchSize * sizeof(NeuronUnit));
+			this->scratchSize = scratchSize;
+		}
+		NeuralNetwork_predictBatch(net, this->batchInputs, size, this->batchOutputs, this->scratch);
+		SharedModel_release(this->model, this->readerSlot);
+
+		//recorded before answering, so that a client sees its own request in the stats
+		unsigned long int now = InferenceServer_now();
+		pthread_mutex_lock(&this->statsLock);
+		this->stats.requests += size;
+		++this->stats.batches;
+		++this->stats.batchSizes[size];
+		for (unsigned int i = 0; i < size; ++i) ++this->stats.latencies[InferenceServer_latencyBucket(now - this->batch[i].arrival)];
+		pthread_mutex_unlock(&this->statsLock);
+
+		for (unsigned int i = 0; i < size; ++i) {
+			InferenceRequest *request = this->batch + i;
+			InferenceConnection_respond(request->connection, request->id, InferenceServer_OK, this->batchOutputs + (unsigned long int) i * this->outputCount, this->outputCount);
+		}
+
+		for (unsigned int i = 0; i < size; ++i) InferenceConnection_release(this->batch[i].connection);
+	}
+
+	/** Takes up to maxBatch requests from the head of the queue. Call with queueLock held. */
+	static unsigned int InferenceServer_dequeue(InferenceServer* this) {
+		unsigned int size = this->queueCount < this->maxBatch? this->queueCount : this->maxBatch;
+		for (unsigned int i = 0; i < size; ++i) {
+			unsigned int slot = (this->queueHead + i) % this->queueCapacity;
+			this->batch[i] = this->queue[slot];
+			memcpy(this->batchInputs + (unsigned long int) i * this->inputCount, this->queueInputs + (unsigned long int) slot * this->inputCount, this->inputCount * sizeof(NeuronUnit));
+		}
+		this->queueHead = (this->queueHead + size) % this->queueCapacity;
+		this->queueCount -= size;
+		return size;
+	}
+
+	static void* InferenceServer_batch(void* arg) {
+		InferenceServer *this = arg;
+
+		pthread_mutex_lock(&this->queueLock);
+		while (1) {
+			while (atomic_load(&this->running) && this->queueCount == 0) pthread_cond_wait(&this->queueChanged, &this->queueLock);
+			if (!atomic_load(&this->running)) break;
+
+			//give the batch some time to fill up, counting from the arrival of its oldest request
+			unsigned long int deadline = this->queue[this->queueHead].arrival + this->maxDelayUs * 1000UL;
+			while (atomic_load(&this->running) && this->queueCount < this->maxBatch && InferenceServer_now() < deadline) {
+				struct timespec until = { deadline / 1000000000UL, deadline % 1000000000UL };
+				pthread_cond_timedwait(&this->queueChanged, &this->queueLock, &until);
+			}
+			if (!atomic_load(&this->running)) break;
+
+			unsigned int size = InferenceServer_dequeue(this);
+			pthread_mutex_unlock(&this->queueLock);
+			InferenceServer_runBatch(this, size);
+			pthread_mutex_lock(&this->queueLock);
+		}
+		pthread_mutex_unlock(&this->queueLock);
+		return NULL;
+	}
+
+
+
+//LIFECYCLE
+	/** The batcher takes a reader slot of model. Returns 0, leaving the server uninitialized, if all of them are taken (see SharedModel_register).
+	 * maxBatch, maxDelayUs and queueCapacity are brought within InferenceServer_MAX_BATCH, _MAX_DELAY_US and _MAX_QUEUE. */
+	char InferenceServer_init(InferenceServer* this, SharedModel* model, unsigned int maxBatch, unsigned int maxDelayUs, unsigned int queueCapacity) {
+		this->readerSlot = SharedModel_register(model);
+		if (this->readerSlot < 0) return 0;
+		this->model = model;
+		this->inputCount = model->inputCount;
+		this->outputCount = model->outputCount;
+		this->maxBatch = maxBatch == 0? 1 : maxBatch > InferenceServer_MAX_BATCH? InferenceServer_MAX_BATCH : maxBatch;
+		this->maxDelayUs = maxDelayUs > InferenceServer_MAX_DELAY_US? InferenceServer_MAX_DELAY_US : maxDelayUs;
+		this->queueCapacity = queueCapacity < this->maxBatch? this->maxBatch : queueCapacity > InferenceServer_MAX_QUEUE? InferenceServer_MAX_QUEUE : queueCapacity;
+
+		this->queue = malloc(this->queueCapacity * sizeof(InferenceRequest));
+		this->queueInputs = malloc((unsigned long int) this->queueCapacity * this->inputCount * sizeof(NeuronUnit));
+		this->queueHead = 0;
+		this->queueCount = 0;
+		pthread_mutex_init(&this->queueLock, NULL);
+		pthread_condattr_t conditionAttributes;
+		pthread_condattr_init(&conditionAttributes);
+		pthread_condattr_setclock(&conditionAttributes, CLOCK_MONOTONIC);
+		pthread_cond_init(&this->queueChanged, &conditionAttributes);
+		pthread_condattr_destroy(&conditionAttributes);
+
+		this->batch = malloc(this->maxBatch * sizeof(InferenceRequest));
+		this->batchInputs = malloc((unsigned long int) this->maxBatch * this->inputCount * sizeof(NeuronUnit));
+		this->batchOutputs = malloc((unsigned long int) this->maxBatch * this->outputCount * sizeof(NeuronUnit));
+		this->scratch = NULL;
+		this->scratchSize = 0;
+
+		this->listenFd = -1;
+		this->port = 0;
+		this->path = NULL;
+		atomic_init(&this->running, 0);
+		this->connections = NULL;
+		pthread_mutex_init(&this->connectionsLock, NULL);
+		pthread_cond_init(&this->connectionsClosed, NULL);
+
+		memset(&this->stats, 0, sizeof(InferenceServerStats));
+		this->stats.batchSizes = calloc(this->maxBatch + 1, sizeof(unsigned long int));
+		pthread_mutex_init(&this->statsLock, NULL);
+		return 1;
+	}
+
+	void InferenceServer_deinit(InferenceServer* this) {
+		InferenceServer_stop(this);
+		SharedModel_unregister(this->model, this->readerSlot);
+		pthread_mutex_destroy(&this->queueLock);
+		pthread_cond_destroy(&this->queueChanged);
+		pthread_mutex_destroy(&this->connectionsLock);
+		pthread_cond_destroy(&this->connectionsClosed);
+		pthread_mutex_destroy(&this->statsLock);
+		free(this->queue);
+		free(this->queueInputs);
+		free(this->batch);
+		free(this->batchInputs);
+		free(this->batchOutputs);
+		free(this->scratch);
+		free(this->stats.batchSizes);
+	}
+
+	static char InferenceServer_start(InferenceServer* this, int fd) {
+		if (listen(fd, 64) != 0) {
+			close(fd);
+			return 0;
+		}
+
+		this->listenFd = fd;
+		atomic_store(&this->running, 1);
+		pthread_create(&this->batcher, NULL, InferenceServer_batch, this);
+		pthread_create(&this->acceptor, NULL, InferenceServer_accept, this);
+		return 1;
+	}
+
+	char InferenceServer_listenUnix(InferenceServer* this, const char* path) {
+		if (atomic_load(&this->running)) return 0;
+		struct sockaddr_un address = {0};
+		if (strlen(path) >= sizeof(address.sun_path)) return 0;
+		address.sun_family = AF_UNIX;
+		strcpy(address.sun_path, path);
+
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd < 0) return 0;
+		unlink(path); //a stale socket of a previous run
+		if (bind(fd, (struct sockaddr*) &address, sizeof(address)) != 0) {
+			close(fd);
+			return 0;
+		}
+
+		this->path = strdup(path);
+		return InferenceServer_start(this, fd);
+	}
+
+	/** Listens on 127.0.0.1 only. Port 0 picks a free port, see InferenceServer.port. */
+	char InferenceServer_listenTcp(InferenceServer* this, unsigned short int port) {
+		if (atomic_load(&this->running)) return 0;
+		int fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (fd < 0) return 0;
+		int on = 1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+		struct sockaddr_in address = {0};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		address.sin_port = htons(port);
+		socklen_t length = sizeof(address);
+		if (bind(fd, (struct sockaddr*) &address, sizeof(address)) != 0 || getsockname(fd, (struct sockaddr*) &address, &length) != 0) {
+			close(fd);
+			return 0;
+		}
+
+		this->port = ntohs(address.sin_port);
+		return InferenceServer_start(this, fd);
+	}
+
+	/** Closes every connection. Queued requests are dropped without an answer. */
+	void InferenceServer_stop(InferenceServer* this) {
+		if (!atomic_load(&this->running)) return;
+
+		pthread_mutex_lock(&this->queueLock);
+		atomic_store(&this->running, 0);
+		pthread_cond_broadcast(&this->queueChanged);
+		pthread_mutex_unlock(&this->queueLock);
+
+		shutdown(this->listenFd, SHUT_RDWR);
+		pthread_join(this->acceptor, NULL);
+		close(this->listenFd);
+		this->listenFd = -1;
+		if (this->path) {
+			unlink(this->path);
+			free(this->path);
+			this->path = NULL;
+		}
+
+		//wake up the readers, and the batcher if it is writing to a connection. Then wait until all of them are gone
+		pthread_mutex_lock(&this->connectionsLock);
+		for (InferenceConnection *connection = this->connections; connection; connection = connection->next) shutdown(connection->fd, SHUT_RDWR);
+		pthread_mutex_unlock(&this->connectionsLock);
+		pthread_join(this->batcher, NULL);
+		pthread_mutex_lock(&this->connectionsLock);
+		while (this->connections) pthread_cond_wait(&this->connectionsClosed, &this->connectionsLock);
+		pthread_mutex_unlock(&this->connectionsLock);
+
+		for (; this->queueCount; --this->queueCount) {
+			InferenceConnection_release(this->queue[this->queueHead].connection);
+			this->queueHead = (this->queueHead + 1) % this->queueCapacity;
+		}
+	}
+
+
+
+//STATS
+	/** Copies the stats. batchSizes receives maxBatch+1 counters. */
+	void InferenceServer_getStats(InferenceServer* this, InferenceServerStats* target, unsigned long int* batchSizes) {
+		pthread_mutex_lock(&this->statsLock);
+		*target = this->stats;
+		memcpy(batchSizes, this->stats.batchSizes, (this->maxBatch + 1) * sizeof(unsigned long int));
+		pthread_mutex_unlock(&this->statsLock);
+		target->batchSizes = batchSizes;
+	}
+
+	/** Upper bound, in microseconds, of the latency below which the given fraction of the requests finished. */
+	unsigned long int InferenceServer_latencyPercentile(InferenceServerStats* stats, double percentile) {
+		unsigned long int total = 0;
+		for (unsigned int i = 0; i < InferenceServer_LATENCY_BUCKETS; ++i) total += stats->latencies[i];
+		if (total == 0) return 0;
+
+		unsigned long int wanted = (unsigned long int) ceil(percentile * total);
+		unsigned long int seen = 0;
+		unsigned int i = 0;
+		for (; i < InferenceServer_LATENCY_BUCKETS - 1; ++i) {
+			seen += stats->latencies[i];
+			if (seen >= wanted) break;
+		}
+		return (unsigned long int) ceil(pow(2, i / 4.0));
+	}
+
+	void InferenceServer_printStats(InferenceServer* this, FILE* out) {
+		unsigned long int *batchSizes = malloc((this->maxBatch + 1) * sizeof(unsigned long int));
+		InferenceServerStats stats;
+		InferenceServer_getStats(this, &stats, batchSizes);
+
+		fprintf(out, "%s, %lu requests, %lu rejected, %lu batches", atomic_load(&this->running)? "Running" : "Stopped", stats.requests, stats.rejected, stats.batches);
+		if (stats.dropped) fprintf(out, ", %lu connections dropped", stats.dropped);
+		if (stats.batches) fprintf(out, " (%.2f requests per batch)", (double) stats.requests / stats.batches);
+		fprintf(out, "\n");
+		if (!stats.requests) {
+			free(batchSizes);
+			return;
+		}
+
+		fprintf(out, "Latency: p50 <= %luus, p90 <= %luus, p99 <= %luus\n",
+			InferenceServer_latencyPercentile(&stats, 0.5),
+			InferenceServer_latencyPercentile(&stats, 0.9),
+			InferenceServer_latencyPercentile(&stats, 0.99));
+		fprintf(out, "Batch sizes:");
+		for (unsigned int i = 1; i <= this->maxBatch; ++i) {
+			if (batchSizes[i]) fprintf(out, " %u:%lu", i, batchSizes[i]);
+		}
+		fprintf(out, "\n");
+		free(batchSizes);
+	}
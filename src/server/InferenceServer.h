@@ -0,0 +1,193 @@
+#pragma once
+
+#include "../network/Network.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+//PROTOCOL
+	/** Every message is this header, followed by count NeuronUnits in host byte order (the server only listens locally).
+	 * Requests carry the inputs, and reserved must be 0. Responses carry the outputs, and reserved holds the status.
+	 * Responses of one connection may come back in any order: match them by id. */
+	typedef struct {
+		uint32_t id;
+		uint16_t count;
+		uint16_t reserved;
+	} InferenceMessageHeader;
+
+	#define InferenceServer_OK 0
+	#define InferenceServer_BAD_REQUEST 1	//wrong input count. The outputs are empty
+	#define InferenceServer_OVERLOADED 2	//the queue was full. The outputs are empty
+
+
+
+//TYPES
+	#define SharedModel_MAX_READERS 64
+	typedef struct {
+		_Alignas(64) _Atomic(NeuralNetwork*) network;	//the network this reader is using, NULL between predictions
+		atomic_char used;
+	} SharedModelReader;
+
+	/** A network that is replaced while readers keep predicting, RCU style: a reader acquires the current network,
+	 * and a publisher swaps in a new one, then frees the old one once no reader slot holds it anymore.
+	 * Readers never wait, and never see a network that is half updated. */
+	typedef struct {
+		_Atomic(NeuralNetwork*) current;
+		atomic_ulong version;				//1 for the initial network, +1 per publication
+		SharedModelReader readers[SharedModel_MAX_READERS];
+		unsigned short int inputCount;		//every published network must have these
+		unsigned short int outputCount;
+		pthread_mutex_t publishLock;
+		NeuralNetwork *spare;				//the network replaced last, no longer read by anyone. Reused by SharedModel_publishWeights
+	} SharedModel;
+
+	/** Polls a model file, and publishes it into a SharedModel whenever it changes.
+	 * Write the file with NeuralNetwork_save (or any other write and rename): incomplete files fail their hash, and are skipped. */
+	typedef struct {
+		SharedModel *model;
+		char *path;
+		unsigned int intervalMs;
+		unsigned long int inode;			//the file as it was last seen
+		long int size;
+		struct timespec modified;
+		atomic_ulong loads;
+		atomic_ulong failures;
+
+		pthread_t thread;
+		pthread_mutex_t lock;
+		pthread_cond_t wakeUp;
+		char running;
+	} ModelWatcher;
+
+
+	typedef struct _InferenceConnection InferenceConnection;
+
+	/** A request waiting in the queue. Its inputs live in InferenceServer.queueInputs, in the same slot. */
+	typedef struct {
+		InferenceConnection *connection;
+		uint32_t id;
+		unsigned long int arrival;	//ns, CLOCK_MONOTONIC
+	} InferenceRequest;
+
+	#define InferenceServer_LATENCY_BUCKETS 128	//bucket i counts latencies up to 2^(i/4) us
+	typedef struct {
+		unsigned long int requests;
+		unsigned long int rejected;			//bad requests and overloaded ones
+		unsigned long int dropped;			//connections closed because an answer could not be written in time
+		unsigned long int batches;
+		unsigned long int *batchSizes;		//maxBatch+1 counters, indexed by batch size
+		unsigned long int latencies[InferenceServer_LATENCY_BUCKETS];	//queueing plus inference, per request
+	} InferenceServerStats;
+
+	#define InferenceServer_MAX_BATCH 4096
+	#define InferenceServer_MAX_DELAY_US 10000000
+	#define InferenceServer_MAX_QUEUE 1048576
+	/** Answers predictions over a local socket. Readers (one thread per connection) queue the requests,
+	 * and a single batcher thread runs them through NeuralNetwork_predictBatch, as soon as maxBatch of them are waiting,
+	 * or when the oldest one has waited maxDelayUs. Every batch uses the network that is current in the model when it starts. */
+	typedef struct {
+		SharedModel *model;
+		int readerSlot;
+		unsigned short int inputCount;
+		unsigned short int outputCount;
+		unsigned int maxBatch;
+		unsigned int maxDelayUs;
+
+		//the queue: a ring of queueCapacity requests
+		InferenceRequest *queue;
+		NeuronUnit *queueInputs;
+		unsigned int queueCapacity;
+		unsigned int queueHead;
+		unsigned int queueCount;
+		pthread_mutex_t queueLock;
+		pthread_cond_t queueChanged;
+
+		//batcher buffers
+		InferenceRequest *batch;
+		NeuronUnit *batchInputs;
+		NeuronUnit *batchOutputs;
+		NeuronUnit *scratch;
+		unsigned long int scratchSize;
+
+		int listenFd;
+		unsigned short int port;		//the bound port, for tcp
+		char *path;						//the socket file, for unix sockets
+		atomic_char running;
+		pthread_t acceptor;
+		pthread_t batcher;
+
+		InferenceConnection *connections;	//open connections, so that stopping can close them
+		pthread_mutex_t connectionsLock;
+		pthread_cond_t connectionsClosed;
+
+		InferenceServerStats stats;
+		pthread_mutex_t statsLock;
+	} InferenceServer;
+
+	#define BulkPredictor_CSV 0			//inputCount (or outputCount) comma separated numbers per line
+	#define BulkPredictor_BINARY 1		//inputCount (or outputCount) NeuronUnits per row, in host byte order
+	#define BulkPredictor_SLOTS 4
+	#define BulkPredictor_MAX_BATCH 65536	//larger batch sizes are lowered to it
+	/** Predicts a whole file or stream, batch by batch, and writes one output row per input row, in the same order.
+	 * Regular files are memory mapped, and binary ones are predicted straight from the mapping. Other inputs are parsed
+	 * by a reader thread into BulkPredictor_SLOTS batch buffers, while the calling thread predicts and writes the previous ones. */
+	typedef struct {
+		//props
+		NeuralNetwork *network;			//only read, like in NeuralNetwork_predictBatch
+		unsigned char inputFormat;
+		unsigned char outputFormat;
+		unsigned int batchSize;
+
+		//the last run
+		unsigned long int rows;
+		unsigned long int batches;
+		unsigned long int errorRow;		//line (CSV) or row (binary) of the first unreadable input, counting from 1. 0 if none
+		char mapped;
+	} BulkPredictor;
+
+	/** Blocking client, mostly for tests and tools. Requests may be pipelined with send and receive. */
+	typedef struct {
+		int fd;
+		uint32_t nextId;
+	} InferenceClient;
+
+
+
+//FUNCTIONS
+	void SharedModel_init(SharedModel* this, NeuralNetwork* initial);
+	void SharedModel_deinit(SharedModel* this);
+	int SharedModel_register(SharedModel* this);
+	void SharedModel_unregister(SharedModel* this, int slot);
+	NeuralNetwork* SharedModel_acquire(SharedModel* this, int slot);
+	void SharedModel_release(SharedModel* this, int slot);
+	char SharedModel_publish(SharedModel* this, NeuralNetwork* network);
+	char SharedModel_publishCopy(SharedModel* this, NeuralNetwork* source);
+	char SharedModel_publishWeights(SharedModel* this, NeuralNetwork* source);
+
+	void ModelWatcher_init(ModelWatcher* this, SharedModel* model, const char* path, unsigned int intervalMs);
+	void ModelWatcher_deinit(ModelWatcher* this);
+	char ModelWatcher_check(ModelWatcher* this);
+
+	char InferenceServer_init(InferenceServer* this, SharedModel* model, unsigned int maxBatch, unsigned int maxDelayUs, unsigned int queueCapacity);
+	void InferenceServer_deinit(InferenceServer* this);
+	char InferenceServer_listenUnix(InferenceServer* this, const char* path);
+	char InferenceServer_listenTcp(InferenceServer* this, unsigned short int port);
+	void InferenceServer_stop(InferenceServer* this);
+	void InferenceServer_getStats(InferenceServer* this, InferenceServerStats* target, unsigned long int* batchSizes);
+	unsigned long int InferenceServer_latencyPercentile(InferenceServerStats* stats, double percentile);
+	void InferenceServer_printStats(InferenceServer* this, FILE* out);
+
+	void BulkPredictor_init(BulkPredictor* this, NeuralNetwork* network, unsigned char inputFormat, unsigned char outputFormat, unsigned int batchSize);
+	char BulkPredictor_run(BulkPredictor* this, int inputFd, FILE* out);
+
+	char InferenceSocket_readAll(int fd, void* target, unsigned long int size);
+	char InferenceSocket_sendMessage(int fd, InferenceMessageHeader* header, const NeuronUnit* units);
+
+	char InferenceClient_connectUnix(InferenceClient* this, const char* path);
+	char InferenceClient_connectTcp(InferenceClient* this, unsigned short int port);
+	void InferenceClient_close(InferenceClient* this);
+	long int InferenceClient_send(InferenceClient* this, const NeuronUnit* inputs, unsigned short int inputCount);
+	int InferenceClient_receive(InferenceClient* this, uint32_t* id, NeuronUnit* outputs, unsigned short int maxOutputs);
+	int InferenceClient_predict(InferenceClient* this, const NeuronUnit* inputs, unsigned short int inputCount, NeuronUnit* outputs, unsigned short int outputCount);
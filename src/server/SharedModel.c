@@ -0,0 +1,216 @@
+#include "InferenceServer.h"
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+//LIFECYCLE
+	/** Starts with a copy of initial. The copy belongs to the model, initial stays with the caller. */
+	void SharedModel_init(SharedModel* this, NeuralNetwork* initial) {
+		NeuralNetwork *copy = malloc(sizeof(NeuralNetwork));
+		NeuralNetwork_initCopy(copy, initial);
+		atomic_init(&this->current, copy);
+		atomic_init(&this->version, 1);
+		for (unsigned int i = 0; i < SharedModel_MAX_READERS; ++i) {
+			atomic_init(&this->readers[i].network, NULL);
+			atomic_init(&this->readers[i].used, 0);
+		}
+		this->inputCount = initial->layers[0].neuronCount;
+		this->outputCount = initial->layers[initial->layerCount - 1].neuronCount;
+		pthread_mutex_init(&this->publishLock, NULL);
+		this->spare = NULL;
+	}
+
+	/** Call once every reader is gone. */
+	void SharedModel_deinit(SharedModel* this) {
+		NeuralNetwork *current = atomic_load(&this->current);
+		NeuralNetwork_deinit(current);
+		free(current);
+		if (this->spare) {
+			NeuralNetwork_deinit(this->spare);
+			free(this->spare);
+		}
+		pthread_mutex_destroy(&this->publishLock);
+	}
+
+
+
+//READERS
+	/** Gives the calling reader a slot. Every thread that predicts needs its own. Returns -1 if all slots are taken. */
+	int SharedModel_register(SharedModel* this) {
+		for (int i = 0; i < SharedModel_MAX_READERS; ++i) {
+			char unused = 0;
+			if (atomic_compare_exchange_strong(&this->readers[i].used, &unused, 1)) return i;
+		}
+		return -1;
+	}
+
+	void SharedModel_unregister(SharedModel* this, int slot) {
+		atomic_store(&this->readers[slot].network, NULL);
+		atomic_store(&this->readers[slot].used, 0);
+	}
+
+	/** The current network, which stays alive until SharedModel_release, even if a newer one is published meanwhile.
+	 * It is shared between readers: only use functions that read it, like NeuralNetwork_predictBatch. */
+	NeuralNetwork* SharedModel_acquire(SharedModel* this, int slot) {
+		NeuralNetwork *network;
+		do {
+			network = atomic_load(&this->current);
+			atomic_store(&this->readers[slot].network, network);
+		} while (network != atomic_load(&this->current)); //published meanwhile: the publisher may not have seen our slot
+		return network;
+	}
+
+	void SharedModel_release(SharedModel* this, int slot) {
+		atomic_store(&this->readers[slot].network, NULL);
+	}
+
+
+
+//WRITERS
+	/** Makes network the current one, and returns the previous one once no reader holds it anymore. Call with publishLock held. */
+	static NeuralNetwork* SharedModel_swap(SharedModel* this, NeuralNetwork* network) {
+		NeuralNetwork *previous = atomic_exchange(&this->current, network);
+		atomic_fetch_add(&this->version, 1);
+
+		//grace period: new readers only see the new network, so wait for the ones that still hold the previous
+		for (unsigned int i = 0; i < SharedModel_MAX_READERS; ++i) {
+			while (atomic_load(&this->readers[i].network) == previous) sched_yield();
+		}
+		return previous;
+	}
+
+	/** Makes network the current one, and frees the previous one once no reader holds it anymore.
+	 * network must come from malloc, and belongs to the model from now on.
+	 * Returns 0 (and frees network) if its inputs or outputs differ from the current one. */
+	char SharedModel_publish(SharedModel* this, NeuralNetwork* network) {
+		if (network->layers[0].neuronCount != this->inputCount || network->layers[network->layerCount - 1].neuronCount != this->outputCount) {
+			NeuralNetwork_deinit(network);
+			free(network);
+			return 0;
+		}
+
+		pthread_mutex_lock(&this->publishLock);
+		NeuralNetwork *previous = SharedModel_swap(this, network);
+		pthread_mutex_unlock(&this->publishLock);
+
+		NeuralNetwork_deinit(previous);
+		free(previous);
+		return 1;
+	}
+
+	/** Publishes a copy of source. source stays with the caller, who may keep training it. */
+	char SharedModel_publishCopy(SharedModel* this, NeuralNetwork* source) {
+		NeuralNetwork *copy = malloc(sizeof(NeuralNetwork));
+		NeuralNetwork_initCopy(copy, source);
+		return SharedModel_publish(this, copy);
+	}
+
+	/** Publishes the weights of source, double buffered: they are copied into the network that the previous publication replaced,
+	 * so that a trainer can publish often without allocating. source stays with the caller.
+	 * Returns 0 if its inputs or outputs differ from the current one. */
+	char SharedModel_publishWeights(SharedModel* this, NeuralNetwork* source) {
+		if (source->layers[0].neuronCount != this->inputCount || source->layers[source->layerCount - 1].neuronCount != this->outputCount) return 0;
+
+		pthread_mutex_lock(&this->publishLock);
+		NeuralNetwork *next = this->spare;
+		if (next != NULL && NeuralNetwork_sameTopology(next, source)) {
+			for (unsigned long int i = source->synapseCount; i--;) next->synapses[i].weight = source->synapses[i].weight;
+		}
+		else {
+			if (next != NULL) NeuralNetwork_deinit(next);
+			else next = malloc(sizeof(NeuralNetwork));
+			NeuralNetwork_initCopy(next, source);
+		}
+
+		this->spare = SharedModel_swap(this, next);
+		pthread_mutex_unlock(&this->publishLock);
+		return 1;
+	}
+
+
+
+//WATCHER
+	/** Whether the file changed since the last look. Files are replaced by rename, so the inode changes too. */
+	static char ModelWatcher_changed(ModelWatcher* this) {
+		struct stat info;
+		if (stat(this->path, &info) != 0) return 0;
+
+		char changed = info.st_ino != this->inode || info.st_size != this->size
+			|| info.st_mtim.tv_sec != this->modified.tv_sec || info.st_mtim.tv_nsec != this->modified.tv_nsec;
+		this->inode = info.st_ino;
+		this->size = info.st_size;
+		this->modified = info.st_mtim;
+		return changed;
+	}
+
+	/** Loads the file if it changed. Returns 1 if a new network was published. */
+	char ModelWatcher_check(ModelWatcher* this) {
+		if (!ModelWatcher_changed(this)) return 0;
+
+		NeuralNetwork *network = malloc(sizeof(NeuralNetwork));
+		char published = NeuralNetwork_load(network, this->path);
+		if (published) published = SharedModel_publish(this->model, network);
+		else free(network);
+
+		if (published) atomic_fetch_add(&this->loads, 1);
+		else atomic_fetch_add(&this->failures, 1); //incomplete, corrupt or incompatible: keep serving the current one
+		return published;
+	}
+
+	static void* ModelWatcher_run(void* arg) {
+		ModelWatcher *this = arg;
+
+		pthread_mutex_lock(&this->lock);
+		while (this->running) {
+			pthread_mutex_unlock(&this->lock);
+			ModelWatcher_check(this);
+			pthread_mutex_lock(&this->lock);
+
+			struct timespec until;
+			clock_gettime(CLOCK_MONOTONIC, &until);
+			unsigned long int nanoseconds = until.tv_nsec + this->intervalMs * 1000000UL;
+			until.tv_sec += nanoseconds / 1000000000UL;
+			until.tv_nsec = nanoseconds % 1000000000UL;
+			if (this->running) pthread_cond_timedwait(&this->wakeUp, &this->lock, &until);
+		}
+		pthread_mutex_unlock(&this->lock);
+		return NULL;
+	}
+
+	/** Publishes path into model every time the file changes from now on. */
+	void ModelWatcher_init(ModelWatcher* this, SharedModel* model, const char* path, unsigned int intervalMs) {
+		this->model = model;
+		this->path = strdup(path);
+		this->intervalMs = intervalMs;
+		this->inode = 0;
+		this->size = -1;
+		this->modified.tv_sec = 0;
+		this->modified.tv_nsec = 0;
+		atomic_init(&this->loads, 0);
+		atomic_init(&this->failures, 0);
+		ModelWatcher_changed(this);
+
+		pthread_mutex_init(&this->lock, NULL);
+		pthread_condattr_t conditionAttributes;
+		pthread_condattr_init(&conditionAttributes);
+		pthread_condattr_setclock(&conditionAttributes, CLOCK_MONOTONIC);
+		pthread_cond_init(&this->wakeUp, &conditionAttributes);
+		pthread_condattr_destroy(&conditionAttributes);
+
+		this->running = 1;
+		pthread_create(&this->thread, NULL, ModelWatcher_run, this);
+	}
+
+	void ModelWatcher_deinit(ModelWatcher* this) {
+		pthread_mutex_lock(&this->lock);
+		this->running = 0;
+		pthread_cond_signal(&this->wakeUp);
+		pthread_mutex_unlock(&this->lock);
+		pthread_join(this->thread, NULL);
+
+		pthread_mutex_destroy(&this->lock);
+		pthread_cond_destroy(&this->wakeUp);
+		free(this->path);
+	}
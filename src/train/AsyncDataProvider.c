@@ -0,0 +1,204 @@
+#include "NetworkTrain.h"
+#include <stdlib.h>
+#include <sched.h>
+
+
+//SAMPLE RING
+	void SampleRing_init(SampleRing* this, unsigned int capacity, unsigned int rowSize) {
+		unsigned long int size = 1;
+		while (size < capacity) size <<= 1;
+
+		this->slots = malloc(size * rowSize * sizeof(NeuronUnit));
+		this->mask = size - 1;
+		this->rowSize = rowSize;
+		atomic_init(&this->head, 0);
+		atomic_init(&this->tail, 0);
+		atomic_init(&this->fullWaits, 0);
+	}
+
+	void SampleRing_deinit(SampleRing* this) {
+		free(this->slots);
+	}
+
+	/** Returns the slot to be filled by the producer, or NULL if the ring is full. */
+	NeuronUnit* SampleRing_reserve(SampleRing* this) {
+		unsigned long int tail = atomic_load_explicit(&this->tail, memory_order_relaxed);
+		unsigned long int head = atomic_load_explicit(&this->head, memory_order_acquire);
+		if (tail - head > this->mask) return NULL;
+
+		return this->slots + (tail & this->mask) * this->rowSize;
+	}
+
+	/** Publishes the slot returned by the last SampleRing_reserve. */
+	void SampleRing_commit(SampleRing* this) {
+		unsigned long int tail = atomic_load_explicit(&this->tail, memory_order_relaxed);
+		atomic_store_explicit(&this->tail, tail + 1, memory_order_release);
+	}
+
+	/** Returns the oldest published slot, or NULL if the ring is empty. */
+	const NeuronUnit* SampleRing_peek(SampleRing* this) {
+		unsigned long int head = atomic_load_explicit(&this->head, memory_order_relaxed);
+		unsigned long int tail = atomic_load_explicit(&this->tail, memory_order_acquire);
+		if (head == tail) return NULL;
+
+		return this->slots + (head & this->mask) * this->rowSize;
+	}
+
+	/** Gives the slot returned by the last SampleRing_peek back to the producer. */
+	void SampleRing_release(SampleRing* this) {
+		unsigned long int head = atomic_load_explicit(&this->head, memory_order_relaxed);
+		atomic_store_explicit(&this->head, head + 1, memory_order_release);
+	}
+
+	unsigned long int SampleRing_occupancy(SampleRing* this) {
+		unsigned long int tail = atomic_load_explicit(&this->tail, memory_order_acquire);
+		unsigned long int head = atomic_load_explicit(&this->head, memory_order_acquire);
+		return tail - head;
+	}
+
+
+
+//PRODUCERS
+	static void* AsyncDataProvider_produce(void* arg) {
+		AsyncProducer *producer = (AsyncProducer*) arg;
+		AsyncDataProvider *this = producer->owner;
+		SampleRing *ring = this->rings + producer->index;
+		unsigned short int inputCount = this->inputCount;
+		Tracer_nameThread("producer");
+
+		while (atomic_load_explicit(&this->running, memory_order_relaxed)) {
+			NeuronUnit *slot = SampleRing_reserve(ring);
+			if (slot == NULL) {
+				atomic_fetch_add_explicit(&ring->fullWaits, 1, memory_order_relaxed);
+				sched_yield();
+				continue;
+			}
+
+			Tracer_BEGIN("generate");
+			char generated = this->generate(this->context, producer->index, slot, slot + inputCount);
+			Tracer_END("generate");
+			if (!generated) break;
+			SampleRing_commit(ring);
+		}
+
+		atomic_store_explicit(&producer->finished, 1, memory_order_release);
+		return NULL;
+	}
+
+
+
+//CONSUMER
+	static char AsyncDataProvider_provideInput(TrainDataProvider* provider, NeuralNetwork* net) {
+		provider->counter++;
+		if (provider->counter > provider->maxResults) return 0;
+
+		AsyncDataProvider *this = (AsyncDataProvider*) provider->source;
+		unsigned int producerCount = this->producerCount;
+
+		while (1) {
+			char allFinished = 1;
+			for (unsigned int i = 0; i < producerCount; ++i) {
+				unsigned int ringIndex = (this->nextRing + i) % producerCount;
+				SampleRing *ring = this->rings + ringIndex;
+
+				const NeuronUnit *row = SampleRing_peek(ring);
+				if (row == NULL) {
+					if (!atomic_load_explicit(&this->producers[ringIndex].finished, memory_order_acquire)) allFinished = 0;
+					else if (SampleRing_occupancy(ring) != 0) allFinished = 0; //published right before finishing
+					continue;
+				}
+
+				Neuron *inputs = net->layers[0].neurons;
+				for (unsigned short int k = this->inputCount; k--;) inputs[k].out = row[k];
+				for (unsigned short int k = this->outputCount; k--;) provider->expected[k] = row[this->inputCount + k];
+
+				this->occupancySum += (NeuronUnit) SampleRing_occupancy(ring) / (ring->mask + 1);
+				SampleRing_release(ring);
+				this->nextRing = (ringIndex + 1) % producerCount;
+				return 1;
+			}
+
+			if (allFinished) return 0;
+			this->consumerWaits++;
+			sched_yield();
+		}
+	}
+
+
+
+//LIFE CIRCLE
+	void AsyncDataProvider_init(
+			AsyncDataProvider* this,
+			char (*generate)(void *context, unsigned int producerIndex, NeuronUnit *input, NeuronUnit *expected),
+			void *context,
+			unsigned short int inputCount,
+			unsigned short int outputCount,
+			unsigned int producerCount,
+			unsigned int ringCapacity,
+			unsigned int maxResults) {
+		TrainDataProvider_init(&this->provider, *AsyncDataProvider_provideInput, outputCount, maxResults);
+		this->provider.source = this;
+
+		this->generate = generate;
+		this->context = context;
+		this->inputCount = inputCount;
+		this->outputCount = outputCount;
+		this->producerCount = producerCount;
+		this->nextRing = 0;
+		this->consumerWaits = 0;
+		this->occupancySum = 0;
+
+		this->rings = aligned_alloc(64, producerCount * sizeof(SampleRing));
+		this->producers = malloc(producerCount * sizeof(AsyncProducer));
+		this->threads = malloc(producerCount * sizeof(pthread_t));
+		atomic_init(&this->running, 1);
+
+		for (unsigned int i = 0; i < producerCount; ++i) {
+			SampleRing_init(this->rings + i, ringCapacity, inputCount + outputCount);
+			this->producers[i].owner = this;
+			this->producers[i].index = i;
+			atomic_init(&this->producers[i].finished, 0);
+		}
+
+		for (unsigned int i = 0; i < producerCount; ++i) {
+			pthread_create(this->threads + i, NULL, AsyncDataProvider_produce, this->producers + i);
+		}
+	}
+
+	void AsyncDataProvider_deinit(AsyncDataProvider* this) {
+		atomic_store(&this->running, 0);
+		for (unsigned int i = 0; i < this->producerCount; ++i) pthread_join(this->threads[i], NULL);
+		for (unsigned int i = 0; i < this->producerCount; ++i) SampleRing_deinit(this->rings + i);
+
+		free(this->threads);
+		free(this->producers);
+		free(this->rings);
+		TrainDataProvider_deinit(&this->provider);
+	}
+
+
+
+//STATS
+	void AsyncDataProvider_getStats(AsyncDataProvider* this, AsyncDataProviderStats* stats) {
+		unsigned long int consumed = 0, producerWaits = 0;
+		for (unsigned int i = 0; i < this->producerCount; ++i) {
+			SampleRing *ring = this->rings + i;
+			consumed += atomic_load(&ring->head);
+			producerWaits += atomic_load_explicit(&ring->fullWaits, memory_order_relaxed);
+		}
+
+		stats->consumed = consumed;
+		stats->consumerWaits = this->consumerWaits;
+		stats->producerWaits = producerWaits;
+		stats->meanOccupancy = consumed == 0? 0 : this->occupancySum / consumed;
+		stats->capacity = this->producerCount == 0? 0 : this->rings[0].mask + 1;
+	}
+
+	void AsyncDataProvider_printStats(AsyncDataProvider* this, FILE* out) {
+		AsyncDataProviderStats stats;
+		AsyncDataProvider_getStats(this, &stats);
+
+		fprintf(out, "Producers: %u   Ring capacity: %u\n", this->producerCount, stats.capacity);
+		fprintf(out, "Consumed: %lu   Mean occupancy: %1.1f%%\n", stats.consumed, stats.meanOccupancy * 100);
+		fprintf(out, "Trainer waits (rings empty): %lu   Producer waits (rings full): %lu\n", stats.consumerWaits, stats.producerWaits);
+	}
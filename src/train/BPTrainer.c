@@ -1,5 +1,6 @@
 #include "NetworkTrain.h"
 #include <stdlib.h>
+#include <math.h>
 
 void BPTrainer_init(
 		BPTrainer* this,
@@ -7,7 +8,7 @@ void BPTrainer_init(
 		TrainDataProvider *provider,
 		void (*errorUpdater)(NeuralNetwork* net, NeuronUnit* expected, NeuronUnit* errorValue, NeuronUnit* errorGradients)) {
 	this->network = network;
-	this->isTraining = 0;
+	atomic_init(&this->isTraining, 0);
 
 	this->start.weights = (NeuronUnit*) malloc(network->synapseCount * sizeof(NeuronUnit));
 	this->minimum.weights = (NeuronUnit*) malloc(network->synapseCount * sizeof(NeuronUnit));
@@ -15,13 +16,58 @@ void BPTrainer_init(
 
 	this->provider = provider;
 	this->errorUpdater = errorUpdater;
+	Optimizer_init(&this->optimizer, Optimizer_SGD, network->synapseCount);
+
+	this->batchSchedule = NULL;
+	this->metrics = NULL;
+	this->metricsEvery = 100;
+
+	this->lossSmoothing = 0.01;
+	this->snapshotEvery = 1000;
+	this->snapshotCount = 0;
+
+	this->hook = NULL;
+	this->hookContext = NULL;
+	this->hookEvery = 1;
+	this->lastHook = 0;
+
+	this->checkpointer = NULL;
+	this->resumeRun = 0;
 }
 
 void BPTrainer_deinit(BPTrainer* this) {
+	Optimizer_deinit(&this->optimizer);
 	free(this->minimum.weights);
 	free(this->start.weights);
 }
 
+/** Replaces the update rule of the trainer. The learning rate given to the train functions still applies. */
+void BPTrainer_setOptimizer(BPTrainer* this, unsigned char optimizerType) {
+	Optimizer_deinit(&this->optimizer);
+	Optimizer_init(&this->optimizer, optimizerType, this->network->synapseCount);
+}
+
+/** The best weights are judged on an exponential moving average of the loss, and copied at most once every snapshotEvery samples.
+ * lossSmoothing = 1 and snapshotEvery = 0 give the raw per update minimum. */
+void BPTrainer_setBestTracking(BPTrainer* this, NeuronUnit lossSmoothing, unsigned int snapshotEvery) {
+	this->lossSmoothing = lossSmoothing <= 0 || lossSmoothing > 1? 1 : lossSmoothing;
+	this->snapshotEvery = snapshotEvery;
+}
+
+/** hook runs on the training thread every `every` samples (or at the next weight update after them), between two updates.
+ * It may read the network, or block to pause the training. NULL removes it. */
+void BPTrainer_setHook(BPTrainer* this, void (*hook)(BPTrainer* trainer, void* context), void* context, unsigned int every) {
+	this->hook = hook;
+	this->hookContext = context;
+	this->hookEvery = every == 0? 1 : every;
+}
+
+/** Reports the mean loss of every `every` samples to metrics. NULL turns the reporting off. */
+void BPTrainer_setMetrics(BPTrainer* this, MetricsSink* metrics, unsigned int every) {
+	this->metrics = metrics;
+	this->metricsEvery = every == 0? 1 : every;
+}
+
 
 //UTILS
 	static void zeroOut(NeuronUnit* target, unsigned int length) {
@@ -31,6 +77,61 @@ void BPTrainer_deinit(BPTrainer* this) {
 		}
 	}
 
+	/** Squared norm of the mean gradient, given the sum of sampleCount gradients. */
+	static NeuronUnit meanGradientSquare(NeuronUnit* gradientSum, unsigned long int length, unsigned int sampleCount) {
+		NeuronUnit sum = 0;
+		for (unsigned long int i = 0; i < length; ++i) sum += gradientSum[i] * gradientSum[i];
+		return sum / ((NeuronUnit) sampleCount * sampleCount);
+	}
+
+	typedef struct {
+		unsigned int count;
+		NeuronUnit lossSum;
+	} Progress;
+
+	static void reportProgress(BPTrainer* this, Progress* progress, NeuronUnit loss) {
+		progress->count++;
+		progress->lossSum += loss;
+		if (progress->count < this->metricsEvery) return;
+
+		MetricsSink_record(this->metrics, this->samplesSeen, progress->lossSum / progress->count, this->minimum.error, this->optimizer.learningRate);
+		progress->count = 0;
+		progress->lossSum = 0;
+	}
+
+	static void finishProgress(BPTrainer* this, Progress* progress) {
+		if (this->metrics == NULL) return;
+		if (progress->count > 0) {
+			MetricsSink_record(this->metrics, this->samplesSeen, progress->lossSum / progress->count, this->minimum.error, this->optimizer.learningRate);
+		}
+		MetricsSink_flush(this->metrics);
+	}
+
+
+	/** Adds the mean loss of sampleCount samples to the moving average. */
+	static void smoothLoss(BPTrainer* this, NeuronUnit loss, unsigned int sampleCount) {
+		NeuronUnit keep = sampleCount == 1? 1 - this->lossSmoothing : pow(1 - this->lossSmoothing, sampleCount);
+		this->smoothedLoss = keep * this->smoothedLoss + (1 - keep) * loss;
+		this->smoothedWeight = keep * this->smoothedWeight + (1 - keep);
+	}
+
+	/** Copies the weights if the smoothed loss is a new minimum. Between checks the copy is deferred, so it happens at most once per snapshotEvery samples. */
+	static void updateMinimum(BPTrainer* this, char force) {
+		unsigned long int samples = this->samplesSeen;
+		if (!force && samples - this->lastSnapshotCheck < this->snapshotEvery) return;
+		if (this->smoothedWeight == 0) return;
+		this->lastSnapshotCheck = samples;
+
+		NeuronUnit loss = this->smoothedLoss / this->smoothedWeight;
+		if (loss >= this->minimum.error) return;
+
+		Tracer_BEGIN("snapshot");
+		this->minimum.error = loss;
+		NeuralNetwork_saveSynapseWeights(this->network, this->minimum.weights);
+		this->snapshotCount++;
+		Tracer_END("snapshot");
+	}
+
 	static void printDebugInfo(BPTrainer* this, NeuronUnit errorValue) {
 		NetworkLayer *inp = this->network->layers;
 		NetworkLayer *out = this->network->layers + this->network->layerCount - 1;
@@ -49,132 +150,212 @@ void BPTrainer_deinit(BPTrainer* this) {
 
 
 
+//RUNS
+	/** Starts a new run: resets the optimizer state, the sample count and the smoothed loss.
+	 * BPTrainer_runOnline and BPTrainer_runStochastic can then be called repeatedly (e.g. once per epoch) and continue from where they stopped.
+	 * After BPTrainer_restoreCheckpoint, the optimizer state and the sample count of the checkpoint are kept instead. */
+	void BPTrainer_beginRun(BPTrainer* this) {
+		if (this->resumeRun) this->resumeRun = 0;
+		else {
+			Optimizer_reset(&this->optimizer);
+			this->samplesSeen = 0;
+		}
+		this->smoothedLoss = 0;
+		this->smoothedWeight = 0;
+		this->lastSnapshotCheck = 0;
+		this->lastHook = 0;
+		if (this->batchSchedule) BatchSizeSchedule_reset(this->batchSchedule);
+		if (this->metrics) MetricsSink_beginRun(this->metrics);
+	}
+
+	/** Ends the current run after the sample in progress. Can be called from another thread. */
+	void BPTrainer_stopTraining(BPTrainer* this) {
+		atomic_store(&this->isTraining, 0);
+	}
+
+	static void callHook(BPTrainer* this) {
+		if (this->samplesSeen - this->lastHook < this->hookEvery) return;
+		this->lastHook = this->samplesSeen;
+		this->hook(this, this->hookContext);
+	}
+
+
+
 //ONLINE TRAINING
+	/** Sets the learning rate and the momentum of the optimizer, unless they are Optimizer_KEEP. */
+	static void BPTrainer_setRates(BPTrainer* this, NeuronUnit learningRate, NeuronUnit momentum) {
+		if (learningRate != Optimizer_KEEP) this->optimizer.learningRate = learningRate;
+		if (momentum != Optimizer_KEEP) this->optimizer.momentum = momentum;
+	}
+
+	/** Trains on the provider in a new run: the state of the optimizer (velocities, Adam moments, RMSProp and AdaGrad sums) restarts from 0.
+	 * learningRate and momentum replace those of the optimizer, unless they are Optimizer_KEEP. */
 	void BPTrainer_trainOnline(BPTrainer* this, NeuronUnit learningRate, NeuronUnit momentum, char debug) {
-		NeuralNetwork *network = this->network;
-		NeuronUnit* adjustment2 = malloc(network->synapseCount * sizeof(NeuronUnit));
-		NeuronUnit* adjustment1 = malloc(network->synapseCount * sizeof(NeuronUnit));
-		NeuronUnit* errorDerivatives = malloc(network->synapseCount * sizeof(NeuronUnit));
+		BPTrainer_setRates(this, learningRate, momentum);
+		BPTrainer_beginRun(this);
+		BPTrainer_runOnline(this, debug);
+	}
 
-		NeuronUnit* lastAdjustment = adjustment1;
-		NeuronUnit errorValue=0;
+	/** Trains until the provider runs out of samples, with the current learning rate. Returns the mean loss of the samples seen. */
+	NeuronUnit BPTrainer_runOnline(BPTrainer* this, char debug) {
+		NeuralNetwork *network = this->network;
+		NetworkLayer *outputLayer = network->layers + network->layerCount-1;
+		NeuronUnit* gradient = malloc(network->synapseCount * sizeof(NeuronUnit));
+		NeuronUnit* errorDerivatives = malloc(outputLayer->neuronCount * sizeof(NeuronUnit));
+		NeuronUnit errorValue=0, errorValueSum = 0;
+		unsigned long int runSamples = 0;
 
-		zeroOut(errorDerivatives, network->synapseCount);
-		zeroOut(adjustment1, network->synapseCount);
-		zeroOut(adjustment2, network->synapseCount);
+		zeroOut(errorDerivatives, outputLayer->neuronCount);
 
+		Optimizer *optimizer = &this->optimizer;
 		TrainDataProvider* provider = this->provider;
 		char (*provideFunc)(TrainDataProvider*, NeuralNetwork*) = provider->provideInput;
 
-		this->isTraining = 1;
-		while(this->isTraining) {
+		Progress progress = {0, 0};
+		atomic_store(&this->isTraining, 1);
+		Tracer_nameThread("trainer");
+		while(atomic_load_explicit(&this->isTraining, memory_order_relaxed)) {
+			Tracer_BEGIN("provide");
 			char hasNext = provideFunc(provider, network);
+			Tracer_END("provide");
 			if (hasNext==0) break;
 
 			//see current error
+			Tracer_BEGIN("forward");
 			NeuralNetwork_predict(network);
+			Tracer_END("forward");
+			Tracer_BEGIN("error");
 			this->errorUpdater(this->network, provider->expected, &errorValue, errorDerivatives);
+			Tracer_END("error");
 			if (debug) printDebugInfo(this, errorValue);
-
-
-			//is it a new minimum? If so, save it.
-			if (errorValue < this->minimum.error) {
-				this->minimum.error = errorValue;
-				printf("Minimum error found: %f\n", errorValue);
-				NeuralNetwork_saveSynapseWeights(network, this->minimum.weights);
-			}
-
-			//calculate adjustment
-			NeuronUnit *currentAdjustment = (lastAdjustment == adjustment1)? adjustment2 : adjustment1;
-			NeuralNetwork_saveGradient(network, errorDerivatives, currentAdjustment);
-
-			for (unsigned int i = network->synapseCount; i--;) {
-				currentAdjustment[i] = - currentAdjustment[i]*learningRate + lastAdjustment[i]*momentum;
-			}
-
-			NeuralNetwork_adjustWeights(network, currentAdjustment);
-			lastAdjustment = currentAdjustment;
+			errorValueSum += errorValue;
+			runSamples++;
+
+
+			//is it a new minimum? If so, save it (or wait for the next check).
+			this->samplesSeen++;
+			smoothLoss(this, errorValue, 1);
+			updateMinimum(this, 0);
+			if (this->metrics) reportProgress(this, &progress, errorValue);
+
+			//calculate gradient and update the weights in one pass
+			Tracer_BEGIN("backward");
+			NeuralNetwork_saveGradient(network, errorDerivatives, gradient);
+			Tracer_END("backward");
+			Tracer_BEGIN("update");
+			Optimizer_step(optimizer, network, gradient, 1);
+			Tracer_END("update");
+			if (this->hook) callHook(this);
+			if (this->checkpointer) Checkpointer_check(this->checkpointer, this);
 		}
+		updateMinimum(this, 1);
+		finishProgress(this, &progress);
 
 		//clean up
 		free(errorDerivatives);
-		free(adjustment1);
-		free(adjustment2);
+		free(gradient);
+		return runSamples == 0? 0 : errorValueSum / runSamples;
 	}
 
 //STOCHASTIC TRAINING
+	/** Same as BPTrainer_trainOnline, with a weight update every updateEvery samples. */
 	void BPTrainer_trainStochastic(BPTrainer* this, unsigned int updateEvery, NeuronUnit learningRate, NeuronUnit momentum, char debug) {
+		BPTrainer_setRates(this, learningRate, momentum);
+		BPTrainer_beginRun(this);
+		BPTrainer_runStochastic(this, updateEvery, debug);
+	}
+
+	/** Trains until the provider runs out of samples, updating the weights every updateEvery samples. Returns the mean loss of the samples seen. */
+	NeuronUnit BPTrainer_runStochastic(BPTrainer* this, unsigned int updateEvery, char debug) {
 		NeuralNetwork *network = this->network;
 		NetworkLayer *outputLayer = network->layers + network->layerCount-1;
 
-		NeuronUnit* adjustment2 = malloc(network->synapseCount * sizeof(NeuronUnit));
-		NeuronUnit* adjustment1 = malloc(network->synapseCount * sizeof(NeuronUnit));
-		NeuronUnit* currentErrorDerivatives = malloc(outputLayer->synapseCount * sizeof(NeuronUnit));
-
-		NeuronUnit *lastAdjustment = adjustment1,
-					*currentAdjustment = adjustment2;
-		NeuronUnit currentErrorValue, errorValueSum = 0;;
+		NeuronUnit* gradient = malloc(network->synapseCount * sizeof(NeuronUnit));
+		NeuronUnit* currentErrorDerivatives = malloc(outputLayer->neuronCount * sizeof(NeuronUnit));
+		NeuronUnit currentErrorValue, errorValueSum = 0, runErrorSum = 0;
+		unsigned long int runSamples = 0;
 
-		zeroOut(currentErrorDerivatives, network->synapseCount);
-		zeroOut(adjustment1, network->synapseCount);
-		zeroOut(adjustment2, network->synapseCount);
+		zeroOut(currentErrorDerivatives, outputLayer->neuronCount);
+		zeroOut(gradient, network->synapseCount);
 
+		Optimizer *optimizer = &this->optimizer;
 		TrainDataProvider* provider = this->provider;
 		char (*provideFunc)(TrainDataProvider*, NeuralNetwork*) = provider->provideInput;
 		unsigned int counter = 1;
+		Progress progress = {0, 0};
+
+		//adaptive batch size: the learning rate is scaled with it for this run only
+		BatchSizeSchedule *schedule = this->batchSchedule;
+		char estimateNoise = schedule != NULL && schedule->mode == BatchSizeSchedule_NOISE;
+		NeuronUnit baseLearningRate = optimizer->learningRate, halfBatchSquare = 0;
+		if (schedule) {
+			updateEvery = schedule->batchSize;
+			optimizer->learningRate = baseLearningRate * BatchSizeSchedule_learningRateFactor(schedule);
+		}
 
-		this->isTraining = 1;
-		while(this->isTraining) {
+		atomic_store(&this->isTraining, 1);
+		Tracer_nameThread("trainer");
+		while(atomic_load_explicit(&this->isTraining, memory_order_relaxed)) {
+			Tracer_BEGIN("provide");
 			char hasNext = provideFunc(provider, network);
+			Tracer_END("provide");
 			if (hasNext==0) break;
 
 			//see current error
+			Tracer_BEGIN("forward");
 			NeuralNetwork_predict(network);
+			Tracer_END("forward");
+			Tracer_BEGIN("error");
 			this->errorUpdater(this->network, provider->expected, &currentErrorValue, currentErrorDerivatives);
+			Tracer_END("error");
 			errorValueSum += currentErrorValue;
+			runErrorSum += currentErrorValue;
+			runSamples++;
 			if (debug) printDebugInfo(this, currentErrorValue);
+			if (this->metrics) reportProgress(this, &progress, currentErrorValue);
 
-			//calculate adjustment
-			NeuralNetwork_addToGradient(network, currentErrorDerivatives, currentAdjustment);
-
-			/*printf("Input:\n  ");
-			for (int i=0; i<network->layers[0].neuronCount; ++i) printf("%1.2f ", network->layers[0].neurons[i].out);
-			printf("Expected: %1.2f     FOUND: %1.2f\n", provider->expected[0], network->layers[network->layerCount-1].neurons[0].out);
-			printf("\ngradients:\n  ");
-			for (int i=0; i<network->synapseCount; ++i) printf("%1.2f ", currentAdjustment[i]);
-			printf("\n\n");*/
+			//accumulate gradient
+			Tracer_BEGIN("backward");
+			NeuralNetwork_addToGradient(network, currentErrorDerivatives, gradient);
+			Tracer_END("backward");
+			if (estimateNoise && counter == updateEvery / 2) halfBatchSquare = meanGradientSquare(gradient, network->synapseCount, counter);
 
 			//update
 			if (counter >= updateEvery) {
 				errorValueSum /= counter; //Average error
-				//printf("Average error:  %1.2f  (%d samples) \n", errorValueSum, counter);
-				if (errorValueSum < this->minimum.error) {
-					this->minimum.error = errorValueSum;
-					printf("Minimum error found: %f\n", errorValueSum);
-					NeuralNetwork_saveSynapseWeights(network, this->minimum.weights);
+				this->samplesSeen += counter;
+				smoothLoss(this, errorValueSum, counter);
+				updateMinimum(this, 0);
+
+				Tracer_BEGIN("update");
+				if (estimateNoise && counter >= 2) {
+					NeuronUnit fullBatchSquare = meanGradientSquare(gradient, network->synapseCount, counter);
+					BatchSizeSchedule_observe(schedule, halfBatchSquare, counter / 2, fullBatchSquare, counter);
 				}
+				Optimizer_step(optimizer, network, gradient, (NeuronUnit)1 / counter);
 
-				for (unsigned int i = network->synapseCount; i--;) {
-					currentAdjustment[i] =  - (currentAdjustment[i]/counter)*learningRate + lastAdjustment[i]*momentum;
-				}
-
-				NeuralNetwork_adjustWeights(network, currentAdjustment);
-
-				//swap adjustments and resrtart counter
-				lastAdjustment = currentAdjustment;
-				currentAdjustment = (lastAdjustment == adjustment1)? adjustment2 : adjustment1;
-
-				//zero out errors
-				zeroOut(currentAdjustment, network->synapseCount);
+				//zero out errors and restart counter
+				zeroOut(gradient, network->synapseCount);
+				Tracer_END("update");
 				errorValueSum = 0;
 				counter=1;
-				//printf("##############################\n");
+
+				if (schedule) {
+					updateEvery = BatchSizeSchedule_update(schedule, this->samplesSeen);
+					optimizer->learningRate = baseLearningRate * BatchSizeSchedule_learningRateFactor(schedule);
+				}
+				if (this->hook) callHook(this);
+				if (this->checkpointer) Checkpointer_check(this->checkpointer, this);
 			}
 			else counter++;
 		}
+		updateMinimum(this, 1);
+		finishProgress(this, &progress);
+
+		optimizer->learningRate = baseLearningRate;
 
 		//clean up
 		free(currentErrorDerivatives);
-		free(adjustment1);
-		free(adjustment2);
+		free(gradient);
+		return runSamples == 0? 0 : runErrorSum / runSamples;
 	}
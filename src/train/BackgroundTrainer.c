@@ -0,0 +1,122 @@
+#include "NetworkTrain.h"
+
+//TRAINING THREAD
+	/** Runs between two weight updates, on the training thread. */
+	static void BackgroundTrainer_hook(BPTrainer* trainer, void* context) {
+		BackgroundTrainer *this = context;
+		atomic_store(&this->samples, trainer->samplesSeen);
+		if (this->publish) {
+			this->publish(this->publishTarget, trainer->network);
+			atomic_fetch_add(&this->publications, 1);
+		}
+
+		if (atomic_load(&this->pauseRequested)) {
+			pthread_mutex_lock(&this->lock);
+			atomic_store(&this->state, BackgroundTrainer_PAUSED);
+			while (atomic_load(&this->pauseRequested) && !atomic_load(&this->stopRequested)) pthread_cond_wait(&this->resumed, &this->lock);
+			atomic_store(&this->state, BackgroundTrainer_RUNNING);
+			pthread_mutex_unlock(&this->lock);
+		}
+
+		if (atomic_load(&this->stopRequested)) BPTrainer_stopTraining(trainer);
+	}
+
+	static void* BackgroundTrainer_run(void* arg) {
+		BackgroundTrainer *this = arg;
+		BPTrainer *trainer = this->trainer;
+
+		BPTrainer_beginRun(trainer);
+		if (!atomic_load(&this->stopRequested)) {
+			this->loss = this->updateEvery == 0? BPTrainer_runOnline(trainer, 0) : BPTrainer_runStochastic(trainer, this->updateEvery, 0);
+		}
+
+		//the final weights, even if the run ended between two publications
+		atomic_store(&this->samples, trainer->samplesSeen);
+		if (this->publish) {
+			this->publish(this->publishTarget, trainer->network);
+			atomic_fetch_add(&this->publications, 1);
+		}
+		BPTrainer_setHook(trainer, NULL, NULL, 1);
+		atomic_store(&this->state, BackgroundTrainer_IDLE);
+		return NULL;
+	}
+
+
+
+//LIFE CIRCLE
+	void BackgroundTrainer_init(BackgroundTrainer* this, BPTrainer* trainer, void (*publish)(void* target, NeuralNetwork* network), void* publishTarget, unsigned int publishEvery) {
+		this->trainer = trainer;
+		this->publish = publish;
+		this->publishTarget = publishTarget;
+		this->publishEvery = publishEvery == 0? 1 : publishEvery;
+		this->updateEvery = 0;
+		this->loss = 0;
+		this->joinable = 0;
+
+		atomic_init(&this->state, BackgroundTrainer_IDLE);
+		atomic_init(&this->pauseRequested, 0);
+		atomic_init(&this->stopRequested, 0);
+		atomic_init(&this->samples, 0);
+		atomic_init(&this->publications, 0);
+		pthread_mutex_init(&this->lock, NULL);
+		pthread_cond_init(&this->resumed, NULL);
+	}
+
+	void BackgroundTrainer_deinit(BackgroundTrainer* this) {
+		BackgroundTrainer_stop(this);
+		pthread_mutex_destroy(&this->lock);
+		pthread_cond_destroy(&this->resumed);
+	}
+
+
+
+//CONTROL
+	/** Trains on the provider, as it is, on a new thread. Returns 0 if a run is still going on.
+	 * learningRate and momentum can be Optimizer_KEEP, as in BPTrainer_trainOnline.
+	 * The trainer and its network belong to the training thread until the run ends (see state, and BackgroundTrainer_wait). */
+	char BackgroundTrainer_start(BackgroundTrainer* this, unsigned int updateEvery, NeuronUnit learningRate, NeuronUnit momentum) {
+		if (atomic_load(&this->state) != BackgroundTrainer_IDLE) return 0;
+		BackgroundTrainer_wait(this);
+
+		this->updateEvery = updateEvery;
+		if (learningRate != Optimizer_KEEP) this->trainer->optimizer.learningRate = learningRate;
+		if (momentum != Optimizer_KEEP) this->trainer->optimizer.momentum = momentum;
+		BPTrainer_setHook(this->trainer, BackgroundTrainer_hook, this, this->publishEvery);
+
+		atomic_store(&this->pauseRequested, 0);
+		atomic_store(&this->stopRequested, 0);
+		atomic_store(&this->samples, 0);
+		atomic_store(&this->state, BackgroundTrainer_RUNNING);
+		pthread_create(&this->thread, NULL, BackgroundTrainer_run, this);
+		this->joinable = 1;
+		return 1;
+	}
+
+	/** The training thread stops at its next publication, and waits there. */
+	void BackgroundTrainer_pause(BackgroundTrainer* this) {
+		atomic_store(&this->pauseRequested, 1);
+	}
+
+	void BackgroundTrainer_resume(BackgroundTrainer* this) {
+		pthread_mutex_lock(&this->lock);
+		atomic_store(&this->pauseRequested, 0);
+		pthread_cond_broadcast(&this->resumed);
+		pthread_mutex_unlock(&this->lock);
+	}
+
+	/** Ends the run after the sample in progress, and waits for the training thread. */
+	void BackgroundTrainer_stop(BackgroundTrainer* this) {
+		pthread_mutex_lock(&this->lock);
+		atomic_store(&this->stopRequested, 1);
+		pthread_cond_broadcast(&this->resumed);
+		pthread_mutex_unlock(&this->lock);
+		BPTrainer_stopTraining(this->trainer);
+		BackgroundTrainer_wait(this);
+	}
+
+	/** Waits until the run ends by itself. */
+	void BackgroundTrainer_wait(BackgroundTrainer* this) {
+		if (!this->joinable) return;
+		pthread_join(this->thread, NULL);
+		this->joinable = 0;
+	}
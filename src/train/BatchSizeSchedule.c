@@ -0,0 +1,75 @@
+#include "NetworkTrain.h"
+#include <math.h>
+
+
+//LIFE CIRCLE
+	/** Defaults: STEP doubles the batch every 10000 samples. NOISE averages its estimates with an EMA weight of 0.1.
+	 * NOISE compares the first half of each batch with the whole batch, so its minBatch is at least 2. */
+	void BatchSizeSchedule_init(BatchSizeSchedule* this, unsigned char mode, unsigned int minBatch, unsigned int maxBatch, unsigned char learningRateScaling) {
+		this->mode = mode;
+		this->learningRateScaling = learningRateScaling;
+		this->minBatch = minBatch == 0? 1 : minBatch;
+		if (mode == BatchSizeSchedule_NOISE && this->minBatch < 2) this->minBatch = 2;
+		this->maxBatch = maxBatch < this->minBatch? this->minBatch : maxBatch;
+		this->growFactor = 2;
+		this->growEvery = 10000;
+		this->smoothing = 0.1;
+		BatchSizeSchedule_reset(this);
+	}
+
+	/** Back to minBatch, forgetting the noise estimates. Called by the trainer when a run begins. */
+	void BatchSizeSchedule_reset(BatchSizeSchedule* this) {
+		this->batchSize = this->minBatch;
+		this->nextGrowth = this->growEvery;
+		this->gradientSquare = 0;
+		this->noiseTrace = 0;
+		this->noiseScale = 0;
+	}
+
+
+
+//ESTIMATION
+	/** Adds one observation of the squared norms of the mean gradient, over the first half of a batch and over the whole batch.
+	 * Since E|G_b|^2 = |G|^2 + tr(S)/b, two batch sizes are enough to separate the signal |G|^2 from the noise tr(S). */
+	void BatchSizeSchedule_observe(BatchSizeSchedule* this, NeuronUnit halfBatchSquare, unsigned int halfBatch, NeuronUnit fullBatchSquare, unsigned int fullBatch) {
+		if (halfBatch == 0 || fullBatch <= halfBatch) return;
+
+		NeuronUnit gradientSquare = (fullBatch * fullBatchSquare - halfBatch * halfBatchSquare) / (fullBatch - halfBatch);
+		NeuronUnit noiseTrace = (halfBatchSquare - fullBatchSquare) / (1.0 / halfBatch - 1.0 / fullBatch);
+
+		NeuronUnit keep = 1 - this->smoothing;
+		this->gradientSquare = keep * this->gradientSquare + this->smoothing * gradientSquare;
+		this->noiseTrace = keep * this->noiseTrace + this->smoothing * noiseTrace;
+
+		//single estimates can be negative. Only their averages are meaningful
+		if (this->gradientSquare > 0 && this->noiseTrace > 0) this->noiseScale = this->noiseTrace / this->gradientSquare;
+	}
+
+	/** Returns the batch size to use after samplesSeen samples. */
+	unsigned int BatchSizeSchedule_update(BatchSizeSchedule* this, unsigned long int samplesSeen) {
+		NeuronUnit target = this->batchSize;
+
+		if (this->mode == BatchSizeSchedule_STEP) {
+			while (samplesSeen >= this->nextGrowth) {
+				target *= this->growFactor;
+				this->nextGrowth += this->growEvery;
+			}
+		}
+		else if (this->mode == BatchSizeSchedule_NOISE && this->noiseScale > 0) {
+			target = this->noiseScale;
+		}
+
+		if (target > this->maxBatch) target = this->maxBatch;
+		if (target > this->batchSize) this->batchSize = (unsigned int) target;
+		return this->batchSize;
+	}
+
+	/** Factor to apply to the learning rate, relative to the one of minBatch. */
+	NeuronUnit BatchSizeSchedule_learningRateFactor(BatchSizeSchedule* this) {
+		NeuronUnit ratio = (NeuronUnit) this->batchSize / this->minBatch;
+		switch (this->learningRateScaling) {
+			case BatchSizeSchedule_SCALE_LINEAR: return ratio;
+			case BatchSizeSchedule_SCALE_SQRT: return sqrt(ratio);
+			default: return 1;
+		}
+	}
@@ -0,0 +1,229 @@
+#include "NetworkTrain.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+//UTILS
+	/** Coarse clock: the check runs after every update, and checkpoints are seconds apart. */
+	static unsigned long int Checkpointer_now() {
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+		return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+	}
+
+	static void CheckpointStage_init(CheckpointStage* this, unsigned long int parameterCount) {
+		this->weights = malloc(parameterCount * sizeof(NeuronUnit));
+		this->extra = malloc(sizeof(CheckpointHeader) + 3 * parameterCount * sizeof(NeuronUnit));
+		this->extraSize = 0;
+	}
+
+	static void CheckpointStage_deinit(CheckpointStage* this) {
+		free(this->weights);
+		free(this->extra);
+	}
+
+
+
+//WRITER
+	static void* Checkpointer_run(void* arg) {
+		Checkpointer *this = arg;
+
+		pthread_mutex_lock(&this->lock);
+		while (1) {
+			while (this->running && !this->pending) pthread_cond_wait(&this->changed, &this->lock);
+			if (!this->pending) break; //stopped, and everything is written
+
+			CheckpointStage next = this->captured;
+			this->captured = this->writing;
+			this->writing = next;
+			this->pending = 0;
+			this->busy = 1;
+			pthread_mutex_unlock(&this->lock);
+
+			struct timespec start, end;
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			char ok = NetworkFile_write(this->path, this->network, this->writing.weights, this->writing.extra, this->writing.extraSize);
+			clock_gettime(CLOCK_MONOTONIC, &end);
+			atomic_store(&this->lastWriteNs, (end.tv_sec - start.tv_sec) * 1000000000UL + end.tv_nsec - start.tv_nsec);
+			atomic_fetch_add(ok? &this->written : &this->failures, 1);
+
+			pthread_mutex_lock(&this->lock);
+			this->busy = 0;
+			pthread_cond_broadcast(&this->changed);
+		}
+		pthread_mutex_unlock(&this->lock);
+		return NULL;
+	}
+
+
+
+//LIFECYCLE
+	/** Checkpoints of trainers of network go to path. Attach it with BPTrainer_setCheckpointer. */
+	void Checkpointer_init(Checkpointer* this, NeuralNetwork* network, const char* path, unsigned long int everySamples, NeuronUnit everySeconds) {
+		this->network = network;
+		this->path = strdup(path);
+		this->everySamples = everySamples;
+		this->everySeconds = everySeconds;
+		this->lastSamples = 0;
+		this->lastTime = Checkpointer_now();
+
+		CheckpointStage_init(&this->captured, network->synapseCount);
+		CheckpointStage_init(&this->writing, network->synapseCount);
+		this->pending = 0;
+		this->busy = 0;
+		atomic_init(&this->written, 0);
+		atomic_init(&this->replaced, 0);
+		atomic_init(&this->failures, 0);
+		atomic_init(&this->lastWriteNs, 0);
+
+		pthread_mutex_init(&this->lock, NULL);
+		pthread_cond_init(&this->changed, NULL);
+		this->running = 1;
+		pthread_create(&this->writer, NULL, Checkpointer_run, this);
+	}
+
+	/** Writes the checkpoint still waiting, if any, and stops the writer. Detach it from the trainers first. */
+	void Checkpointer_deinit(Checkpointer* this) {
+		pthread_mutex_lock(&this->lock);
+		this->running = 0;
+		pthread_cond_broadcast(&this->changed);
+		pthread_mutex_unlock(&this->lock);
+		pthread_join(this->writer, NULL);
+
+		pthread_mutex_destroy(&this->lock);
+		pthread_cond_destroy(&this->changed);
+		CheckpointStage_deinit(&this->captured);
+		CheckpointStage_deinit(&this->writing);
+		free(this->path);
+	}
+
+	/** Waits until every checkpoint captured so far is on disk. */
+	void Checkpointer_flush(Checkpointer* this) {
+		pthread_mutex_lock(&this->lock);
+		while (this->pending || this->busy) pthread_cond_wait(&this->changed, &this->lock);
+		pthread_mutex_unlock(&this->lock);
+	}
+
+
+
+//CAPTURE
+	/** Copies the state of trainer for the writer. Runs on the training thread, and only waits for the writer to swap its buffers. */
+	void Checkpointer_capture(Checkpointer* this, BPTrainer* trainer) {
+		Optimizer *optimizer = &trainer->optimizer;
+		unsigned long int n = this->network->synapseCount;
+		if (trainer->network->synapseCount != n || optimizer->parameterCount != n) return;
+
+		CheckpointHeader header = {0};
+		header.samples = trainer->samplesSeen;
+		header.step = optimizer->step;
+		header.parameterCount = n;
+		header.optimizerType = optimizer->type;
+		header.hasState2 = optimizer->state2 != NULL;
+		header.learningRate = optimizer->learningRate;
+		header.momentum = optimizer->momentum;
+		header.beta1 = optimizer->beta1;
+		header.beta2 = optimizer->beta2;
+		header.epsilon = optimizer->epsilon;
+		header.minimumError = trainer->minimum.error;
+
+		pthread_mutex_lock(&this->lock);
+		if (this->pending) atomic_fetch_add(&this->replaced, 1);
+
+		CheckpointStage *stage = &this->captured;
+		NeuralNetwork_saveSynapseWeights(trainer->network, stage->weights);
+		unsigned char *position = stage->extra;
+		memcpy(position, &header, sizeof(CheckpointHeader));
+		position += sizeof(CheckpointHeader);
+		memcpy(position, optimizer->state1, n * sizeof(NeuronUnit));
+		position += n * sizeof(NeuronUnit);
+		if (header.hasState2) {
+			memcpy(position, optimizer->state2, n * sizeof(NeuronUnit));
+			position += n * sizeof(NeuronUnit);
+		}
+		memcpy(position, trainer->minimum.weights, n * sizeof(NeuronUnit));
+		position += n * sizeof(NeuronUnit);
+		stage->extraSize = position - stage->extra;
+
+		this->pending = 1;
+		pthread_cond_broadcast(&this->changed);
+		pthread_mutex_unlock(&this->lock);
+	}
+
+	/** Captures a checkpoint if one is due. Called by the trainers after every weight update. */
+	void Checkpointer_check(Checkpointer* this, BPTrainer* trainer) {
+		unsigned long int samples = trainer->samplesSeen;
+		if (samples < this->lastSamples) this->lastSamples = 0; //a new run
+
+		char due = this->everySamples > 0 && samples - this->lastSamples >= this->everySamples;
+		unsigned long int now = 0;
+		if (!due && this->everySeconds > 0) {
+			now = Checkpointer_now();
+			due = now - this->lastTime >= this->everySeconds * 1e9;
+		}
+		if (!due) return;
+
+		Tracer_BEGIN("checkpoint");
+		Checkpointer_capture(this, trainer);
+		Tracer_END("checkpoint");
+		this->lastSamples = samples;
+		this->lastTime = now? now : Checkpointer_now();
+	}
+
+
+
+//TRAINER
+	/** Checkpoints the runs of this trainer. NULL stops checkpointing. */
+	void BPTrainer_setCheckpointer(BPTrainer* this, Checkpointer* checkpointer) {
+		this->checkpointer = checkpointer;
+	}
+
+	/** Loads the weights, the optimizer and the best weights of a checkpoint into this trainer.
+	 * The next run continues the checkpointed one: the optimizer state and the sample count are not reset.
+	 * Returns 0, changing nothing, if the file is not a checkpoint of a network with this topology. */
+	char BPTrainer_restoreCheckpoint(BPTrainer* this, const char* path) {
+		NeuralNetwork loaded;
+		void *extra;
+		unsigned long int extraSize;
+		if (!NetworkFile_read(path, &loaded, &extra, &extraSize)) return 0;
+
+		unsigned long int n = this->network->synapseCount;
+		CheckpointHeader header;
+		char ok = NeuralNetwork_sameTopology(this->network, &loaded) && extraSize >= sizeof(CheckpointHeader);
+		if (ok) {
+			memcpy(&header, extra, sizeof(CheckpointHeader));
+			ok = header.parameterCount == n && header.optimizerType != Optimizer_CUSTOM && header.optimizerType <= Optimizer_ADAGRAD
+				&& (header.hasState2 != 0) == (header.optimizerType == Optimizer_ADAM)
+				&& extraSize == sizeof(CheckpointHeader) + (header.hasState2? 3 : 2) * n * sizeof(NeuronUnit);
+		}
+
+		if (ok) {
+			if (this->optimizer.type != header.optimizerType) BPTrainer_setOptimizer(this, header.optimizerType);
+			for (unsigned long int i = n; i--;) this->network->synapses[i].weight = loaded.synapses[i].weight;
+
+			Optimizer *optimizer = &this->optimizer;
+			optimizer->step = header.step;
+			optimizer->learningRate = header.learningRate;
+			optimizer->stepRate = header.learningRate;
+			optimizer->momentum = header.momentum;
+			optimizer->beta1 = header.beta1;
+			optimizer->beta2 = header.beta2;
+			optimizer->epsilon = header.epsilon;
+
+			const unsigned char *position = (const unsigned char*) extra + sizeof(CheckpointHeader);
+			memcpy(optimizer->state1, position, n * sizeof(NeuronUnit));
+			position += n * sizeof(NeuronUnit);
+			if (header.hasState2) {
+				memcpy(optimizer->state2, position, n * sizeof(NeuronUnit));
+				position += n * sizeof(NeuronUnit);
+			}
+			memcpy(this->minimum.weights, position, n * sizeof(NeuronUnit));
+			this->minimum.error = header.minimumError;
+
+			this->samplesSeen = header.samples;
+			this->resumeRun = 1;
+		}
+
+		NeuralNetwork_deinit(&loaded);
+		free(extra);
+		return ok;
+	}
@@ -0,0 +1,319 @@
+#include "NetworkTrain.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define LBFGSTrainer_C1 1e-4
+#define LBFGSTrainer_C2 0.9
+#define LBFGSTrainer_MAX_EVALUATIONS 20
+
+
+//LIFE CIRCLE
+	void LBFGSTrainer_init(
+			LBFGSTrainer* this,
+			NeuralNetwork* network,
+			TrainDataSet* data,
+			void (*errorUpdater)(NeuralNetwork* net, NeuronUnit* expected, NeuronUnit* errorValue, NeuronUnit* errorGradients),
+			unsigned short int historySize,
+			unsigned int threadCount) {
+		unsigned long int n = network->synapseCount;
+		unsigned short int outputCount = network->layers[network->layerCount - 1].neuronCount;
+
+		this->network = network;
+		this->data = data;
+		this->errorUpdater = errorUpdater;
+		this->historySize = historySize;
+
+		NetworkReplicas_init(&this->replicas, network, threadCount);
+		this->s = malloc(historySize * n * sizeof(NeuronUnit));
+		this->y = malloc(historySize * n * sizeof(NeuronUnit));
+		this->rho = malloc(historySize * sizeof(NeuronUnit));
+		this->alpha = malloc(historySize * sizeof(NeuronUnit));
+		this->historyLength = 0;
+		this->historyStart = 0;
+
+		this->weights = malloc(n * sizeof(NeuronUnit));
+		this->gradient = malloc(n * sizeof(NeuronUnit));
+		this->direction = malloc(n * sizeof(NeuronUnit));
+		this->trialWeights = malloc(n * sizeof(NeuronUnit));
+		this->trialGradient = malloc(n * sizeof(NeuronUnit));
+		this->threadGradients = malloc(this->replicas.threadCount * n * sizeof(NeuronUnit));
+		this->threadErrors = malloc(this->replicas.threadCount * (1 + 2*outputCount) * sizeof(NeuronUnit));
+
+		this->dataPasses = 0;
+		this->iterations = 0;
+	}
+
+	void LBFGSTrainer_deinit(LBFGSTrainer* this) {
+		NetworkReplicas_deinit(&this->replicas);
+		free(this->s);
+		free(this->y);
+		free(this->rho);
+		free(this->alpha);
+		free(this->weights);
+		free(this->gradient);
+		free(this->direction);
+		free(this->trialWeights);
+		free(this->trialGradient);
+		free(this->threadGradients);
+		free(this->threadErrors);
+	}
+
+
+
+//UTILS
+	static NeuronUnit dot(const NeuronUnit* a, const NeuronUnit* b, unsigned long int length) {
+		NeuronUnit sum = 0;
+		for (unsigned long int i = 0; i < length; ++i) sum += a[i] * b[i];
+		return sum;
+	}
+
+
+
+//FULL BATCH EVALUATION
+	static void LBFGSTrainer_evaluateChunk(NeuralNetwork* replica, unsigned int threadIndex, unsigned int from, unsigned int to, void* context) {
+		LBFGSTrainer *this = (LBFGSTrainer*) context;
+		unsigned long int n = replica->synapseCount;
+		unsigned short int outputCount = replica->layers[replica->layerCount - 1].neuronCount;
+
+		NeuronUnit *gradient = this->threadGradients + threadIndex * n;
+		NeuronUnit *errors = this->threadErrors + threadIndex * (1 + 2*outputCount);
+		NeuronUnit *errorDerivatives = errors + 1;
+		NeuronUnit *expected = errors + 1 + outputCount;
+
+		memset(gradient, 0, n * sizeof(NeuronUnit));
+		NeuronUnit errorSum = 0;
+		for (unsigned int i = from; i < to; ++i) {
+			NeuronUnit errorValue;
+			TrainDataSet_loadSample(this->data, replica, i, expected);
+			NeuralNetwork_predict(replica);
+			this->errorUpdater(replica, expected, &errorValue, errorDerivatives);
+			NeuralNetwork_addToGradient(replica, errorDerivatives, gradient);
+			errorSum += errorValue;
+		}
+
+		errors[0] = errorSum;
+	}
+
+	/** Computes the mean error and its exact gradient over the whole data set for the given weights. */
+	NeuronUnit LBFGSTrainer_evaluate(LBFGSTrainer* this, NeuronUnit* weights, NeuronUnit* gradient) {
+		unsigned long int n = this->network->synapseCount;
+		unsigned short int outputCount = this->network->layers[this->network->layerCount - 1].neuronCount;
+		unsigned int sampleCount = this->data->sampleCount;
+		unsigned int threadCount = this->replicas.threadCount;
+		if (threadCount > sampleCount) threadCount = sampleCount;
+
+		NetworkReplicas_loadSynapseWeights(&this->replicas, weights);
+		NetworkReplicas_run(&this->replicas, sampleCount, LBFGSTrainer_evaluateChunk, this);
+		this->dataPasses++;
+
+		NeuronUnit errorSum = 0;
+		memset(gradient, 0, n * sizeof(NeuronUnit));
+		for (unsigned int t = 0; t < threadCount; ++t) {
+			NeuronUnit *threadGradient = this->threadGradients + t * n;
+			for (unsigned long int i = 0; i < n; ++i) gradient[i] += threadGradient[i];
+			errorSum += this->threadErrors[t * (1 + 2*outputCount)];
+		}
+
+		NeuronUnit scale = sampleCount == 0? 0 : (NeuronUnit)1 / sampleCount;
+		for (unsigned long int i = 0; i < n; ++i) gradient[i] *= scale;
+		return errorSum * scale;
+	}
+
+
+
+//DIRECTION
+	/** Two loop recursion: direction = -H * gradient, with H the inverse Hessian approximation of the history. */
+	static void LBFGSTrainer_computeDirection(LBFGSTrainer* this) {
+		unsigned long int n = this->network->synapseCount;
+		unsigned short int m = this->historySize;
+		NeuronUnit *q = this->direction;
+		memcpy(q, this->gradient, n * sizeof(NeuronUnit));
+
+		for (unsigned short int i = this->historyLength; i--;) {
+			unsigned short int k = (this->historyStart + i) % m;
+			NeuronUnit *s = this->s + k*n, *y = this->y + k*n;
+			NeuronUnit a = this->rho[k] * dot(s, q, n);
+			this->alpha[k] = a;
+			for (unsigned long int j = 0; j < n; ++j) q[j] -= a * y[j];
+		}
+
+		if (this->historyLength > 0) {
+			unsigned short int newest = (this->historyStart + this->historyLength - 1) % m;
+			NeuronUnit *y = this->y + newest*n;
+			NeuronUnit gamma = 1 / (this->rho[newest] * dot(y, y, n));
+			for (unsigned long int j = 0; j < n; ++j) q[j] *= gamma;
+		}
+
+		for (unsigned short int i = 0; i < this->historyLength; ++i) {
+			unsigned short int k = (this->historyStart + i) % m;
+			NeuronUnit *s = this->s + k*n, *y = this->y + k*n;
+			NeuronUnit b = this->rho[k] * dot(y, q, n);
+			NeuronUnit coefficient = this->alpha[k] - b;
+			for (unsigned long int j = 0; j < n; ++j) q[j] += coefficient * s[j];
+		}
+
+		for (unsigned long int j = 0; j < n; ++j) q[j] = -q[j];
+	}
+
+	static void LBFGSTrainer_pushHistory(LBFGSTrainer* this) {
+		unsigned long int n = this->network->synapseCount;
+		unsigned short int m = this->historySize;
+		unsigned short int slot = (this->historyStart + this->historyLength) % m;
+
+		//checked before writing: with a full history, the slot holds the oldest pair, which must stay intact if the new one is refused
+		NeuronUnit sy = 0;
+		for (unsigned long int j = 0; j < n; ++j) sy += (this->trialWeights[j] - this->weights[j]) * (this->trialGradient[j] - this->gradient[j]);
+		if (sy <= 1e-12) return; //curvature condition violated: keep the old history
+
+		NeuronUnit *s = this->s + slot*n, *y = this->y + slot*n;
+		for (unsigned long int j = 0; j < n; ++j) {
+			s[j] = this->trialWeights[j] - this->weights[j];
+			y[j] = this->trialGradient[j] - this->gradient[j];
+		}
+		this->rho[slot] = 1 / sy;
+		if (this->historyLength < m) this->historyLength++;
+		else this->historyStart = (this->historyStart + 1) % m;
+	}
+
+
+
+//LINE SEARCH
+	/** Evaluates weights + step * direction into trialWeights and trialGradient. */
+	static NeuronUnit LBFGSTrainer_trial(LBFGSTrainer* this, NeuronUnit step, NeuronUnit* slope) {
+		unsigned long int n = this->network->synapseCount;
+		for (unsigned long int j = 0; j < n; ++j) this->trialWeights[j] = this->weights[j] + step * this->direction[j];
+
+		NeuronUnit error = LBFGSTrainer_evaluate(this, this->trialWeights, this->trialGradient);
+		*slope = dot(this->trialGradient, this->direction, n);
+		return error;
+	}
+
+	/** Minimizer of the cubic through both points, or the midpoint if it falls too close to the interval ends. */
+	static NeuronUnit interpolate(NeuronUnit aLo, NeuronUnit fLo, NeuronUnit dLo, NeuronUnit aHi, NeuronUnit fHi, NeuronUnit dHi) {
+		NeuronUnit d1 = dLo + dHi - 3 * (fLo - fHi) / (aLo - aHi);
+		NeuronUnit radicand = d1*d1 - dLo*dHi;
+
+		if (radicand >= 0) {
+			NeuronUnit d2 = (aHi > aLo? 1 : -1) * sqrt(radicand);
+			NeuronUnit a = aHi - (aHi - aLo) * (dHi + d2 - d1) / (dHi - dLo + 2*d2);
+			NeuronUnit lo = fmin(aLo, aHi), width = fabs(aHi - aLo);
+			if (a > lo + 0.1*width && a < lo + 0.9*width) return a;
+		}
+
+		return (aLo + aHi) / 2;
+	}
+
+	static char LBFGSTrainer_zoom(
+			LBFGSTrainer* this,
+			NeuronUnit lo, NeuronUnit fLo, NeuronUnit dLo,
+			NeuronUnit hi, NeuronUnit fHi, NeuronUnit dHi,
+			NeuronUnit error, NeuronUnit slope0, NeuronUnit* trialError) {
+		for (unsigned int i = 0; i < LBFGSTrainer_MAX_EVALUATIONS; ++i) {
+			NeuronUnit slope;
+			NeuronUnit step = interpolate(lo, fLo, dLo, hi, fHi, dHi);
+			NeuronUnit f = LBFGSTrainer_trial(this, step, &slope);
+
+			if (f > error + LBFGSTrainer_C1 * step * slope0 || f >= fLo) {
+				hi = step; fHi = f; dHi = slope;
+			} else {
+				if (fabs(slope) <= -LBFGSTrainer_C2 * slope0) {
+					*trialError = f;
+					return 1;
+				}
+				if (slope * (hi - lo) >= 0) {
+					hi = lo; fHi = fLo; dHi = dLo;
+				}
+				lo = step; fLo = f; dLo = slope;
+			}
+
+			if (fabs(hi - lo) < 1e-12) break;
+		}
+
+		//no point satisfies the curvature condition. Settle for sufficient decrease.
+		if (lo > 0 && fLo < error) {
+			NeuronUnit slope;
+			*trialError = LBFGSTrainer_trial(this, lo, &slope);
+			return 1;
+		}
+		return 0;
+	}
+
+	/** Line search for a step satisfying the strong Wolfe conditions. On success trialWeights and trialGradient hold the new point. */
+	static char LBFGSTrainer_lineSearch(LBFGSTrainer* this, NeuronUnit error, NeuronUnit slope0, NeuronUnit step, NeuronUnit* trialError) {
+		NeuronUnit previousStep = 0, previousError = error, previousSlope = slope0;
+
+		for (unsigned int i = 0; i < LBFGSTrainer_MAX_EVALUATIONS; ++i) {
+			NeuronUnit slope;
+			NeuronUnit f = LBFGSTrainer_trial(this, step, &slope);
+
+			if (f > error + LBFGSTrainer_C1 * step * slope0 || (i > 0 && f >= previousError)) {
+				return LBFGSTrainer_zoom(this, previousStep, previousError, previousSlope, step, f, slope, error, slope0, trialError);
+			}
+			if (fabs(slope) <= -LBFGSTrainer_C2 * slope0) {
+				*trialError = f;
+				return 1;
+			}
+			if (slope >= 0) {
+				return LBFGSTrainer_zoom(this, step, f, slope, previousStep, previousError, previousSlope, error, slope0, trialError);
+			}
+
+			previousStep = step;
+			previousError = f;
+			previousSlope = slope;
+			step *= 2;
+		}
+
+		return 0;
+	}
+
+
+
+//TRAINING
+	/** Runs L-BFGS from the current network weights until maxIterations, or until no gradient component exceeds
+	 * gradientTolerance, or until the line search fails. Leaves the best weights in the network and returns their error. */
+	NeuronUnit LBFGSTrainer_train(LBFGSTrainer* this, unsigned int maxIterations, NeuronUnit gradientTolerance) {
+		NeuralNetwork *network = this->network;
+		unsigned long int n = network->synapseCount;
+
+		NeuralNetwork_saveSynapseWeights(network, this->weights);
+		NeuronUnit error = LBFGSTrainer_evaluate(this, this->weights, this->gradient);
+		this->historyLength = 0;
+		this->historyStart = 0;
+		this->iterations = 0;
+
+		while (this->iterations < maxIterations) {
+			NeuronUnit maxComponent = 0;
+			for (unsigned long int j = 0; j < n; ++j) maxComponent = fmax(maxComponent, fabs(this->gradient[j]));
+			if (maxComponent <= gradientTolerance) break;
+
+			LBFGSTrainer_computeDirection(this);
+			NeuronUnit slope = dot(this->gradient, this->direction, n);
+			if (slope >= 0) { //not a descent direction: restart from steepest descent
+				this->historyLength = 0;
+				for (unsigned long int j = 0; j < n; ++j) this->direction[j] = -this->gradient[j];
+				slope = -dot(this->gradient, this->gradient, n);
+			}
+
+			NeuronUnit step = 1;
+			if (this->historyLength == 0) step = fmin(1, 1 / sqrt(dot(this->gradient, this->gradient, n)));
+
+			NeuronUnit trialError;
+			if (!LBFGSTrainer_lineSearch(this, error, slope, step, &trialError)) break;
+
+			LBFGSTrainer_pushHistory(this);
+
+			NeuronUnit *swap = this->weights;
+			this->weights = this->trialWeights;
+			this->trialWeights = swap;
+			swap = this->gradient;
+			this->gradient = this->trialGradient;
+			this->trialGradient = swap;
+
+			error = trialError;
+			this->iterations++;
+		}
+
+		NeuralNetwork_loadSynapseWeights(network, this->weights);
+		return error;
+	}
@@ -0,0 +1,203 @@
+#include "NetworkTrain.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define LMTrainer_MAX_DAMPING 1e10
+
+
+//LIFE CIRCLE
+	static unsigned long int threadStride(LMTrainer* this) {
+		unsigned long int n = this->network->synapseCount;
+		unsigned short int outputCount = this->network->layers[this->network->layerCount - 1].neuronCount;
+		return n*n + n + 1 + n + outputCount;
+	}
+
+	void LMTrainer_init(LMTrainer* this, NeuralNetwork* network, TrainDataSet* data, unsigned int threadCount) {
+		unsigned long int n = network->synapseCount;
+		this->network = network;
+		this->data = data;
+
+		NetworkReplicas_init(&this->replicas, network, threadCount);
+		this->hessian = malloc(n * n * sizeof(NeuronUnit));
+		this->gradient = malloc(n * sizeof(NeuronUnit));
+		this->trialHessian = malloc(n * n * sizeof(NeuronUnit));
+		this->trialGradient = malloc(n * sizeof(NeuronUnit));
+		this->factor = malloc(n * n * sizeof(NeuronUnit));
+		this->weights = malloc(n * sizeof(NeuronUnit));
+		this->trialWeights = malloc(n * sizeof(NeuronUnit));
+		this->step = malloc(n * sizeof(NeuronUnit));
+		this->threadSums = malloc(this->replicas.threadCount * threadStride(this) * sizeof(NeuronUnit));
+
+		this->damping = 1e-3;
+		this->dataPasses = 0;
+		this->iterations = 0;
+	}
+
+	void LMTrainer_deinit(LMTrainer* this) {
+		NetworkReplicas_deinit(&this->replicas);
+		free(this->hessian);
+		free(this->gradient);
+		free(this->trialHessian);
+		free(this->trialGradient);
+		free(this->factor);
+		free(this->weights);
+		free(this->trialWeights);
+		free(this->step);
+		free(this->threadSums);
+	}
+
+
+
+//JACOBIAN PASS
+	static void LMTrainer_accumulateChunk(NeuralNetwork* replica, unsigned int threadIndex, unsigned int from, unsigned int to, void* context) {
+		LMTrainer *this = (LMTrainer*) context;
+		unsigned long int n = replica->synapseCount;
+		NetworkLayer *outputLayer = replica->layers + replica->layerCount - 1;
+		unsigned short int outputCount = outputLayer->neuronCount;
+
+		NeuronUnit *hessian = this->threadSums + threadIndex * threadStride(this);
+		NeuronUnit *gradient = hessian + n*n;
+		NeuronUnit *squaredError = gradient + n;
+		NeuronUnit *row = squaredError + 1;
+		NeuronUnit *expected = row + n;
+
+		memset(hessian, 0, (n*n + n + 1) * sizeof(NeuronUnit));
+		for (unsigned int s = from; s < to; ++s) {
+			TrainDataSet_loadSample(this->data, replica, s, expected);
+			NeuralNetwork_predict(replica);
+
+			for (unsigned short int k = 0; k < outputCount; ++k) {
+				NeuronUnit residual = outputLayer->neurons[k].out - expected[k];
+				*squaredError += residual * residual;
+				NeuralNetwork_saveJacobianRow(replica, k, row);
+
+				//upper triangle of row * row^T. Zero entries (unreachable synapses) are skipped.
+				for (unsigned long int i = 0; i < n; ++i) {
+					NeuronUnit ri = row[i];
+					if (ri == 0) continue;
+
+					gradient[i] += ri * residual;
+					NeuronUnit *hessianRow = hessian + i*n;
+					for (unsigned long int j = i; j < n; ++j) hessianRow[j] += ri * row[j];
+				}
+			}
+		}
+	}
+
+	/** Computes J^T*J, J^T*e and the squared error sum over the whole data set, for the given weights. */
+	static NeuronUnit LMTrainer_accumulate(LMTrainer* this, NeuronUnit* weights, NeuronUnit* hessian, NeuronUnit* gradient) {
+		unsigned long int n = this->network->synapseCount;
+		unsigned long int stride = threadStride(this);
+		unsigned int sampleCount = this->data->sampleCount;
+		unsigned int threadCount = this->replicas.threadCount;
+		if (threadCount > sampleCount) threadCount = sampleCount;
+
+		NetworkReplicas_loadSynapseWeights(&this->replicas, weights);
+		NetworkReplicas_run(&this->replicas, sampleCount, LMTrainer_accumulateChunk, this);
+		this->dataPasses++;
+
+		memset(hessian, 0, n * n * sizeof(NeuronUnit));
+		memset(gradient, 0, n * sizeof(NeuronUnit));
+		NeuronUnit squaredError = 0;
+		for (unsigned int t = 0; t < threadCount; ++t) {
+			NeuronUnit *sums = this->threadSums + t * stride;
+			for (unsigned long int i = 0; i < n*n; ++i) hessian[i] += sums[i];
+			for (unsigned long int i = 0; i < n; ++i) gradient[i] += sums[n*n + i];
+			squaredError += sums[n*n + n];
+		}
+
+		//mirror the upper triangle
+		for (unsigned long int i = 0; i < n; ++i) {
+			for (unsigned long int j = 0; j < i; ++j) hessian[i*n + j] = hessian[j*n + i];
+		}
+
+		return squaredError;
+	}
+
+
+
+//LINEAR ALGEBRA
+	/** Cholesky factorization of the symmetric matrix (hessian + damping*I) into the lower triangle of factor.
+	 * Returns 0 if the matrix is not positive definite. */
+	static char cholesky(const NeuronUnit* hessian, NeuronUnit damping, NeuronUnit* factor, unsigned long int n) {
+		for (unsigned long int j = 0; j < n; ++j) {
+			NeuronUnit diagonal = hessian[j*n + j] + damping;
+			for (unsigned long int k = 0; k < j; ++k) diagonal -= factor[j*n + k] * factor[j*n + k];
+			if (diagonal <= 0) return 0;
+
+			NeuronUnit pivot = sqrt(diagonal);
+			factor[j*n + j] = pivot;
+			for (unsigned long int i = j + 1; i < n; ++i) {
+				NeuronUnit sum = hessian[i*n + j];
+				for (unsigned long int k = 0; k < j; ++k) sum -= factor[i*n + k] * factor[j*n + k];
+				factor[i*n + j] = sum / pivot;
+			}
+		}
+		return 1;
+	}
+
+	/** Solves L*L^T * x = b in place, with L the lower triangle of factor. */
+	static void choleskySolve(const NeuronUnit* factor, NeuronUnit* x, unsigned long int n) {
+		for (unsigned long int i = 0; i < n; ++i) {
+			NeuronUnit sum = x[i];
+			for (unsigned long int k = 0; k < i; ++k) sum -= factor[i*n + k] * x[k];
+			x[i] = sum / factor[i*n + i];
+		}
+
+		for (unsigned long int i = n; i--;) {
+			NeuronUnit sum = x[i];
+			for (unsigned long int k = i + 1; k < n; ++k) sum -= factor[k*n + i] * x[k];
+			x[i] = sum / factor[i*n + i];
+		}
+	}
+
+
+
+//TRAINING
+	/** Runs Levenberg-Marquardt from the current network weights. Stops after maxIterations accepted steps,
+	 * when no component of J^T*e exceeds gradientTolerance, or when the damping grows out of range.
+	 * Leaves the best weights in the network and returns their mean squared error per sample. */
+	NeuronUnit LMTrainer_train(LMTrainer* this, unsigned int maxIterations, NeuronUnit gradientTolerance) {
+		NeuralNetwork *network = this->network;
+		unsigned long int n = network->synapseCount;
+		unsigned int sampleCount = this->data->sampleCount;
+
+		NeuralNetwork_saveSynapseWeights(network, this->weights);
+		NeuronUnit error = LMTrainer_accumulate(this, this->weights, this->hessian, this->gradient);
+		this->iterations = 0;
+
+		while (this->iterations < maxIterations && this->damping < LMTrainer_MAX_DAMPING) {
+			NeuronUnit maxComponent = 0;
+			for (unsigned long int i = 0; i < n; ++i) maxComponent = fmax(maxComponent, fabs(this->gradient[i]));
+			if (maxComponent <= gradientTolerance) break;
+
+			//solve (J^T*J + damping*I) * step = -J^T*e
+			if (!cholesky(this->hessian, this->damping, this->factor, n)) {
+				this->damping *= 10;
+				continue;
+			}
+			for (unsigned long int i = 0; i < n; ++i) this->step[i] = -this->gradient[i];
+			choleskySolve(this->factor, this->step, n);
+
+			for (unsigned long int i = 0; i < n; ++i) this->trialWeights[i] = this->weights[i] + this->step[i];
+			NeuronUnit trialError = LMTrainer_accumulate(this, this->trialWeights, this->trialHessian, this->trialGradient);
+
+			if (trialError >= error) {
+				this->damping *= 10;
+				continue;
+			}
+
+			//accept: the trial pass already holds the Jacobian products of the new point
+			NeuronUnit *swap = this->weights; this->weights = this->trialWeights; this->trialWeights = swap;
+			swap = this->hessian; this->hessian = this->trialHessian; this->trialHessian = swap;
+			swap = this->gradient; this->gradient = this->trialGradient; this->trialGradient = swap;
+
+			error = trialError;
+			this->damping = fmax(this->damping / 10, 1e-12);
+			this->iterations++;
+		}
+
+		NeuralNetwork_loadSynapseWeights(network, this->weights);
+		return sampleCount == 0? 0 : error / sampleCount;
+	}
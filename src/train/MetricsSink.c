@@ -0,0 +1,144 @@
+#include "NetworkTrain.h"
+#include <stdlib.h>
+#include <time.h>
+
+//UTILS
+	static unsigned long int MetricsSink_now() {
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+	}
+
+
+
+//WRITERS
+	static NeuronUnit MetricsSink_throughput(MetricsSink* this, MetricsRecord* record) {
+		if (record->samples < this->lastSamples || record->timestamp < this->lastTime) { //a new run
+			this->lastSamples = 0;
+			this->lastTime = 0;
+		}
+
+		unsigned long int elapsed = record->timestamp - this->lastTime;
+		NeuronUnit throughput = elapsed == 0? 0 : (record->samples - this->lastSamples) * 1e9 / elapsed;
+
+		this->lastSamples = record->samples;
+		this->lastTime = record->timestamp;
+		return throughput;
+	}
+
+	static void MetricsSink_writeRecord(MetricsSink* this, MetricsRecord* record) {
+		NeuronUnit throughput = MetricsSink_throughput(this, record);
+		if (this->format == MetricsSink_CSV) {
+			fprintf(this->out, "%lu,%.6f,%g,%g,%g,%.1f\n",
+				record->samples, record->timestamp / 1e9, record->loss, record->minimumLoss, record->learningRate, throughput);
+		}
+		else {
+			fprintf(this->out, "{\"samples\":%lu,\"time\":%.6f,\"loss\":%g,\"minLoss\":%g,\"learningRate\":%g,\"samplesPerSec\":%.1f}\n",
+				record->samples, record->timestamp / 1e9, record->loss, record->minimumLoss, record->learningRate, throughput);
+		}
+	}
+
+	/** Coalesces everything drained in one interval into a single console line. */
+	static void MetricsSink_writeConsole(MetricsSink* this, MetricsRecord* last, unsigned long int count, NeuronUnit lossSum) {
+		NeuronUnit throughput = MetricsSink_throughput(this, last);
+		fprintf(this->out, "samples: %lu    loss: %f    min: %f    rate: %g    %.0f samples/s\n",
+			last->samples, lossSum / count, last->minimumLoss, last->learningRate, throughput);
+	}
+
+	/** Writes out every pending record. Only one thread drains at a time. */
+	void MetricsSink_flush(MetricsSink* this) {
+		pthread_mutex_lock(&this->drainLock);
+
+		unsigned long int head = atomic_load_explicit(&this->head, memory_order_relaxed);
+		unsigned long int tail = atomic_load_explicit(&this->tail, memory_order_acquire);
+		if (head != tail) {
+			if (this->format == MetricsSink_CONSOLE) {
+				NeuronUnit lossSum = 0;
+				for (unsigned long int i = head; i != tail; ++i) lossSum += this->records[i & this->mask].loss;
+				MetricsSink_writeConsole(this, this->records + ((tail - 1) & this->mask), tail - head, lossSum);
+			}
+			else {
+				for (unsigned long int i = head; i != tail; ++i) MetricsSink_writeRecord(this, this->records + (i & this->mask));
+			}
+			atomic_store_explicit(&this->head, tail, memory_order_release);
+		}
+
+		unsigned long int dropped = atomic_exchange_explicit(&this->dropped, 0, memory_order_relaxed);
+		if (dropped > 0 && this->format == MetricsSink_CONSOLE) fprintf(this->out, "(%lu progress records dropped)\n", dropped);
+		fflush(this->out);
+
+		pthread_mutex_unlock(&this->drainLock);
+	}
+
+	static void* MetricsSink_report(void* arg) {
+		MetricsSink *this = (MetricsSink*) arg;
+		struct timespec interval = { this->intervalMs / 1000, (this->intervalMs % 1000) * 1000000L };
+
+		while (atomic_load_explicit(&this->running, memory_order_relaxed)) {
+			nanosleep(&interval, NULL);
+			MetricsSink_flush(this);
+		}
+		return NULL;
+	}
+
+
+
+//RECORDING
+	/** Never blocks: if the reporter is behind and the ring is full, the record is dropped. */
+	void MetricsSink_record(MetricsSink* this, unsigned long int samples, NeuronUnit loss, NeuronUnit minimumLoss, NeuronUnit learningRate) {
+		unsigned long int tail = atomic_load_explicit(&this->tail, memory_order_relaxed);
+		unsigned long int head = atomic_load_explicit(&this->head, memory_order_acquire);
+		if (tail - head > this->mask) {
+			atomic_fetch_add_explicit(&this->dropped, 1, memory_order_relaxed);
+			return;
+		}
+
+		this->records[tail & this->mask] = (MetricsRecord) { samples, MetricsSink_now() - this->runStart, loss, minimumLoss, learningRate };
+		atomic_store_explicit(&this->tail, tail + 1, memory_order_release);
+	}
+
+
+
+	/** Called by the trainers when a run starts. Timestamps and sample counts are relative to it. */
+	void MetricsSink_beginRun(MetricsSink* this) {
+		this->runStart = MetricsSink_now();
+	}
+
+
+
+//LIFE CIRCLE
+	/** capacity is rounded up to a power of two. With intervalMs == 0 no reporter thread is started. */
+	void MetricsSink_init(MetricsSink* this, unsigned char format, FILE* out, unsigned int capacity, unsigned int intervalMs) {
+		unsigned long int size = 1;
+		while (size < capacity) size <<= 1;
+
+		this->records = malloc(size * sizeof(MetricsRecord));
+		this->mask = size - 1;
+		this->format = format;
+		this->out = out;
+		this->intervalMs = intervalMs;
+		this->runStart = MetricsSink_now();
+		this->lastSamples = 0;
+		this->lastTime = 0;
+		atomic_init(&this->head, 0);
+		atomic_init(&this->tail, 0);
+		atomic_init(&this->dropped, 0);
+		pthread_mutex_init(&this->drainLock, NULL);
+
+		if (format == MetricsSink_CSV) fprintf(out, "samples,time,loss,min_loss,learning_rate,samples_per_sec\n");
+
+		atomic_init(&this->running, intervalMs > 0);
+		if (intervalMs > 0) pthread_create(&this->reporter, NULL, MetricsSink_report, this);
+	}
+
+	/** Stops the reporter and writes out whatever is left. The output file is not closed. */
+	void MetricsSink_deinit(MetricsSink* this) {
+		if (this->intervalMs > 0) {
+			atomic_store(&this->running, 0);
+			pthread_join(this->reporter, NULL);
+		}
+
+		MetricsSink_flush(this);
+		pthread_mutex_destroy(&this->drainLock);
+		free(this->records);
+	}
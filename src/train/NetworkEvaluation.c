@@ -0,0 +1,207 @@
+#include "NetworkTrain.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define NetworkEvaluation_BATCH_SIZE 4096
+#define NetworkEvaluation_CHUNK 64		//rows per NeuralNetwork_predictBatch call
+
+/** Partial sums of one replica. They are reduced once, after the whole data set. */
+struct _EvaluationPartial {
+	_Alignas(64) NeuronUnit lossSum;	//own cache line per replica
+	unsigned long int correct;
+	unsigned long int *confusion;
+	NeuronUnit *absoluteErrorSum;
+	NeuronUnit *errorGradients;		//scratch for the loss function
+	NeuronUnit *outputs;			//NetworkEvaluation_CHUNK predictions
+	NeuronUnit *scratch;			//for NeuralNetwork_predictBatch
+};
+
+typedef struct {
+	NetworkEvaluator *evaluator;
+	void (*lossFunction)(NeuralNetwork* net, NeuronUnit* expected, NeuronUnit* errorValue, NeuronUnit* errorGradients);
+} EvaluationJob;
+
+
+//METRICS
+	void EvaluationMetrics_init(EvaluationMetrics* this, unsigned short int outputCount) {
+		this->outputCount = outputCount;
+		this->classCount = outputCount == 1? 2 : outputCount;
+		this->confusion = calloc((unsigned long int) this->classCount * this->classCount, sizeof(unsigned long int));
+		this->meanAbsoluteError = calloc(outputCount, sizeof(NeuronUnit));
+		this->sampleCount = 0;
+		this->loss = 0;
+		this->accuracy = 0;
+	}
+
+	void EvaluationMetrics_deinit(EvaluationMetrics* this) {
+		free(this->confusion);
+		free(this->meanAbsoluteError);
+	}
+
+	void EvaluationMetrics_print(EvaluationMetrics* this, FILE* out) {
+		fprintf(out, "Samples: %lu\nLoss: %f\nAccuracy: %.2f%%\n", this->sampleCount, this->loss, this->accuracy * 100);
+
+		fprintf(out, "Mean absolute error:");
+		for (unsigned short int i = 0; i < this->outputCount; ++i) fprintf(out, " %f", this->meanAbsoluteError[i]);
+
+		fprintf(out, "\nConfusion matrix (rows: expected, columns: predicted):\n");
+		for (unsigned short int i = 0; i < this->classCount; ++i) {
+			for (unsigned short int j = 0; j < this->classCount; ++j) fprintf(out, " %8lu", this->confusion[i * this->classCount + j]);
+			fprintf(out, "\n");
+		}
+	}
+
+
+
+//EVALUATION
+	static unsigned short int classOf(NeuronUnit* values, unsigned short int count) {
+		if (count == 1) return values[0] >= 0.5;
+
+		unsigned short int best = 0;
+		for (unsigned short int i = 1; i < count; ++i) {
+			if (values[i] > values[best]) best = i;
+		}
+		return best;
+	}
+
+	static void evaluateRows(NeuralNetwork* replica, unsigned int threadIndex, unsigned int from, unsigned int to, void* context) {
+		EvaluationJob *job = (EvaluationJob*) context;
+		NetworkEvaluator *evaluator = job->evaluator;
+		EvaluationPartial *partial = evaluator->partials + threadIndex;
+		unsigned short int inputCount = evaluator->network->layers[0].neuronCount;
+		unsigned short int outputCount = evaluator->outputCount, classCount = evaluator->classCount;
+		Neuron *outputs = replica->layers[replica->layerCount - 1].neurons;
+
+		for (unsigned int first = from; first < to; first += NetworkEvaluation_CHUNK) {
+			unsigned int count = to - first < NetworkEvaluation_CHUNK? to - first : NetworkEvaluation_CHUNK;
+			NeuralNetwork_predictBatch(evaluator->network, evaluator->inputs + (unsigned long int) first * inputCount, count, partial->outputs, partial->scratch);
+
+			for (unsigned int r = 0; r < count; ++r) {
+				NeuronUnit *predicted = partial->outputs + (unsigned long int) r * outputCount;
+				NeuronUnit *expected = evaluator->expected + (unsigned long int) (first + r) * outputCount;
+
+				//the loss function reads the output layer
+				for (unsigned short int i = outputCount; i--;) outputs[i].out = predicted[i];
+				NeuronUnit loss;
+				job->lossFunction(replica, expected, &loss, partial->errorGradients);
+				partial->lossSum += loss;
+
+				for (unsigned short int i = outputCount; i--;) partial->absoluteErrorSum[i] += fabs(predicted[i] - expected[i]);
+
+				unsigned short int expectedClass = classOf(expected, outputCount);
+				unsigned short int predictedClass = classOf(predicted, outputCount);
+				partial->confusion[expectedClass * classCount + predictedClass]++;
+				if (expectedClass == predictedClass) partial->correct++;
+			}
+		}
+	}
+
+	/** A threadCount of 0 means one thread per core. The copies of the network are made here, once. */
+	void NetworkEvaluator_init(NetworkEvaluator* this, NeuralNetwork* network, unsigned int threadCount) {
+		unsigned short int inputCount = network->layers[0].neuronCount;
+		unsigned short int outputCount = network->layers[network->layerCount - 1].neuronCount;
+		this->network = network;
+		this->outputCount = outputCount;
+		this->classCount = outputCount == 1? 2 : outputCount;
+		this->inputs = malloc((unsigned long int) NetworkEvaluation_BATCH_SIZE * inputCount * sizeof(NeuronUnit));
+		this->expected = malloc((unsigned long int) NetworkEvaluation_BATCH_SIZE * outputCount * sizeof(NeuronUnit));
+
+		NetworkReplicas_init(&this->replicas, network, threadCount);
+		unsigned int count = this->replicas.threadCount;
+		this->partials = aligned_alloc(64, count * sizeof(EvaluationPartial)); //the size is a multiple of 64: sizeof rounds up to the alignment
+		for (unsigned int t = count; t--;) {
+			EvaluationPartial *partial = this->partials + t;
+			partial->confusion = malloc((unsigned long int) this->classCount * this->classCount * sizeof(unsigned long int));
+			partial->absoluteErrorSum = malloc(outputCount * sizeof(NeuronUnit));
+			partial->errorGradients = calloc(outputCount, sizeof(NeuronUnit));
+			partial->outputs = malloc((unsigned long int) NetworkEvaluation_CHUNK * outputCount * sizeof(NeuronUnit));
+			partial->scratch = malloc(NeuralNetwork_batchScratchSize(network, NetworkEvaluation_CHUNK) * sizeof(NeuronUnit));
+		}
+	}
+
+	void NetworkEvaluator_deinit(NetworkEvaluator* this) {
+		for (unsigned int t = this->replicas.threadCount; t--;) {
+			EvaluationPartial *partial = this->partials + t;
+			free(partial->confusion);
+			free(partial->absoluteErrorSum);
+			free(partial->errorGradients);
+			free(partial->outputs);
+			free(partial->scratch);
+		}
+		free(this->partials);
+		NetworkReplicas_deinit(&this->replicas);
+		free(this->inputs);
+		free(this->expected);
+	}
+
+	/** Runs the network over every sample of the provider, until it returns 0, and fills metrics.
+	 * Samples are read in batches on the calling thread, and each batch is split between the threads, which predict
+	 * NetworkEvaluation_CHUNK rows at a time with the current weights of the network. The network is not modified,
+	 * apart from the values of its input layer. The loss function sees the outputs in the output layer of a copy of the network. */
+	void NetworkEvaluator_run(
+			NetworkEvaluator* this,
+			TrainDataProvider* provider,
+			void (*lossFunction)(NeuralNetwork* net, NeuronUnit* expected, NeuronUnit* errorValue, NeuronUnit* errorGradients),
+			EvaluationMetrics* metrics) {
+		NeuralNetwork *net = this->network;
+		unsigned short int inputCount = net->layers[0].neuronCount;
+		unsigned short int outputCount = this->outputCount;
+		unsigned short int classCount = this->classCount;
+		unsigned int threadCount = this->replicas.threadCount;
+		for (unsigned int t = threadCount; t--;) {
+			EvaluationPartial *partial = this->partials + t;
+			partial->lossSum = 0;
+			partial->correct = 0;
+			memset(partial->confusion, 0, (unsigned long int) classCount * classCount * sizeof(unsigned long int));
+			memset(partial->absoluteErrorSum, 0, outputCount * sizeof(NeuronUnit));
+		}
+		EvaluationJob job = { this, lossFunction };
+
+		unsigned long int sampleCount = 0;
+		char hasNext = 1;
+		while (hasNext) {
+			unsigned int count = 0;
+			while (count < NetworkEvaluation_BATCH_SIZE && (hasNext = provider->provideInput(provider, net))) {
+				NeuronUnit *inputs = this->inputs + (unsigned long int) count * inputCount;
+				NeuronUnit *expected = this->expected + (unsigned long int) count * outputCount;
+				for (unsigned short int i = inputCount; i--;) inputs[i] = net->layers[0].neurons[i].out;
+				for (unsigned short int i = outputCount; i--;) expected[i] = provider->expected[i];
+				count++;
+			}
+
+			if (count == 0) break;
+			NetworkReplicas_run(&this->replicas, count, evaluateRows, &job);
+			sampleCount += count;
+		}
+
+		//reduce
+		memset(metrics->confusion, 0, (unsigned long int) classCount * classCount * sizeof(unsigned long int));
+		memset(metrics->meanAbsoluteError, 0, outputCount * sizeof(NeuronUnit));
+		NeuronUnit lossSum = 0;
+		unsigned long int correct = 0;
+		for (unsigned int t = 0; t < threadCount; ++t) {
+			EvaluationPartial *partial = this->partials + t;
+			lossSum += partial->lossSum;
+			correct += partial->correct;
+			for (unsigned long int i = (unsigned long int) classCount * classCount; i--;) metrics->confusion[i] += partial->confusion[i];
+			for (unsigned short int i = outputCount; i--;) metrics->meanAbsoluteError[i] += partial->absoluteErrorSum[i];
+		}
+
+		metrics->sampleCount = sampleCount;
+		metrics->loss = sampleCount == 0? 0 : lossSum / sampleCount;
+		metrics->accuracy = sampleCount == 0? 0 : (NeuronUnit) correct / sampleCount;
+		for (unsigned short int i = outputCount; i--;) metrics->meanAbsoluteError[i] = sampleCount == 0? 0 : metrics->meanAbsoluteError[i] / sampleCount;
+	}
+
+	/** A single evaluation, see NetworkEvaluator_run. To evaluate the same network again and again, keep a NetworkEvaluator instead. */
+	void NeuralNetwork_evaluate(
+			NeuralNetwork* net,
+			TrainDataProvider* provider,
+			void (*lossFunction)(NeuralNetwork* net, NeuronUnit* expected, NeuronUnit* errorValue, NeuronUnit* errorGradients),
+			EvaluationMetrics* metrics) {
+		NetworkEvaluator evaluator;
+		NetworkEvaluator_init(&evaluator, net, 0);
+		NetworkEvaluator_run(&evaluator, provider, lossFunction, metrics);
+		NetworkEvaluator_deinit(&evaluator);
+	}
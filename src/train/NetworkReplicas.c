@@ -0,0 +1,77 @@
+#include "NetworkTrain.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+
+typedef struct {
+	NetworkReplicas *owner;
+	unsigned int threadIndex;
+	unsigned int from;
+	unsigned int to;
+	void (*job)(NeuralNetwork* replica, unsigned int threadIndex, unsigned int from, unsigned int to, void* context);
+	void *context;
+} ReplicaTask;
+
+
+//LIFE CIRCLE
+	unsigned int NetworkReplicas_defaultThreadCount() {
+		long int cores = sysconf(_SC_NPROCESSORS_ONLN);
+		return cores > 0? (unsigned int) cores : 1;
+	}
+
+	/** Creates threadCount copies of network. A threadCount of 0 means one per core. */
+	void NetworkReplicas_init(NetworkReplicas* this, NeuralNetwork* network, unsigned int threadCount) {
+		if (threadCount == 0) threadCount = NetworkReplicas_defaultThreadCount();
+
+		this->network = network;
+		this->threadCount = threadCount;
+		this->replicas = (NeuralNetwork*) malloc(threadCount * sizeof(NeuralNetwork));
+		for (unsigned int i = threadCount; i--;) NeuralNetwork_initCopy(this->replicas + i, network);
+	}
+
+	void NetworkReplicas_deinit(NetworkReplicas* this) {
+		for (unsigned int i = this->threadCount; i--;) NeuralNetwork_deinit(this->replicas + i);
+		free(this->replicas);
+	}
+
+	void NetworkReplicas_loadSynapseWeights(NetworkReplicas* this, NeuronUnit* weights) {
+		for (unsigned int i = this->threadCount; i--;) NeuralNetwork_loadSynapseWeights(this->replicas + i, weights);
+	}
+
+
+
+//OPERATIONS
+	static void* NetworkReplicas_runTask(void* arg) {
+		ReplicaTask *task = (ReplicaTask*) arg;
+		if (task->threadIndex > 0) Tracer_nameThread("replica");
+		Tracer_BEGIN("replicaJob");
+		task->job(task->owner->replicas + task->threadIndex, task->threadIndex, task->from, task->to, task->context);
+		Tracer_END("replicaJob");
+		return NULL;
+	}
+
+	/** Splits [0, itemCount) in contiguous chunks, one per replica, and runs job on them in parallel.
+	 * The first chunk runs on the calling thread. Returns when all chunks are done. */
+	void NetworkReplicas_run(
+			NetworkReplicas* this,
+			unsigned int itemCount,
+			void (*job)(NeuralNetwork* replica, unsigned int threadIndex, unsigned int from, unsigned int to, void* context),
+			void* context) {
+		unsigned int threadCount = this->threadCount;
+		if (threadCount > itemCount) threadCount = itemCount == 0? 1 : itemCount;
+
+		ReplicaTask tasks[threadCount];
+		pthread_t threads[threadCount];
+		unsigned int chunk = itemCount / threadCount, rest = itemCount % threadCount;
+		unsigned int from = 0;
+
+		for (unsigned int i = 0; i < threadCount; ++i) {
+			unsigned int length = chunk + (i < rest? 1 : 0);
+			tasks[i] = (ReplicaTask) { this, i, from, from + length, job, context };
+			from += length;
+		}
+
+		for (unsigned int i = 1; i < threadCount; ++i) pthread_create(threads + i, NULL, NetworkReplicas_runTask, tasks + i);
+		NetworkReplicas_runTask(tasks);
+		for (unsigned int i = 1; i < threadCount; ++i) pthread_join(threads[i], NULL);
+	}
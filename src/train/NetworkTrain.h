@@ -1,9 +1,15 @@
 #pragma once
 #include "../network/Network.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
 
 
 //FORWARD DECLARATIONS
 	typedef struct _TrainDataProvider TrainDataProvider;
+	typedef struct _BPTrainer BPTrainer;
+	typedef struct _Checkpointer Checkpointer;
 
 
 
@@ -14,15 +20,242 @@
 		unsigned int maxResults;
 		NeuronUnit *expected;
 		char (*provideInput)(TrainDataProvider* this, NeuralNetwork* net); //returns 0 if no data are available
+
+		//epoch state. Used only by indexed providers (see TrainDataProvider_initIndexed)
+		char (*provideSample)(TrainDataProvider* this, NeuralNetwork* net, unsigned int index);
+		void *source;
+		unsigned int sampleCount;
+		unsigned int epoch;
+		unsigned int epochPosition;
+		unsigned int *order;	//permutation of the sample indices of the current epoch
+		unsigned int blockSize;	//0 for a full permutation, otherwise blocks of that many consecutive samples are kept together
+	};
+
+
+	/** A read only set of samples, stored row by row: inputCount inputs followed by outputCount expected values.
+	 * The rows may live in user memory or in a memory mapped file. They are never copied. */
+	typedef struct {
+		const NeuronUnit *rows;
+		unsigned int sampleCount;
+		unsigned short int inputCount;
+		unsigned short int outputCount;
+
+		void *mapping;
+		unsigned long int mappingSize;
+		NeuronUnit *ownedRows;
+	} TrainDataSet;
+
+
+	/** Copies of a network, one per thread, for passes over a whole data set. */
+	typedef struct {
+		NeuralNetwork *network;
+		unsigned int threadCount;
+		NeuralNetwork *replicas;
+	} NetworkReplicas;
+
+
+	/** Lock-free single producer / single consumer ring of fixed size samples.
+	 * Each slot holds rowSize NeuronUnits. The capacity is a power of two. */
+	typedef struct {
+		_Alignas(64) atomic_ulong head;	//next slot to read. Written by the consumer only
+		_Alignas(64) atomic_ulong tail;	//next slot to write. Written by the producer only
+		_Alignas(64) atomic_ulong fullWaits;	//times the producer found the ring full
+
+		NeuronUnit *slots;
+		unsigned long int mask;
+		unsigned int rowSize;
+	} SampleRing;
+
+	typedef struct {
+		unsigned long int consumed;
+		unsigned long int consumerWaits;	//trainer found every ring empty: producers are the bottleneck
+		unsigned long int producerWaits;	//producers found their ring full: back-pressure from the trainer
+		NeuronUnit meanOccupancy;	//average fill ratio of the rings, sampled at each consumed sample
+		unsigned int capacity;
+	} AsyncDataProviderStats;
+
+	typedef struct _AsyncDataProvider AsyncDataProvider;
+	typedef struct {
+		AsyncDataProvider *owner;
+		unsigned int index;
+		atomic_char finished;
+	} AsyncProducer;
+
+	/** Runs generator callbacks on producer threads. Every producer owns an SPSC ring, and the trainer
+	 * drains the rings round robin through provider.provideInput. Pass &provider to the trainers. */
+	struct _AsyncDataProvider {
+		TrainDataProvider provider;
+		char (*generate)(void *context, unsigned int producerIndex, NeuronUnit *input, NeuronUnit *expected); //returns 0 when exhausted
+		void *context;
+		unsigned short int inputCount;
+		unsigned short int outputCount;
+
+		unsigned int producerCount;
+		SampleRing *rings;
+		AsyncProducer *producers;
+		pthread_t *threads;
+		atomic_char running;
+
+		unsigned int nextRing;
+		unsigned long int consumerWaits;
+		NeuronUnit occupancySum;
 	};
 
 
+	/** Result of NeuralNetwork_evaluate. With one output the prediction is thresholded at 0.5 (two classes),
+	 * otherwise the class is the output with the largest value. */
+	typedef struct {
+		unsigned long int sampleCount;
+		NeuronUnit loss;					//mean of the loss function
+		NeuronUnit accuracy;
+		unsigned short int outputCount;
+		unsigned short int classCount;
+		unsigned long int *confusion;		//classCount x classCount. Row: expected class, column: predicted class
+		NeuronUnit *meanAbsoluteError;		//one per output
+	} EvaluationMetrics;
+
+	typedef struct _EvaluationPartial EvaluationPartial;
+	/** What NeuralNetwork_evaluate needs besides the network: sample buffers, per thread sums and a copy of the network per thread.
+	 * Keep one to evaluate the same network many times (after every epoch, say): the weights are read from the network at every run. */
+	typedef struct {
+		NeuralNetwork *network;
+		unsigned short int outputCount;
+		unsigned short int classCount;
+		NeuronUnit *inputs;				//a batch of samples, inputCount values each
+		NeuronUnit *expected;			//and their outputCount expected values
+		NetworkReplicas replicas;		//where the loss function reads the outputs
+		EvaluationPartial *partials;	//one per replica
+	} NetworkEvaluator;
+
+
+	/** One event of the tracer. name must outlive the trace (string literals), it is not copied. */
+	typedef struct {
+		const char *name;
+		unsigned long int timestamp;	//ns since Tracer_start
+		unsigned int threadId;
+		char phase;						//'B' begin, 'E' end, 'M' thread name
+	} TraceEvent;
+
+	#define Tracer_CHUNK_CAPACITY 65536	//events per chunk: the buffers grow one chunk at a time
+	#define Tracer_MAX_CHUNKS 64			//per thread. Events beyond that are dropped, and counted
+	typedef struct _TraceChunk TraceChunk;
+	struct _TraceChunk {
+		_Atomic(TraceChunk*) next;
+		TraceEvent events[Tracer_CHUNK_CAPACITY];
+	};
+
+	/** Events of one thread. Only the owning thread writes, so recording needs no locks.
+	 * Buffers are never freed: when a thread exits its buffer is released and reused by the next thread. Their chunks are kept too. */
+	typedef struct _TraceBuffer TraceBuffer;
+	struct _TraceBuffer {
+		TraceBuffer *next;
+		atomic_char inUse;
+		atomic_ulong count;
+		atomic_ulong dropped;
+		unsigned int threadId;
+		TraceChunk *first;
+		TraceChunk *current;	//the chunk of the next event, for the owning thread
+	};
+
+	extern atomic_char Tracer_enabled;
+	#define Tracer_BEGIN(name) do { if (atomic_load_explicit(&Tracer_enabled, memory_order_relaxed)) Tracer_record(name, 'B'); } while(0)
+	#define Tracer_END(name) do { if (atomic_load_explicit(&Tracer_enabled, memory_order_relaxed)) Tracer_record(name, 'E'); } while(0)
+
+
+	/** One progress record of a training run. */
+	typedef struct {
+		unsigned long int samples;		//samples seen so far in the run
+		unsigned long int timestamp;	//ns since the run started
+		NeuronUnit loss;				//mean loss since the previous record
+		NeuronUnit minimumLoss;
+		NeuronUnit learningRate;
+	} MetricsRecord;
+
+	#define MetricsSink_CONSOLE 1
+	#define MetricsSink_CSV 2
+	#define MetricsSink_JSONL 3
+	/** Trainers record progress here without blocking, and a reporter thread writes it every intervalMs.
+	 * The console writer prints one line per interval, the CSV and JSONL writers one line per record.
+	 * If the ring is full, records are dropped (and counted) instead of slowing down the trainer. */
+	typedef struct {
+		_Alignas(64) atomic_ulong head;	//next record to write out. Written by the reporter only
+		_Alignas(64) atomic_ulong tail;	//next free slot. Written by the trainer only
+		_Alignas(64) atomic_ulong dropped;
+
+		MetricsRecord *records;
+		unsigned long int mask;
+		unsigned char format;
+		FILE *out;
+		unsigned int intervalMs;		//0: no reporter thread, call MetricsSink_flush
+		unsigned long int runStart;
+
+		pthread_t reporter;
+		pthread_mutex_t drainLock;
+		atomic_char running;
+		unsigned long int lastSamples;	//previous record written, for the throughput
+		unsigned long int lastTime;
+	} MetricsSink;
+
+
+	#define Optimizer_CUSTOM 0
+	#define Optimizer_SGD 1
+	#define Optimizer_NESTEROV 2
+	#define Optimizer_ADAM 3
+	#define Optimizer_RMSPROP 4
+	#define Optimizer_ADAGRAD 5
+	#define Optimizer_KEEP -1	//as a learning rate or momentum argument: keep the value of the optimizer (the default of its type, or the last one set)
+	typedef struct _Optimizer Optimizer;
+	struct _Optimizer {
+		unsigned char type;
+		NeuronUnit learningRate;
+		NeuronUnit momentum;	//SGD and Nesterov
+		NeuronUnit beta1;		//Adam
+		NeuronUnit beta2;		//Adam, decay rate of RMSProp
+		NeuronUnit epsilon;		//Adam, RMSProp and AdaGrad
+
+		unsigned long int step;
+		NeuronUnit stepRate;	//learning rate of the current step, including Adam's bias correction
+		unsigned long int parameterCount;
+		NeuronUnit *state1;		//velocity, first moment or sum of squared gradients
+		NeuronUnit *state2;		//Adam second moment
+
+		/** Applies grad[i]*gradScale to synapses[i] for i in [from, to), updating the state in the same pass. */
+		void (*update)(Optimizer* this, NeuronSynapse* synapses, NeuronUnit* grad, unsigned long int from, unsigned long int to, NeuronUnit gradScale);
+	};
+
+
+	#define BatchSizeSchedule_FIXED 0
+	#define BatchSizeSchedule_STEP 1		//multiplied by growFactor every growEvery samples
+	#define BatchSizeSchedule_NOISE 2		//follows the gradient noise scale, estimated from half batch and full batch gradients
+	#define BatchSizeSchedule_SCALE_NONE 0
+	#define BatchSizeSchedule_SCALE_LINEAR 1	//learning rate proportional to the batch size (SGD)
+	#define BatchSizeSchedule_SCALE_SQRT 2		//proportional to its square root (adaptive optimizers)
+	/** Grows the batch size of the stochastic trainer during a run. It never shrinks. */
+	typedef struct {
+		//props
+		unsigned char mode;
+		unsigned char learningRateScaling;
+		unsigned int minBatch;
+		unsigned int maxBatch;
+		NeuronUnit growFactor;
+		unsigned long int growEvery;
+		NeuronUnit smoothing;			//EMA weight of each new noise estimate
+
+		//state
+		unsigned int batchSize;
+		unsigned long int nextGrowth;
+		NeuronUnit gradientSquare;		//EMA of |G|^2, the squared norm of the true gradient
+		NeuronUnit noiseTrace;			//EMA of tr(S), the total variance of a single sample gradient
+		NeuronUnit noiseScale;			//tr(S) / |G|^2: the batch size where noise and signal are about equal
+	} BatchSizeSchedule;
+
+
 	typedef struct {
 		NeuronUnit* weights;
 		NeuronUnit error;
 	} ErrorPoint;
 
-	typedef struct {
+	struct _BPTrainer {
 		//props
 		NeuralNetwork* network;
 		TrainDataProvider *provider;
@@ -30,10 +263,233 @@
 
 
 		//state
-		char isTraining;
+		atomic_char isTraining;		//cleared by BPTrainer_stopTraining, from any thread
+		Optimizer optimizer;
 		ErrorPoint start;
 		ErrorPoint minimum;
-	} BPTrainer;
+
+		//adaptive batch size of BPTrainer_runStochastic. NULL keeps updateEvery
+		BatchSizeSchedule *batchSchedule;
+
+		//progress reporting
+		MetricsSink *metrics;		//NULL for no reporting
+		unsigned int metricsEvery;	//samples averaged into one record
+
+		//best model tracking. minimum holds the weights of the lowest smoothed loss seen
+		NeuronUnit lossSmoothing;		//EMA weight of each new sample, 1 tracks the raw loss
+		unsigned int snapshotEvery;		//at most one weight copy per that many samples, 0 checks after every update
+		NeuronUnit smoothedLoss;
+		NeuronUnit smoothedWeight;		//bias correction of the EMA
+		unsigned long int samplesSeen;	//since BPTrainer_beginRun
+		unsigned long int lastSnapshotCheck;
+		unsigned long int snapshotCount;
+
+		//called on the training thread about every hookEvery samples, right after a weight update. NULL for none
+		void (*hook)(BPTrainer* trainer, void* context);
+		void *hookContext;
+		unsigned int hookEvery;
+		unsigned long int lastHook;
+
+		//periodic checkpoints, see Checkpointer. NULL for none
+		Checkpointer *checkpointer;
+		char resumeRun;		//set by BPTrainer_restoreCheckpoint: the next BPTrainer_beginRun keeps the optimizer state and samplesSeen
+	};
+
+
+	#define LearningRateSchedule_CONSTANT 0
+	#define LearningRateSchedule_STEP 1		//multiplied by decay every stepEpochs epochs
+	#define LearningRateSchedule_COSINE 2	//from learningRate down to minLearningRate over maxEpochs
+	#define LearningRateSchedule_PLATEAU 3	//multiplied by decay after plateauPatience epochs without improvement
+
+	#define TrainingController_RUNNING 0
+	#define TrainingController_TARGET_REACHED 1
+	#define TrainingController_PLATEAU 2
+	#define TrainingController_SAMPLE_BUDGET 3
+	#define TrainingController_TIME_BUDGET 4
+	#define TrainingController_MAX_EPOCHS 5
+	#define TrainingController_STOPPED 6
+	#define TrainingController_NO_SAMPLES 7		//an epoch made no update (the provider ran dry), so its loss means nothing
+	#define TrainingController_NO_TARGET (-INFINITY)
+	/** Runs a BPTrainer epoch after epoch, until one of the stop criteria is met. Criteria set to 0 are ignored, except targetLoss
+	 * which is ignored when set to TrainingController_NO_TARGET.
+	 * The loss of an epoch is the validation loss if a validation provider is given, otherwise the mean training loss of the epoch. */
+	typedef struct {
+		//props
+		BPTrainer *trainer;
+		unsigned int epochSamples;
+		unsigned int updateEvery;		//0 for online training, otherwise stochastic with this batch size
+		TrainDataProvider *validation;
+		unsigned int validationSamples;
+
+		//stop criteria
+		unsigned int maxEpochs;
+		NeuronUnit targetLoss;
+		unsigned int patience;			//epochs without an improvement of more than minDelta
+		NeuronUnit minDelta;
+		unsigned long int sampleBudget;
+		NeuronUnit timeBudget;			//seconds, checked after every epoch
+
+		//learning rate schedule
+		unsigned char schedule;
+		NeuronUnit learningRate;
+		NeuronUnit momentum;
+		NeuronUnit minLearningRate;
+		NeuronUnit decay;
+		unsigned int stepEpochs;
+		unsigned int plateauPatience;
+
+		//state
+		unsigned int epoch;
+		unsigned long int samples;
+		NeuronUnit currentLearningRate;
+		NeuronUnit lastLoss;
+		NeuronUnit bestLoss;
+		unsigned int epochsWithoutImprovement;
+		unsigned int epochsSinceDecay;
+		NeuronUnit elapsed;				//seconds
+		unsigned char stopReason;
+		atomic_char stopRequested;
+	} TrainingController;
+
+
+	#define BackgroundTrainer_IDLE 0
+	#define BackgroundTrainer_RUNNING 1
+	#define BackgroundTrainer_PAUSED 2
+	/** Runs a BPTrainer on its own thread, so that the caller stays responsive.
+	 * Every publishEvery samples, between two updates, the training thread hands the network to publish
+	 * (to copy it somewhere readers can predict with it, see SharedModel_publishWeights), then honours pause and stop requests. */
+	typedef struct {
+		//props
+		BPTrainer *trainer;
+		void (*publish)(void* target, NeuralNetwork* network);	//NULL to only pause and stop
+		void *publishTarget;
+		unsigned int publishEvery;
+
+		//the run
+		unsigned int updateEvery;		//0 for online training, otherwise stochastic with this batch size
+		NeuronUnit loss;				//mean loss of the last finished run
+		pthread_t thread;
+		char joinable;
+
+		//shared with the training thread
+		atomic_uchar state;
+		atomic_char pauseRequested;
+		atomic_char stopRequested;
+		atomic_ulong samples;			//of the current run, as of the last publication
+		atomic_ulong publications;
+		pthread_mutex_t lock;
+		pthread_cond_t resumed;
+	} BackgroundTrainer;
+
+
+	/** The training state after the weights of a checkpoint file. It is followed by parameterCount NeuronUnits of
+	 * optimizer state1, as many of state2 if hasState2, and as many of the best weights (BPTrainer.minimum). */
+	typedef struct {
+		uint64_t samples;				//BPTrainer.samplesSeen
+		uint64_t step;
+		uint64_t parameterCount;
+		uint32_t optimizerType;
+		uint32_t hasState2;
+		NeuronUnit learningRate;
+		NeuronUnit momentum;
+		NeuronUnit beta1;
+		NeuronUnit beta2;
+		NeuronUnit epsilon;
+		NeuronUnit minimumError;
+	} CheckpointHeader;
+
+	/** A checkpoint as copied from the trainer: the weights, and the CheckpointHeader with what follows it. */
+	typedef struct {
+		NeuronUnit *weights;
+		unsigned char *extra;
+		unsigned long int extraSize;
+	} CheckpointStage;
+
+	/** Writes checkpoints of the trainers it is attached to (see BPTrainer_setCheckpointer) every everySamples samples or everySeconds seconds.
+	 * The training thread only copies its state into a staging buffer, between two updates. A writer thread then saves it
+	 * with NetworkFile_write (temporary file, fsync, rename), so the run never waits for the disk. If the writer is still busy
+	 * when the next checkpoint is due, the waiting one is replaced by the newer one. Checkpoint files are model files: load, watch and serve read them. */
+	struct _Checkpointer {
+		//props
+		NeuralNetwork *network;			//gives the topology of the files
+		char *path;
+		unsigned long int everySamples;	//0 to ignore
+		NeuronUnit everySeconds;		//0 to ignore
+
+		//training thread
+		unsigned long int lastSamples;
+		unsigned long int lastTime;		//ns, CLOCK_MONOTONIC
+
+		//shared with the writer
+		CheckpointStage captured;		//filled by the training thread
+		CheckpointStage writing;		//owned by the writer while it writes
+		char pending;					//captured holds a checkpoint that is not written yet
+		char busy;
+		char running;
+		pthread_t writer;
+		pthread_mutex_t lock;
+		pthread_cond_t changed;
+
+		atomic_ulong written;
+		atomic_ulong replaced;			//captured again before the writer took them
+		atomic_ulong failures;
+		atomic_ulong lastWriteNs;		//duration of the last write, fsync and rename included
+	};
+
+
+	/** Full batch L-BFGS. Every evaluation is an exact pass over the whole data set, split across replicas. */
+	typedef struct {
+		//props
+		NeuralNetwork* network;
+		TrainDataSet *data;
+		void (*errorUpdater)(NeuralNetwork* net, NeuronUnit* expected, NeuronUnit* errorValue, NeuronUnit* errorGradients);
+		unsigned short int historySize;
+
+		//state
+		NetworkReplicas replicas;
+		NeuronUnit *s;			//historySize weight steps, one after the other
+		NeuronUnit *y;			//historySize gradient changes, one after the other
+		NeuronUnit *rho;
+		NeuronUnit *alpha;
+		unsigned short int historyLength;
+		unsigned short int historyStart;
+
+		NeuronUnit *weights;
+		NeuronUnit *gradient;
+		NeuronUnit *direction;
+		NeuronUnit *trialWeights;
+		NeuronUnit *trialGradient;
+		NeuronUnit *threadGradients;	//one gradient per replica, reduced after each pass
+		NeuronUnit *threadErrors;		//one error value and outputCount error derivatives per replica
+
+		unsigned long int dataPasses;
+		unsigned int iterations;
+	} LBFGSTrainer;
+
+
+	/** Levenberg-Marquardt on the squared output residuals of a TrainDataSet.
+	 * The Jacobian rows are computed per sample by the replicas, and only J^T*J and J^T*e are kept. */
+	typedef struct {
+		//props
+		NeuralNetwork* network;
+		TrainDataSet *data;
+
+		//state
+		NetworkReplicas replicas;
+		NeuronUnit *hessian;			//J^T*J, n*n
+		NeuronUnit *gradient;			//J^T*e
+		NeuronUnit *trialHessian;
+		NeuronUnit *trialGradient;
+		NeuronUnit *factor;				//Cholesky factor of the damped system
+		NeuronUnit *weights;
+		NeuronUnit *trialWeights;
+		NeuronUnit *step;
+		NeuronUnit *threadSums;			//per replica: n*n + n partial sums, the squared error, a Jacobian row and outputCount expected values
+
+		NeuronUnit damping;
+		unsigned long int dataPasses;
+		unsigned int iterations;
+	} LMTrainer;
 
 
 
@@ -47,6 +503,93 @@
 	void TrainDataProvider_deinit(TrainDataProvider* this);
 	void TrainDataProvider_reset(TrainDataProvider* this, unsigned int maxReslts);
 
+	void TrainDataProvider_initIndexed(
+		TrainDataProvider* this,
+		char (*provideSample)(TrainDataProvider* this, NeuralNetwork* net, unsigned int index),
+		void *source,
+		unsigned short int outputCount,
+		unsigned int sampleCount,
+		unsigned int maxResults,
+		unsigned int blockSize);
+	void TrainDataProvider_shuffle(TrainDataProvider* this);
+
+	void TrainDataSet_init(TrainDataSet* this, const NeuronUnit *rows, unsigned int sampleCount, unsigned short int inputCount, unsigned short int outputCount);
+	char TrainDataSet_initMapped(TrainDataSet* this, const char *path, unsigned short int inputCount, unsigned short int outputCount);
+	void TrainDataSet_deinit(TrainDataSet* this);
+	void TrainDataSet_initFromProvider(TrainDataSet* this, TrainDataProvider* provider, NeuralNetwork* net, unsigned int sampleCount);
+	void TrainDataSet_loadSample(TrainDataSet* this, NeuralNetwork* net, unsigned int index, NeuronUnit* expected);
+	char TrainDataSet_provideSample(TrainDataProvider* provider, NeuralNetwork* net, unsigned int index);
+
+	void NetworkReplicas_init(NetworkReplicas* this, NeuralNetwork* network, unsigned int threadCount);
+	void NetworkReplicas_deinit(NetworkReplicas* this);
+	void NetworkReplicas_loadSynapseWeights(NetworkReplicas* this, NeuronUnit* weights);
+	void NetworkReplicas_run(
+		NetworkReplicas* this,
+		unsigned int itemCount,
+		void (*job)(NeuralNetwork* replica, unsigned int threadIndex, unsigned int from, unsigned int to, void* context),
+		void* context);
+	unsigned int NetworkReplicas_defaultThreadCount();
+
+	void SampleRing_init(SampleRing* this, unsigned int capacity, unsigned int rowSize);
+	void SampleRing_deinit(SampleRing* this);
+	NeuronUnit* SampleRing_reserve(SampleRing* this);
+	void SampleRing_commit(SampleRing* this);
+	const NeuronUnit* SampleRing_peek(SampleRing* this);
+	void SampleRing_release(SampleRing* this);
+	unsigned long int SampleRing_occupancy(SampleRing* this);
+
+	void AsyncDataProvider_init(
+		AsyncDataProvider* this,
+		char (*generate)(void *context, unsigned int producerIndex, NeuronUnit *input, NeuronUnit *expected),
+		void *context,
+		unsigned short int inputCount,
+		unsigned short int outputCount,
+		unsigned int producerCount,
+		unsigned int ringCapacity,
+		unsigned int maxResults);
+	void AsyncDataProvider_deinit(AsyncDataProvider* this);
+	void AsyncDataProvider_getStats(AsyncDataProvider* this, AsyncDataProviderStats* stats);
+	void AsyncDataProvider_printStats(AsyncDataProvider* this, FILE* out);
+
+
+	void Tracer_start();
+	void Tracer_stop();
+	void Tracer_record(const char *name, char phase);
+	void Tracer_nameThread(const char *name);
+	unsigned long int Tracer_eventCount();
+	unsigned long int Tracer_droppedCount();
+	char Tracer_write(const char *path);
+
+
+	void EvaluationMetrics_init(EvaluationMetrics* this, unsigned short int outputCount);
+	void EvaluationMetrics_deinit(EvaluationMetrics* this);
+	void EvaluationMetrics_print(EvaluationMetrics* this, FILE* out);
+	void NetworkEvaluator_init(NetworkEvaluator* this, NeuralNetwork* network, unsigned int threadCount);
+	void NetworkEvaluator_deinit(NetworkEvaluator* this);
+	void NetworkEvaluator_run(
+		NetworkEvaluator* this,
+		TrainDataProvider* provider,
+		void (*lossFunction)(NeuralNetwork* net, NeuronUnit* expected, NeuronUnit* errorValue, NeuronUnit* errorGradients),
+		EvaluationMetrics* metrics);
+	void NeuralNetwork_evaluate(
+		NeuralNetwork* net,
+		TrainDataProvider* provider,
+		void (*lossFunction)(NeuralNetwork* net, NeuronUnit* expected, NeuronUnit* errorValue, NeuronUnit* errorGradients),
+		EvaluationMetrics* metrics);
+
+
+	void MetricsSink_init(MetricsSink* this, unsigned char format, FILE* out, unsigned int capacity, unsigned int intervalMs);
+	void MetricsSink_deinit(MetricsSink* this);
+	void MetricsSink_beginRun(MetricsSink* this);
+	void MetricsSink_record(MetricsSink* this, unsigned long int samples, NeuronUnit loss, NeuronUnit minimumLoss, NeuronUnit learningRate);
+	void MetricsSink_flush(MetricsSink* this);
+
+
+	void Optimizer_init(Optimizer* this, unsigned char type, unsigned long int parameterCount);
+	void Optimizer_deinit(Optimizer* this);
+	void Optimizer_reset(Optimizer* this);
+	void Optimizer_step(Optimizer* this, NeuralNetwork* net, NeuronUnit* grad, NeuronUnit gradScale);
+
 
 	void BPTrainer_init(
 		BPTrainer* this,
@@ -54,10 +597,60 @@
 		TrainDataProvider *provider,
 		void (*errorUpdater)(NeuralNetwork* net, NeuronUnit* expected, NeuronUnit* errorValue, NeuronUnit* errorGradients));
 	void BPTrainer_deinit(BPTrainer* this);
+	void BPTrainer_setOptimizer(BPTrainer* this, unsigned char optimizerType);
+	void BPTrainer_setMetrics(BPTrainer* this, MetricsSink* metrics, unsigned int every);
+	void BPTrainer_setBestTracking(BPTrainer* this, NeuronUnit lossSmoothing, unsigned int snapshotEvery);
+	void BPTrainer_setHook(BPTrainer* this, void (*hook)(BPTrainer* trainer, void* context), void* context, unsigned int every);
 
 	void BPTrainer_trainOnline(BPTrainer* this, NeuronUnit learningRate, NeuronUnit momentum, char debug);
 	void BPTrainer_trainStochastic(BPTrainer* this, unsigned int updateEvery, NeuronUnit learningRate, NeuronUnit momentum, char debug);
 	void BPTrainer_stopTraining(BPTrainer* this);
+	void BPTrainer_beginRun(BPTrainer* this);
+	NeuronUnit BPTrainer_runOnline(BPTrainer* this, char debug);
+	NeuronUnit BPTrainer_runStochastic(BPTrainer* this, unsigned int updateEvery, char debug);
+
+	void BatchSizeSchedule_init(BatchSizeSchedule* this, unsigned char mode, unsigned int minBatch, unsigned int maxBatch, unsigned char learningRateScaling);
+	void BatchSizeSchedule_reset(BatchSizeSchedule* this);
+	void BatchSizeSchedule_observe(BatchSizeSchedule* this, NeuronUnit halfBatchSquare, unsigned int halfBatch, NeuronUnit fullBatchSquare, unsigned int fullBatch);
+	unsigned int BatchSizeSchedule_update(BatchSizeSchedule* this, unsigned long int samplesSeen);
+	NeuronUnit BatchSizeSchedule_learningRateFactor(BatchSizeSchedule* this);
+
+	char TrainingController_init(TrainingController* this, BPTrainer* trainer, unsigned int epochSamples);
+	void TrainingController_setSchedule(TrainingController* this, unsigned char schedule, NeuronUnit decay, unsigned int epochs);
+	unsigned char TrainingController_run(TrainingController* this);
+	void TrainingController_stop(TrainingController* this);
+	const char* TrainingController_stopReasonName(unsigned char stopReason);
+
+	void BackgroundTrainer_init(BackgroundTrainer* this, BPTrainer* trainer, void (*publish)(void* target, NeuralNetwork* network), void* publishTarget, unsigned int publishEvery);
+	void BackgroundTrainer_deinit(BackgroundTrainer* this);
+	char BackgroundTrainer_start(BackgroundTrainer* this, unsigned int updateEvery, NeuronUnit learningRate, NeuronUnit momentum);
+	void BackgroundTrainer_pause(BackgroundTrainer* this);
+	void BackgroundTrainer_resume(BackgroundTrainer* this);
+	void BackgroundTrainer_stop(BackgroundTrainer* this);
+	void BackgroundTrainer_wait(BackgroundTrainer* this);
+
+	void Checkpointer_init(Checkpointer* this, NeuralNetwork* network, const char* path, unsigned long int everySamples, NeuronUnit everySeconds);
+	void Checkpointer_deinit(Checkpointer* this);
+	void Checkpointer_check(Checkpointer* this, BPTrainer* trainer);
+	void Checkpointer_capture(Checkpointer* this, BPTrainer* trainer);
+	void Checkpointer_flush(Checkpointer* this);
+	void BPTrainer_setCheckpointer(BPTrainer* this, Checkpointer* checkpointer);
+	char BPTrainer_restoreCheckpoint(BPTrainer* this, const char* path);
+
+	void LBFGSTrainer_init(
+		LBFGSTrainer* this,
+		NeuralNetwork* network,
+		TrainDataSet* data,
+		void (*errorUpdater)(NeuralNetwork* net, NeuronUnit* expected, NeuronUnit* errorValue, NeuronUnit* errorGradients),
+		unsigned short int historySize,
+		unsigned int threadCount);
+	void LBFGSTrainer_deinit(LBFGSTrainer* this);
+	NeuronUnit LBFGSTrainer_evaluate(LBFGSTrainer* this, NeuronUnit* weights, NeuronUnit* gradient);
+	NeuronUnit LBFGSTrainer_train(LBFGSTrainer* this, unsigned int maxIterations, NeuronUnit gradientTolerance);
+
+	void LMTrainer_init(LMTrainer* this, NeuralNetwork* network, TrainDataSet* data, unsigned int threadCount);
+	void LMTrainer_deinit(LMTrainer* this);
+	NeuronUnit LMTrainer_train(LMTrainer* this, unsigned int maxIterations, NeuronUnit gradientTolerance);
 
 	void BPTrainer_saveState(BPTrainer* this, FILE f);
 	void BPTrainer_loadState(BPTrainer* this, FILE f);
@@ -0,0 +1,162 @@
+#include "NetworkTrain.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+
+//UPDATE KERNELS. Each one reads the gradient, updates its state and writes the weight in a single pass.
+	static void Optimizer_sgd(Optimizer* this, NeuronSynapse* restrict synapses, NeuronUnit* restrict grad, unsigned long int from, unsigned long int to, NeuronUnit gradScale) {
+		NeuronUnit* restrict velocity = this->state1;
+		NeuronUnit rate = this->learningRate * gradScale;
+		NeuronUnit momentum = this->momentum;
+
+		for (unsigned long int i = from; i < to; ++i) {
+			NeuronUnit v = momentum * velocity[i] - rate * grad[i];
+			velocity[i] = v;
+			synapses[i].weight += v;
+		}
+	}
+
+	static void Optimizer_nesterov(Optimizer* this, NeuronSynapse* restrict synapses, NeuronUnit* restrict grad, unsigned long int from, unsigned long int to, NeuronUnit gradScale) {
+		NeuronUnit* restrict velocity = this->state1;
+		NeuronUnit rate = this->learningRate * gradScale;
+		NeuronUnit momentum = this->momentum;
+
+		for (unsigned long int i = from; i < to; ++i) {
+			NeuronUnit previous = velocity[i];
+			NeuronUnit v = momentum * previous - rate * grad[i];
+			velocity[i] = v;
+			synapses[i].weight += (1 + momentum) * v - momentum * previous;
+		}
+	}
+
+	static void Optimizer_adam(Optimizer* this, NeuronSynapse* restrict synapses, NeuronUnit* restrict grad, unsigned long int from, unsigned long int to, NeuronUnit gradScale) {
+		NeuronUnit* restrict m = this->state1;
+		NeuronUnit* restrict v = this->state2;
+		NeuronUnit beta1 = this->beta1, beta2 = this->beta2, epsilon = this->epsilon;
+		NeuronUnit rate = this->stepRate;
+
+		for (unsigned long int i = from; i < to; ++i) {
+			NeuronUnit g = grad[i] * gradScale;
+			NeuronUnit mi = beta1 * m[i] + (1 - beta1) * g;
+			NeuronUnit vi = beta2 * v[i] + (1 - beta2) * g * g;
+			m[i] = mi;
+			v[i] = vi;
+			synapses[i].weight -= rate * mi / (sqrt(vi) + epsilon);
+		}
+	}
+
+	static void Optimizer_rmsprop(Optimizer* this, NeuronSynapse* restrict synapses, NeuronUnit* restrict grad, unsigned long int from, unsigned long int to, NeuronUnit gradScale) {
+		NeuronUnit* restrict v = this->state1;
+		NeuronUnit decay = this->beta2, epsilon = this->epsilon;
+		NeuronUnit rate = this->learningRate;
+
+		for (unsigned long int i = from; i < to; ++i) {
+			NeuronUnit g = grad[i] * gradScale;
+			NeuronUnit vi = decay * v[i] + (1 - decay) * g * g;
+			v[i] = vi;
+			synapses[i].weight -= rate * g / (sqrt(vi) + epsilon);
+		}
+	}
+
+	static void Optimizer_adagrad(Optimizer* this, NeuronSynapse* restrict synapses, NeuronUnit* restrict grad, unsigned long int from, unsigned long int to, NeuronUnit gradScale) {
+		NeuronUnit* restrict sum = this->state1;
+		NeuronUnit epsilon = this->epsilon;
+		NeuronUnit rate = this->learningRate;
+
+		for (unsigned long int i = from; i < to; ++i) {
+			NeuronUnit g = grad[i] * gradScale;
+			NeuronUnit si = sum[i] + g * g;
+			sum[i] = si;
+			synapses[i].weight -= rate * g / (sqrt(si) + epsilon);
+		}
+	}
+
+
+
+//LIFE CIRCLE
+	/** Sets up an optimizer with the usual defaults of its type. For Optimizer_CUSTOM, set update after init. */
+	void Optimizer_init(Optimizer* this, unsigned char type, unsigned long int parameterCount) {
+		this->type = type;
+		this->learningRate = 0.1;
+		this->momentum = 0;
+		this->beta1 = 0.9;
+		this->beta2 = 0.999;
+		this->epsilon = 1e-8;
+		this->parameterCount = parameterCount;
+		this->state1 = malloc(parameterCount * sizeof(NeuronUnit));
+		this->state2 = NULL;
+
+		switch (type) {
+			case Optimizer_SGD:
+				this->update = *Optimizer_sgd;
+				break;
+
+			case Optimizer_NESTEROV:
+				this->momentum = 0.9;
+				this->update = *Optimizer_nesterov;
+				break;
+
+			case Optimizer_ADAM:
+				this->learningRate = 0.001;
+				this->state2 = malloc(parameterCount * sizeof(NeuronUnit));
+				this->update = *Optimizer_adam;
+				break;
+
+			case Optimizer_RMSPROP:
+				this->learningRate = 0.001;
+				this->beta2 = 0.9;
+				this->update = *Optimizer_rmsprop;
+				break;
+
+			case Optimizer_ADAGRAD:
+				this->learningRate = 0.01;
+				this->update = *Optimizer_adagrad;
+				break;
+
+			default:
+				this->update = NULL;
+				break;
+		}
+
+		Optimizer_reset(this);
+	}
+
+	void Optimizer_deinit(Optimizer* this) {
+		free(this->state1);
+		free(this->state2);
+	}
+
+	void Optimizer_reset(Optimizer* this) {
+		this->step = 0;
+		this->stepRate = this->learningRate;
+		memset(this->state1, 0, this->parameterCount * sizeof(NeuronUnit));
+		if (this->state2 != NULL) memset(this->state2, 0, this->parameterCount * sizeof(NeuronUnit));
+	}
+
+
+
+//OPERATIONS
+	/** Applies one update with the gradient grad, scaled by gradScale (e.g. 1/batchSize), directly to the network weights. */
+	void Optimizer_step(Optimizer* this, NeuralNetwork* net, NeuronUnit* grad, NeuronUnit gradScale) {
+		this->step++;
+		if (this->type == Optimizer_ADAM) {
+			this->stepRate = this->learningRate * sqrt(1 - pow(this->beta2, this->step)) / (1 - pow(this->beta1, this->step));
+		}
+		else this->stepRate = this->learningRate;
+
+		#ifdef NETWORK_STATS
+			//one kernel call per layer range, so that the update time is attributed to each layer.
+			unsigned long int from = 0;
+			for (unsigned short int i = 0; i < net->layerCount; ++i) {
+				NetworkLayer* layer = net->layers + i;
+				if (layer->synapseCount == 0) continue;
+				NetworkStats_BEGIN(start);
+				this->update(this, net->synapses, grad, from, from + layer->synapseCount, gradScale);
+				NetworkStats_END(layer, NetworkStats_ADJUST_WEIGHTS, start, layer->synapseCount);
+				from += layer->synapseCount;
+			}
+		#else
+			this->update(this, net->synapses, grad, 0, net->synapseCount, gradScale);
+		#endif
+	}
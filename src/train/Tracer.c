@@ -0,0 +1,158 @@
+#include "NetworkTrain.h"
+#include <stdlib.h>
+#include <time.h>
+
+atomic_char Tracer_enabled = 0;
+
+static _Atomic(TraceBuffer*) buffers = NULL;
+static atomic_uint nextThreadId = 1;
+static unsigned long int startTime = 0;
+static pthread_key_t releaseKey;
+static pthread_once_t releaseKeyOnce = PTHREAD_ONCE_INIT;
+static __thread TraceBuffer *localBuffer = NULL;
+
+
+//BUFFERS
+	static unsigned long int Tracer_now() {
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+	}
+
+	static void Tracer_releaseBuffer(void* buffer) {
+		atomic_store_explicit(&((TraceBuffer*) buffer)->inUse, 0, memory_order_release);
+	}
+
+	static void Tracer_createReleaseKey() {
+		pthread_key_create(&releaseKey, Tracer_releaseBuffer);
+	}
+
+	static TraceChunk* Tracer_createChunk() {
+		TraceChunk *chunk = malloc(sizeof(TraceChunk));
+		atomic_init(&chunk->next, NULL);
+		return chunk;
+	}
+
+	/** Claims a released buffer, or pushes a new one to the list. Both are lock-free. */
+	static TraceBuffer* Tracer_claimBuffer() {
+		pthread_once(&releaseKeyOnce, Tracer_createReleaseKey);
+
+		TraceBuffer *buffer = atomic_load_explicit(&buffers, memory_order_acquire);
+		for (; buffer != NULL; buffer = buffer->next) {
+			char expected = 0;
+			if (atomic_compare_exchange_strong(&buffer->inUse, &expected, 1)) break;
+		}
+
+		if (buffer == NULL) {
+			buffer = malloc(sizeof(TraceBuffer));
+			buffer->first = buffer->current = Tracer_createChunk();
+			atomic_init(&buffer->inUse, 1);
+			atomic_init(&buffer->count, 0);
+			atomic_init(&buffer->dropped, 0);
+
+			buffer->next = atomic_load_explicit(&buffers, memory_order_relaxed);
+			while (!atomic_compare_exchange_weak(&buffers, &buffer->next, buffer));
+		}
+
+		buffer->threadId = atomic_fetch_add(&nextThreadId, 1);
+		pthread_setspecific(releaseKey, buffer);
+		return buffer;
+	}
+
+
+
+//RECORDING
+	void Tracer_record(const char *name, char phase) {
+		TraceBuffer *buffer = localBuffer;
+		if (buffer == NULL) buffer = localBuffer = Tracer_claimBuffer();
+
+		unsigned long int count = atomic_load_explicit(&buffer->count, memory_order_relaxed);
+		if (count >= (unsigned long int) Tracer_CHUNK_CAPACITY * Tracer_MAX_CHUNKS) {
+			atomic_fetch_add_explicit(&buffer->dropped, 1, memory_order_relaxed);
+			return;
+		}
+
+		//the chunk is published before the count that makes Tracer_write read it
+		unsigned long int offset = count % Tracer_CHUNK_CAPACITY;
+		if (offset == 0 && count > 0) {
+			TraceChunk *next = atomic_load_explicit(&buffer->current->next, memory_order_relaxed);
+			if (next == NULL) {
+				next = Tracer_createChunk();
+				atomic_store_explicit(&buffer->current->next, next, memory_order_release);
+			}
+			buffer->current = next;
+		}
+
+		buffer->current->events[offset] = (TraceEvent) { name, Tracer_now() - startTime, buffer->threadId, phase };
+		atomic_store_explicit(&buffer->count, count + 1, memory_order_release);
+	}
+
+	/** Names the calling thread in the trace viewer. */
+	void Tracer_nameThread(const char *name) {
+		if (atomic_load_explicit(&Tracer_enabled, memory_order_relaxed)) Tracer_record(name, 'M');
+	}
+
+	/** Clears all buffers and starts recording. Call it while no other thread is recording. */
+	void Tracer_start() {
+		atomic_store(&Tracer_enabled, 0);
+		for (TraceBuffer *buffer = atomic_load(&buffers); buffer != NULL; buffer = buffer->next) {
+			atomic_store(&buffer->count, 0);
+			atomic_store(&buffer->dropped, 0);
+			buffer->current = buffer->first;
+		}
+		startTime = Tracer_now();
+		atomic_store(&Tracer_enabled, 1);
+	}
+
+	void Tracer_stop() {
+		atomic_store(&Tracer_enabled, 0);
+	}
+
+	unsigned long int Tracer_eventCount() {
+		unsigned long int count = 0;
+		for (TraceBuffer *buffer = atomic_load(&buffers); buffer != NULL; buffer = buffer->next) count += atomic_load(&buffer->count);
+		return count;
+	}
+
+	/** Events that did not fit in the buffers since Tracer_start. */
+	unsigned long int Tracer_droppedCount() {
+		unsigned long int dropped = 0;
+		for (TraceBuffer *buffer = atomic_load(&buffers); buffer != NULL; buffer = buffer->next) dropped += atomic_load(&buffer->dropped);
+		return dropped;
+	}
+
+
+
+//EXPORT
+	/** Writes the recorded events in the Chrome trace event format (chrome://tracing, ui.perfetto.dev). Returns 0 on failure. */
+	char Tracer_write(const char *path) {
+		FILE *file = fopen(path, "w");
+		if (file == NULL) return 0;
+
+		unsigned long int dropped = 0;
+		char first = 1;
+		fprintf(file, "{\"traceEvents\":[\n");
+		for (TraceBuffer *buffer = atomic_load(&buffers); buffer != NULL; buffer = buffer->next) {
+			unsigned long int count = atomic_load_explicit(&buffer->count, memory_order_acquire);
+			dropped += atomic_load(&buffer->dropped);
+
+			TraceChunk *chunk = buffer->first;
+			for (unsigned long int i = 0; i < count; ++i) {
+				if (i > 0 && i % Tracer_CHUNK_CAPACITY == 0) chunk = atomic_load_explicit(&chunk->next, memory_order_acquire);
+				TraceEvent *event = chunk->events + i % Tracer_CHUNK_CAPACITY;
+				if (!first) fprintf(file, ",\n");
+				first = 0;
+
+				if (event->phase == 'M') {
+					fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", event->threadId, event->name);
+				}
+				else {
+					fprintf(file, "{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}",
+						event->name, event->phase, event->timestamp / 1000.0, event->threadId);
+				}
+			}
+		}
+		fprintf(file, "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"droppedEvents\":%lu}}\n", dropped);
+
+		return fclose(file) == 0;
+	}
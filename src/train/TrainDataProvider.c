@@ -11,13 +11,102 @@ void TrainDataProvider_init(
 	this->counter = 0;
 	this->maxResults = maxResults;
 	this->expected = malloc(outputCount * sizeof(NeuronUnit));
+
+	this->provideSample = NULL;
+	this->source = NULL;
+	this->sampleCount = 0;
+	this->epoch = 0;
+	this->epochPosition = 0;
+	this->order = NULL;
+	this->blockSize = 0;
 }
 
 void TrainDataProvider_deinit(TrainDataProvider* this) {
 	free(this->expected);
+	free(this->order);
 }
 
 void TrainDataProvider_reset(TrainDataProvider* this, unsigned int maxResults) {
 	this->counter = 0;
 	this->maxResults = maxResults;
 }
+
+
+
+//INDEXED PROVIDERS
+	static unsigned int randomBelow(unsigned int limit) {
+		unsigned long int r = ((unsigned long int)rand() << 31) ^ (unsigned long int)rand();
+		return (unsigned int)(r % limit);
+	}
+
+	static void shuffleRange(unsigned int *values, unsigned int length) {
+		for (unsigned int i = length; i > 1; --i) {
+			unsigned int j = randomBelow(i);
+			unsigned int tmp = values[i-1];
+			values[i-1] = values[j];
+			values[j] = tmp;
+		}
+	}
+
+	/** Feeds the next sample of the current epoch. Starts a new, reshuffled epoch when the current one is exhausted. */
+	static char TrainDataProvider_provideIndexed(TrainDataProvider* this, NeuralNetwork* net) {
+		this->counter++;
+		if (this->counter > this->maxResults || this->sampleCount == 0) return 0;
+
+		if (this->epochPosition >= this->sampleCount) {
+			this->epoch++;
+			this->epochPosition = 0;
+			TrainDataProvider_shuffle(this);
+		}
+
+		return this->provideSample(this, net, this->order[this->epochPosition++]);
+	}
+
+	void TrainDataProvider_initIndexed(
+			TrainDataProvider* this,
+			char (*provideSample)(TrainDataProvider* this, NeuralNetwork* net, unsigned int index),
+			void *source,
+			unsigned short int outputCount,
+			unsigned int sampleCount,
+			unsigned int maxResults,
+			unsigned int blockSize) {
+		TrainDataProvider_init(this, *TrainDataProvider_provideIndexed, outputCount, maxResults);
+		this->provideSample = provideSample;
+		this->source = source;
+		this->sampleCount = sampleCount;
+		this->blockSize = blockSize;
+		this->order = malloc(sampleCount * sizeof(unsigned int));
+		TrainDataProvider_shuffle(this);
+	}
+
+	/** Generates a new sample order. Only the index array is permuted, the samples themselves are never touched.
+	 * With a blockSize, the order of the blocks is randomized and then each block is shuffled internally,
+	 * so the reads of an epoch stay within blockSize consecutive samples at a time. */
+	void TrainDataProvider_shuffle(TrainDataProvider* this) {
+		unsigned int count = this->sampleCount;
+		unsigned int *order = this->order;
+		if (count == 0) return;
+
+		unsigned int blockSize = this->blockSize;
+		if (blockSize == 0 || blockSize >= count) {
+			for (unsigned int i = count; i--;) order[i] = i;
+			shuffleRange(order, count);
+			return;
+		}
+
+		unsigned int blockCount = (count + blockSize - 1) / blockSize;
+		unsigned int *blocks = malloc(blockCount * sizeof(unsigned int));
+		for (unsigned int i = blockCount; i--;) blocks[i] = i;
+		shuffleRange(blocks, blockCount);
+
+		unsigned int position = 0;
+		for (unsigned int b = 0; b < blockCount; ++b) {
+			unsigned int first = blocks[b] * blockSize;
+			unsigned int length = (first + blockSize > count)? count - first : blockSize;
+			for (unsigned int i = 0; i < length; ++i) order[position + i] = first + i;
+			shuffleRange(order + position, length);
+			position += length;
+		}
+
+		free(blocks);
+	}
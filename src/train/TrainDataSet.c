@@ -0,0 +1,92 @@
+#include "NetworkTrain.h"
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+//LIFE CIRCLE
+	void TrainDataSet_init(TrainDataSet* this, const NeuronUnit *rows, unsigned int sampleCount, unsigned short int inputCount, unsigned short int outputCount) {
+		this->rows = rows;
+		this->sampleCount = sampleCount;
+		this->inputCount = inputCount;
+		this->outputCount = outputCount;
+		this->mapping = NULL;
+		this->mappingSize = 0;
+		this->ownedRows = NULL;
+	}
+
+	/** Draws sampleCount samples from provider and keeps them in memory, so they can be revisited in any order. */
+	void TrainDataSet_initFromProvider(TrainDataSet* this, TrainDataProvider* provider, NeuralNetwork* net, unsigned int sampleCount) {
+		unsigned short int inputCount = net->layers[0].neuronCount;
+		unsigned short int outputCount = net->layers[net->layerCount - 1].neuronCount;
+		unsigned int rowSize = inputCount + outputCount;
+		NeuronUnit *rows = malloc((unsigned long int)sampleCount * rowSize * sizeof(NeuronUnit));
+
+		TrainDataProvider_reset(provider, sampleCount);
+		unsigned int count = 0;
+		while (count < sampleCount && provider->provideInput(provider, net)) {
+			NeuronUnit *row = rows + (unsigned long int)count * rowSize;
+			for (unsigned short int i = inputCount; i--;) row[i] = net->layers[0].neurons[i].out;
+			for (unsigned short int i = outputCount; i--;) row[inputCount + i] = provider->expected[i];
+			count++;
+		}
+
+		TrainDataSet_init(this, rows, count, inputCount, outputCount);
+		this->ownedRows = rows;
+	}
+
+	/** Maps a file of raw NeuronUnit rows into memory. Returns 0 if the file cannot be mapped. */
+	char TrainDataSet_initMapped(TrainDataSet* this, const char *path, unsigned short int inputCount, unsigned short int outputCount) {
+		TrainDataSet_init(this, NULL, 0, inputCount, outputCount);
+
+		int fd = open(path, O_RDONLY);
+		if (fd < 0) return 0;
+
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0) {
+			close(fd);
+			return 0;
+		}
+
+		void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (mapping == MAP_FAILED) return 0;
+
+		unsigned long int rowSize = (inputCount + outputCount) * sizeof(NeuronUnit);
+		this->mapping = mapping;
+		this->mappingSize = st.st_size;
+		this->rows = (const NeuronUnit*) mapping;
+		this->sampleCount = st.st_size / rowSize;
+		return 1;
+	}
+
+	void TrainDataSet_deinit(TrainDataSet* this) {
+		if (this->mapping != NULL) munmap(this->mapping, this->mappingSize);
+		free(this->ownedRows);
+		this->mapping = NULL;
+		this->ownedRows = NULL;
+	}
+
+
+
+//SAMPLES
+	/** Feeds the inputs of sample index to net, and writes its expected outputs to expected. */
+	void TrainDataSet_loadSample(TrainDataSet* this, NeuralNetwork* net, unsigned int index, NeuronUnit* expected) {
+		unsigned short int inputCount = this->inputCount;
+		const NeuronUnit *row = this->rows + (unsigned long int)index * (inputCount + this->outputCount);
+
+		Neuron *inputs = net->layers[0].neurons;
+		for (unsigned short int i = inputCount; i--;) inputs[i].out = row[i];
+		for (unsigned short int i = this->outputCount; i--;) expected[i] = row[inputCount + i];
+	}
+
+	/** provideSample implementation for indexed providers whose source is a TrainDataSet. */
+	char TrainDataSet_provideSample(TrainDataProvider* provider, NeuralNetwork* net, unsigned int index) {
+		TrainDataSet *set = (TrainDataSet*) provider->source;
+		if (index >= set->sampleCount) return 0;
+
+		TrainDataSet_loadSample(set, net, index, provider->expected);
+		return 1;
+	}
@@ -0,0 +1,185 @@
+#include "NetworkTrain.h"
+#include <math.h>
+#include <time.h>
+
+
+//LIFE CIRCLE
+	/** Defaults: online training with learning rate 0.1, at most 100 epochs, patience of 5 epochs and a constant learning rate.
+	 * epochSamples of 0 uses the sample count of an indexed provider. Returns 0 if that leaves no sample to train on. */
+	char TrainingController_init(TrainingController* this, BPTrainer* trainer, unsigned int epochSamples) {
+		this->trainer = trainer;
+		this->epochSamples = epochSamples == 0? trainer->provider->sampleCount : epochSamples;
+		this->updateEvery = 0;
+		this->validation = NULL;
+		this->validationSamples = 0;
+
+		this->maxEpochs = 100;
+		this->targetLoss = TrainingController_NO_TARGET;
+		this->patience = 5;
+		this->minDelta = 0;
+		this->sampleBudget = 0;
+		this->timeBudget = 0;
+
+		this->schedule = LearningRateSchedule_CONSTANT;
+		this->learningRate = 0.1;
+		this->momentum = 0;
+		this->minLearningRate = 0;
+		this->decay = 0.5;
+		this->stepEpochs = 10;
+		this->plateauPatience = 2;
+
+		this->stopReason = TrainingController_RUNNING;
+		atomic_init(&this->stopRequested, 0);
+		return this->epochSamples > 0;
+	}
+
+	/** epochs is the step length of STEP and the patience of PLATEAU. */
+	void TrainingController_setSchedule(TrainingController* this, unsigned char schedule, NeuronUnit decay, unsigned int epochs) {
+		this->schedule = schedule;
+		this->decay = decay;
+		if (schedule == LearningRateSchedule_STEP) this->stepEpochs = epochs == 0? 1 : epochs;
+		else if (schedule == LearningRateSchedule_PLATEAU) this->plateauPatience = epochs == 0? 1 : epochs;
+	}
+
+	const char* TrainingController_stopReasonName(unsigned char stopReason) {
+		switch (stopReason) {
+			case TrainingController_TARGET_REACHED: return "target loss reached";
+			case TrainingController_PLATEAU: return "no improvement";
+			case TrainingController_SAMPLE_BUDGET: return "sample budget";
+			case TrainingController_TIME_BUDGET: return "time budget";
+			case TrainingController_MAX_EPOCHS: return "max epochs";
+			case TrainingController_STOPPED: return "stopped";
+			case TrainingController_NO_SAMPLES: return "no samples";
+			default: return "running";
+		}
+	}
+
+
+
+//SCHEDULE
+	static NeuronUnit TrainingController_scheduledRate(TrainingController* this) {
+		switch (this->schedule) {
+			case LearningRateSchedule_STEP:
+				return this->learningRate * pow(this->decay, this->epoch / this->stepEpochs);
+
+			case LearningRateSchedule_COSINE: {
+				if (this->maxEpochs == 0) return this->learningRate;
+				NeuronUnit progress = (NeuronUnit) this->epoch / this->maxEpochs;
+				return this->minLearningRate + (this->learningRate - this->minLearningRate) * (1 + cos(M_PI * progress)) / 2;
+			}
+
+			case LearningRateSchedule_PLATEAU:
+				if (this->epochsSinceDecay >= this->plateauPatience) {
+					this->epochsSinceDecay = 0;
+					NeuronUnit reduced = this->currentLearningRate * this->decay;
+					return reduced < this->minLearningRate? this->minLearningRate : reduced;
+				}
+				return this->currentLearningRate;
+
+			default:
+				return this->learningRate;
+		}
+	}
+
+
+
+//TRAINING
+	static NeuronUnit TrainingController_seconds() {
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec + ts.tv_nsec / 1e9;
+	}
+
+	static unsigned char TrainingController_checkStop(TrainingController* this) {
+		if (atomic_load(&this->stopRequested)) return TrainingController_STOPPED;
+		if (this->targetLoss != TrainingController_NO_TARGET && this->lastLoss <= this->targetLoss) return TrainingController_TARGET_REACHED;
+		if (this->patience > 0 && this->epochsWithoutImprovement >= this->patience) return TrainingController_PLATEAU;
+		if (this->sampleBudget > 0 && this->samples >= this->sampleBudget) return TrainingController_SAMPLE_BUDGET;
+		if (this->timeBudget > 0 && this->elapsed >= this->timeBudget) return TrainingController_TIME_BUDGET;
+		if (this->maxEpochs > 0 && this->epoch >= this->maxEpochs) return TrainingController_MAX_EPOCHS;
+		return TrainingController_RUNNING;
+	}
+
+	/** Trains until a stop criterion is met, and returns it. The best weights are tracked by the trainer as usual (trainer->minimum). */
+	unsigned char TrainingController_run(TrainingController* this) {
+		BPTrainer *trainer = this->trainer;
+		TrainDataProvider *provider = trainer->provider;
+		NeuronUnit start = TrainingController_seconds();
+		EvaluationMetrics validationMetrics;
+		NetworkEvaluator evaluator;		//made once: the copies of the network are reused by every epoch
+		if (this->validation != NULL) {
+			EvaluationMetrics_init(&validationMetrics, trainer->network->layers[trainer->network->layerCount - 1].neuronCount);
+			NetworkEvaluator_init(&evaluator, trainer->network, 0);
+		}
+
+		this->epoch = 0;
+		this->samples = 0;
+		this->bestLoss = INFINITY;
+		this->lastLoss = INFINITY;
+		this->epochsWithoutImprovement = 0;
+		this->epochsSinceDecay = 0;
+		this->currentLearningRate = this->learningRate;
+		this->stopReason = TrainingController_RUNNING;
+		atomic_store(&this->stopRequested, 0);
+
+		trainer->optimizer.learningRate = this->learningRate;
+		trainer->optimizer.momentum = this->momentum;
+		BPTrainer_beginRun(trainer);
+
+		while (this->stopReason == TrainingController_RUNNING) {
+			this->currentLearningRate = TrainingController_scheduledRate(this);
+			trainer->optimizer.learningRate = this->currentLearningRate;
+
+			//an epoch, cut short by the sample budget
+			unsigned long int epochSamples = this->epochSamples;
+			if (this->sampleBudget > 0 && this->sampleBudget - this->samples < epochSamples) epochSamples = this->sampleBudget - this->samples;
+			TrainDataProvider_reset(provider, epochSamples);
+			unsigned long int seenBefore = trainer->samplesSeen;
+
+			NeuronUnit loss = this->updateEvery == 0?
+				BPTrainer_runOnline(trainer, 0) :
+				BPTrainer_runStochastic(trainer, this->updateEvery, 0);
+			this->samples += provider->counter > epochSamples? epochSamples : provider->counter;
+			this->epoch++;
+
+			//the provider ran dry (or a stop came first): the loss of an epoch without a single update means nothing
+			if (trainer->samplesSeen == seenBefore) {
+				this->elapsed = TrainingController_seconds() - start;
+				this->stopReason = atomic_load(&this->stopRequested)? TrainingController_STOPPED : TrainingController_NO_SAMPLES;
+				break;
+			}
+
+			if (this->validation != NULL) {
+				TrainDataProvider_reset(this->validation, this->validationSamples);
+				NetworkEvaluator_run(&evaluator, this->validation, trainer->errorUpdater, &validationMetrics);
+				loss = validationMetrics.loss;
+			}
+
+			//bookkeeping
+			this->lastLoss = loss;
+			if (loss < this->bestLoss - this->minDelta) {
+				this->bestLoss = loss;
+				this->epochsWithoutImprovement = 0;
+				this->epochsSinceDecay = 0;
+			}
+			else {
+				this->epochsWithoutImprovement++;
+				this->epochsSinceDecay++;
+			}
+
+			this->elapsed = TrainingController_seconds() - start;
+			this->stopReason = TrainingController_checkStop(this);
+		}
+
+		if (this->validation != NULL) {
+			NetworkEvaluator_deinit(&evaluator);
+			EvaluationMetrics_deinit(&validationMetrics);
+		}
+		return this->stopReason;
+	}
+
+	/** Stops the current epoch early, and the run after it. Can be called from another thread. */
+	void TrainingController_stop(TrainingController* this) {
+		atomic_store(&this->stopRequested, 1);
+		BPTrainer_stopTraining(this->trainer);
+	}
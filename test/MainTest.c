@@ -2,7 +2,14 @@
 #include <time.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
 #include "../src/network/Network.h"
+#include "../src/train/NetworkTrain.h"
+#include "../src/server/InferenceServer.h"
 
 
 
@@ -489,6 +496,565 @@
 	}
 
 
+	void testNetworkCopy(TestCase *t) {
+		NeuralNetwork net, copy;
+		createSimpleNetwork(&net);
+		NeuralNetwork_initCopy(&copy, &net);
+
+		assertIntEqual(net.layerCount, copy.layerCount, t, "A1");
+		assertIntEqual(net.synapseCount, copy.synapseCount, t, "A2");
+		for (unsigned long int i = 0; i < net.synapseCount; ++i) {
+			assertIntEqual(net.synapses[i].targetIndex, copy.synapses[i].targetIndex, t, "A3");
+			assertDoubleEqual(net.synapses[i].weight, copy.synapses[i].weight, 0, t, "A4");
+		}
+
+		copy.layers[0].neurons[0].out = 0.4;
+		copy.layers[0].neurons[1].out = 0.6;
+		NeuralNetwork_predict(&net);
+		NeuralNetwork_predict(&copy);
+		assertDoubleEqual(net.layers[3].neurons[0].out, copy.layers[3].neurons[0].out, 0, t, "B1");
+		assertDoubleEqual(net.layers[3].neurons[1].out, copy.layers[3].neurons[1].out, 0, t, "B2");
+
+		//copies are independent
+		copy.synapses[0].weight = 5;
+		assertDoubleEqual(0.1, net.synapses[0].weight, 0, t, "C1");
+
+		NeuralNetwork_deinit(&copy);
+		NeuralNetwork_deinit(&net);
+	}
+
+
+	void testNetworkStats(TestCase *t) {
+		NeuralNetwork net;
+		createSimpleNetwork(&net);
+		NeuronUnit errorDerivatives[2] = {0.1, -0.2};
+		NeuronUnit *grad = calloc(net.synapseCount, sizeof(NeuronUnit));
+
+		NeuralNetwork_predict(&net);
+		NeuralNetwork_predict(&net);
+		NeuralNetwork_addToGradient(&net, errorDerivatives, grad);
+
+		NetworkLayerStats stats;
+		if (!NeuralNetwork_getLayerStats(&net, 0, NetworkStats_PREDICT, &stats)) {
+			//built without NETWORK_STATS: everything reads as zero
+			assertIntEqual(0, stats.calls, t, "A1");
+		}
+		else {
+			for (unsigned short int i = 0; i < net.layerCount - 1; ++i) {
+				NeuralNetwork_getLayerStats(&net, i, NetworkStats_PREDICT, &stats);
+				assertIntEqual(2, stats.calls, t, "B1");
+				assertIntEqual(2 * net.layers[i].synapseCount, stats.synapses, t, "B2");
+
+				NeuralNetwork_getLayerStats(&net, i, NetworkStats_ADD_TO_GRADIENT, &stats);
+				assertIntEqual(1, stats.calls, t, "B3");
+				assertIntEqual(net.layers[i].synapseCount, stats.synapses, t, "B4");
+			}
+
+			NeuralNetwork_getLayerStats(&net, net.layerCount - 1, NetworkStats_PREDICT, &stats);
+			assertIntEqual(0, stats.calls, t, "C1");
+
+			#ifdef NETWORK_PERF_COUNTERS
+				//counters are optional (containers, VMs), but never garbage
+				NeuralNetwork_getLayerStats(&net, 0, NetworkStats_PREDICT, &stats);
+				if (NetworkStats_countersAvailable()) assertIntEqual(1, stats.counters[NetworkStats_CYCLES] > 0, t, "D1");
+				else for (int i=0; i<NetworkStats_COUNTER_COUNT; ++i) assertIntEqual(0, stats.counters[i], t, "D2");
+			#endif
+
+			NeuralNetwork_resetStats(&net);
+			NeuralNetwork_getLayerStats(&net, 0, NetworkStats_PREDICT, &stats);
+			assertIntEqual(0, stats.calls, t, "C2");
+			assertIntEqual(0, stats.nanoseconds, t, "C3");
+		}
+
+		free(grad);
+		NeuralNetwork_deinit(&net);
+	}
+
+
+	void testPredictBatch(TestCase *t) {
+		NeuralNetwork net;
+		createSimpleNetwork(&net);
+		NeuronUnit inputs[10] = {0.4, 0.6, -1, 2, 0, 0, 3.5, -0.25, 1, 1};
+		NeuronUnit expected[10];
+		for (int b = 0; b < 5; ++b) {
+			net.layers[0].neurons[0].out = inputs[2*b];
+			net.layers[0].neurons[1].out = inputs[2*b + 1];
+			NeuralNetwork_predict(&net);
+			expected[2*b] = net.layers[3].neurons[0].out;
+			expected[2*b + 1] = net.layers[3].neurons[1].out;
+		}
+
+		assertIntEqual(2 * 3 * 5, NeuralNetwork_batchScratchSize(&net, 5), t, "A1");
+		NeuronUnit *scratch = malloc(NeuralNetwork_batchScratchSize(&net, 5) * sizeof(NeuronUnit));
+		NeuronUnit outputs[10];
+		NeuralNetwork_predictBatch(&net, inputs, 5, outputs, scratch);
+		for (int i = 0; i < 10; ++i) assertDoubleEqual(expected[i], outputs[i], 0.000000000001, t, "B1");
+
+		//a batch of one, from the middle
+		NeuralNetwork_predictBatch(&net, inputs + 6, 1, outputs, scratch);
+		assertDoubleEqual(expected[6], outputs[0], 0.000000000001, t, "C1");
+		assertDoubleEqual(expected[7], outputs[1], 0.000000000001, t, "C2");
+
+		free(scratch);
+		NeuralNetwork_deinit(&net);
+	}
+
+
+	/** Generates C for net, compiles it with gcc, and runs it on sampleCount inputs. Returns 0 if any step fails. */
+	char runGeneratedNetwork(NeuralNetwork *net, NeuronUnit *inputs, unsigned int sampleCount, NeuronUnit *outputs) {
+		unsigned short int inputCount = net->layers[0].neuronCount;
+		unsigned short int outputCount = net->layers[net->layerCount - 1].neuronCount;
+		FILE *file = fopen("/tmp/c_machine_learning_test.gen.c", "w");
+		char ok = NeuralNetwork_generateC(net, file, "generated");
+		fprintf(file, "\n#include <stdio.h>\nint main() {\n"
+			"\tdouble input[generated_INPUT_COUNT], output[generated_OUTPUT_COUNT];\n"
+			"\twhile (1) {\n"
+			"\t\tfor (int i = 0; i < generated_INPUT_COUNT; ++i) if (scanf(\"%%la\", input + i) != 1) return 0;\n"
+			"\t\tgenerated(input, output);\n"
+			"\t\tfor (int i = 0; i < generated_OUTPUT_COUNT; ++i) printf(\"%%a\\n\", output[i]);\n"
+			"\t}\n}\n");
+		fclose(file);
+		ok = ok && system("gcc -O2 -ffp-contract=off -o /tmp/c_machine_learning_test.gen /tmp/c_machine_learning_test.gen.c -lm") == 0;
+
+		file = fopen("/tmp/c_machine_learning_test.gen.in", "w");
+		for (unsigned int i = 0; i < sampleCount * inputCount; ++i) fprintf(file, "%a\n", inputs[i]);
+		fclose(file);
+		FILE *results = ok? popen("/tmp/c_machine_learning_test.gen < /tmp/c_machine_learning_test.gen.in", "r") : NULL;
+		for (unsigned int i = 0; ok && i < sampleCount * outputCount; ++i) ok = fscanf(results, "%lf", outputs + i) == 1;
+		if (results) ok = pclose(results) == 0 && ok;
+
+		remove("/tmp/c_machine_learning_test.gen.c");
+		remove("/tmp/c_machine_learning_test.gen.in");
+		remove("/tmp/c_machine_learning_test.gen");
+		return ok;
+	}
+
+	void testGenerateC(TestCase *t) {
+		NeuralNetwork simple;
+		createSimpleNetwork(&simple);
+		NeuralNetworkStructure str = {
+			(NetworkLayerStructure[]) {
+				(NetworkLayerStructure) { .connectionType = NetworkLayer_FULLY_CONNECTED, .neuronCount = 3 },
+				(NetworkLayerStructure) { .connectionType = NetworkLayer_FULLY_CONNECTED, .neuronCount = 4, .activatorType = NeuronActivator_TANH },
+				(NetworkLayerStructure) { .connectionType = NetworkLayer_FULLY_CONNECTED, .neuronCount = 4, .activatorType = NeuronActivator_RELU },
+				(NetworkLayerStructure) { .connectionType = NetworkLayer_FULLY_CONNECTED, .neuronCount = 3, .activatorType = NeuronActivator_LEAKY_RELU },
+				(NetworkLayerStructure) { .connectionType = NetworkLayer_OUTPUT, .neuronCount = 2, .activatorType = NeuronActivator_LINEAR }
+			}
+		};
+		NeuralNetwork deep;
+		NeuralNetwork_init(&deep, &str);
+		NeuralNetwork_randomSynapses(&deep);
+
+		//same outputs as NeuralNetwork_predict, to the last bit
+		NeuralNetwork *nets[] = {&simple, &deep};
+		for (int n = 0; n < 2; ++n) {
+			NeuralNetwork *net = nets[n];
+			unsigned short int inputCount = net->layers[0].neuronCount;
+			unsigned short int outputCount = net->layers[net->layerCount - 1].neuronCount;
+			NeuronUnit inputs[5 * 3], outputs[5 * 2];
+			for (int i = 0; i < 5 * inputCount; ++i) inputs[i] = (NeuronUnit) rand() / RAND_MAX * 4 - 2;
+			assertIntEqual(1, runGeneratedNetwork(net, inputs, 5, outputs), t, "A1");
+
+			for (int i = 0; i < 5; ++i) {
+				for (int j = 0; j < inputCount; ++j) net->layers[0].neurons[j].out = inputs[i * inputCount + j];
+				NeuralNetwork_predict(net);
+				for (int j = 0; j < outputCount; ++j) assertDoubleEqual(net->layers[net->layerCount - 1].neurons[j].out, outputs[i * outputCount + j], 0, t, "A2");
+			}
+		}
+
+		//bad names and custom activators cannot be generated
+		FILE *out = tmpfile();
+		assertIntEqual(0, NeuralNetwork_generateC(&simple, out, "2fast"), t, "B1");
+		simple.layers[1].activator.type = NeuronActivator_CUSTOM;
+		assertIntEqual(0, NeuralNetwork_generateC(&simple, out, "generated"), t, "B2");
+		fclose(out);
+
+		NeuralNetwork_deinit(&deep);
+		NeuralNetwork_deinit(&simple);
+	}
+
+	NeuronUnit cube(NeuronUnit x) {
+		return x * x * x;
+	}
+
+	/** Predicts the outputs of every sample with NeuralNetwork_predict and with plan, and checks that they are the same, to the last bit. */
+	void assertPlanPredicts(NetworkPlan *plan, NeuralNetwork *net, TestCase *t, char *name) {
+		unsigned short int inputCount = net->layers[0].neuronCount;
+		NetworkLayer *last = net->layers + net->layerCount - 1;
+		NeuronUnit input[8], output[8];
+		for (int i = 0; i < 5; ++i) {
+			for (int j = 0; j < inputCount; ++j) input[j] = net->layers[0].neurons[j].out = (NeuronUnit) rand() / RAND_MAX * 4 - 2;
+			NeuralNetwork_predict(net);
+			NetworkPlan_run(plan, input, output);
+			for (int j = 0; j < last->neuronCount; ++j) assertDoubleEqual(last->neurons[j].out, output[j], 0, t, name);
+		}
+	}
+
+	void testNetworkPlan(TestCase *t) {
+		//dense layers
+		NeuralNetwork simple;
+		createSimpleNetwork(&simple);
+		NetworkPlan plan;
+		NetworkPlan_init(&plan, &simple);
+		assertIntEqual(3, plan.opCount, t, "A1");
+		assertIntEqual(NetworkPlan_DENSE, plan.ops[0].kind, t, "A2");
+		assertIntEqual(NetworkPlan_DENSE, plan.ops[2].kind, t, "A3");
+		assertPlanPredicts(&plan, &simple, t, "A4");
+
+		//new weights are seen only after a refresh
+		for (unsigned long int i = 0; i < simple.synapseCount; ++i) simple.synapses[i].weight = 0.3 - 0.05 * i;
+		NeuronUnit input[2] = {0.4, 0.6}, stale[2], output[2];
+		NetworkPlan_run(&plan, input, stale);
+		NetworkPlan_refresh(&plan, &simple);
+		NetworkPlan_run(&plan, input, output);
+		assertIntEqual(1, stale[0] != output[0], t, "B1");
+		assertPlanPredicts(&plan, &simple, t, "B2");
+		NetworkPlan_deinit(&plan);
+
+		//custom activators are called through their function
+		simple.layers[2].activator.type = NeuronActivator_CUSTOM;
+		simple.layers[2].activator.inToOut = cube;
+		NetworkPlan_init(&plan, &simple);
+		assertPlanPredicts(&plan, &simple, t, "C1");
+		NetworkPlan_deinit(&plan);
+		NeuralNetwork_deinit(&simple);
+
+		//sparse layers, and synapses that repeat a target
+		NeuralNetworkStructure str = {
+			(NetworkLayerStructure[]) {
+				(NetworkLayerStructure) {
+					.connectionType = NetworkLayer_INDIVIDUAL,
+					.neurons = (int*[]) {
+						(int[]) {0, -1},
+						(int[]) {3, -1},
+						(int[]) {1, 1, -1},
+						(int[]) {-1},
+						(int[]) {2, 0, -1},
+						(int[]) {3, -1},
+						NULL
+					},
+					.bias = (int[]) {2, -1},
+				},
+				(NetworkLayerStructure) {
+					.connectionType = NetworkLayer_INDIVIDUAL,
+					.neurons = (int*[]) {
+						(int[]) {0, 1, -1},
+						(int[]) {0, 1, -1},
+						(int[]) {0, 0, 1, -1},
+						(int[]) {0, 1, -1},
+						NULL
+					},
+					.bias = (int[]) {0, 1, -1},
+					.activatorType = NeuronActivator_RELU
+				},
+				(NetworkLayerStructure) { .connectionType = NetworkLayer_OUTPUT, .neuronCount = 2, .activatorType = NeuronActivator_TANH }
+			}
+		};
+		NeuralNetwork sparse;
+		NeuralNetwork_init(&sparse, &str);
+		NeuralNetwork_randomSynapses(&sparse);
+		NetworkPlan_init(&plan, &sparse);
+		assertIntEqual(NetworkPlan_SPARSE, plan.ops[0].kind, t, "D1");
+		assertIntEqual(NetworkPlan_SPARSE, plan.ops[1].kind, t, "D2");
+		assertIntEqual(sparse.synapseCount, plan.weightCount, t, "D3");
+		assertPlanPredicts(&plan, &sparse, t, "D4");
+		NetworkPlan_deinit(&plan);
+		NeuralNetwork_deinit(&sparse);
+	}
+
+	/** Checks that optimized, given raw inputs, predicts like net given them standardized. */
+	void assertOptimizedPredicts(NeuralNetwork *net, NeuralNetwork *optimized, NeuronUnit *means, NeuronUnit *deviations, TestCase *t, char *name) {
+		NetworkLayer *last = net->layers + net->layerCount - 1;
+		NetworkLayer *optimizedLast = optimized->layers + optimized->layerCount - 1;
+		for (int i = 0; i < 5; ++i) {
+			for (int j = 0; j < net->layers[0].neuronCount; ++j) {
+				NeuronUnit raw = (NeuronUnit) rand() / RAND_MAX * 20 - 10;
+				optimized->layers[0].neurons[j].out = raw;
+				net->layers[0].neurons[j].out = means == NULL? raw : (raw - means[j]) / deviations[j];
+			}
+			NeuralNetwork_predict(net);
+			NeuralNetwork_predict(optimized);
+			for (int j = 0; j < last->neuronCount; ++j) assertDoubleEqual(last->neurons[j].out, optimizedLast->neurons[j].out, 0.000000001, t, name);
+		}
+	}
+
+	void testNetworkOptimizer(TestCase *t) {
+		//two linear layers fold into the first one
+		NeuralNetworkStructure str = {
+			(NetworkLayerStructure[]) {
+				(NetworkLayerStructure) { .connectionType = NetworkLayer_FULLY_CONNECTED, .neuronCount = 3 },
+				(NetworkLayerStructure) { .connectionType = NetworkLayer_FULLY_CONNECTED, .neuronCount = 4, .activatorType = NeuronActivator_LINEAR },
+				(NetworkLayerStructure) { .connectionType = NetworkLayer_FULLY_CONNECTED, .neuronCount = 2, .activatorType = NeuronActivator_LINEAR },
+				(NetworkLayerStructure) { .connectionType = NetworkLayer_OUTPUT, .neuronCount = 2, .activatorType = NeuronActivator_SIGMOID }
+			}
+		};
+		NeuralNetwork net, optimized;
+		NeuralNetwork_init(&net, &str);
+		NeuralNetwork_randomSynapses(&net);
+		NeuronUnit means[3] = {5, -1, 0}, deviations[3] = {2, 0.5, 3};
+		NetworkOptimizerReport report;
+		assertIntEqual(1, NeuralNetwork_optimize(&net, &optimized, means, deviations, &report), t, "A1");
+		assertIntEqual(4, report.layersBefore, t, "A2");
+		assertIntEqual(2, report.layersAfter, t, "A3");
+		assertIntEqual(32, report.synapsesBefore, t, "A4");
+		assertIntEqual(8, report.synapsesAfter, t, "A5");
+		assertIntEqual(8, optimized.synapseCount, t, "A6");
+		assertIntEqual(1, report.maxDifference < 0.000000001, t, "A7");
+		assertOptimizedPredicts(&net, &optimized, means, deviations, t, "A8");
+		NeuralNetwork_deinit(&optimized);
+
+		//without normalization. Zero deviations cannot be folded
+		assertIntEqual(1, NeuralNetwork_optimize(&net, &optimized, NULL, NULL, NULL), t, "B1");
+		assertOptimizedPredicts(&net, &optimized, NULL, NULL, t, "B2");
+		NeuralNetwork_deinit(&optimized);
+		deviations[1] = 0;
+		assertIntEqual(0, NeuralNetwork_optimize(&net, &optimized, means, deviations, NULL), t, "B3");
+		NeuralNetwork_deinit(&net);
+
+		//a linear bottleneck stays: folding it would add synapses
+		NeuralNetworkStructure bottleneck = {
+			(NetworkLayerStructure[]) {
+				(NetworkLayerStructure) { .connectionType = NetworkLayer_FULLY_CONNECTED, .neuronCount = 6 },
+				(NetworkLayerStructure) { .connectionType = NetworkLayer_FULLY_CONNECTED, .neuronCount = 2, .activatorType = NeuronActivator_LINEAR },
+				(NetworkLayerStructure) { .connectionType = NetworkLayer_OUTPUT, .neuronCount = 6, .activatorType = NeuronActivator_TANH }
+			}
+		};
+		NeuralNetwork_init(&net, &bottleneck);
+		NeuralNetwork_randomSynapses(&net);
+		assertIntEqual(1, NeuralNetwork_optimize(&net, &optimized, NULL, NULL, &report), t, "C1");
+		assertIntEqual(3, report.layersAfter, t, "C2");
+		assertIntEqual(net.synapseCount, optimized.synapseCount, t, "C3");
+		NeuralNetwork_deinit(&optimized);
+		NeuralNetwork_deinit(&net);
+
+		//individual synapses: the sigmoid layer stays, the linear one folds
+		createSimpleNetwork(&net);
+		NeuronUnit simpleMeans[2] = {0.5, -3}, simpleDeviations[2] = {0.1, 4};
+		assertIntEqual(1, NeuralNetwork_optimize(&net, &optimized, simpleMeans, simpleDeviations, &report), t, "D1");
+		assertIntEqual(3, report.layersAfter, t, "D2");
+		assertIntEqual(NeuronActivator_SIGMOID, optimized.layers[1].activator.type, t, "D3");
+		assertIntEqual(NeuronActivator_SIGMOID, optimized.layers[2].activator.type, t, "D4");
+		assertOptimizedPredicts(&net, &optimized, simpleMeans, simpleDeviations, t, "D5");
+		NeuralNetwork_deinit(&optimized);
+		NeuralNetwork_deinit(&net);
+
+		//normalization files
+		char *path = "/tmp/c_machine_learning_test.norm";
+		FILE *file = fopen(path, "w");
+		fprintf(file, "1, -2.5,3\r\n0.5,1,2\n");
+		fclose(file);
+		assertIntEqual(1, NetworkOptimizer_readNormalization(path, 3, means, deviations), t, "E1");
+		assertDoubleEqual(-2.5, means[1], 0, t, "E2");
+		assertDoubleEqual(2, deviations[2], 0, t, "E3");
+		assertIntEqual(0, NetworkOptimizer_readNormalization(path, 2, means, deviations), t, "E4");
+		assertIntEqual(0, NetworkOptimizer_readNormalization(path, 4, means, deviations), t, "E5");
+		remove(path);
+		assertIntEqual(0, NetworkOptimizer_readNormalization(path, 3, means, deviations), t, "E6");
+	}
+
+	void testNetworkPruner(TestCase *t) {
+		NeuralNetworkStructure str = {
+			(NetworkLayerStructure[]) {
+				(NetworkLayerStructure) { .connectionType = NetworkLayer_FULLY_CONNECTED, .neuronCount = 4 },
+				(NetworkLayerStructure) { .connectionType = NetworkLayer_FULLY_CONNECTED, .neuronCount = 6, .activatorType = NeuronActivator_TANH },
+				(NetworkLayerStructure) { .connectionType = NetworkLayer_OUTPUT, .neuronCount = 3, .activatorType = NeuronActivator_LINEAR }
+			}
+		};
+		NeuralNetwork net, pruned, expected;
+		NeuralNetwork_init(&net, &str);
+		NeuralNetwork_randomSynapses(&net);
+
+		//below a threshold: the same as zeroing those weights, but the biases stay
+		NeuralNetwork_initCopy(&expected, &net);
+		unsigned long int kept = 0;
+		for (unsigned short int i = 0; i < 2; ++i) {
+			NetworkLayer *layer = expected.layers + i;
+			for (unsigned short int j = 0; j < layer->neuronCount; ++j) {
+				for (unsigned int k = 0; k < layer->neurons[j].synapseCount; ++k) {
+					NeuronSynapse *synapse = layer->neurons[j].synapses + k;
+					if (fabs(synapse->weight) < 0.3) synapse->weight = 0;
+					else kept++;
+				}
+			}
+			kept += layer->bias.synapseCount;
+		}
+
+		NetworkPruneReport report;
+		NeuralNetwork_prune(&net, &pruned, 0.3, 0, &report);
+		assertIntEqual(kept, pruned.synapseCount, t, "A1");
+		assertIntEqual(net.synapseCount, report.synapsesBefore, t, "A2");
+		assertIntEqual(kept, report.synapsesAfter, t, "A3");
+		assertIntEqual(1, report.bytesAfter < report.bytesBefore, t, "A4");
+		assertIntEqual(1, report.predictNsBefore > 0 && report.predictNsAfter > 0 && report.planNsBefore > 0 && report.planNsAfter > 0, t, "A5");
+		assertIntEqual(6, pruned.layers[0].bias.synapseCount, t, "A6");
+		for (int n = 0; n < 5; ++n) {
+			for (int j = 0; j < 4; ++j) expected.layers[0].neurons[j].out = pruned.layers[0].neurons[j].out = (NeuronUnit) rand() / RAND_MAX * 4 - 2;
+			NeuralNetwork_predict(&expected);
+			NeuralNetwork_predict(&pruned);
+			for (int j = 0; j < 3; ++j) assertDoubleEqual(expected.layers[2].neurons[j].out, pruned.layers[2].neurons[j].out, 0.000000000001, t, "A7");
+		}
+		NeuralNetwork_deinit(&pruned);
+		NeuralNetwork_deinit(&expected);
+
+		//the largest ones of every layer
+		net.layers[0].neurons[2].synapses[4].weight = 50;
+		NeuralNetwork_prune(&net, &pruned, 0, 5, NULL);
+		assertIntEqual(5 + 6 + 5 + 3, pruned.synapseCount, t, "B1");
+		Neuron *strongest = pruned.layers[0].neurons + 2;
+		NeuronUnit weight = 0;
+		for (unsigned int k = 0; k < strongest->synapseCount; ++k) {
+			if (strongest->synapses[k].targetIndex == 4) weight = strongest->synapses[k].weight;
+		}
+		assertDoubleEqual(50, weight, 0, t, "B2");
+		NeuralNetwork_deinit(&pruned);
+
+		//both: nothing is above a huge threshold
+		NeuralNetwork_prune(&net, &pruned, 1000, 5, NULL);
+		assertIntEqual(6 + 3, pruned.synapseCount, t, "C1");
+		NeuralNetwork_deinit(&pruned);
+		NeuralNetwork_deinit(&net);
+	}
+
+	void testNeuronPruner(TestCase *t) {
+		NeuralNetworkStructure str = {
+			(NetworkLayerStructure[]) {
+				(NetworkLayerStructure) { .connectionType = NetworkLayer_FULLY_CONNECTED, .neuronCount = 2 },
+				(NetworkLayerStructure) { .connectionType = NetworkLayer_FULLY_CONNECTED, .neuronCount = 5, .activatorType = NeuronActivator_RELU },
+				(NetworkLayerStructure) { .connectionType = NetworkLayer_OUTPUT, .neuronCount = 2, .activatorType = NeuronActivator_LINEAR }
+			}
+		};
+		NeuralNetwork net, pruned;
+		NeuralNetwork_init(&net, &str);
+		NeuralNetwork_randomSynapses(&net);
+
+		//hidden neuron 0 is dead, 2 repeats 1, and 3 is constant
+		NeuronUnit hiddenWeights[3][5] = {
+			{-1, 0.7, 0.7, 0, -0.3},
+			{-1, -0.4, -0.4, 0, 0.9},
+			{-10, 0.1, 0.1, 0.5, 0.2}
+		};
+		for (int j = 0; j < 3; ++j) {
+			Neuron *neuron = j == 2? &net.layers[0].bias : net.layers[0].neurons + j;
+			for (int k = 0; k < 5; ++k) neuron->synapses[k].weight = hiddenWeights[j][k];
+		}
+
+		//calibration rows with a third, unused value
+		NeuronUnit rows[50 * 3];
+		for (int i = 0; i < 50; ++i) {
+			rows[i * 3] = (NeuronUnit) rand() / RAND_MAX;
+			rows[i * 3 + 1] = (NeuronUnit) rand() / RAND_MAX;
+			rows[i * 3 + 2] = 99;
+		}
+
+		NetworkNeuronPruneReport report;
+		NeuralNetwork_pruneNeurons(&net, &pruned, rows, 50, 3, 0.000000001, &report);
+		assertIntEqual(5, report.hiddenBefore, t, "A1");
+		assertIntEqual(2, report.hiddenAfter, t, "A2");
+		assertIntEqual(1, report.dead, t, "A3");
+		assertIntEqual(1, report.constant, t, "A4");
+		assertIntEqual(1, report.duplicates, t, "A5");
+		assertIntEqual(2, pruned.layers[1].neuronCount, t, "A6");
+		assertIntEqual(3 * 2 + 3 * 2, pruned.synapseCount, t, "A7");
+		assertIntEqual(report.synapsesAfter, pruned.synapseCount, t, "A8");
+		assertIntEqual(1, report.maxDifference < 0.000000001, t, "A9");
+
+		//same outputs, and still dense
+		for (int i = 0; i < 5; ++i) {
+			for (int j = 0; j < 2; ++j) net.layers[0].neurons[j].out = pruned.layers[0].neurons[j].out = (NeuronUnit) rand() / RAND_MAX;
+			NeuralNetwork_predict(&net);
+			NeuralNetwork_predict(&pruned);
+			for (int j = 0; j < 2; ++j) assertDoubleEqual(net.layers[2].neurons[j].out, pruned.layers[2].neurons[j].out, 0.000000000001, t, "B1");
+		}
+		NetworkPlan plan;
+		NetworkPlan_init(&plan, &pruned);
+		assertIntEqual(NetworkPlan_DENSE, plan.ops[0].kind, t, "B2");
+		assertIntEqual(NetworkPlan_DENSE, plan.ops[1].kind, t, "B3");
+		NetworkPlan_deinit(&plan);
+		NeuralNetwork_deinit(&pruned);
+
+		//every neuron dead: one is kept
+		for (int k = 0; k < 5; ++k) net.layers[0].bias.synapses[k].weight = -10;
+		NeuralNetwork_pruneNeurons(&net, &pruned, rows, 50, 3, 0, &report);
+		assertIntEqual(1, pruned.layers[1].neuronCount, t, "C1");
+		assertIntEqual(4, report.dead, t, "C2");
+		assertDoubleEqual(0, report.maxDifference, 0.000000000001, t, "C3");
+		NeuralNetwork_deinit(&pruned);
+		NeuralNetwork_deinit(&net);
+
+		//leaky ReLU: a neuron that never activates still passes its leak on, so it only goes if that leak is flat enough
+		str.layers[1].activatorType = NeuronActivator_LEAKY_RELU;
+		NeuralNetwork_init(&net, &str);
+		NeuralNetwork_randomSynapses(&net);
+		for (int j = 0; j < 3; ++j) {
+			Neuron *neuron = j == 2? &net.layers[0].bias : net.layers[0].neurons + j;
+			for (int k = 0; k < 5; ++k) neuron->synapses[k].weight = hiddenWeights[j][k];
+		}
+		for (int k = 0; k < 2; ++k) net.layers[1].neurons[0].synapses[k].weight = 1000; //amplifies the leak of neuron 0
+
+		NeuralNetwork_pruneNeurons(&net, &pruned, rows, 50, 3, 0.000000001, &report);
+		assertIntEqual(0, report.dead, t, "D1");
+		assertIntEqual(3, pruned.layers[1].neuronCount, t, "D2");
+		assertIntEqual(1, report.maxDifference < 0.000000001, t, "D3");
+		NeuralNetwork_deinit(&pruned);
+
+		NeuralNetwork_pruneNeurons(&net, &pruned, rows, 50, 3, 0.01, &report);
+		assertIntEqual(1, report.dead, t, "D4");
+		assertIntEqual(2, pruned.layers[1].neuronCount, t, "D5");
+		NeuralNetwork_deinit(&pruned);
+		NeuralNetwork_deinit(&net);
+	}
+
+	void testNetworkFile(TestCase *t) {
+		NeuralNetwork net;
+		createSimpleNetwork(&net);
+		for (unsigned long int i = 0; i < net.synapseCount; ++i) net.synapses[i].weight = 0.1 * i - 1;
+		char *path = "/tmp/c_machine_learning_test.nnw";
+
+		assertIntEqual(1, NeuralNetwork_save(&net, path), t, "A1");
+		assertIntEqual(0, remove("/tmp/c_machine_learning_test.nnw.tmp") == 0, t, "A2");
+
+		NeuralNetwork loaded;
+		assertIntEqual(1, NeuralNetwork_load(&loaded, path), t, "B1");
+		assertIntEqual(net.layerCount, loaded.layerCount, t, "B2");
+		assertIntEqual(net.synapseCount, loaded.synapseCount, t, "B3");
+		for (unsigned short int i = 1; i < net.layerCount; ++i) {
+			assertIntEqual(net.layers[i].neuronCount, loaded.layers[i].neuronCount, t, "B4");
+			assertIntEqual(net.layers[i].activator.type, loaded.layers[i].activator.type, t, "B5");
+		}
+		for (unsigned long int i = 0; i < net.synapseCount; ++i) {
+			assertIntEqual(net.synapses[i].targetIndex, loaded.synapses[i].targetIndex, t, "B6");
+			assertDoubleEqual(net.synapses[i].weight, loaded.synapses[i].weight, 0, t, "B7");
+		}
+
+		loaded.layers[0].neurons[0].out = net.layers[0].neurons[0].out;
+		loaded.layers[0].neurons[1].out = net.layers[0].neurons[1].out;
+		NeuralNetwork_predict(&net);
+		NeuralNetwork_predict(&loaded);
+		assertDoubleEqual(net.layers[3].neurons[0].out, loaded.layers[3].neurons[0].out, 0, t, "C1");
+		assertDoubleEqual(net.layers[3].neurons[1].out, loaded.layers[3].neurons[1].out, 0, t, "C2");
+		NeuralNetwork_deinit(&loaded);
+
+		//a truncated file is refused
+		FILE *file = fopen(path, "rb");
+		char content[4096];
+		unsigned long int size = fread(content, 1, sizeof(content), file);
+		fclose(file);
+		file = fopen(path, "wb");
+		fwrite(content, 1, size - 3, file);
+		fclose(file);
+		assertIntEqual(0, NeuralNetwork_load(&loaded, path), t, "D1");
+		assertIntEqual(0, NeuralNetwork_load(&loaded, "/tmp/c_machine_learning_missing.nnw"), t, "D2");
+
+		//custom activators cannot be saved
+		net.layers[1].activator.type = NeuronActivator_CUSTOM;
+		assertIntEqual(0, NeuralNetwork_save(&net, path), t, "E1");
+
+		remove(path);
+		NeuralNetwork_deinit(&net);
+	}
+
+
+
 //LAYER FUNCTIONS
 	void testLayerInitializations(TestCase *t) {
 		//Test output layer
@@ -527,6 +1093,16 @@
 			for (int j=0; j<layer.bias.synapseCount; ++j) assertIntEqual(j, layer.neurons[i].synapses[j].targetIndex, t, "B8");
 		}
 		NetworkLayer_deinit(&layer);
+
+		//a next layer wider than this one
+		NetworkLayer_initFullyConnected(&layer, &str, 64);
+		assertIntEqual(4*64 + 64, layer.synapseCount, t, "C1");
+		assertIntEqual(64, layer.bias.synapseCount, t, "C2");
+		for (int i=0; i<layer.neuronCount; ++i) {
+			assertIntEqual(64, layer.neurons[i].synapseCount, t, "C3");
+			for (int j=0; j<64; ++j) assertIntEqual(j, layer.neurons[i].synapses[j].targetIndex, t, "C4");
+		}
+		NetworkLayer_deinit(&layer);
 	}
 
 
@@ -935,6 +1511,1178 @@
 	}
 
 
+//TRAINING TESTS
+	void createIdentityNetwork(NeuralNetwork *net) {
+		NeuralNetworkStructure str = {
+			(NetworkLayerStructure[]) {
+				(NetworkLayerStructure) {
+					.connectionType = NetworkLayer_FULLY_CONNECTED,
+					.neuronCount = 1,
+				},
+				(NetworkLayerStructure) {
+					.connectionType = NetworkLayer_OUTPUT,
+					.neuronCount = 1,
+					.activatorType = NeuronActivator_LINEAR
+				}
+			}
+		};
+
+		NeuralNetwork_init(net, &str);
+	}
+
+	void testIndexedProvider(TestCase *t) {
+		NeuralNetwork net;
+		createIdentityNetwork(&net);
+
+		NeuronUnit rows[2*10];
+		for (int i=0; i<10; ++i) {
+			rows[2*i] = i;
+			rows[2*i + 1] = -i;
+		}
+
+		TrainDataSet set;
+		TrainDataSet_init(&set, rows, 10, 1, 1);
+
+		//full permutation: every sample exactly once per epoch
+		TrainDataProvider provider;
+		TrainDataProvider_initIndexed(&provider, *TrainDataSet_provideSample, &set, 1, 10, 25, 0);
+		int seen[10] = {0};
+		for (int i=0; i<20; ++i) {
+			assertIntEqual(1, provider.provideInput(&provider, &net), t, "A1");
+			int index = (int) net.layers[0].neurons[0].out;
+			assertDoubleEqual(-index, provider.expected[0], 0.00001, t, "A2");
+			seen[index]++;
+		}
+		for (int i=0; i<10; ++i) assertIntEqual(2, seen[i], t, "A3");
+		assertIntEqual(1, provider.epoch, t, "A4");
+
+		for (int i=0; i<5; ++i) provider.provideInput(&provider, &net);
+		assertIntEqual(0, provider.provideInput(&provider, &net), t, "A5");
+		assertPtrEqual(rows, (void*) set.rows, t, "A6");
+		TrainDataProvider_deinit(&provider);
+
+		//block-wise permutation: blocks of 4 consecutive samples stay together
+		TrainDataProvider_initIndexed(&provider, *TrainDataSet_provideSample, &set, 1, 10, 10, 4);
+		int blockSeen[3] = {0};
+		int lastBlock = -1, blockChanges = 0;
+		for (int i=0; i<10; ++i) {
+			provider.provideInput(&provider, &net);
+			int block = (int) net.layers[0].neurons[0].out / 4;
+			blockSeen[block]++;
+			if (block != lastBlock) blockChanges++;
+			lastBlock = block;
+		}
+		assertIntEqual(4, blockSeen[0], t, "B1");
+		assertIntEqual(4, blockSeen[1], t, "B2");
+		assertIntEqual(2, blockSeen[2], t, "B3");
+		assertIntEqual(3, blockChanges, t, "B4");
+
+		TrainDataProvider_deinit(&provider);
+		TrainDataSet_deinit(&set);
+		NeuralNetwork_deinit(&net);
+	}
+
+
+	typedef struct {
+		int produced[2];
+		int limit;
+	} CountingGenerator;
+
+	char countingGenerate(void *context, unsigned int producerIndex, NeuronUnit *input, NeuronUnit *expected) {
+		CountingGenerator *gen = (CountingGenerator*) context;
+		if (gen->produced[producerIndex] >= gen->limit) return 0;
+
+		input[0] = gen->produced[producerIndex]++;
+		expected[0] = producerIndex;
+		return 1;
+	}
+
+	void testAsyncProvider(TestCase *t) {
+		SampleRing ring;
+		SampleRing_init(&ring, 3, 2);
+		assertIntEqual(3, ring.mask, t, "A1");
+		assertPtrEqual(NULL, (void*) SampleRing_peek(&ring), t, "A2");
+		for (int i=0; i<4; ++i) {
+			NeuronUnit *slot = SampleRing_reserve(&ring);
+			slot[0] = i;
+			SampleRing_commit(&ring);
+		}
+		assertPtrEqual(NULL, SampleRing_reserve(&ring), t, "A3");
+		assertIntEqual(4, SampleRing_occupancy(&ring), t, "A4");
+		assertDoubleEqual(0, SampleRing_peek(&ring)[0], 0.00001, t, "A5");
+		SampleRing_release(&ring);
+		assertDoubleEqual(1, SampleRing_peek(&ring)[0], 0.00001, t, "A6");
+		SampleRing_deinit(&ring);
+
+
+		NeuralNetwork net;
+		createIdentityNetwork(&net);
+		CountingGenerator gen = { .produced = {0, 0}, .limit = 300 };
+
+		AsyncDataProvider async;
+		AsyncDataProvider_init(&async, *countingGenerate, &gen, 1, 1, 2, 16, 1000);
+		TrainDataProvider *provider = &async.provider;
+
+		//samples of each producer arrive in order, and the provider stops when the producers are exhausted
+		NeuronUnit next[2] = {0, 0};
+		int count = 0;
+		while (provider->provideInput(provider, &net)) {
+			int producer = (int) provider->expected[0];
+			assertDoubleEqual(next[producer], net.layers[0].neurons[0].out, 0.00001, t, "B1");
+			next[producer]++;
+			count++;
+		}
+		assertIntEqual(600, count, t, "B2");
+
+		AsyncDataProviderStats stats;
+		AsyncDataProvider_getStats(&async, &stats);
+		assertIntEqual(600, stats.consumed, t, "B3");
+		assertIntEqual(16, stats.capacity, t, "B4");
+
+		AsyncDataProvider_deinit(&async);
+		NeuralNetwork_deinit(&net);
+	}
+
+
+	void testOptimizers(TestCase *t) {
+		NeuralNetwork net;
+		createIdentityNetwork(&net);
+		assertIntEqual(2, net.synapseCount, t, "pre1");
+		assertPtrEqual(net.layers[0].neurons[0].synapses, net.synapses, t, "pre2");
+		assertPtrEqual(net.layers[0].bias.synapses, net.synapses + 1, t, "pre3");
+
+		NeuronUnit weights[2] = {0.5, -0.5};
+		NeuronUnit grad[2] = {2, -4};
+		Optimizer opt;
+
+		//SGD with momentum: v = momentum*v - rate*g
+		Optimizer_init(&opt, Optimizer_SGD, 2);
+		opt.learningRate = 0.1;
+		opt.momentum = 0.5;
+		NeuralNetwork_loadSynapseWeights(&net, weights);
+		Optimizer_step(&opt, &net, grad, 0.5);
+		assertDoubleEqual(0.5 - 0.1, net.synapses[0].weight, 0.00001, t, "A1");
+		assertDoubleEqual(-0.5 + 0.2, net.synapses[1].weight, 0.00001, t, "A2");
+		Optimizer_step(&opt, &net, grad, 0.5);
+		assertDoubleEqual(0.4 - 0.05 - 0.1, net.synapses[0].weight, 0.00001, t, "A3");
+		Optimizer_deinit(&opt);
+
+		//Nesterov: first step moves by (1 + momentum) * v
+		Optimizer_init(&opt, Optimizer_NESTEROV, 2);
+		opt.learningRate = 0.1;
+		NeuralNetwork_loadSynapseWeights(&net, weights);
+		Optimizer_step(&opt, &net, grad, 1);
+		assertDoubleEqual(0.5 - 1.9 * 0.2, net.synapses[0].weight, 0.00001, t, "B1");
+		assertDoubleEqual(-0.5 + 1.9 * 0.4, net.synapses[1].weight, 0.00001, t, "B2");
+		Optimizer_deinit(&opt);
+
+		//Adam: bias corrected first step has the size of the learning rate
+		Optimizer_init(&opt, Optimizer_ADAM, 2);
+		NeuralNetwork_loadSynapseWeights(&net, weights);
+		Optimizer_step(&opt, &net, grad, 1);
+		assertDoubleEqual(0.5 - 0.001, net.synapses[0].weight, 0.000001, t, "C1");
+		assertDoubleEqual(-0.5 + 0.001, net.synapses[1].weight, 0.000001, t, "C2");
+		assertDoubleEqual(0.2, opt.state1[0], 0.00001, t, "C3");
+		assertDoubleEqual(0.016, opt.state2[1], 0.00001, t, "C4");
+		Optimizer_deinit(&opt);
+
+		//RMSProp
+		Optimizer_init(&opt, Optimizer_RMSPROP, 2);
+		NeuralNetwork_loadSynapseWeights(&net, weights);
+		Optimizer_step(&opt, &net, grad, 1);
+		assertDoubleEqual(0.5 - 0.001 / sqrt(0.1), net.synapses[0].weight, 0.000001, t, "D1");
+		Optimizer_deinit(&opt);
+
+		//AdaGrad
+		Optimizer_init(&opt, Optimizer_ADAGRAD, 2);
+		NeuralNetwork_loadSynapseWeights(&net, weights);
+		Optimizer_step(&opt, &net, grad, 1);
+		Optimizer_step(&opt, &net, grad, 1);
+		assertDoubleEqual(-0.5 + 0.01 + 0.01 / sqrt(2), net.synapses[1].weight, 0.000001, t, "E1");
+		Optimizer_deinit(&opt);
+
+		NeuralNetwork_deinit(&net);
+	}
+
+
+	void squaredError(NeuralNetwork* net, NeuronUnit* expected, NeuronUnit* errorValue, NeuronUnit* errorGradients) {
+		NetworkLayer *out = net->layers + net->layerCount - 1;
+		NeuronUnit sum = 0;
+		for (unsigned short int i = out->neuronCount; i--;) {
+			NeuronUnit diff = out->neurons[i].out - expected[i];
+			errorGradients[i] = 2 * diff;
+			sum += diff * diff;
+		}
+		*errorValue = sum;
+	}
+
+	void testLBFGSTrainer(TestCase *t) {
+		NeuralNetwork net;
+		createIdentityNetwork(&net);
+		net.synapses[0].weight = 0;
+		net.synapses[1].weight = 0;
+
+		//y = 2x + 1
+		NeuronUnit rows[2*50];
+		for (int i=0; i<50; ++i) {
+			rows[2*i] = i / 25.0 - 1;
+			rows[2*i + 1] = 2 * rows[2*i] + 1;
+		}
+		TrainDataSet set;
+		TrainDataSet_init(&set, rows, 50, 1, 1);
+
+		LBFGSTrainer trainer;
+		LBFGSTrainer_init(&trainer, &net, &set, *squaredError, 5, 3);
+
+		//the full batch gradient matches a sequential pass
+		NeuronUnit weights[2] = {0.5, -0.5}, grad[2], expectedGrad[2] = {0, 0}, expected[1], errorDerivatives[1], errorValue, errorSum = 0;
+		NeuronUnit error = LBFGSTrainer_evaluate(&trainer, weights, grad);
+		NeuralNetwork_loadSynapseWeights(&net, weights);
+		for (int i=0; i<50; ++i) {
+			TrainDataSet_loadSample(&set, &net, i, expected);
+			NeuralNetwork_predict(&net);
+			squaredError(&net, expected, &errorValue, errorDerivatives);
+			NeuralNetwork_addToGradient(&net, errorDerivatives, expectedGrad);
+			errorSum += errorValue;
+		}
+		assertDoubleEqual(errorSum / 50, error, 0.000001, t, "A1");
+		assertDoubleEqual(expectedGrad[0] / 50, grad[0], 0.000001, t, "A2");
+		assertDoubleEqual(expectedGrad[1] / 50, grad[1], 0.000001, t, "A3");
+
+		//a quadratic problem is solved in a few iterations
+		NeuralNetwork_loadSynapseWeights(&net, (NeuronUnit[]) {0, 0});
+		error = LBFGSTrainer_train(&trainer, 50, 1e-9);
+		assertDoubleEqual(0, error, 0.000001, t, "B1");
+		assertDoubleEqual(2, net.synapses[0].weight, 0.0001, t, "B2");
+		assertDoubleEqual(1, net.synapses[1].weight, 0.0001, t, "B3");
+		if (trainer.iterations > 10) assertIntEqual(10, trainer.iterations, t, "B4");
+
+		LBFGSTrainer_deinit(&trainer);
+		TrainDataSet_deinit(&set);
+		NeuralNetwork_deinit(&net);
+	}
+
+
+	void testLMTrainer(TestCase *t) {
+		//Jacobian rows match finite differences
+		NeuralNetwork net;
+		createSimpleNetwork(&net);
+		NeuronUnit row[net.synapseCount];
+		NeuralNetwork_predict(&net);
+		NeuralNetwork_saveJacobianRow(&net, 1, row);
+
+		for (unsigned long int i = 0; i < net.synapseCount; ++i) {
+			NeuronUnit weight = net.synapses[i].weight;
+			net.synapses[i].weight = weight + 1e-6;
+			NeuralNetwork_predict(&net);
+			NeuronUnit up = net.layers[3].neurons[1].out;
+			net.synapses[i].weight = weight - 1e-6;
+			NeuralNetwork_predict(&net);
+			NeuronUnit down = net.layers[3].neurons[1].out;
+			net.synapses[i].weight = weight;
+
+			assertDoubleEqual((up - down) / 2e-6, row[i], 0.00001, t, "A1");
+		}
+		NeuralNetwork_deinit(&net);
+
+
+		//a linear least squares problem is solved in very few iterations
+		createIdentityNetwork(&net);
+		net.synapses[0].weight = 0;
+		net.synapses[1].weight = 0;
+
+		NeuronUnit rows[2*40];
+		for (int i=0; i<40; ++i) {
+			rows[2*i] = i / 20.0 - 1;
+			rows[2*i + 1] = -3 * rows[2*i] + 0.5;
+		}
+		TrainDataSet set;
+		TrainDataSet_init(&set, rows, 40, 1, 1);
+
+		LMTrainer trainer;
+		LMTrainer_init(&trainer, &net, &set, 2);
+		NeuronUnit error = LMTrainer_train(&trainer, 20, 1e-10);
+		assertDoubleEqual(0, error, 0.000001, t, "B1");
+		assertDoubleEqual(-3, net.synapses[0].weight, 0.0001, t, "B2");
+		assertDoubleEqual(0.5, net.synapses[1].weight, 0.0001, t, "B3");
+		if (trainer.iterations > 5) assertIntEqual(5, trainer.iterations, t, "B4");
+
+		LMTrainer_deinit(&trainer);
+		TrainDataSet_deinit(&set);
+		NeuralNetwork_deinit(&net);
+	}
+
+
+	int countOccurrences(char *text, char *pattern) {
+		int count = 0;
+		for (char *pos = strstr(text, pattern); pos != NULL; pos = strstr(pos + 1, pattern)) count++;
+		return count;
+	}
+
+	void testTracer(TestCase *t) {
+		NeuralNetwork net;
+		createIdentityNetwork(&net);
+		CountingGenerator gen = { .produced = {0, 0}, .limit = 50 };
+		AsyncDataProvider async;
+		BPTrainer trainer;
+
+		Tracer_start();
+		AsyncDataProvider_init(&async, *countingGenerate, &gen, 1, 1, 2, 16, 1000);
+		BPTrainer_init(&trainer, &net, &async.provider, *squaredError);
+		BPTrainer_trainOnline(&trainer, 0.01, 0, 0);
+		AsyncDataProvider_deinit(&async);
+		Tracer_stop();
+
+		//nothing is recorded while stopped
+		unsigned long int eventCount = Tracer_eventCount();
+		Tracer_BEGIN("ignored");
+		assertIntEqual(eventCount, Tracer_eventCount(), t, "A1");
+
+		char *path = "out/testTrace.json";
+		assertIntEqual(1, Tracer_write(path), t, "A2");
+		FILE *file = fopen(path, "r");
+		char *text = calloc(1 << 20, 1);
+		fread(text, 1, (1 << 20) - 1, file);
+		fclose(file);
+		remove(path);
+
+		assertIntEqual(1, strncmp(text, "{\"traceEvents\":[", 16) == 0, t, "B1");
+		assertIntEqual(100, countOccurrences(text, "\"forward\",\"ph\":\"B\""), t, "B2");
+		assertIntEqual(100, countOccurrences(text, "\"forward\",\"ph\":\"E\""), t, "B3");
+		assertIntEqual(101, countOccurrences(text, "\"provide\",\"ph\":\"B\""), t, "B4");
+		assertIntEqual(102, countOccurrences(text, "\"generate\",\"ph\":\"B\""), t, "B5"); //the last call of each producer returns 0
+		assertIntEqual(1, countOccurrences(text, "{\"name\":\"trainer\"}"), t, "B6");
+		assertIntEqual(2, countOccurrences(text, "{\"name\":\"producer\"}"), t, "B7");
+		free(text);
+
+		//the buffers grow past one chunk
+		Tracer_start();
+		for (unsigned long int i = 0; i < Tracer_CHUNK_CAPACITY + 10; ++i) Tracer_BEGIN("many");
+		Tracer_stop();
+		assertIntEqual(Tracer_CHUNK_CAPACITY + 10, Tracer_eventCount(), t, "C1");
+		assertIntEqual(0, Tracer_droppedCount(), t, "C2");
+		assertIntEqual(1, Tracer_write(path), t, "C3");
+		file = fopen(path, "r");
+		fseek(file, 0, SEEK_END);
+		assertIntEqual(1, ftell(file) > 40L * Tracer_CHUNK_CAPACITY, t, "C4");
+		fclose(file);
+		remove(path);
+
+		BPTrainer_deinit(&trainer);
+		NeuralNetwork_deinit(&net);
+	}
+
+
+	void testMetricsSink(TestCase *t) {
+		char line[256];
+
+		//no reporter thread: records stay in the ring until flushed, and a full ring drops instead of blocking
+		FILE *out = tmpfile();
+		MetricsSink sink;
+		MetricsSink_init(&sink, MetricsSink_CSV, out, 2, 0);
+		MetricsSink_record(&sink, 10, 0.5, 0.4, 0.1);
+		MetricsSink_record(&sink, 20, 0.3, 0.2, 0.1);
+		MetricsSink_record(&sink, 30, 0.1, 0.1, 0.1);
+		assertIntEqual(1, sink.dropped, t, "A1");
+		MetricsSink_flush(&sink);
+
+		rewind(out);
+		int lines = 0;
+		while (fgets(line, 256, out) != NULL) lines++;
+		assertIntEqual(3, lines, t, "A2"); //header and two records
+		MetricsSink_deinit(&sink);
+		fclose(out);
+
+		//the trainer writes the mean loss of every metricsEvery samples
+		NeuralNetwork net;
+		createIdentityNetwork(&net);
+		CountingGenerator gen = { .produced = {0, 0}, .limit = 50 };
+		AsyncDataProvider async;
+		AsyncDataProvider_init(&async, *countingGenerate, &gen, 1, 1, 2, 16, 1000);
+
+		out = tmpfile();
+		MetricsSink_init(&sink, MetricsSink_JSONL, out, 64, 1);
+		BPTrainer trainer;
+		BPTrainer_init(&trainer, &net, &async.provider, *squaredError);
+		BPTrainer_setMetrics(&trainer, &sink, 30);
+		BPTrainer_trainOnline(&trainer, 0.001, 0, 0);
+		MetricsSink_deinit(&sink);
+
+		rewind(out);
+		unsigned long int samples[4];
+		lines = 0;
+		while (fgets(line, 256, out) != NULL && lines < 4) {
+			assertIntEqual(1, sscanf(line, "{\"samples\":%lu,", samples + lines), t, "B1");
+			lines++;
+		}
+		assertIntEqual(4, lines, t, "B2"); //30, 60, 90 and the last 10
+		assertIntEqual(30, samples[0], t, "B3");
+		assertIntEqual(100, samples[3], t, "B4");
+
+		fclose(out);
+		BPTrainer_deinit(&trainer);
+		AsyncDataProvider_deinit(&async);
+		NeuralNetwork_deinit(&net);
+	}
+
+
+	void testBestTracking(TestCase *t) {
+		NeuralNetwork net;
+		createIdentityNetwork(&net);
+		NeuronUnit rows[2*10];
+		for (int i=0; i<10; ++i) {
+			rows[2*i] = i / 10.0;
+			rows[2*i + 1] = -i / 10.0 + ((i % 3) - 1) * 0.05; //noisy target
+		}
+		TrainDataSet set;
+		TrainDataSet_init(&set, rows, 10, 1, 1);
+		TrainDataProvider provider;
+		srand(7); //the same sample order and start weights for both runs, so that their copies can be compared
+		TrainDataProvider_initIndexed(&provider, *TrainDataSet_provideSample, &set, 1, 10, 200, 0);
+		NeuronUnit start[2] = {0, 0};
+
+		//raw tracking: a copy for every new minimum, and the minimum is a single sample's error
+		NeuralNetwork_loadSynapseWeights(&net, start);
+		BPTrainer trainer;
+		BPTrainer_init(&trainer, &net, &provider, *squaredError);
+		BPTrainer_setBestTracking(&trainer, 1, 0);
+		BPTrainer_trainOnline(&trainer, 0.05, 0, 0);
+		unsigned long int rawCopies = trainer.snapshotCount;
+		assertIntEqual(1, rawCopies >= 2, t, "A1");
+		BPTrainer_deinit(&trainer);
+
+		//smoothed tracking: at most one copy per 50 samples
+		NeuralNetwork_deinit(&net);
+		createIdentityNetwork(&net);
+		NeuralNetwork_loadSynapseWeights(&net, start);
+		TrainDataProvider_reset(&provider, 200);
+		BPTrainer_init(&trainer, &net, &provider, *squaredError);
+		BPTrainer_setBestTracking(&trainer, 0.05, 50);
+		BPTrainer_trainOnline(&trainer, 0.05, 0, 0);
+		assertIntEqual(1, trainer.snapshotCount >= 1 && trainer.snapshotCount <= 4, t, "B1");
+		assertIntEqual(1, trainer.snapshotCount < rawCopies, t, "B2");
+		assertIntEqual(1, trainer.minimum.error < 999, t, "B3");
+
+		//Optimizer_KEEP leaves the hyperparameters of the optimizer, explicit values replace them
+		BPTrainer_setOptimizer(&trainer, Optimizer_ADAM);
+		TrainDataProvider_reset(&provider, 10);
+		BPTrainer_trainOnline(&trainer, Optimizer_KEEP, Optimizer_KEEP, 0);
+		assertDoubleEqual(0.001, trainer.optimizer.learningRate, 0, t, "C1");
+		BPTrainer_setOptimizer(&trainer, Optimizer_NESTEROV);
+		TrainDataProvider_reset(&provider, 10);
+		BPTrainer_trainStochastic(&trainer, 5, 0.02, Optimizer_KEEP, 0);
+		assertDoubleEqual(0.02, trainer.optimizer.learningRate, 0, t, "C2");
+		assertDoubleEqual(0.9, trainer.optimizer.momentum, 0, t, "C3");
+
+		BPTrainer_deinit(&trainer);
+		TrainDataProvider_deinit(&provider);
+		TrainDataSet_deinit(&set);
+		NeuralNetwork_deinit(&net);
+	}
+
+
+	void testEvaluate(TestCase *t) {
+		NeuralNetwork net;
+		createIdentityNetwork(&net);
+		NeuronUnit weights[2] = {1, 0};
+		NeuralNetwork_loadSynapseWeights(&net, weights);
+
+		NeuronUnit rows[2*4] = {
+			0.1, 0,
+			0.7, 1,
+			0.6, 0,
+			0.2, 1
+		};
+		TrainDataSet set;
+		TrainDataSet_init(&set, rows, 4, 1, 1);
+		TrainDataProvider provider;
+		TrainDataProvider_initIndexed(&provider, *TrainDataSet_provideSample, &set, 1, 4, 4, 0);
+
+		EvaluationMetrics metrics;
+		EvaluationMetrics_init(&metrics, 1);
+		assertIntEqual(2, metrics.classCount, t, "A1");
+
+		NeuralNetwork_evaluate(&net, &provider, *squaredError, &metrics);
+		assertIntEqual(4, metrics.sampleCount, t, "B1");
+		assertDoubleEqual((0.01 + 0.09 + 0.36 + 0.64) / 4, metrics.loss, 0.00001, t, "B2");
+		assertDoubleEqual(0.5, metrics.accuracy, 0.00001, t, "B3");
+		assertDoubleEqual((0.1 + 0.3 + 0.6 + 0.8) / 4, metrics.meanAbsoluteError[0], 0.00001, t, "B4");
+		for (int i=0; i<4; ++i) assertIntEqual(1, metrics.confusion[i], t, "B5");
+
+		//several batches: the sums are reduced over all of them
+		TrainDataProvider_reset(&provider, 10000);
+		NeuralNetwork_evaluate(&net, &provider, *squaredError, &metrics);
+		assertIntEqual(10000, metrics.sampleCount, t, "C1");
+		assertDoubleEqual((0.01 + 0.09 + 0.36 + 0.64) / 4, metrics.loss, 0.00001, t, "C2");
+		assertDoubleEqual(0.5, metrics.accuracy, 0.00001, t, "C3");
+		for (int i=0; i<4; ++i) assertIntEqual(2500, metrics.confusion[i], t, "C4");
+
+		//the network is not trained by the evaluation
+		NeuralNetwork_saveSynapseWeights(&net, weights);
+		assertDoubleEqual(1, weights[0], 0, t, "D1");
+		assertDoubleEqual(0, weights[1], 0, t, "D2");
+
+		//a kept evaluator predicts with the current weights at every run
+		NetworkEvaluator evaluator;
+		NetworkEvaluator_init(&evaluator, &net, 2);
+		TrainDataProvider_reset(&provider, 4);
+		NetworkEvaluator_run(&evaluator, &provider, *squaredError, &metrics);
+		assertDoubleEqual((0.01 + 0.09 + 0.36 + 0.64) / 4, metrics.loss, 0.00001, t, "E1");
+		NeuronUnit constant[2] = {0, 0.5};
+		NeuralNetwork_loadSynapseWeights(&net, constant);
+		TrainDataProvider_reset(&provider, 4);
+		NetworkEvaluator_run(&evaluator, &provider, *squaredError, &metrics);
+		assertIntEqual(4, metrics.sampleCount, t, "E2");
+		assertDoubleEqual(0.25, metrics.loss, 0.00001, t, "E3");
+		assertDoubleEqual(0.5, metrics.meanAbsoluteError[0], 0.00001, t, "E4");
+		NetworkEvaluator_deinit(&evaluator);
+
+		EvaluationMetrics_deinit(&metrics);
+		TrainDataProvider_deinit(&provider);
+		TrainDataSet_deinit(&set);
+		NeuralNetwork_deinit(&net);
+	}
+
+
+	char provideNothing(TrainDataProvider* provider, NeuralNetwork* net) {
+		return 0;
+	}
+
+	void testTrainingController(TestCase *t) {
+		NeuralNetwork net;
+		createIdentityNetwork(&net);
+		NeuronUnit rows[2*10];
+		for (int i=0; i<10; ++i) {
+			rows[2*i] = i / 10.0;
+			rows[2*i + 1] = 0.5 * i / 10.0 + 0.1;
+		}
+		TrainDataSet set;
+		TrainDataSet_init(&set, rows, 10, 1, 1);
+		TrainDataProvider provider;
+		TrainDataProvider_initIndexed(&provider, *TrainDataSet_provideSample, &set, 1, 10, 10, 0);
+		BPTrainer trainer;
+		BPTrainer_init(&trainer, &net, &provider, *squaredError);
+		TrainingController controller;
+
+		//target loss: stops as soon as an epoch is good enough
+		TrainingController_init(&controller, &trainer, 0);
+		assertIntEqual(10, controller.epochSamples, t, "A1");
+		controller.maxEpochs = 1000;
+		controller.targetLoss = 0.0001;
+		controller.patience = 0;
+		assertIntEqual(TrainingController_TARGET_REACHED, TrainingController_run(&controller), t, "A2");
+		assertIntEqual(1, controller.epoch < 1000, t, "A3");
+		assertIntEqual(1, controller.lastLoss <= 0.0001, t, "A4");
+		assertIntEqual(controller.epoch * 10, controller.samples, t, "A5");
+
+		//sample budget: the last epoch is cut short
+		TrainingController_init(&controller, &trainer, 10);
+		controller.sampleBudget = 25;
+		controller.patience = 0;
+		controller.updateEvery = 5;
+		assertIntEqual(TrainingController_SAMPLE_BUDGET, TrainingController_run(&controller), t, "B1");
+		assertIntEqual(25, controller.samples, t, "B2");
+		assertIntEqual(3, controller.epoch, t, "B3");
+
+		//step schedule: halved every 2 epochs
+		TrainingController_init(&controller, &trainer, 10);
+		controller.maxEpochs = 5;
+		controller.patience = 0;
+		controller.learningRate = 0.04;
+		TrainingController_setSchedule(&controller, LearningRateSchedule_STEP, 0.5, 2);
+		assertIntEqual(TrainingController_MAX_EPOCHS, TrainingController_run(&controller), t, "C1");
+		assertDoubleEqual(0.01, controller.currentLearningRate, 0.000001, t, "C2"); //epoch index 4
+
+		//plateau: nothing can improve with a learning rate of 0
+		TrainingController_init(&controller, &trainer, 10);
+		controller.learningRate = 0;
+		controller.minDelta = 0.001; //epochs do not start at the same sample, so the loss still moves a little
+		controller.patience = 3;
+		assertIntEqual(TrainingController_PLATEAU, TrainingController_run(&controller), t, "D1");
+		assertIntEqual(4, controller.epoch, t, "D2");
+
+		//reduce on plateau lowers the rate instead, until the patience runs out
+		TrainingController_init(&controller, &trainer, 10);
+		controller.learningRate = 0;
+		controller.minDelta = 0.001;
+		controller.patience = 4;
+		TrainingController_setSchedule(&controller, LearningRateSchedule_PLATEAU, 0.5, 2);
+		TrainingController_run(&controller);
+		assertIntEqual(5, controller.epoch, t, "E1");
+
+		//cosine: from learningRate to minLearningRate
+		TrainingController_init(&controller, &trainer, 10);
+		controller.maxEpochs = 4;
+		controller.patience = 0;
+		controller.learningRate = 0.02;
+		controller.minLearningRate = 0.01;
+		TrainingController_setSchedule(&controller, LearningRateSchedule_COSINE, 0, 0);
+		TrainingController_run(&controller);
+		assertDoubleEqual(0.01 + 0.01 * (1 + cos(M_PI * 3 / 4)) / 2, controller.currentLearningRate, 0.000001, t, "F1");
+
+		//no target loss by default
+		TrainingController_init(&controller, &trainer, 10);
+		assertIntEqual(1, controller.targetLoss == TrainingController_NO_TARGET, t, "G1");
+		controller.maxEpochs = 2;
+		controller.patience = 0;
+		assertIntEqual(TrainingController_MAX_EPOCHS, TrainingController_run(&controller), t, "G2");
+
+		//a provider without a sample count needs an explicit epoch length, and an empty epoch is not a loss
+		TrainDataProvider empty;
+		TrainDataProvider_init(&empty, *provideNothing, 1, 10);
+		BPTrainer emptyTrainer;
+		BPTrainer_init(&emptyTrainer, &net, &empty, *squaredError);
+		assertIntEqual(0, TrainingController_init(&controller, &emptyTrainer, 0), t, "H1");
+		assertIntEqual(1, TrainingController_init(&controller, &emptyTrainer, 10), t, "H2");
+		controller.targetLoss = 1;
+		assertIntEqual(TrainingController_NO_SAMPLES, TrainingController_run(&controller), t, "H3");
+		assertIntEqual(1, controller.epoch, t, "H4");
+		BPTrainer_deinit(&emptyTrainer);
+		TrainDataProvider_deinit(&empty);
+
+		BPTrainer_deinit(&trainer);
+		TrainDataProvider_deinit(&provider);
+		TrainDataSet_deinit(&set);
+		NeuralNetwork_deinit(&net);
+	}
+
+
+	void testBatchSizeSchedule(TestCase *t) {
+		//|G|^2 = 1 and tr(S) = 20: E|G_5|^2 = 1 + 20/5, E|G_10|^2 = 1 + 20/10. The noise scale is 20
+		BatchSizeSchedule schedule;
+		BatchSizeSchedule_init(&schedule, BatchSizeSchedule_NOISE, 4, 64, BatchSizeSchedule_SCALE_LINEAR);
+		assertIntEqual(4, BatchSizeSchedule_update(&schedule, 0), t, "A1");
+		for (int i=0; i<5; ++i) BatchSizeSchedule_observe(&schedule, 5, 5, 3, 10);
+		assertDoubleEqual(20, schedule.noiseScale, 0.00001, t, "A2");
+		assertIntEqual(20, BatchSizeSchedule_update(&schedule, 100), t, "A3");
+		assertDoubleEqual(5, BatchSizeSchedule_learningRateFactor(&schedule), 0.00001, t, "A4");
+
+		//never shrinks, and stays under maxBatch
+		for (int i=0; i<50; ++i) BatchSizeSchedule_observe(&schedule, 1.5, 5, 1.25, 10); //noise scale 2.5
+		assertIntEqual(20, BatchSizeSchedule_update(&schedule, 200), t, "B1");
+		for (int i=0; i<50; ++i) BatchSizeSchedule_observe(&schedule, 101, 5, 51, 10); //noise scale 500
+		assertIntEqual(64, BatchSizeSchedule_update(&schedule, 300), t, "B2");
+		schedule.learningRateScaling = BatchSizeSchedule_SCALE_SQRT;
+		assertDoubleEqual(4, BatchSizeSchedule_learningRateFactor(&schedule), 0.00001, t, "B3");
+
+		//step schedule inside the stochastic trainer: 4, 8 after 40 samples, 16 after 80, then capped
+		NeuralNetwork net;
+		createIdentityNetwork(&net);
+		CountingGenerator gen = { .produced = {0, 0}, .limit = 100 };
+		AsyncDataProvider async;
+		AsyncDataProvider_init(&async, *countingGenerate, &gen, 1, 1, 2, 16, 1000);
+		BPTrainer trainer;
+		BPTrainer_init(&trainer, &net, &async.provider, *squaredError);
+
+		BatchSizeSchedule_init(&schedule, BatchSizeSchedule_STEP, 4, 16, BatchSizeSchedule_SCALE_LINEAR);
+		schedule.growEvery = 40;
+		trainer.batchSchedule = &schedule;
+		BPTrainer_trainStochastic(&trainer, 1, 0.0001, 0, 0);
+		assertIntEqual(16, schedule.batchSize, t, "C1");
+		assertDoubleEqual(0.0001, trainer.optimizer.learningRate, 0, t, "C2"); //the scaling is undone after the run
+		assertIntEqual(1, trainer.optimizer.step < 200 / 4, t, "C3");
+
+		//noise schedule: a minBatch of 1 would have no half batch to compare
+		BatchSizeSchedule_init(&schedule, BatchSizeSchedule_NOISE, 1, 16, BatchSizeSchedule_SCALE_NONE);
+		assertIntEqual(2, schedule.minBatch, t, "D1");
+		gen.produced[0] = gen.produced[1] = 0;
+		AsyncDataProvider_deinit(&async);
+		AsyncDataProvider_init(&async, *countingGenerate, &gen, 1, 1, 2, 16, 1000);
+		BPTrainer_trainStochastic(&trainer, 1, 0.0001, 0, 0);
+		assertIntEqual(1, schedule.gradientSquare > 0, t, "D2"); //estimates were taken
+
+		BPTrainer_deinit(&trainer);
+		AsyncDataProvider_deinit(&async);
+		NeuralNetwork_deinit(&net);
+	}
+
+
+	typedef struct {
+		unsigned int calls;
+		NeuronUnit weights[2];
+	} RecordingPublisher;
+
+	void recordPublication(void* target, NeuralNetwork* network) {
+		RecordingPublisher *publisher = target;
+		publisher->calls++;
+		for (int i = 0; i < 2; ++i) publisher->weights[i] = network->synapses[i].weight;
+	}
+
+	void testBackgroundTrainer(TestCase *t) {
+		NeuralNetwork net;
+		createIdentityNetwork(&net);
+		NeuronUnit rows[2*10];
+		for (int i=0; i<10; ++i) {
+			rows[2*i] = i / 10.0;
+			rows[2*i + 1] = 0.5 * i / 10.0 + 0.1;
+		}
+		TrainDataSet set;
+		TrainDataSet_init(&set, rows, 10, 1, 1);
+		TrainDataProvider provider;
+		TrainDataProvider_initIndexed(&provider, *TrainDataSet_provideSample, &set, 1, 10, 10, 0);
+		BPTrainer trainer;
+		BPTrainer_init(&trainer, &net, &provider, *squaredError);
+		RecordingPublisher publisher = {0};
+		BackgroundTrainer background;
+		BackgroundTrainer_init(&background, &trainer, recordPublication, &publisher, 100);
+
+		//a whole run: one publication per 100 samples, and the final weights
+		TrainDataProvider_reset(&provider, 1000);
+		assertIntEqual(1, BackgroundTrainer_start(&background, 0, 0.1, 0), t, "A1");
+		BackgroundTrainer_wait(&background);
+		assertIntEqual(BackgroundTrainer_IDLE, atomic_load(&background.state), t, "A2");
+		assertIntEqual(1000, atomic_load(&background.samples), t, "A3");
+		assertIntEqual(11, publisher.calls, t, "A4");
+		assertDoubleEqual(net.synapses[0].weight, publisher.weights[0], 0, t, "A5");
+		assertDoubleEqual(net.synapses[1].weight, publisher.weights[1], 0, t, "A6");
+		assertIntEqual(1, background.loss < 0.01, t, "A7");
+		assertPtrEqual(NULL, trainer.hook, t, "A8");
+
+		//pause, resume and stop a long run
+		struct timespec pause = {0, 5000000};
+		TrainDataProvider_reset(&provider, 100000000);
+		assertIntEqual(1, BackgroundTrainer_start(&background, 0, 0.01, 0), t, "B1");
+		assertIntEqual(0, BackgroundTrainer_start(&background, 0, 0.01, 0), t, "B2");
+		BackgroundTrainer_pause(&background);
+		for (int i = 0; i < 1000 && atomic_load(&background.state) != BackgroundTrainer_PAUSED; ++i) nanosleep(&pause, NULL);
+		assertIntEqual(BackgroundTrainer_PAUSED, atomic_load(&background.state), t, "B3");
+		unsigned long int pausedAt = atomic_load(&background.samples);
+		NeuronUnit pausedWeight = net.synapses[0].weight;
+		nanosleep(&pause, NULL);
+		assertIntEqual(pausedAt, atomic_load(&background.samples), t, "B4");
+		assertDoubleEqual(pausedWeight, net.synapses[0].weight, 0, t, "B5");
+		assertDoubleEqual(pausedWeight, publisher.weights[0], 0, t, "B6");
+
+		BackgroundTrainer_resume(&background);
+		for (int i = 0; i < 1000 && atomic_load(&background.samples) == pausedAt; ++i) nanosleep(&pause, NULL);
+		assertIntEqual(1, atomic_load(&background.samples) > pausedAt, t, "B7");
+		BackgroundTrainer_stop(&background);
+		assertIntEqual(BackgroundTrainer_IDLE, atomic_load(&background.state), t, "B8");
+		assertIntEqual(1, atomic_load(&background.samples) < 100000000, t, "B9");
+
+		//stochastic: publications follow the weight updates
+		publisher.calls = 0;
+		background.publishEvery = 50;
+		TrainDataProvider_reset(&provider, 200);
+		BackgroundTrainer_start(&background, 10, 0.1, 0);
+		BackgroundTrainer_wait(&background);
+		assertIntEqual(5, publisher.calls, t, "C1");
+		assertIntEqual(200, atomic_load(&background.samples), t, "C2");
+
+		BackgroundTrainer_deinit(&background);
+		BPTrainer_deinit(&trainer);
+		TrainDataProvider_deinit(&provider);
+		TrainDataSet_deinit(&set);
+		NeuralNetwork_deinit(&net);
+	}
+
+	void testCheckpointer(TestCase *t) {
+		NeuralNetwork net;
+		createIdentityNetwork(&net);
+		NeuronUnit rows[2*10];
+		for (int i=0; i<10; ++i) {
+			rows[2*i] = i / 10.0;
+			rows[2*i + 1] = 0.5 * i / 10.0 + 0.1;
+		}
+		TrainDataSet set;
+		TrainDataSet_init(&set, rows, 10, 1, 1);
+		TrainDataProvider provider;
+		TrainDataProvider_initIndexed(&provider, *TrainDataSet_provideSample, &set, 1, 10, 10, 0);
+		BPTrainer trainer;
+		BPTrainer_init(&trainer, &net, &provider, *squaredError);
+		BPTrainer_setOptimizer(&trainer, Optimizer_ADAM);
+		BPTrainer_setBestTracking(&trainer, 1, 0);
+
+		const char *path = "/tmp/c_machine_learning_test.checkpoint";
+		remove(path);
+		Checkpointer checkpointer;
+		Checkpointer_init(&checkpointer, &net, path, 100, 0);
+		BPTrainer_setCheckpointer(&trainer, &checkpointer);
+
+		//one capture per 100 samples. The last one holds the final state
+		TrainDataProvider_reset(&provider, 1000);
+		BPTrainer_trainOnline(&trainer, 0.01, 0, 0);
+		Checkpointer_flush(&checkpointer);
+		assertIntEqual(10, atomic_load(&checkpointer.written) + atomic_load(&checkpointer.replaced), t, "A1");
+		assertIntEqual(0, atomic_load(&checkpointer.failures), t, "A2");
+		assertIntEqual(0, remove("/tmp/c_machine_learning_test.checkpoint.tmp") == 0, t, "A3");
+
+		//it is a model file too
+		NeuralNetwork loaded;
+		assertIntEqual(1, NeuralNetwork_load(&loaded, path), t, "B1");
+		assertDoubleEqual(net.synapses[0].weight, loaded.synapses[0].weight, 0, t, "B2");
+		assertDoubleEqual(net.synapses[1].weight, loaded.synapses[1].weight, 0, t, "B3");
+
+		//restore into another trainer: weights, optimizer and best weights
+		for (int i = 0; i < 2; ++i) loaded.synapses[i].weight = 0.3;
+		BPTrainer restored;
+		BPTrainer_init(&restored, &loaded, &provider, *squaredError);
+		assertIntEqual(1, BPTrainer_restoreCheckpoint(&restored, path), t, "C1");
+		assertIntEqual(Optimizer_ADAM, restored.optimizer.type, t, "C2");
+		assertIntEqual(1000, restored.optimizer.step, t, "C3");
+		assertIntEqual(1000, restored.samplesSeen, t, "C4");
+		assertDoubleEqual(trainer.minimum.error, restored.minimum.error, 0, t, "C5");
+		for (int i = 0; i < 2; ++i) {
+			assertDoubleEqual(net.synapses[i].weight, loaded.synapses[i].weight, 0, t, "C6");
+			assertDoubleEqual(trainer.optimizer.state1[i], restored.optimizer.state1[i], 0, t, "C7");
+			assertDoubleEqual(trainer.optimizer.state2[i], restored.optimizer.state2[i], 0, t, "C8");
+			assertDoubleEqual(trainer.minimum.weights[i], restored.minimum.weights[i], 0, t, "C9");
+		}
+
+		//the next run continues the checkpointed one
+		TrainDataProvider_reset(&provider, 10);
+		BPTrainer_trainOnline(&restored, 0.01, 0, 0);
+		assertIntEqual(1010, restored.optimizer.step, t, "D1");
+		assertIntEqual(1010, restored.samplesSeen, t, "D2");
+		TrainDataProvider_reset(&provider, 10);
+		BPTrainer_trainOnline(&restored, 0.01, 0, 0);
+		assertIntEqual(10, restored.optimizer.step, t, "D3");
+
+		//plain model files and other topologies are refused
+		BPTrainer_setCheckpointer(&trainer, NULL);
+		Checkpointer_deinit(&checkpointer);
+		assertIntEqual(1, NeuralNetwork_save(&net, path), t, "E1");
+		assertIntEqual(0, BPTrainer_restoreCheckpoint(&restored, path), t, "E2");
+		NeuralNetwork simple;
+		createSimpleNetwork(&simple);
+		BPTrainer other;
+		BPTrainer_init(&other, &simple, &provider, *squaredError);
+		Checkpointer_init(&checkpointer, &net, path, 0, 0);
+		Checkpointer_capture(&checkpointer, &trainer);
+		Checkpointer_deinit(&checkpointer);
+		assertIntEqual(0, BPTrainer_restoreCheckpoint(&other, path), t, "E3");
+		assertIntEqual(1, BPTrainer_restoreCheckpoint(&restored, path), t, "E4");
+
+		remove(path);
+		BPTrainer_deinit(&other);
+		NeuralNetwork_deinit(&simple);
+		BPTrainer_deinit(&restored);
+		NeuralNetwork_deinit(&loaded);
+		BPTrainer_deinit(&trainer);
+		TrainDataProvider_deinit(&provider);
+		TrainDataSet_deinit(&set);
+		NeuralNetwork_deinit(&net);
+	}
+
+//SERVER TESTS
+	void testInferenceServer(TestCase *t) {
+		NeuralNetwork net;
+		createSimpleNetwork(&net);
+		NeuronUnit inputs[16];
+		NeuronUnit expected[16];
+		for (int b = 0; b < 8; ++b) {
+			inputs[2*b] = b * 0.3 - 1;
+			inputs[2*b + 1] = 0.5 - b * 0.1;
+			net.layers[0].neurons[0].out = inputs[2*b];
+			net.layers[0].neurons[1].out = inputs[2*b + 1];
+			NeuralNetwork_predict(&net);
+			expected[2*b] = net.layers[3].neurons[0].out;
+			expected[2*b + 1] = net.layers[3].neurons[1].out;
+		}
+
+		SharedModel model;
+		SharedModel_init(&model, &net);
+		InferenceServer server;
+		assertIntEqual(1, InferenceServer_init(&server, &model, 4, 50000, 64), t, "A0");
+		assertIntEqual(1, InferenceServer_listenUnix(&server, "/tmp/c_machine_learning_test.sock"), t, "A1");
+		InferenceClient client;
+		assertIntEqual(1, InferenceClient_connectUnix(&client, "/tmp/c_machine_learning_test.sock"), t, "A2");
+
+		//pipelined requests fill up two whole batches
+		for (int b = 0; b < 8; ++b) assertIntEqual(b, InferenceClient_send(&client, inputs + 2*b, 2), t, "B1");
+		for (int b = 0; b < 8; ++b) {
+			uint32_t id;
+			NeuronUnit outputs[2];
+			assertIntEqual(InferenceServer_OK, InferenceClient_receive(&client, &id, outputs, 2), t, "B2");
+			assertIntEqual(1, id < 8, t, "B3");
+			assertDoubleEqual(expected[2*id], outputs[0], 0.000000000001, t, "B4");
+			assertDoubleEqual(expected[2*id + 1], outputs[1], 0.000000000001, t, "B5");
+		}
+
+		InferenceServerStats stats;
+		unsigned long int batchSizes[5];
+		InferenceServer_getStats(&server, &stats, batchSizes);
+		assertIntEqual(8, stats.requests, t, "C1");
+		assertIntEqual(2, stats.batches, t, "C2");
+		assertIntEqual(2, batchSizes[4], t, "C3");
+
+		//a lonely request waits for maxDelayUs
+		NeuronUnit outputs[2];
+		assertIntEqual(InferenceServer_OK, InferenceClient_predict(&client, inputs, 2, outputs, 2), t, "D1");
+		assertDoubleEqual(expected[0], outputs[0], 0.000000000001, t, "D2");
+		InferenceServer_getStats(&server, &stats, batchSizes);
+		assertIntEqual(1, batchSizes[1], t, "D3");
+		assertIntEqual(1, InferenceServer_latencyPercentile(&stats, 0.99) >= 50000, t, "D4");
+
+		//wrong input count
+		assertIntEqual(InferenceServer_BAD_REQUEST, InferenceClient_predict(&client, inputs, 3, outputs, 2), t, "E1");
+		InferenceServer_getStats(&server, &stats, batchSizes);
+		assertIntEqual(1, stats.rejected, t, "E2");
+		assertIntEqual(InferenceServer_OK, InferenceClient_predict(&client, inputs + 2, 2, outputs, 2), t, "E3");
+		assertDoubleEqual(expected[2], outputs[0], 0.000000000001, t, "E4");
+
+		//a client that never reads its answers is dropped, instead of stalling the batcher and the other clients
+		InferenceClient greedy;
+		assertIntEqual(1, InferenceClient_connectUnix(&greedy, "/tmp/c_machine_learning_test.sock"), t, "F1");
+		struct timeval timeout = { 2, 0 };
+		setsockopt(greedy.fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+		int sent = 0;
+		while (sent < 100000 && InferenceClient_send(&greedy, inputs, 2) >= 0) sent++;
+		assertIntEqual(1, sent < 100000, t, "F2");
+		InferenceServer_getStats(&server, &stats, batchSizes);
+		assertIntEqual(1, stats.dropped, t, "F3");
+		int status = InferenceServer_OVERLOADED;
+		for (int attempt = 0; attempt < 100 && status == InferenceServer_OVERLOADED; ++attempt) { //its last requests may still fill the queue
+			status = InferenceClient_predict(&client, inputs + 4, 2, outputs, 2);
+			if (status == InferenceServer_OVERLOADED) usleep(10000);
+		}
+		assertIntEqual(InferenceServer_OK, status, t, "F4");
+		assertDoubleEqual(expected[4], outputs[0], 0.000000000001, t, "F5");
+		InferenceClient_close(&greedy);
+
+		//stopping closes the open connections
+		InferenceServer_deinit(&server);
+		assertIntEqual(-1, InferenceClient_predict(&client, inputs, 2, outputs, 2), t, "G1");
+		InferenceClient_close(&client);
+
+		//tcp, on a free port
+		assertIntEqual(1, InferenceServer_init(&server, &model, 8, 0, 64), t, "H0");
+		assertIntEqual(1, InferenceServer_listenTcp(&server, 0), t, "H1");
+		assertIntEqual(1, server.port != 0, t, "H2");
+		assertIntEqual(1, InferenceClient_connectTcp(&client, server.port), t, "H3");
+		assertIntEqual(InferenceServer_OK, InferenceClient_predict(&client, inputs + 14, 2, outputs, 2), t, "H4");
+		assertDoubleEqual(expected[14], outputs[0], 0.000000000001, t, "H5");
+		assertDoubleEqual(expected[15], outputs[1], 0.000000000001, t, "H6");
+		InferenceClient_close(&client);
+		InferenceServer_deinit(&server);
+
+		//no server without a reader slot
+		for (int i = 0; i < SharedModel_MAX_READERS; ++i) SharedModel_register(&model);
+		assertIntEqual(0, InferenceServer_init(&server, &model, 8, 0, 64), t, "I1");
+		for (int i = 0; i < SharedModel_MAX_READERS; ++i) SharedModel_unregister(&model, i);
+
+		//the sizes are kept within bounds
+		assertIntEqual(1, InferenceServer_init(&server, &model, 100000000, 4000000000u, 4000000000u), t, "J1");
+		assertIntEqual(InferenceServer_MAX_BATCH, server.maxBatch, t, "J2");
+		assertIntEqual(InferenceServer_MAX_DELAY_US, server.maxDelayUs, t, "J3");
+		assertIntEqual(InferenceServer_MAX_QUEUE, server.queueCapacity, t, "J4");
+		FILE *statsOut = tmpfile();
+		InferenceServer_printStats(&server, statsOut);
+		fclose(statsOut);
+		InferenceServer_deinit(&server);
+
+		SharedModel_deinit(&model);
+		NeuralNetwork_deinit(&net);
+	}
+
+
+	typedef struct {
+		SharedModel *model;
+		NeuralNetwork *source;
+		atomic_char done;
+	} PublishJob;
+
+	void* publishCopy(void* arg) {
+		PublishJob *job = arg;
+		SharedModel_publishCopy(job->model, job->source);
+		atomic_store(&job->done, 1);
+		return NULL;
+	}
+
+	/** Runs a BulkPredictor over data, given as a file or through a pipe. The outputs end up in out, rewound. */
+	char runBulkPredictor(BulkPredictor* predictor, const char* data, unsigned long int size, char throughPipe, FILE* out) {
+		int fd;
+		if (throughPipe) {
+			int ends[2];
+			pipe(ends);
+			write(ends[1], data, size);
+			close(ends[1]);
+			fd = ends[0];
+		}
+		else {
+			FILE *file = fopen("/tmp/c_machine_learning_test.bulk", "wb");
+			fwrite(data, 1, size, file);
+			fclose(file);
+			fd = open("/tmp/c_machine_learning_test.bulk", O_RDONLY);
+		}
+
+		char ok = BulkPredictor_run(predictor, fd, out);
+		close(fd);
+		remove("/tmp/c_machine_learning_test.bulk");
+		rewind(out);
+		return ok;
+	}
+
+	void testBulkPredictor(TestCase *t) {
+		NeuralNetwork net;
+		createSimpleNetwork(&net);
+		NeuronUnit rows[10] = {0.5, 1, 0.25, -1, -0.5, 0.75, 1, 1, 0, -0.25};
+		NeuronUnit expected[10];
+		for (int i = 0; i < 5; ++i) {
+			net.layers[0].neurons[0].out = rows[2*i];
+			net.layers[0].neurons[1].out = rows[2*i + 1];
+			NeuralNetwork_predict(&net);
+			for (int j = 0; j < 2; ++j) expected[2*i + j] = net.layers[net.layerCount - 1].neurons[j].out;
+		}
+
+		//CSV file: blank lines, spaces, CRLF and a last line without '\n'
+		const char *csv = "0.5,1\n 0.25 , -1\r\n\n-0.5,0.75";
+		BulkPredictor predictor;
+		BulkPredictor_init(&predictor, &net, BulkPredictor_CSV, BulkPredictor_CSV, 2);
+		FILE *out = tmpfile();
+		assertIntEqual(1, runBulkPredictor(&predictor, csv, strlen(csv), 0, out), t, "A1");
+		assertIntEqual(3, predictor.rows, t, "A2");
+		assertIntEqual(2, predictor.batches, t, "A3");
+		assertIntEqual(1, predictor.mapped, t, "A4");
+		for (int i = 0; i < 3; ++i) {
+			double values[2] = {0, 0};
+			assertIntEqual(2, fscanf(out, "%lf,%lf", values, values + 1), t, "A5");
+			assertDoubleEqual(expected[2*i], values[0], 1e-8, t, "A6");
+			assertDoubleEqual(expected[2*i + 1], values[1], 1e-8, t, "A7");
+		}
+		fclose(out);
+
+		//the same through a pipe, written as binary
+		predictor.outputFormat = BulkPredictor_BINARY;
+		out = tmpfile();
+		assertIntEqual(1, runBulkPredictor(&predictor, csv, strlen(csv), 1, out), t, "B1");
+		assertIntEqual(0, predictor.mapped, t, "B2");
+		NeuronUnit outputs[10];
+		assertIntEqual(6, fread(outputs, sizeof(NeuronUnit), 10, out), t, "B3");
+		for (int i = 0; i < 6; ++i) assertDoubleEqual(expected[i], outputs[i], 0, t, "B4");
+		fclose(out);
+
+		//binary rows, from a mapped file and from a pipe
+		predictor.inputFormat = BulkPredictor_BINARY;
+		for (int throughPipe = 0; throughPipe < 2; ++throughPipe) {
+			out = tmpfile();
+			assertIntEqual(1, runBulkPredictor(&predictor, (const char*) rows, sizeof(rows), throughPipe, out), t, "C1");
+			assertIntEqual(5, predictor.rows, t, "C2");
+			assertIntEqual(3, predictor.batches, t, "C3");
+			assertIntEqual(!throughPipe, predictor.mapped, t, "C4");
+			assertIntEqual(10, fread(outputs, sizeof(NeuronUnit), 10, out), t, "C5");
+			for (int i = 0; i < 10; ++i) assertDoubleEqual(expected[i], outputs[i], 0, t, "C6");
+			fclose(out);
+		}
+
+		//bad input: the rows before it are still written
+		for (int throughPipe = 0; throughPipe < 2; ++throughPipe) {
+			out = tmpfile();
+			assertIntEqual(0, runBulkPredictor(&predictor, (const char*) rows, 5 * sizeof(NeuronUnit), throughPipe, out), t, "D1");
+			assertIntEqual(2, predictor.rows, t, "D2");
+			assertIntEqual(3, predictor.errorRow, t, "D3");
+			fclose(out);
+		}
+
+		const char *badCsv = "1,2\n1,x\n3,4\n";
+		predictor.inputFormat = BulkPredictor_CSV;
+		predictor.outputFormat = BulkPredictor_CSV;
+		out = tmpfile();
+		assertIntEqual(0, runBulkPredictor(&predictor, badCsv, strlen(badCsv), 0, out), t, "E1");
+		assertIntEqual(1, predictor.rows, t, "E2");
+		assertIntEqual(2, predictor.errorRow, t, "E3");
+		fclose(out);
+
+		//batch sizes are kept within bounds
+		BulkPredictor_init(&predictor, &net, BulkPredictor_CSV, BulkPredictor_CSV, 4000000000u);
+		assertIntEqual(BulkPredictor_MAX_BATCH, predictor.batchSize, t, "F1");
+		BulkPredictor_init(&predictor, &net, BulkPredictor_CSV, BulkPredictor_CSV, 0);
+		assertIntEqual(1, predictor.batchSize, t, "F2");
+
+		NeuralNetwork_deinit(&net);
+	}
+
+	void testSharedModel(TestCase *t) {
+		NeuralNetwork net;
+		createSimpleNetwork(&net);
+		NeuronUnit inputs[2] = {0.4, 0.6};
+		NeuronUnit outputs[2];
+		NeuronUnit *scratch = malloc(NeuralNetwork_batchScratchSize(&net, 1) * sizeof(NeuronUnit));
+		NeuralNetwork_predictBatch(&net, inputs, 1, outputs, scratch);
+		NeuronUnit oldOutput = outputs[0];
+
+		SharedModel model;
+		SharedModel_init(&model, &net);
+		int slot = SharedModel_register(&model);
+		assertIntEqual(0, slot, t, "A1");
+		assertIntEqual(1, atomic_load(&model.version), t, "A2");
+
+		//a reader keeps its network while a new one is published
+		NeuralNetwork *held = SharedModel_acquire(&model, slot);
+		for (unsigned long int i = 0; i < net.synapseCount; ++i) net.synapses[i].weight += 0.5;
+		PublishJob job = { &model, &net, 0 };
+		pthread_t publisher;
+		pthread_create(&publisher, NULL, publishCopy, &job);
+		struct timespec pause = {0, 20000000};
+		nanosleep(&pause, NULL);
+		assertIntEqual(0, atomic_load(&job.done), t, "B1");
+		assertIntEqual(2, atomic_load(&model.version), t, "B2");
+		NeuralNetwork_predictBatch(held, inputs, 1, outputs, scratch);
+		assertDoubleEqual(oldOutput, outputs[0], 0, t, "B3");
+
+		//and the old one is freed once the reader lets go
+		SharedModel_release(&model, slot);
+		pthread_join(publisher, NULL);
+		assertIntEqual(1, atomic_load(&job.done), t, "C1");
+		NeuralNetwork_predictBatch(&net, inputs, 1, outputs, scratch);
+		NeuronUnit newOutput = outputs[0];
+		NeuralNetwork_predictBatch(SharedModel_acquire(&model, slot), inputs, 1, outputs, scratch);
+		SharedModel_release(&model, slot);
+		assertDoubleEqual(newOutput, outputs[0], 0, t, "C2");
+		assertIntEqual(1, newOutput != oldOutput, t, "C3");
+
+		//other inputs or outputs are refused
+		NeuralNetwork other;
+		createIdentityNetwork(&other);
+		NeuralNetwork *copy = malloc(sizeof(NeuralNetwork));
+		NeuralNetwork_initCopy(copy, &other);
+		assertIntEqual(0, SharedModel_publish(&model, copy), t, "D1");
+		assertIntEqual(2, atomic_load(&model.version), t, "D2");
+
+		//published weights alternate between two networks
+		assertIntEqual(1, SharedModel_publishWeights(&model, &net), t, "D3");
+		NeuralNetwork *first = atomic_load(&model.current);
+		net.synapses[0].weight = 7;
+		assertIntEqual(1, SharedModel_publishWeights(&model, &net), t, "D4");
+		NeuralNetwork *second = atomic_load(&model.current);
+		assertDoubleEqual(7, second->synapses[0].weight, 0, t, "D5");
+		assertIntEqual(1, SharedModel_publishWeights(&model, &net), t, "D6");
+		assertPtrEqual(first, atomic_load(&model.current), t, "D7");
+		assertIntEqual(1, first != second, t, "D8");
+		assertIntEqual(5, atomic_load(&model.version), t, "D9");
+
+		//slots are reused
+		SharedModel_unregister(&model, slot);
+		assertIntEqual(0, SharedModel_register(&model), t, "E1");
+		assertIntEqual(1, SharedModel_register(&model), t, "E2");
+
+		//a watcher publishes every new version of the file
+		char *path = "/tmp/c_machine_learning_test.nnw";
+		remove(path);
+		ModelWatcher watcher;
+		ModelWatcher_init(&watcher, &model, path, 5);
+		assertIntEqual(1, NeuralNetwork_save(&net, path), t, "F1");
+		for (int i = 0; i < 400 && atomic_load(&model.version) < 6; ++i) nanosleep(&pause, NULL);
+		assertIntEqual(6, atomic_load(&model.version), t, "F2");
+		assertIntEqual(1, atomic_load(&watcher.loads), t, "F3");
+
+		//a corrupt file is skipped, and the current version stays
+		FILE *file = fopen(path, "wb");
+		fwrite("NNW1 garbage", 1, 12, file);
+		fclose(file);
+		for (int i = 0; i < 400 && atomic_load(&watcher.failures) < 1; ++i) nanosleep(&pause, NULL);
+		assertIntEqual(1, atomic_load(&watcher.failures), t, "G1");
+		assertIntEqual(6, atomic_load(&model.version), t, "G2");
+
+		ModelWatcher_deinit(&watcher);
+		remove(path);
+		SharedModel_deinit(&model);
+		NeuralNetwork_deinit(&other);
+		free(scratch);
+		NeuralNetwork_deinit(&net);
+	}
+
+
 
 int main() {
 	TestCase t;
@@ -973,4 +2721,83 @@ int main() {
 
 	t.name = "testNetworkPropagations";
 	testNetworkPropagations(&t);
+
+	t.name = "testNetworkCopy";
+	testNetworkCopy(&t);
+
+	t.name = "testNetworkStats";
+	testNetworkStats(&t);
+
+	t.name = "testPredictBatch";
+	testPredictBatch(&t);
+
+	t.name = "testNetworkFile";
+	testNetworkFile(&t);
+
+	t.name = "testGenerateC";
+	testGenerateC(&t);
+
+	t.name = "testNetworkPlan";
+	testNetworkPlan(&t);
+
+	t.name = "testNetworkOptimizer";
+	testNetworkOptimizer(&t);
+
+	t.name = "testNetworkPruner";
+	testNetworkPruner(&t);
+
+	t.name = "testNeuronPruner";
+	testNeuronPruner(&t);
+
+
+//TRAINING
+	t.name = "testIndexedProvider";
+	testIndexedProvider(&t);
+
+	t.name = "testAsyncProvider";
+	testAsyncProvider(&t);
+
+	t.name = "testOptimizers";
+	testOptimizers(&t);
+
+	t.name = "testLBFGSTrainer";
+	testLBFGSTrainer(&t);
+
+	t.name = "testLMTrainer";
+	testLMTrainer(&t);
+
+	t.name = "testTracer";
+	testTracer(&t);
+
+	t.name = "testMetricsSink";
+	testMetricsSink(&t);
+
+	t.name = "testBestTracking";
+	testBestTracking(&t);
+
+	t.name = "testEvaluate";
+	testEvaluate(&t);
+
+	t.name = "testTrainingController";
+	testTrainingController(&t);
+
+	t.name = "testBatchSizeSchedule";
+	testBatchSizeSchedule(&t);
+
+	t.name = "testBackgroundTrainer";
+	testBackgroundTrainer(&t);
+
+	t.name = "testCheckpointer";
+	testCheckpointer(&t);
+
+
+//SERVER
+	t.name = "testInferenceServer";
+	testInferenceServer(&t);
+
+	t.name = "testSharedModel";
+	testSharedModel(&t);
+
+	t.name = "testBulkPredictor";
+	testBulkPredictor(&t);
 }